@@ -24,6 +24,7 @@
 #include "pandora_windows_service.h"
 #include "ssh/pandora_ssh_test.h"
 #include "ftp/pandora_ftp_test.h"
+#include "modules/pandora_conf_check.h"
 #ifdef __DEBUG__
 	#include "debug_new.h"
 #endif
@@ -38,6 +39,7 @@ using namespace Pandora;
 #define FTP_TEST_CMDLINE_PARAM           "--test-ftp"
 #define HELP_CMDLINE_PARAM               "--help"
 #define PROCESS_CMDLINE_PARAM            "--process"
+#define CHECK_CONFIG_CMDLINE_PARAM       "--check-config"
 
 int
 main (int argc, char *argv[]) {
@@ -113,6 +115,23 @@ main (int argc, char *argv[]) {
 			}
 		
 			return 0;
+		} else if (_stricmp(argv[i], CHECK_CONFIG_CMDLINE_PARAM) == 0 && i + 1 < argc) {
+			/* Configuration check parameter */
+			Pandora_Modules::Pandora_Conf_Check conf_check;
+			bool                                valid;
+
+			valid = conf_check.check (argv[i + 1]);
+			conf_check.printReport (cout);
+
+			/* Optional snapshot of the accepted module definitions */
+			if (i + 2 < argc && ! conf_check.writeSnapshot (argv[i + 2])) {
+				cout << "Could not write " << argv[i + 2] << endl;
+				valid = false;
+			}
+
+			delete service;
+
+			return valid ? 0 : 1;
 		} else if (_stricmp(argv[i], HELP_CMDLINE_PARAM) == 0) {
 			/* Help parameter */
 			cout << "Pandora agent for Windows. ";
@@ -129,6 +148,9 @@ main (int argc, char *argv[]) {
 			cout << ": Test the FTP Pandora Agent configuration." << endl;
 			cout << "\t" << PROCESS_CMDLINE_PARAM;
 			cout << ": Run the Pandora Agent as a user process instead of a service." << endl;
+			cout << "\t" << CHECK_CONFIG_CMDLINE_PARAM << " <file> [<snapshot>]";
+			cout << ": Check a configuration file and estimate its cost per" << endl;
+			cout << "\t\tinterval, optionally writing the accepted module definitions to <snapshot>." << endl;
 		
 			return 0;
 		} else if (_stricmp(argv[i], PROCESS_CMDLINE_PARAM) == 0) {
@@ -141,7 +163,8 @@ main (int argc, char *argv[]) {
 			cout << "] [" << SERVICE_UNINSTALL_CMDLINE_PARAM;
 			cout << "] [" << SSH_TEST_CMDLINE_PARAM;
 			cout << "] [" << FTP_TEST_CMDLINE_PARAM;
-			cout << "] [" << PROCESS_CMDLINE_PARAM << "]";
+			cout << "] [" << PROCESS_CMDLINE_PARAM;
+			cout << "] [" << CHECK_CONFIG_CMDLINE_PARAM << " <file> [<snapshot>]]";
 			cout << endl << endl;
 			cout << "Run " << argv[0] << " with " << HELP_CMDLINE_PARAM;
 			cout << " parameter for more info." << endl;
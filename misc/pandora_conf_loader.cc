@@ -0,0 +1,202 @@
+/* Shared cache of the configuration files read by the agent.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_conf_loader.h"
+#include "md5.h"
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+/* Seconds a modification time may lag behind an edit (FAT: 2) */
+#define CONF_MTIME_GRANULARITY 2
+
+using namespace Pandora;
+
+/**
+ * Creates an empty configuration cache.
+ */
+Pandora_Conf_Loader::Pandora_Conf_Loader () {
+}
+
+/**
+ * Get the configuration cache.
+ *
+ * @return The configuration cache.
+ */
+Pandora_Conf_Loader *
+Pandora_Conf_Loader::getInstance () {
+	static Pandora_Conf_Loader *loader = NULL;
+
+	if (loader)
+		return loader;
+	loader = new Pandora_Conf_Loader ();
+	return loader;
+}
+
+/**
+ * Get the cached contents of a file, reading it if it has changed.
+ *
+ * @param filename Path of the file.
+ *
+ * @return The cached file, or NULL if the file could not be read.
+ */
+Pandora_Conf_Loader::Conf_File *
+Pandora_Conf_Loader::load (string filename) {
+	map<string, Conf_File>::iterator iter;
+	Conf_File                       *conf_file;
+	struct stat                      file_stat;
+	time_t                           read_time;
+	ostringstream                    contents;
+	md5_state_t                      pms;
+	md5_byte_t                       digest[16];
+	char                             md5[33];
+	size_t                           i;
+
+	if (stat (filename.c_str (), &file_stat) != 0) {
+		this->files.erase (filename);
+		return NULL;
+	}
+
+	/* Unchanged since the last read. A read too close to the
+	   modification time may have missed a later edit of the same
+	   size within the same mtime tick, so it is not trusted. */
+	iter = this->files.find (filename);
+	if (iter != this->files.end () &&
+	    iter->second.size == file_stat.st_size &&
+	    iter->second.mtime == file_stat.st_mtime &&
+	    iter->second.read_time - iter->second.mtime >= CONF_MTIME_GRANULARITY) {
+		return &(iter->second);
+	}
+
+	read_time = time (NULL);
+	ifstream file (filename.c_str (), ios::binary);
+	if (! file.is_open ()) {
+		this->files.erase (filename);
+		return NULL;
+	}
+	contents << file.rdbuf ();
+	file.close ();
+
+	conf_file = &(this->files[filename]);
+	conf_file->size  = file_stat.st_size;
+	conf_file->mtime = file_stat.st_mtime;
+	conf_file->read_time = read_time;
+	conf_file->data  = contents.str ();
+
+	/* Hash the same buffer */
+	md5_init (&pms);
+	md5_append (&pms, (const md5_byte_t *) conf_file->data.c_str (), conf_file->data.size ());
+	md5_finish (&pms, digest);
+	for (i = 0; i < 16; i++) {
+		sprintf (md5 + (i << 1), "%.2x", (unsigned int) digest[i]);
+	}
+	conf_file->md5 = md5;
+
+	/* The consumers parse it line by line, as if read in text mode */
+	conf_file->text.erase ();
+	conf_file->text.reserve (conf_file->data.size ());
+	for (i = 0; i < conf_file->data.size (); i++) {
+		if (conf_file->data[i] == '\r' && i + 1 < conf_file->data.size () &&
+		    conf_file->data[i + 1] == '\n') {
+			continue;
+		}
+		conf_file->text += conf_file->data[i];
+	}
+
+	return conf_file;
+}
+
+/**
+ * Get the contents of a configuration file.
+ *
+ * @param filename Path of the file.
+ * @param text Where the contents are copied, with LF line endings.
+ *
+ * @return False if the file could not be read.
+ */
+bool
+Pandora_Conf_Loader::getText (string filename, string &text) {
+	Conf_File *conf_file;
+
+	conf_file = this->load (filename);
+	if (conf_file == NULL) {
+		text = "";
+		return false;
+	}
+
+	text = conf_file->text;
+	return true;
+}
+
+/**
+ * Get the raw contents of a configuration file.
+ *
+ * @param filename Path of the file.
+ * @param data Where the contents are copied.
+ *
+ * @return False if the file could not be read.
+ */
+bool
+Pandora_Conf_Loader::getData (string filename, string &data) {
+	Conf_File *conf_file;
+
+	conf_file = this->load (filename);
+	if (conf_file == NULL) {
+		data = "";
+		return false;
+	}
+
+	data = conf_file->data;
+	return true;
+}
+
+/**
+ * Get the md5 hash of a configuration file.
+ *
+ * @param filename Path of the file.
+ *
+ * @return The 32 digit hexadecimal md5 of the raw contents, or an
+ *         empty string if the file could not be read.
+ */
+string
+Pandora_Conf_Loader::getMd5 (string filename) {
+	Conf_File *conf_file;
+
+	conf_file = this->load (filename);
+	if (conf_file == NULL) {
+		return "";
+	}
+
+	return conf_file->md5;
+}
+
+/**
+ * Discard the cached contents of a file.
+ *
+ * Must be called after rewriting a file, since the modification time
+ * may not change if it is rewritten within the same second.
+ *
+ * @param filename Path of the file.
+ */
+void
+Pandora_Conf_Loader::invalidate (string filename) {
+	this->files.erase (filename);
+}
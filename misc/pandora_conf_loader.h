@@ -0,0 +1,68 @@
+/* Shared cache of the configuration files read by the agent.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_CONF_LOADER_H__
+#define	__PANDORA_CONF_LOADER_H__
+
+#include <sys/types.h>
+#include <time.h>
+#include <string>
+#include <map>
+
+using namespace std;
+
+namespace Pandora {
+	/**
+	 * Cache of the configuration files read by the agent.
+	 *
+	 * Each file is read once and hashed in the same pass. The same
+	 * contents are then handed to every consumer (agent configuration,
+	 * broker agents, module list, remote configuration check...).
+	 * A file is only read again when its size or modification time
+	 * change, or when it is invalidated after being rewritten. A file
+	 * read within a couple of seconds of its modification time is
+	 * read again on every request until it settles, since a same size
+	 * edit within the same mtime tick would leave both unchanged.
+	 */
+	class Pandora_Conf_Loader {
+	private:
+		typedef struct {
+			off_t  size;
+			time_t mtime;
+			time_t read_time; /* When the contents were read */
+			string data; /* Raw contents */
+			string text; /* Contents with LF line endings */
+			string md5;
+		} Conf_File;
+
+		map<string, Conf_File> files;
+
+		Pandora_Conf_Loader           ();
+		Conf_File *load               (string filename);
+	public:
+		static Pandora_Conf_Loader *getInstance ();
+
+		bool       getText            (string filename, string &text);
+		bool       getData            (string filename, string &data);
+		string     getMd5             (string filename);
+		void       invalidate         (string filename);
+	};
+}
+
+#endif /* __PANDORA_CONF_LOADER_H__ */
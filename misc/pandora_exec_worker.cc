@@ -0,0 +1,236 @@
+/* Persistent shell to run the exec module commands.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_exec_worker.h"
+#include "pandora_timing.h"
+
+#include <sstream>
+#include <cstdlib>
+
+/* The command of a request is grouped, so its input can be redirected
+   as a whole. On Windows ERRORLEVEL is reset first, since builtins such
+   as echo keep the one of the previous command. */
+#ifdef _WIN32
+#define WORKER_SHELL       "cmd.exe /d /q"
+#define WORKER_BEGIN       "(call ) & ("
+#define WORKER_END         ") < NUL"
+#define WORKER_STATUS      "%ERRORLEVEL%"
+#else
+#define WORKER_SHELL       "exec /bin/sh"
+#define WORKER_BEGIN       "{ "
+#define WORKER_END         "\n} < /dev/null"
+#define WORKER_STATUS      "$?"
+#endif
+
+/* Milliseconds the shell has to answer after starting */
+#define WORKER_START_TIMEOUT 10000
+
+using namespace Pandora;
+
+/**
+ * Creates a disabled worker. The shell is started with the first
+ * command.
+ */
+Pandora_Exec_Worker::Pandora_Exec_Worker () {
+	this->enabled  = false;
+	this->sequence = 0;
+	this->restarts = 0;
+}
+
+/**
+ * Destroys the worker, killing the shell.
+ */
+Pandora_Exec_Worker::~Pandora_Exec_Worker () {
+	this->shell.stop ();
+}
+
+/**
+ * Get the agent worker.
+ *
+ * @return The worker.
+ */
+Pandora_Exec_Worker *
+Pandora_Exec_Worker::getInstance () {
+	static Pandora_Exec_Worker *worker = NULL;
+
+	if (worker)
+		return worker;
+	worker = new Pandora_Exec_Worker ();
+	return worker;
+}
+
+/**
+ * Enable or disable the worker. Disabling it kills the shell.
+ *
+ * @param enabled True to run the commands in the worker.
+ */
+void
+Pandora_Exec_Worker::setEnabled (bool enabled) {
+	this->enabled = enabled;
+	if (! enabled) {
+		this->shell.stop ();
+	}
+}
+
+/**
+ * Check if the worker is enabled.
+ *
+ * @return True if the commands should be run in the worker.
+ */
+bool
+Pandora_Exec_Worker::isEnabled () const {
+	return this->enabled;
+}
+
+/**
+ * Set the working directory of the shell. It is restarted if the
+ * directory changes.
+ *
+ * @param working_dir Working directory.
+ */
+void
+Pandora_Exec_Worker::setWorkingDir (string working_dir) {
+	if (working_dir != this->working_dir) {
+		this->working_dir = working_dir;
+		this->shell.stop ();
+	}
+}
+
+/**
+ * Set the environment of the shell. It is restarted if the
+ * environment changes.
+ *
+ * @param environment Environment block: NUL terminated "NAME=value"
+ *        entries. If empty, the shell inherits the agent environment.
+ */
+void
+Pandora_Exec_Worker::setEnvironment (string environment) {
+	if (environment != this->environment) {
+		this->environment = environment;
+		this->shell.stop ();
+	}
+}
+
+/**
+ * Get the number of times the shell was killed because it did not
+ * answer in time or it died.
+ *
+ * @return Number of restarts.
+ */
+unsigned long
+Pandora_Exec_Worker::getRestarts () const {
+	return this->restarts;
+}
+
+/**
+ * Get a new end of output marker.
+ *
+ * @return A marker that cannot be found in the output of the
+ *         previous commands.
+ */
+string
+Pandora_Exec_Worker::getMarker () {
+	ostringstream marker;
+
+	this->sequence++;
+	marker << "__pandora_worker_" << Pandora_Timing::getMicroseconds () << "_" << this->sequence << "__";
+	return marker.str ();
+}
+
+/**
+ * Start the shell and wait until it reads commands.
+ *
+ * @return False if the shell could not be started.
+ */
+bool
+Pandora_Exec_Worker::start () {
+	string marker, banner, trailer;
+
+	if (! this->shell.start (WORKER_SHELL, this->working_dir, this->environment)) {
+		this->shell.stop ();
+		return false;
+	}
+
+	/* Skip the banner */
+	marker = this->getMarker ();
+	if (! this->shell.write ("echo " + marker + " 0\n") ||
+	    this->shell.readUntil (marker, WORKER_START_TIMEOUT, banner, trailer) != PIPE_OK) {
+		this->shell.stop ();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Run a command in the worker shell.
+ *
+ * The shell is started if it is not running. If the command does not
+ * finish in time or the shell dies, the shell is killed and started
+ * again with the next command.
+ *
+ * @param command Command line, as it would be typed in the shell.
+ * @param timeout Milliseconds to wait for the command.
+ * @param output Where the output (stdout and stderr) is stored, within
+ *        the limits of the buffer. The rest is read and discarded.
+ * @param status Where the exit status is stored.
+ *
+ * @return WORKER_OK, WORKER_TIMEOUT, WORKER_FAILED if the shell died
+ *         after accepting the command, or WORKER_ERROR if the shell
+ *         did not accept it (it should be run apart).
+ */
+int
+Pandora_Exec_Worker::execute (string command, int timeout,
+			      Pandora_Output_Buffer &output, int &status) {
+	string marker, request, trailer;
+	int    result;
+
+	output.clear ();
+	status = -1;
+
+	/* Each request is a single line */
+	if (command.find_first_of ("\r\n") != string::npos) {
+		return WORKER_ERROR;
+	}
+
+	if (! this->shell.isRunning () && this->start () == false) {
+		return WORKER_ERROR;
+	}
+
+	/* Commands must not read the requests */
+	marker = this->getMarker ();
+	request = WORKER_BEGIN + command + WORKER_END "\n";
+	request += "echo " + marker + " " WORKER_STATUS "\n";
+	if (! this->shell.write (request)) {
+		this->shell.stop ();
+		this->restarts++;
+		return WORKER_ERROR;
+	}
+
+	/* From now on the command may have run, it must not be retried */
+	result = this->shell.readUntil (marker, timeout, output, trailer);
+	if (result != PIPE_OK) {
+		this->shell.stop ();
+		this->restarts++;
+		return (result == PIPE_TIMEOUT) ? WORKER_TIMEOUT : WORKER_FAILED;
+	}
+
+	status = atoi (trailer.c_str ());
+	return WORKER_OK;
+}
@@ -0,0 +1,92 @@
+/* Persistent shell to run the exec module commands.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_EXEC_WORKER_H__
+#define	__PANDORA_EXEC_WORKER_H__
+
+#include "pandora_pipe_process.h"
+#include <string>
+
+/* Results of Pandora_Exec_Worker::execute () */
+#define WORKER_OK      0
+#define WORKER_TIMEOUT 1 /* The worker was killed, it restarts on the next command */
+#define WORKER_ERROR   2 /* The worker could not run the command */
+#define WORKER_FAILED  3 /* The shell died running the command, it restarts on the next one */
+
+using namespace std;
+
+namespace Pandora {
+	/**
+	 * Persistent shell that runs commands sent through a pipe.
+	 *
+	 * Instead of creating a job, the pipes and a cmd.exe process for
+	 * every command, the commands are written to the standard input
+	 * of a single shell (cmd.exe on Windows, /bin/sh elsewhere). Each
+	 * command is followed by an echo of a unique marker and the exit
+	 * status, so the output of the command is everything read before
+	 * the marker:
+	 *
+	 *   (call ) & (<command>) < NUL
+	 *   echo <marker> %ERRORLEVEL%
+	 *
+	 * "(call )" resets ERRORLEVEL, and the whole command, pipelines
+	 * included, reads from NUL instead of the requests.
+	 *
+	 * Since all the commands share the shell, its environment and
+	 * working directory are set when it starts, and it is restarted
+	 * when they change. If a command does not
+	 * finish within its timeout the whole process tree is killed, and
+	 * a new shell is started for the next command. The same happens
+	 * if the command makes the shell exit; the command is not run
+	 * again, since it may have done its work.
+	 *
+	 * It is not thread-safe, and it is meant to be used only from the
+	 * module loop.
+	 */
+	class Pandora_Exec_Worker {
+	private:
+		bool               enabled;
+		string             working_dir;
+		string             environment;
+		unsigned long      sequence;
+		unsigned long      restarts;
+		Pandora_Pipe_Process shell;
+
+		Pandora_Exec_Worker           ();
+
+		bool       start              ();
+		string     getMarker          ();
+	public:
+		static Pandora_Exec_Worker *getInstance ();
+
+		~Pandora_Exec_Worker          ();
+
+		void       setEnabled         (bool enabled);
+		bool       isEnabled          () const;
+		void       setWorkingDir      (string working_dir);
+		void       setEnvironment     (string environment);
+		unsigned long getRestarts     () const;
+
+		int        execute            (string command, int timeout,
+					       Pandora_Output_Buffer &output,
+					       int &status);
+	};
+}
+
+#endif /* __PANDORA_EXEC_WORKER_H__ */
@@ -0,0 +1,154 @@
+/* XML of log modules.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_log_xml.h"
+
+#define CDATA_END        "]]>"
+#define CDATA_END_ESCAPE "]]]]><![CDATA[>"
+#define DATA_BEGIN       "\t<data><![CDATA["
+#define DATA_END         "]]></data></log_module>"
+
+/**
+ * Escape a text to be put in a CDATA section.
+ *
+ * The % are doubled, as the agent always did for the log data, and
+ * each "]]>" is split in two CDATA sections.
+ *
+ * @param text Text to escape.
+ *
+ * @return The escaped text.
+ */
+string
+Pandora_Log_Xml::escapeCdata (const string &text) {
+	string result;
+	size_t i;
+
+	result.reserve (text.size ());
+	for (i = 0; i < text.size (); i++) {
+		if (text[i] == '%') {
+			result += "%%";
+		} else if (text[i] == '>' && i >= 2 && text[i - 1] == ']' && text[i - 2] == ']') {
+			/* The "]]" is already in the result */
+			result.erase (result.size () - 2);
+			result += CDATA_END_ESCAPE;
+		} else {
+			result += text[i];
+		}
+	}
+
+	return result;
+}
+
+/**
+ * Find where the next chunk of log data ends.
+ *
+ * The chunk is the longest one whose escaped size fits in max_size,
+ * cut after its last line feed. A line longer than max_size is cut
+ * on a UTF-8 character boundary. At least one character is taken, so
+ * the data always advances.
+ *
+ * @param data Log data, not escaped.
+ * @param start Where the chunk begins.
+ * @param max_size Maximum escaped size of the chunk.
+ *
+ * @return The position after the end of the chunk.
+ */
+size_t
+Pandora_Log_Xml::getCut (const string &data, size_t start, size_t max_size) {
+	size_t size, cost, i, line_end;
+
+	size = 0;
+	line_end = string::npos;
+	for (i = start; i < data.size (); i++) {
+		cost = (data[i] == '%') ? 2 : 1;
+		if (data[i] == '>' && i >= start + 2 && data[i - 1] == ']' && data[i - 2] == ']') {
+			cost += sizeof (CDATA_END_ESCAPE) - sizeof (CDATA_END);
+		}
+		if (size + cost > max_size) {
+			break;
+		}
+		size += cost;
+		if (data[i] == '\n') {
+			line_end = i + 1;
+		}
+	}
+
+	if (i == data.size ()) {
+		return i;
+	}
+	if (line_end != string::npos) {
+		return line_end;
+	}
+
+	/* Do not split a multibyte character */
+	while (i > start && ((unsigned char) data[i] & 0xC0) == 0x80) {
+		i--;
+	}
+	if (i == start) {
+		i++;
+		while (i < data.size () && ((unsigned char) data[i] & 0xC0) == 0x80) {
+			i++;
+		}
+	}
+
+	return i;
+}
+
+/**
+ * Split the data of a log module in <log_module> elements.
+ *
+ * Each element, tags included, fits in max_size bytes unless the tags
+ * alone leave less than LOG_XML_MIN_DATA bytes for the data. At least
+ * one element is added, even if there is no data.
+ *
+ * @param source Name of the module.
+ * @param dropped Tags about the discarded data, put in the first
+ *        element only.
+ * @param data Log data, not escaped.
+ * @param max_size Maximum size of each element, or 0 for a single
+ *        element.
+ * @param chunks Where the elements are added.
+ */
+void
+Pandora_Log_Xml::split (const string &source, const string &dropped,
+			const string &data, size_t max_size,
+			list<string> &chunks) {
+	string head, extra;
+	size_t start, cut, tags;
+	bool   first;
+
+	head = "<log_module>\n\t<source><![CDATA[" + escapeCdata (source) + "]]></source>\n";
+
+	start = 0;
+	first = true;
+	do {
+		extra = first ? dropped : "";
+		cut = data.size ();
+		if (max_size > 0) {
+			tags = head.size () + extra.size () + sizeof (DATA_BEGIN) - 1 + sizeof (DATA_END) - 1;
+			cut = getCut (data, start,
+				      (max_size > tags + LOG_XML_MIN_DATA) ? max_size - tags : LOG_XML_MIN_DATA);
+		}
+
+		chunks.push_back (head + extra + DATA_BEGIN +
+				  escapeCdata (data.substr (start, cut - start)) + DATA_END);
+		start = cut;
+		first = false;
+	} while (start < data.size ());
+}
@@ -0,0 +1,44 @@
+/* XML of log modules.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_LOG_XML_H__
+#define	__PANDORA_LOG_XML_H__
+
+#include <list>
+#include <string>
+
+/* Minimum log data in each element, used when the element tags leave
+   no room for it in the requested size */
+#define LOG_XML_MIN_DATA 512
+
+using namespace std;
+
+/**
+ * Building of the <log_module> elements.
+ */
+namespace Pandora_Log_Xml {
+
+	string escapeCdata (const string &text);
+	size_t getCut      (const string &data, size_t start, size_t max_size);
+	void   split       (const string &source, const string &dropped,
+			    const string &data, size_t max_size,
+			    list<string> &chunks);
+}
+
+#endif /* __PANDORA_LOG_XML_H__ */
@@ -0,0 +1,181 @@
+/* Bounded buffer for the output of child processes.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_output_buffer.h"
+
+#include <algorithm>
+
+using namespace Pandora;
+
+/**
+ * Creates an empty buffer without limits.
+ */
+Pandora_Output_Buffer::Pandora_Output_Buffer () {
+	this->max_bytes = 0;
+	this->max_lines = 0;
+	this->keep_last = false;
+	this->truncated = false;
+	this->lines     = 0;
+}
+
+/**
+ * Set the limits of the buffer.
+ *
+ * @param max_bytes Bytes kept, 0 for no limit.
+ * @param max_lines Lines kept, 0 for no limit.
+ * @param keep_last Keep the end of the output instead of the beginning.
+ */
+void
+Pandora_Output_Buffer::setLimits (size_t max_bytes, size_t max_lines, bool keep_last) {
+	this->max_bytes = max_bytes;
+	this->max_lines = max_lines;
+	this->keep_last = keep_last;
+}
+
+/**
+ * Discard the contents of the buffer. The limits are kept.
+ */
+void
+Pandora_Output_Buffer::clear () {
+	this->data.erase ();
+	this->truncated = false;
+	this->lines     = 0;
+}
+
+/**
+ * Add a chunk of output.
+ *
+ * @param data Output read.
+ * @param size Bytes read.
+ */
+void
+Pandora_Output_Buffer::append (const char *data, size_t size) {
+	size_t i;
+
+	if (this->keep_last) {
+		this->data.append (data, size);
+		if (this->max_lines > 0) {
+			this->lines += count (data, data + size, '\n');
+		}
+
+		if ((this->max_bytes > 0 && this->data.size () > 2 * this->max_bytes) ||
+		    (this->max_lines > 0 && this->lines > 2 * this->max_lines)) {
+			this->dropOldest ();
+		}
+		return;
+	}
+
+	/* Keep up to the last allowed line feed */
+	if (this->max_lines > 0) {
+		for (i = 0; i < size && this->lines < this->max_lines; i++) {
+			if (data[i] == '\n') {
+				this->lines++;
+			}
+		}
+		if (i < size) {
+			size = i;
+			this->truncated = true;
+		}
+	}
+
+	if (this->max_bytes > 0 && this->data.size () + size > this->max_bytes) {
+		size = this->max_bytes - this->data.size ();
+		this->truncated = true;
+	}
+
+	this->data.append (data, size);
+}
+
+/**
+ * Get where the kept output starts, in tail mode.
+ *
+ * A line feed at the very end ends the last line, it does not start
+ * a new one.
+ *
+ * @return Offset of the first byte kept.
+ */
+size_t
+Pandora_Output_Buffer::getStart () const {
+	size_t start = 0, end, pos, found = 0;
+
+	if (this->max_bytes > 0 && this->data.size () > this->max_bytes) {
+		start = this->data.size () - this->max_bytes;
+	}
+
+	if (this->max_lines > 0) {
+		end = this->data.size ();
+		if (end > 0 && this->data[end - 1] == '\n') {
+			end--;
+		}
+
+		for (pos = end; pos > start; pos--) {
+			if (this->data[pos - 1] == '\n' && ++found == this->max_lines) {
+				start = pos;
+				break;
+			}
+		}
+	}
+
+	return start;
+}
+
+/**
+ * Drop the output beyond the limits, in tail mode.
+ */
+void
+Pandora_Output_Buffer::dropOldest () {
+	size_t start;
+
+	start = this->getStart ();
+	if (start == 0) {
+		return;
+	}
+
+	if (this->max_lines > 0) {
+		this->lines -= count (this->data.begin (), this->data.begin () + start, '\n');
+	}
+	this->data.erase (0, start);
+	this->truncated = true;
+}
+
+/**
+ * Get the output kept.
+ *
+ * @return The output, within the limits.
+ */
+string
+Pandora_Output_Buffer::getData () const {
+	if (this->keep_last) {
+		return this->data.substr (this->getStart ());
+	}
+	return this->data;
+}
+
+/**
+ * Check if part of the output was discarded.
+ *
+ * @return True if the output exceeded the limits.
+ */
+bool
+Pandora_Output_Buffer::isTruncated () const {
+	if (this->keep_last) {
+		return this->truncated || this->getStart () > 0;
+	}
+	return this->truncated;
+}
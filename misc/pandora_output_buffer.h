@@ -0,0 +1,60 @@
+/* Bounded buffer for the output of child processes.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_OUTPUT_BUFFER_H__
+#define	__PANDORA_OUTPUT_BUFFER_H__
+
+#include <string>
+
+using namespace std;
+
+namespace Pandora {
+	/**
+	 * Output of a child process, capped while it is read.
+	 *
+	 * The output can be limited in bytes and in lines. By default the
+	 * beginning is kept and the rest is discarded as it arrives. In
+	 * tail mode the end is kept instead, like a ring buffer: the
+	 * buffer is allowed to grow to twice the limits before the oldest
+	 * data is dropped, so each byte is moved a bounded number of times.
+	 */
+	class Pandora_Output_Buffer {
+	private:
+		string data;
+		size_t max_bytes;
+		size_t max_lines;
+		bool   keep_last;
+		bool   truncated;
+		size_t lines; /* Line feeds in data */
+
+		size_t getStart    () const;
+		void   dropOldest  ();
+	public:
+		Pandora_Output_Buffer      ();
+
+		void   setLimits   (size_t max_bytes, size_t max_lines, bool keep_last);
+		void   clear       ();
+		void   append      (const char *data, size_t size);
+
+		string getData     () const;
+		bool   isTruncated () const;
+	};
+}
+
+#endif /* __PANDORA_OUTPUT_BUFFER_H__ */
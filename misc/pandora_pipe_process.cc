@@ -0,0 +1,524 @@
+/* Child process that exchanges requests through its standard input and output.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_pipe_process.h"
+#include "pandora_timing.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+#ifndef _WIN32
+#define PIPE_SHELL     "/bin/sh"
+#endif
+
+/* Bytes of the marker line kept after the marker */
+#define PIPE_MAX_TRAILER 256
+
+using namespace Pandora;
+
+/**
+ * Creates a stopped process.
+ */
+Pandora_Pipe_Process::Pandora_Pipe_Process () {
+#ifdef _WIN32
+	this->process  = NULL;
+	this->job      = NULL;
+	this->in_write = NULL;
+	this->out_read = NULL;
+	this->read_pending = false;
+	ZeroMemory (&this->overlapped, sizeof (this->overlapped));
+#else
+	this->pid      = -1;
+	this->in_write = -1;
+	this->out_read = -1;
+#endif
+}
+
+/**
+ * Destroys the object, killing the process.
+ */
+Pandora_Pipe_Process::~Pandora_Pipe_Process () {
+	this->stop ();
+}
+
+#ifdef _WIN32
+
+/**
+ * Start the process, without waiting for it to be ready.
+ *
+ * The output is a named pipe read with overlapped reads, so a reply
+ * can be waited for along with the process exit.
+ *
+ * @param command Command line.
+ * @param working_dir Working directory. If empty, the agent one.
+ * @param environment Environment block: NUL terminated "NAME=value"
+ *        entries. If empty, the process inherits the agent environment.
+ *
+ * @return False if the process could not be started.
+ */
+bool
+Pandora_Pipe_Process::start (string command, string working_dir, string environment) {
+	static LONG         pipe_count = 0;
+	char                pipe_name[MAX_PATH];
+	STARTUPINFO         si;
+	PROCESS_INFORMATION pi;
+	SECURITY_ATTRIBUTES attributes;
+	HANDLE              in_read, out_write;
+
+	this->stop ();
+
+	attributes.nLength = sizeof (SECURITY_ATTRIBUTES);
+	attributes.bInheritHandle = TRUE;
+	attributes.lpSecurityDescriptor = NULL;
+
+	/* The job kills the children along with the process */
+	this->job = CreateJobObject (NULL, NULL);
+	if (this->job == NULL) {
+		return false;
+	}
+
+	if (! CreatePipe (&in_read, &this->in_write, &attributes, 0)) {
+		this->stop ();
+		return false;
+	}
+	SetHandleInformation (this->in_write, HANDLE_FLAG_INHERIT, 0);
+
+	/* Anonymous pipes do not support overlapped reads */
+	sprintf (pipe_name, "\\\\.\\pipe\\pandora_pipe_%lu_%ld",
+		 (unsigned long) GetCurrentProcessId (), (long) InterlockedIncrement (&pipe_count));
+	this->out_read = CreateNamedPipe (pipe_name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+					  PIPE_TYPE_BYTE | PIPE_WAIT, 1, PIPE_READ_SIZE, PIPE_READ_SIZE, 0, NULL);
+	if (this->out_read == INVALID_HANDLE_VALUE) {
+		this->out_read = NULL;
+		CloseHandle (in_read);
+		this->stop ();
+		return false;
+	}
+	out_write = CreateFile (pipe_name, GENERIC_WRITE, 0, &attributes, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, NULL);
+	this->overlapped.hEvent = CreateEvent (NULL, TRUE, FALSE, NULL);
+	if (out_write == INVALID_HANDLE_VALUE || this->overlapped.hEvent == NULL) {
+		if (out_write != INVALID_HANDLE_VALUE) {
+			CloseHandle (out_write);
+		}
+		CloseHandle (in_read);
+		this->stop ();
+		return false;
+	}
+
+	ZeroMemory (&si, sizeof (si));
+	GetStartupInfo (&si);
+	si.cb = sizeof (si);
+	si.dwFlags     = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+	si.wShowWindow = SW_HIDE;
+	si.hStdInput   = in_read;
+	si.hStdError   = out_write;
+	si.hStdOutput  = out_write;
+	ZeroMemory (&pi, sizeof (pi));
+
+	if (! CreateProcess (NULL, (CHAR *) command.c_str (), NULL, NULL, TRUE,
+			     CREATE_SUSPENDED | CREATE_NO_WINDOW,
+			     environment.empty () ? NULL : (LPVOID) environment.c_str (),
+			     working_dir.empty () ? NULL : working_dir.c_str (),
+			     &si, &pi)) {
+		CloseHandle (in_read);
+		CloseHandle (out_write);
+		this->stop ();
+		return false;
+	}
+
+	AssignProcessToJobObject (this->job, pi.hProcess);
+	ResumeThread (pi.hThread);
+	CloseHandle (pi.hThread);
+	this->process = pi.hProcess;
+
+	/* Only the process keeps these ends */
+	CloseHandle (in_read);
+	CloseHandle (out_write);
+
+	return true;
+}
+
+/**
+ * Kill the process and its children.
+ */
+void
+Pandora_Pipe_Process::stop () {
+	if (this->job != NULL) {
+		TerminateJobObject (this->job, 0);
+		CloseHandle (this->job);
+		this->job = NULL;
+	}
+	if (this->process != NULL) {
+		CloseHandle (this->process);
+		this->process = NULL;
+	}
+	if (this->in_write != NULL) {
+		CloseHandle (this->in_write);
+		this->in_write = NULL;
+	}
+	if (this->read_pending) {
+		DWORD read;
+
+		CancelIo (this->out_read);
+		GetOverlappedResult (this->out_read, &this->overlapped, &read, TRUE);
+		this->read_pending = false;
+	}
+	if (this->out_read != NULL) {
+		CloseHandle (this->out_read);
+		this->out_read = NULL;
+	}
+	if (this->overlapped.hEvent != NULL) {
+		CloseHandle (this->overlapped.hEvent);
+		this->overlapped.hEvent = NULL;
+	}
+}
+
+/**
+ * Check if the process is alive.
+ *
+ * @return True if the process is running.
+ */
+bool
+Pandora_Pipe_Process::isRunning () {
+	return this->process != NULL &&
+	       WaitForSingleObject (this->process, 0) == WAIT_TIMEOUT;
+}
+
+/**
+ * Write a request to the process.
+ *
+ * @param request Data to write.
+ *
+ * @return False if the process is not reading.
+ */
+bool
+Pandora_Pipe_Process::write (const string &request) {
+	DWORD  written;
+	size_t total = 0;
+
+	while (total < request.size ()) {
+		if (! WriteFile (this->in_write, request.c_str () + total,
+				 request.size () - total, &written, NULL)) {
+			return false;
+		}
+		total += written;
+	}
+
+	return true;
+}
+
+#else /* POSIX */
+
+/**
+ * Start the process, without waiting for it to be ready.
+ *
+ * @param command Command line.
+ * @param working_dir Working directory. If empty, the agent one.
+ * @param environment Environment block: NUL terminated "NAME=value"
+ *        entries. If empty, the process inherits the agent environment.
+ *
+ * @return False if the process could not be started.
+ */
+bool
+Pandora_Pipe_Process::start (string command, string working_dir, string environment) {
+	vector<char *> envp;
+	char          *argv[] = { (char *) PIPE_SHELL, (char *) "-c", (char *) command.c_str (), NULL };
+	int            in[2], out[2];
+	size_t         pos;
+
+	this->stop ();
+
+	if (pipe (in) != 0) {
+		return false;
+	}
+	if (pipe (out) != 0) {
+		close (in[0]);
+		close (in[1]);
+		return false;
+	}
+
+	/* Build the environment before forking */
+	for (pos = 0; pos < environment.size (); pos += strlen (environment.c_str () + pos) + 1) {
+		if (environment[pos] == '\0') {
+			break;
+		}
+		envp.push_back ((char *) environment.c_str () + pos);
+	}
+	envp.push_back (NULL);
+
+	/* A dead process is detected when reading, not with a signal */
+	signal (SIGPIPE, SIG_IGN);
+
+	this->pid = fork ();
+	if (this->pid < 0) {
+		close (in[0]);
+		close (in[1]);
+		close (out[0]);
+		close (out[1]);
+		return false;
+	}
+
+	if (this->pid == 0) {
+		/* Own process group, to kill the children along with the process */
+		setpgid (0, 0);
+		dup2 (in[0], 0);
+		dup2 (out[1], 1);
+		dup2 (out[1], 2);
+		close (in[0]);
+		close (in[1]);
+		close (out[0]);
+		close (out[1]);
+		if (! working_dir.empty () && chdir (working_dir.c_str ()) != 0) {
+			_exit (127);
+		}
+		if (environment.empty ()) {
+			execv (PIPE_SHELL, argv);
+		} else {
+			execve (PIPE_SHELL, argv, &envp[0]);
+		}
+		_exit (127);
+	}
+
+	setpgid (this->pid, this->pid);
+	close (in[0]);
+	close (out[1]);
+	this->in_write = in[1];
+	this->out_read = out[0];
+	fcntl (this->in_write, F_SETFD, FD_CLOEXEC);
+	fcntl (this->out_read, F_SETFD, FD_CLOEXEC);
+
+	return true;
+}
+
+/**
+ * Kill the process and its children.
+ */
+void
+Pandora_Pipe_Process::stop () {
+	if (this->pid > 0) {
+		kill (-this->pid, SIGKILL);
+		waitpid (this->pid, NULL, 0);
+		this->pid = -1;
+	}
+	if (this->in_write >= 0) {
+		close (this->in_write);
+		this->in_write = -1;
+	}
+	if (this->out_read >= 0) {
+		close (this->out_read);
+		this->out_read = -1;
+	}
+}
+
+/**
+ * Check if the process is alive.
+ *
+ * @return True if the process is running.
+ */
+bool
+Pandora_Pipe_Process::isRunning () {
+	return this->pid > 0 && waitpid (this->pid, NULL, WNOHANG) == 0;
+}
+
+/**
+ * Write a request to the process.
+ *
+ * @param request Data to write.
+ *
+ * @return False if the process is not reading.
+ */
+bool
+Pandora_Pipe_Process::write (const string &request) {
+	ssize_t written;
+	size_t  total = 0;
+
+	while (total < request.size ()) {
+		written = ::write (this->in_write, request.c_str () + total, request.size () - total);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		total += written;
+	}
+
+	return true;
+}
+
+#endif /* _WIN32 */
+
+/**
+ * Read a reply of the process, up to the end of the line with its
+ * marker. Anything read after that line is discarded.
+ *
+ * @param marker End of reply marker.
+ * @param timeout Milliseconds to wait for the marker line.
+ * @param output Where the reply, before the marker, is stored.
+ * @param trailer Where the rest of the marker line is stored.
+ *
+ * @return PIPE_OK, PIPE_TIMEOUT or PIPE_ERROR if the process died.
+ */
+int
+Pandora_Pipe_Process::readUntil (const string &marker, int timeout, string &output, string &trailer) {
+	Pandora_Output_Buffer reply;
+	int                   result;
+
+	result = this->readUntil (marker, timeout, reply, trailer);
+	output = reply.getData ();
+	return result;
+}
+
+/**
+ * Read a reply of the process into a capped buffer, up to the end of
+ * the line with its marker. Anything read after that line is
+ * discarded.
+ *
+ * Only the bytes that may be the beginning of the marker are held
+ * apart; the rest goes to the buffer as it is read, so the limits of
+ * the buffer bound the memory used while the marker is still looked
+ * for in the whole reply.
+ *
+ * @param marker End of reply marker.
+ * @param timeout Milliseconds to wait for the marker line.
+ * @param output Where the reply, before the marker, is appended. It
+ *        is cleared first, its limits are kept.
+ * @param trailer Where the rest of the marker line is stored.
+ *
+ * @return PIPE_OK, PIPE_TIMEOUT or PIPE_ERROR if the process died.
+ */
+int
+Pandora_Pipe_Process::readUntil (const string &marker, int timeout,
+				 Pandora_Output_Buffer &output, string &trailer) {
+	unsigned long long start, elapsed;
+	string             pending;
+	size_t             pos, end, keep;
+	long long          remaining;
+#ifdef _WIN32
+	HANDLE             handles[2];
+	DWORD              read, rc;
+	bool               exited = false;
+#else
+	char               buffer[PIPE_READ_SIZE];
+	struct pollfd      fds;
+	ssize_t            read;
+	int                ready;
+#endif
+
+	output.clear ();
+	trailer.erase ();
+	start = Pandora_Timing::getMicroseconds ();
+
+	while (1) {
+		/* The marker, up to the end of its line */
+		pos = pending.find (marker);
+		if (pos != string::npos) {
+			output.append (pending.data (), pos);
+			pending.erase (0, pos);
+
+			end = pending.find ('\n', marker.size ());
+			if (end != string::npos || pending.size () > marker.size () + PIPE_MAX_TRAILER) {
+				if (end == string::npos) {
+					end = marker.size () + PIPE_MAX_TRAILER;
+				}
+				trailer = pending.substr (marker.size (), end - marker.size ());
+				if (! trailer.empty () && trailer[trailer.size () - 1] == '\r') {
+					trailer.erase (trailer.size () - 1);
+				}
+				return PIPE_OK;
+			}
+		} else if (pending.size () >= marker.size ()) {
+			/* Hold only what may be the beginning of the marker */
+			keep = marker.size () - 1;
+			output.append (pending.data (), pending.size () - keep);
+			pending.erase (0, pending.size () - keep);
+		}
+
+		elapsed = (Pandora_Timing::getMicroseconds () - start) / 1000;
+		remaining = (long long) timeout - (long long) elapsed;
+		if (remaining <= 0) {
+			return PIPE_TIMEOUT;
+		}
+
+#ifdef _WIN32
+		/* A read left pending by a timeout is still in progress */
+		if (! this->read_pending) {
+			ResetEvent (this->overlapped.hEvent);
+			if (! ReadFile (this->out_read, this->read_buffer, sizeof (this->read_buffer),
+					NULL, &this->overlapped) &&
+			    GetLastError () != ERROR_IO_PENDING) {
+				return PIPE_ERROR; /* Broken pipe */
+			}
+			this->read_pending = true;
+		}
+
+		/* Wait for the read or the process exit. Once the process has
+		   exited, only what is already in the pipe is read. */
+		handles[0] = this->overlapped.hEvent;
+		handles[1] = this->process;
+		rc = WaitForMultipleObjects (exited ? 1 : 2, handles, FALSE,
+					     exited ? 0 : (DWORD) remaining);
+		if (rc == WAIT_OBJECT_0 + 1) {
+			exited = true;
+			continue;
+		} else if (rc != WAIT_OBJECT_0) {
+			if (exited) {
+				return PIPE_ERROR;
+			}
+			continue;
+		}
+
+		this->read_pending = false;
+		if (! GetOverlappedResult (this->out_read, &this->overlapped, &read, FALSE)) {
+			return PIPE_ERROR;
+		}
+		pending.append (this->read_buffer, read);
+#else
+		fds.fd = this->out_read;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		ready = poll (&fds, 1, remaining > 1000 ? 1000 : (int) remaining);
+		if (ready < 0 && errno != EINTR) {
+			return PIPE_ERROR;
+		}
+		if (ready <= 0) {
+			continue;
+		}
+		read = ::read (this->out_read, buffer, sizeof (buffer));
+		if (read < 0 && errno == EINTR) {
+			continue;
+		}
+		if (read <= 0) {
+			return PIPE_ERROR;
+		}
+		pending.append (buffer, read);
+#endif
+	}
+}
@@ -0,0 +1,82 @@
+/* Child process that exchanges requests through its standard input and output.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_PIPE_PROCESS_H__
+#define	__PANDORA_PIPE_PROCESS_H__
+
+#include "pandora_output_buffer.h"
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#endif
+
+#define PIPE_READ_SIZE 4096
+
+/* Results of Pandora_Pipe_Process::readUntil () */
+#define PIPE_OK      0
+#define PIPE_TIMEOUT 1 /* The marker was not read in time */
+#define PIPE_ERROR   2 /* The process died or closed its output */
+
+using namespace std;
+
+namespace Pandora {
+	/**
+	 * Long-lived child process driven through its standard input and
+	 * output (stderr is merged into stdout).
+	 *
+	 * Requests are written to the standard input of the process, and
+	 * each reply is read up to a line with a marker agreed on with the
+	 * process. Stopping the process kills its whole tree (a job on
+	 * Windows, a process group elsewhere).
+	 *
+	 * On Windows the command line is passed to CreateProcess as is;
+	 * elsewhere it is run with /bin/sh -c.
+	 */
+	class Pandora_Pipe_Process {
+	private:
+#ifdef _WIN32
+		HANDLE             process, job, in_write, out_read;
+		OVERLAPPED         overlapped; /* Read of the output */
+		bool               read_pending;
+		char               read_buffer[PIPE_READ_SIZE];
+#else
+		pid_t              pid;
+		int                in_write, out_read;
+#endif
+	public:
+		Pandora_Pipe_Process          ();
+		~Pandora_Pipe_Process         ();
+
+		bool       start              (string command, string working_dir,
+					       string environment);
+		void       stop               ();
+		bool       isRunning          ();
+		bool       write              (const string &request);
+		int        readUntil          (const string &marker, int timeout,
+					       string &output, string &trailer);
+		int        readUntil          (const string &marker, int timeout,
+					       Pandora_Output_Buffer &output,
+					       string &trailer);
+	};
+}
+
+#endif /* __PANDORA_PIPE_PROCESS_H__ */
@@ -0,0 +1,544 @@
+/* Child process execution with output capture.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_process_runner.h"
+#include "pandora_timing.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+#define RUNNER_READ_SIZE 4096
+
+/* Milliseconds between checks for the exit of a process whose output
+   is still open (a child of the command may have inherited it) */
+#define RUNNER_EXIT_CHECK 100
+
+/* Milliseconds between checks for a free process slot */
+#define RUNNER_SLOT_WAIT 10
+
+using namespace Pandora;
+
+/* Processes allowed to run at the same time (0 for no limit), and
+   processes running */
+static volatile int max_processes = 0;
+static volatile int running_processes = 0;
+
+/**
+ * Wait until a new process can be started.
+ */
+static void
+acquireSlot () {
+	while (1) {
+		if (__sync_add_and_fetch (&running_processes, 1) <= max_processes ||
+		    max_processes <= 0) {
+			return;
+		}
+		__sync_sub_and_fetch (&running_processes, 1);
+#ifdef _WIN32
+		Sleep (RUNNER_SLOT_WAIT);
+#else
+		poll (NULL, 0, RUNNER_SLOT_WAIT);
+#endif
+	}
+}
+
+/**
+ * Free the slot of a finished process.
+ */
+static void
+releaseSlot () {
+	__sync_sub_and_fetch (&running_processes, 1);
+}
+
+/**
+ * Creates a runner for a command line.
+ *
+ * By default the process inherits the agent environment and working
+ * directory, and there is no timeout.
+ *
+ * @param command Command line.
+ */
+Pandora_Process_Runner::Pandora_Process_Runner (string command) {
+	this->command    = command;
+	this->timeout    = 0;
+	this->max_output = 0;
+	this->max_lines  = 0;
+	this->keep_last  = false;
+	this->exit_code  = 0;
+}
+
+/**
+ * Set the working directory of the process.
+ *
+ * @param working_dir Working directory.
+ */
+void
+Pandora_Process_Runner::setWorkingDir (string working_dir) {
+	this->working_dir = working_dir;
+}
+
+/**
+ * Set the environment of the process.
+ *
+ * @param environment Environment block: NUL terminated "NAME=value"
+ *        entries. If empty, the process inherits the agent environment.
+ */
+void
+Pandora_Process_Runner::setEnvironment (string environment) {
+	this->environment = environment;
+}
+
+/**
+ * Set the timeout of the process.
+ *
+ * @param timeout Milliseconds, 0 or less to wait forever.
+ */
+void
+Pandora_Process_Runner::setTimeout (int timeout) {
+	this->timeout = timeout;
+}
+
+/**
+ * Set the maximum size of the output kept.
+ *
+ * @param max_output Bytes, 0 for no limit.
+ */
+void
+Pandora_Process_Runner::setMaxOutput (size_t max_output) {
+	this->max_output = max_output;
+}
+
+/**
+ * Set the maximum number of lines of the output kept.
+ *
+ * @param max_lines Lines, 0 for no limit.
+ */
+void
+Pandora_Process_Runner::setMaxLines (size_t max_lines) {
+	this->max_lines = max_lines;
+}
+
+/**
+ * Choose which part of the output is kept when it exceeds the limits.
+ *
+ * @param keep_last Keep the end of the output instead of the beginning.
+ */
+void
+Pandora_Process_Runner::setKeepLast (bool keep_last) {
+	this->keep_last = keep_last;
+}
+
+/**
+ * Limit the number of processes run at the same time by all the
+ * runners of the agent.
+ *
+ * @param max_processes Maximum number of processes, 0 for no limit.
+ */
+void
+Pandora_Process_Runner::setMaxProcesses (int max_processes) {
+	::max_processes = max_processes;
+}
+
+/**
+ * Get the output of the last run.
+ *
+ * @return Everything the process wrote to stdout and stderr.
+ */
+string
+Pandora_Process_Runner::getOutput () const {
+	return this->output.getData ();
+}
+
+/**
+ * Check if the output of the last run was truncated.
+ *
+ * @return True if the process wrote more than the limits allow.
+ */
+bool
+Pandora_Process_Runner::isTruncated () const {
+	return this->output.isTruncated ();
+}
+
+/**
+ * Get the exit code of the last run.
+ *
+ * @return The exit code. If the process timed out, STILL_ACTIVE on
+ *         Windows and 128 + SIGKILL elsewhere.
+ */
+unsigned long
+Pandora_Process_Runner::getExitCode () const {
+	return this->exit_code;
+}
+
+/**
+ * Run the command and wait for it, once there is a free process slot.
+ *
+ * @return RUNNER_OK, RUNNER_TIMEOUT or RUNNER_ERROR.
+ */
+int
+Pandora_Process_Runner::run () {
+	int result;
+
+	this->output.setLimits (this->max_output, this->max_lines, this->keep_last);
+	this->output.clear ();
+
+	acquireSlot ();
+	result = this->runProcess ();
+	releaseSlot ();
+
+	return result;
+}
+
+#ifdef _WIN32
+
+/**
+ * Start the process and wait for it.
+ *
+ * The output is read from a named pipe with overlapped reads, waiting
+ * for the read and for the process exit with a single call.
+ *
+ * @return RUNNER_OK, RUNNER_TIMEOUT or RUNNER_ERROR.
+ */
+int
+Pandora_Process_Runner::runProcess () {
+	static LONG         pipe_count = 0;
+	STARTUPINFO         si;
+	PROCESS_INFORMATION pi;
+	SECURITY_ATTRIBUTES attributes;
+	OVERLAPPED          overlapped;
+	HANDLE              job, out_read, out_write, handles[2];
+	char                buffer[RUNNER_READ_SIZE];
+	char                pipe_name[MAX_PATH];
+	DWORD               read, wait, rc, code;
+	unsigned long long  start, elapsed;
+	bool                pending = false, pipe_open = true, exited = false;
+	int                 result = RUNNER_OK;
+
+	this->exit_code = 0;
+
+	attributes.nLength = sizeof (SECURITY_ATTRIBUTES);
+	attributes.bInheritHandle = TRUE;
+	attributes.lpSecurityDescriptor = NULL;
+
+	/* Anonymous pipes do not support overlapped reads */
+	sprintf (pipe_name, "\\\\.\\pipe\\pandora_runner_%lu_%ld",
+		 (unsigned long) GetCurrentProcessId (), (long) InterlockedIncrement (&pipe_count));
+	out_read = CreateNamedPipe (pipe_name, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+				    PIPE_TYPE_BYTE | PIPE_WAIT, 1, RUNNER_READ_SIZE, RUNNER_READ_SIZE, 0, NULL);
+	if (out_read == INVALID_HANDLE_VALUE) {
+		return RUNNER_ERROR;
+	}
+	out_write = CreateFile (pipe_name, GENERIC_WRITE, 0, &attributes, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, NULL);
+	if (out_write == INVALID_HANDLE_VALUE) {
+		CloseHandle (out_read);
+		return RUNNER_ERROR;
+	}
+
+	/* Create a job to kill the child tree if it become zombie */
+	job = CreateJobObject (NULL, NULL);
+	if (job == NULL) {
+		CloseHandle (out_read);
+		CloseHandle (out_write);
+		return RUNNER_ERROR;
+	}
+
+	ZeroMemory (&si, sizeof (si));
+	GetStartupInfo (&si);
+	si.cb = sizeof (si);
+	si.dwFlags     = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+	si.wShowWindow = SW_HIDE;
+	si.hStdError   = out_write;
+	si.hStdOutput  = out_write;
+	ZeroMemory (&pi, sizeof (pi));
+
+	if (! CreateProcess (NULL, (CHAR *) this->command.c_str (), NULL, NULL, TRUE,
+			     CREATE_SUSPENDED | CREATE_NO_WINDOW,
+			     this->environment.empty () ? NULL : (LPVOID) this->environment.c_str (),
+			     this->working_dir.empty () ? NULL : this->working_dir.c_str (),
+			     &si, &pi)) {
+		CloseHandle (job);
+		CloseHandle (out_read);
+		CloseHandle (out_write);
+		return RUNNER_ERROR;
+	}
+
+	AssignProcessToJobObject (job, pi.hProcess);
+	ResumeThread (pi.hThread);
+
+	/* Only the process tree keeps the write end, so the pipe breaks
+	   as soon as it finishes */
+	CloseHandle (out_write);
+
+	ZeroMemory (&overlapped, sizeof (overlapped));
+	overlapped.hEvent = CreateEvent (NULL, TRUE, FALSE, NULL);
+	start = Pandora_Timing::getMicroseconds ();
+
+	while (pipe_open) {
+		if (! pending) {
+			ResetEvent (overlapped.hEvent);
+			if (! ReadFile (out_read, buffer, sizeof (buffer), NULL, &overlapped)) {
+				if (GetLastError () != ERROR_IO_PENDING) {
+					break; /* Broken pipe */
+				}
+			}
+			pending = true;
+		}
+
+		/* Once the process has exited, only what is already in the
+		   pipe is read */
+		if (exited) {
+			wait = 0;
+		} else if (this->timeout <= 0) {
+			wait = INFINITE;
+		} else {
+			elapsed = (Pandora_Timing::getMicroseconds () - start) / 1000;
+			wait = (elapsed >= (unsigned long long) this->timeout) ? 0 : this->timeout - elapsed;
+		}
+
+		handles[0] = overlapped.hEvent;
+		handles[1] = pi.hProcess;
+		rc = WaitForMultipleObjects (exited ? 1 : 2, handles, FALSE, wait);
+		if (rc == WAIT_OBJECT_0) {
+			pending = false;
+			if (GetOverlappedResult (out_read, &overlapped, &read, FALSE)) {
+				this->output.append (buffer, read);
+			} else {
+				pipe_open = false;
+			}
+		} else if (rc == WAIT_OBJECT_0 + 1) {
+			exited = true;
+		} else {
+			if (! exited) {
+				result = RUNNER_TIMEOUT;
+			}
+			break;
+		}
+	}
+
+	if (pending) {
+		CancelIo (out_read);
+		GetOverlappedResult (out_read, &overlapped, &read, TRUE);
+	}
+
+	/* The output was closed before the process exit */
+	if (result == RUNNER_OK && ! exited) {
+		if (this->timeout <= 0) {
+			wait = INFINITE;
+		} else {
+			elapsed = (Pandora_Timing::getMicroseconds () - start) / 1000;
+			wait = (elapsed >= (unsigned long long) this->timeout) ? 0 : this->timeout - elapsed;
+		}
+		if (WaitForSingleObject (pi.hProcess, wait) != WAIT_OBJECT_0) {
+			result = RUNNER_TIMEOUT;
+		}
+	}
+
+	if (result == RUNNER_TIMEOUT) {
+		TerminateJobObject (job, STILL_ACTIVE);
+		this->exit_code = STILL_ACTIVE;
+	} else {
+		GetExitCodeProcess (pi.hProcess, &code);
+		this->exit_code = code;
+
+		/* Kill what is left of a failed command */
+		if (code != 0) {
+			TerminateJobObject (job, 0);
+		}
+	}
+
+	CloseHandle (overlapped.hEvent);
+	CloseHandle (job);
+	CloseHandle (pi.hProcess);
+	CloseHandle (pi.hThread);
+	CloseHandle (out_read);
+
+	return result;
+}
+
+#else /* POSIX */
+
+/**
+ * Start the process and wait for it.
+ *
+ * The output is read with poll (), which also wakes up when the pipe
+ * is closed at the process exit.
+ *
+ * @return RUNNER_OK, RUNNER_TIMEOUT or RUNNER_ERROR.
+ */
+int
+Pandora_Process_Runner::runProcess () {
+	vector<char *>     envp;
+	char              *argv[] = { (char *) "sh", (char *) "-c", (char *) this->command.c_str (), NULL };
+	char               buffer[RUNNER_READ_SIZE];
+	struct pollfd      fds;
+	unsigned long long start, elapsed;
+	size_t             pos;
+	ssize_t            read;
+	pid_t              pid;
+	int                out[2], null_fd, rc, wait, status = 0;
+	bool               pipe_open = true, exited = false;
+	int                result = RUNNER_OK;
+
+	this->exit_code = 0;
+
+	if (pipe (out) != 0) {
+		return RUNNER_ERROR;
+	}
+
+	/* Build the environment before forking */
+	for (pos = 0; pos < this->environment.size (); pos += strlen (this->environment.c_str () + pos) + 1) {
+		if (this->environment[pos] == '\0') {
+			break;
+		}
+		envp.push_back ((char *) this->environment.c_str () + pos);
+	}
+	envp.push_back (NULL);
+
+	pid = fork ();
+	if (pid < 0) {
+		close (out[0]);
+		close (out[1]);
+		return RUNNER_ERROR;
+	}
+
+	if (pid == 0) {
+		/* Own process group, to kill the whole tree */
+		setpgid (0, 0);
+		null_fd = open ("/dev/null", O_RDONLY);
+		if (null_fd >= 0) {
+			dup2 (null_fd, 0);
+			close (null_fd);
+		}
+		dup2 (out[1], 1);
+		dup2 (out[1], 2);
+		close (out[0]);
+		close (out[1]);
+		if (! this->working_dir.empty () && chdir (this->working_dir.c_str ()) != 0) {
+			_exit (127);
+		}
+		if (this->environment.empty ()) {
+			execv ("/bin/sh", argv);
+		} else {
+			execve ("/bin/sh", argv, &envp[0]);
+		}
+		_exit (127);
+	}
+
+	setpgid (pid, pid);
+	close (out[1]);
+	start = Pandora_Timing::getMicroseconds ();
+
+	while (pipe_open) {
+		elapsed = (Pandora_Timing::getMicroseconds () - start) / 1000;
+		if (! exited && this->timeout > 0 && elapsed >= (unsigned long long) this->timeout) {
+			result = RUNNER_TIMEOUT;
+			break;
+		}
+
+		/* Once the process has exited, only what is already in the
+		   pipe is read */
+		if (exited) {
+			wait = 0;
+		} else if (this->timeout > 0 && this->timeout - elapsed < RUNNER_EXIT_CHECK) {
+			wait = this->timeout - elapsed;
+		} else {
+			wait = RUNNER_EXIT_CHECK;
+		}
+
+		fds.fd = out[0];
+		fds.events = POLLIN;
+		fds.revents = 0;
+		rc = poll (&fds, 1, wait);
+		if (rc < 0 && errno != EINTR) {
+			break;
+		}
+
+		if (rc > 0) {
+			read = ::read (out[0], buffer, sizeof (buffer));
+			if (read > 0) {
+				this->output.append (buffer, read);
+			} else if (read == 0 || errno != EINTR) {
+				pipe_open = false;
+			}
+			continue;
+		}
+
+		if (exited) {
+			break;
+		}
+		if (waitpid (pid, &status, WNOHANG) == pid) {
+			exited = true;
+		}
+	}
+
+	/* The output was closed before the process exit */
+	while (result == RUNNER_OK && ! exited) {
+		rc = waitpid (pid, &status, (this->timeout > 0) ? WNOHANG : 0);
+		if (rc == pid) {
+			exited = true;
+			break;
+		}
+		if (rc < 0 && errno != EINTR) {
+			break;
+		}
+
+		elapsed = (Pandora_Timing::getMicroseconds () - start) / 1000;
+		if (this->timeout > 0 && elapsed >= (unsigned long long) this->timeout) {
+			result = RUNNER_TIMEOUT;
+			break;
+		}
+		poll (NULL, 0, 1);
+	}
+
+	if (result == RUNNER_TIMEOUT) {
+		kill (-pid, SIGKILL);
+		waitpid (pid, &status, 0);
+		this->exit_code = 128 + SIGKILL;
+	} else {
+		if (WIFEXITED (status)) {
+			this->exit_code = WEXITSTATUS (status);
+		} else if (WIFSIGNALED (status)) {
+			this->exit_code = 128 + WTERMSIG (status);
+		}
+
+		/* Kill what is left of a failed command */
+		if (this->exit_code != 0) {
+			kill (-pid, SIGKILL);
+		}
+	}
+
+	close (out[0]);
+
+	return result;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,85 @@
+/* Child process execution with output capture.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_PROCESS_RUNNER_H__
+#define	__PANDORA_PROCESS_RUNNER_H__
+
+#include "pandora_output_buffer.h"
+#include <string>
+
+/* Results of Pandora_Process_Runner::run () */
+#define RUNNER_OK      0
+#define RUNNER_TIMEOUT 1 /* The process tree was killed */
+#define RUNNER_ERROR   2 /* The process could not be started */
+
+using namespace std;
+
+namespace Pandora {
+	/**
+	 * Runs a command line and captures its output (stdout and stderr).
+	 *
+	 * The runner waits for the process exit and for its output at the
+	 * same time, so a command is collected as soon as it finishes:
+	 * with overlapped reads on a named pipe on Windows, and with
+	 * poll () elsewhere. When the timeout expires the whole process
+	 * tree (a job on Windows, a process group elsewhere) is killed.
+	 *
+	 * On Windows the command line is passed to CreateProcess as is;
+	 * elsewhere it is run with /bin/sh -c.
+	 *
+	 * The output kept can be capped in bytes and lines, keeping either
+	 * its beginning or its end; the rest is read and discarded, so the
+	 * process never blocks on a full pipe. The number of processes
+	 * running at the same time can be limited for the whole agent: run ()
+	 * waits for a free slot before starting the process.
+	 */
+	class Pandora_Process_Runner {
+	private:
+		string        command;
+		string        working_dir;
+		string        environment;
+		int           timeout;
+		Pandora_Output_Buffer output;
+		size_t        max_output;
+		size_t        max_lines;
+		bool          keep_last;
+		unsigned long exit_code;
+
+		int           runProcess      ();
+	public:
+		Pandora_Process_Runner        (string command);
+
+		void          setWorkingDir   (string working_dir);
+		void          setEnvironment  (string environment);
+		void          setTimeout      (int timeout);
+		void          setMaxOutput    (size_t max_output);
+		void          setMaxLines     (size_t max_lines);
+		void          setKeepLast     (bool keep_last);
+
+		static void   setMaxProcesses (int max_processes);
+
+		int           run             ();
+
+		string        getOutput       () const;
+		bool          isTruncated     () const;
+		unsigned long getExitCode     () const;
+	};
+}
+
+#endif /* __PANDORA_PROCESS_RUNNER_H__ */
@@ -0,0 +1,192 @@
+/* Monotonic clock and timing histograms.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_timing.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <sstream>
+
+using namespace Pandora_Timing;
+
+/**
+ * Get the value of a monotonic clock.
+ *
+ * It is not affected by changes of the system time, so it must only be
+ * used to measure durations.
+ *
+ * @return Elapsed microseconds since an arbitrary point.
+ */
+unsigned long long
+Pandora_Timing::getMicroseconds () {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER        counter;
+
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency (&frequency);
+	}
+	QueryPerformanceCounter (&counter);
+
+	return (counter.QuadPart / frequency.QuadPart) * 1000000 +
+		(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * Creates an empty histogram.
+ */
+Histogram::Histogram () {
+	this->reset ();
+}
+
+/**
+ * Discard every duration.
+ */
+void
+Histogram::reset () {
+	int i;
+
+	for (i = 0; i < TIMING_BUCKETS; i++) {
+		this->buckets[i] = 0;
+	}
+	this->count = 0;
+	this->total = 0;
+	this->max   = 0;
+	this->last  = 0;
+}
+
+/**
+ * Add a duration to the histogram.
+ *
+ * @param usecs Duration in microseconds.
+ */
+void
+Histogram::add (unsigned long long usecs) {
+	int bucket = 0;
+
+	while (bucket < TIMING_BUCKETS - 1 && (usecs >> (bucket + 1)) > 0) {
+		bucket++;
+	}
+
+	this->buckets[bucket]++;
+	this->count++;
+	this->total += usecs;
+	this->last   = usecs;
+	if (usecs > this->max) {
+		this->max = usecs;
+	}
+}
+
+/**
+ * Get the number of durations in the histogram.
+ *
+ * @return Number of durations.
+ */
+unsigned long
+Histogram::getCount () const {
+	return this->count;
+}
+
+/**
+ * Get the latest duration added.
+ *
+ * @return Duration in microseconds.
+ */
+unsigned long long
+Histogram::getLast () const {
+	return this->last;
+}
+
+/**
+ * Get the longest duration.
+ *
+ * @return Duration in microseconds.
+ */
+unsigned long long
+Histogram::getMax () const {
+	return this->max;
+}
+
+/**
+ * Get the average duration.
+ *
+ * @return Duration in microseconds.
+ */
+unsigned long long
+Histogram::getAverage () const {
+	if (this->count == 0) {
+		return 0;
+	}
+
+	return this->total / this->count;
+}
+
+/**
+ * Get an upper bound of a percentile.
+ *
+ * @param percentile Percentile between 0 and 1.
+ *
+ * @return The upper limit of the bucket that holds the percentile,
+ *         in microseconds, and never greater than the longest duration.
+ */
+unsigned long long
+Histogram::getPercentile (double percentile) const {
+	unsigned long      accumulated = 0;
+	unsigned long long limit;
+	int                i;
+
+	for (i = 0; i < TIMING_BUCKETS; i++) {
+		accumulated += this->buckets[i];
+		if (accumulated > 0 && accumulated >= percentile * this->count) {
+			limit = (2ULL << i) - 1;
+			return (limit < this->max) ? limit : this->max;
+		}
+	}
+
+	return this->max;
+}
+
+/**
+ * Get a human readable summary of the histogram.
+ *
+ * @return The summary, with the durations in milliseconds.
+ */
+string
+Histogram::toString () const {
+	ostringstream summary;
+
+	summary.precision (3);
+	summary << fixed;
+	summary << "n=" << this->count
+		<< " avg=" << this->getAverage () / 1000.0 << "ms"
+		<< " p95<=" << this->getPercentile (0.95) / 1000.0 << "ms"
+		<< " max=" << this->max / 1000.0 << "ms";
+
+	return summary.str ();
+}
@@ -0,0 +1,63 @@
+/* Monotonic clock and timing histograms.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_TIMING_H__
+#define	__PANDORA_TIMING_H__
+
+#include <string>
+
+/* Bucket i counts the durations between 2^i and 2^(i+1) microseconds,
+   so the last bucket holds everything above ~17 minutes */
+#define TIMING_BUCKETS 30
+
+using namespace std;
+
+/**
+ * Timing utilities.
+ */
+namespace Pandora_Timing {
+
+	unsigned long long getMicroseconds ();
+
+	/**
+	 * Histogram of durations with logarithmic buckets.
+	 *
+	 * It has a fixed size, so it can be kept for every module.
+	 */
+	class Histogram {
+	private:
+		unsigned long      buckets[TIMING_BUCKETS];
+		unsigned long      count;
+		unsigned long long total, max, last;
+	public:
+		Histogram                      ();
+
+		void               add         (unsigned long long usecs);
+		void               reset       ();
+
+		unsigned long      getCount    () const;
+		unsigned long long getLast     () const;
+		unsigned long long getMax      () const;
+		unsigned long long getAverage  () const;
+		unsigned long long getPercentile (double percentile) const;
+		string             toString    () const;
+	};
+}
+
+#endif /* __PANDORA_TIMING_H__ */
@@ -0,0 +1,272 @@
+/* Store of the variables exported to the processes launched by the agent.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_variables.h"
+
+#include <cctype>
+#include <cstring>
+
+using namespace Pandora;
+
+/**
+ * Get the upper case version of a variable name.
+ */
+static string
+toKey (string name) {
+	string::iterator iter;
+
+	for (iter = name.begin (); iter != name.end (); iter++) {
+		*iter = toupper (*iter);
+	}
+
+	return name;
+}
+
+/**
+ * Creates the variable store.
+ */
+Pandora_Variables::Pandora_Variables () {
+	InitializeCriticalSection (&this->lock);
+}
+
+/**
+ * Destroys the variable store.
+ */
+Pandora_Variables::~Pandora_Variables () {
+	DeleteCriticalSection (&this->lock);
+}
+
+/**
+ * Get the variable store.
+ *
+ * The first call must be done before any other thread is started.
+ *
+ * @return The variable store.
+ */
+Pandora_Variables *
+Pandora_Variables::getInstance () {
+	static Pandora_Variables *variables = NULL;
+
+	if (variables)
+		return variables;
+	variables = new Pandora_Variables ();
+	return variables;
+}
+
+/**
+ * Set the value of a variable (usually saved by a module).
+ *
+ * Variables with an empty value are not passed to the children.
+ *
+ * @param name Variable name.
+ * @param value Variable value.
+ */
+void
+Pandora_Variables::setValue (string name, string value) {
+	EnterCriticalSection (&this->lock);
+	this->values[toKey (name)] = make_pair (name, value);
+	LeaveCriticalSection (&this->lock);
+}
+
+/**
+ * Get the value of a variable.
+ *
+ * @param name Variable name.
+ * @param value Where the value is copied.
+ *
+ * @return True if the variable is defined.
+ */
+bool
+Pandora_Variables::getValue (string name, string &value) {
+	map<string, pair<string, string> >::iterator iter;
+	bool found = false;
+
+	EnterCriticalSection (&this->lock);
+	iter = this->values.find (toKey (name));
+	if (iter != this->values.end ()) {
+		value = iter->second.second;
+		found = true;
+	}
+	LeaveCriticalSection (&this->lock);
+
+	return found;
+}
+
+/**
+ * Set a variable that is passed to every child.
+ *
+ * @param name Variable name.
+ * @param value Variable value.
+ */
+void
+Pandora_Variables::setGlobal (string name, string value) {
+	EnterCriticalSection (&this->lock);
+	this->globals[toKey (name)] = make_pair (name, value);
+	LeaveCriticalSection (&this->lock);
+}
+
+/**
+ * Append a directory to the PATH of every child.
+ *
+ * @param directory Directory to add. Nothing is done if it was
+ *        already added.
+ */
+void
+Pandora_Variables::addPath (string directory) {
+	list<string>::iterator iter;
+
+	EnterCriticalSection (&this->lock);
+	for (iter = this->path.begin (); iter != this->path.end (); iter++) {
+		if (toKey (*iter) == toKey (directory)) {
+			break;
+		}
+	}
+	if (iter == this->path.end ()) {
+		this->path.push_back (directory);
+	}
+	LeaveCriticalSection (&this->lock);
+}
+
+/**
+ * Build the environment block of a child process.
+ *
+ * The block contains a copy of the agent environment, the global
+ * variables, the PATH with the additional directories and the
+ * requested variables, sorted by name without regard to case as
+ * CreateProcess requires.
+ *
+ * @param names Names of the variables the child needs. May be NULL.
+ *
+ * @return The environment block, terminated by two null characters.
+ */
+string
+Pandora_Variables::getEnvironmentBlock (list<string> *names) {
+	map<string, pair<string, string> >           variables;
+	map<string, pair<string, string> >::iterator iter;
+	map<string, string>                          entries;
+	map<string, string>::iterator                entry_iter;
+	list<string>::iterator                       name_iter, path_iter;
+	string                                       block, entry, key, path_value, path_key;
+	char                                        *environment, *ptr;
+	size_t                                       pos;
+
+	EnterCriticalSection (&this->lock);
+
+	variables = this->globals;
+	if (names != NULL) {
+		for (name_iter = names->begin (); name_iter != names->end (); name_iter++) {
+			iter = this->values.find (toKey (*name_iter));
+			if (iter != this->values.end ()) {
+				variables[iter->first] = iter->second;
+			}
+		}
+	}
+
+	/* Copy the agent environment */
+	environment = GetEnvironmentStrings ();
+	if (environment != NULL) {
+		for (ptr = environment; *ptr != '\0'; ptr += strlen (ptr) + 1) {
+			entry = ptr;
+
+			/* Entries like "=C:=C:\" have no name */
+			pos = entry.find ('=', 1);
+			key = toKey (entry.substr (0, pos));
+			if (key == "PATH") {
+				path_value = entry.substr (pos + 1);
+				continue;
+			}
+
+			entries[key] = entry;
+		}
+		FreeEnvironmentStrings (environment);
+	}
+
+	/* Additional PATH directories */
+	for (path_iter = this->path.begin (); path_iter != this->path.end (); path_iter++) {
+		path_key = ";" + toKey (path_value) + ";";
+		if (path_key.find (";" + toKey (*path_iter) + ";") == string::npos) {
+			if (! path_value.empty ()) {
+				path_value += ";";
+			}
+			path_value += *path_iter;
+		}
+	}
+	if (! path_value.empty ()) {
+		entries["PATH"] = "PATH=" + path_value;
+	}
+
+	/* Global and requested variables override the agent ones, or
+	   remove them when empty */
+	for (iter = variables.begin (); iter != variables.end (); iter++) {
+		if (iter->second.second.empty ()) {
+			entries.erase (iter->first);
+		} else {
+			entries[iter->first] = iter->second.first + "=" + iter->second.second;
+		}
+	}
+
+	LeaveCriticalSection (&this->lock);
+
+	/* The map keeps them sorted by upper case name */
+	for (entry_iter = entries.begin (); entry_iter != entries.end (); entry_iter++) {
+		block += entry_iter->second;
+		block += '\0';
+	}
+
+	if (block.empty ()) {
+		block += '\0';
+	}
+	block += '\0';
+
+	return block;
+}
+
+/**
+ * Get the variables referenced by a command with the %NAME% syntax.
+ *
+ * @param command Command line.
+ * @param names List where the names are appended.
+ */
+void
+Pandora_Variables::getReferences (string command, list<string> &names) {
+	size_t begin, end;
+	string name;
+
+	begin = command.find ('%');
+	while (begin != string::npos) {
+		end = command.find ('%', begin + 1);
+		if (end == string::npos) {
+			break;
+		}
+
+		name = command.substr (begin + 1, end - begin - 1);
+
+		/* Not a variable (%% or a literal percent sign), resync */
+		if (name.empty () || name.find_first_of (" \t\"") != string::npos) {
+			begin = end;
+			if (name.empty ()) {
+				begin = command.find ('%', end + 1);
+			}
+			continue;
+		}
+
+		names.push_back (name);
+		begin = command.find ('%', end + 1);
+	}
+}
@@ -0,0 +1,65 @@
+/* Store of the variables exported to the processes launched by the agent.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_VARIABLES_H__
+#define	__PANDORA_VARIABLES_H__
+
+#include <windows.h>
+#include <string>
+#include <list>
+#include <map>
+
+using namespace std;
+
+namespace Pandora {
+	/**
+	 * Thread-safe store of the variables passed to child processes.
+	 *
+	 * It replaces the use of putenv: the process environment is never
+	 * modified. Instead, an environment block is built for each child
+	 * with only the variables it needs, the global variables (like
+	 * PANDORA_AGENT) and the additional PATH directories.
+	 *
+	 * Variable names are case insensitive, as in the Windows environment.
+	 */
+	class Pandora_Variables {
+	private:
+		/* Upper case name -> (name, value) */
+		map<string, pair<string, string> > values;
+		map<string, pair<string, string> > globals;
+		list<string>                        path;
+		CRITICAL_SECTION                    lock;
+
+		Pandora_Variables             ();
+	public:
+		static Pandora_Variables *getInstance ();
+
+		~Pandora_Variables            ();
+
+		void   setValue               (string name, string value);
+		bool   getValue               (string name, string &value);
+		void   setGlobal              (string name, string value);
+		void   addPath                (string directory);
+		string getEnvironmentBlock    (list<string> *names);
+
+		static void getReferences     (string command, list<string> &names);
+	};
+}
+
+#endif /* __PANDORA_VARIABLES_H__ */
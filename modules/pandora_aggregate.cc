@@ -0,0 +1,253 @@
+/* Constant memory aggregation of module samples.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_aggregate.h"
+
+#include <cmath>
+
+#define AGGREGATE_QUANTILE 0.95
+
+using namespace Pandora_Modules;
+
+/**
+ * Creates an empty aggregate.
+ *
+ * @param mode Aggregation mode.
+ */
+Pandora_Aggregate::Pandora_Aggregate (Aggregate_Mode mode) {
+	this->mode = mode;
+	this->reset ();
+}
+
+/**
+ * Get the Aggregate_Mode from a string.
+ *
+ * @param mode String mode (avg, min, max, p95 or sum).
+ *
+ * @return The Aggregate_Mode, AGGREGATE_NONE if the string is not valid.
+ */
+Aggregate_Mode
+Pandora_Aggregate::parseModeFromString (string mode) {
+	if (mode == aggregate_avg_str) {
+		return AGGREGATE_AVG;
+	} else if (mode == aggregate_min_str) {
+		return AGGREGATE_MIN;
+	} else if (mode == aggregate_max_str) {
+		return AGGREGATE_MAX;
+	} else if (mode == aggregate_p95_str) {
+		return AGGREGATE_P95;
+	} else if (mode == aggregate_sum_str) {
+		return AGGREGATE_SUM;
+	}
+
+	return AGGREGATE_NONE;
+}
+
+/**
+ * Discard every sample.
+ */
+void
+Pandora_Aggregate::reset () {
+	int i;
+
+	this->count = 0;
+	this->sum   = 0;
+	this->min   = 0;
+	this->max   = 0;
+
+	for (i = 0; i < 5; i++) {
+		this->heights[i]   = 0;
+		this->positions[i] = i + 1;
+	}
+
+	this->desired[0] = 1;
+	this->desired[1] = 1 + 2 * AGGREGATE_QUANTILE;
+	this->desired[2] = 1 + 4 * AGGREGATE_QUANTILE;
+	this->desired[3] = 3 + 2 * AGGREGATE_QUANTILE;
+	this->desired[4] = 5;
+
+	this->increments[0] = 0;
+	this->increments[1] = AGGREGATE_QUANTILE / 2;
+	this->increments[2] = AGGREGATE_QUANTILE;
+	this->increments[3] = (1 + AGGREGATE_QUANTILE) / 2;
+	this->increments[4] = 1;
+}
+
+/**
+ * Add a new sample to the aggregate.
+ *
+ * @param value Sample value.
+ */
+void
+Pandora_Aggregate::addSample (double value) {
+	if (this->count == 0 || value < this->min) {
+		this->min = value;
+	}
+	if (this->count == 0 || value > this->max) {
+		this->max = value;
+	}
+	this->sum += value;
+
+	if (this->mode == AGGREGATE_P95) {
+		this->addQuantileSample (value);
+	}
+
+	this->count++;
+}
+
+/**
+ * Update the P-square markers with a new sample.
+ *
+ * The first five samples are stored sorted and used as the initial
+ * marker heights.
+ *
+ * @param value Sample value.
+ */
+void
+Pandora_Aggregate::addQuantileSample (double value) {
+	int    i, k;
+	double d, height;
+
+	/* Initial samples */
+	if (this->count < 5) {
+		for (i = this->count; i > 0 && this->heights[i - 1] > value; i--) {
+			this->heights[i] = this->heights[i - 1];
+		}
+		this->heights[i] = value;
+		return;
+	}
+
+	/* Find the cell the sample falls into */
+	if (value < this->heights[0]) {
+		this->heights[0] = value;
+		k = 0;
+	} else if (value >= this->heights[4]) {
+		this->heights[4] = value;
+		k = 3;
+	} else {
+		for (k = 0; k < 3 && value >= this->heights[k + 1]; k++);
+	}
+
+	for (i = k + 1; i < 5; i++) {
+		this->positions[i]++;
+	}
+	for (i = 0; i < 5; i++) {
+		this->desired[i] += this->increments[i];
+	}
+
+	/* Adjust the middle markers */
+	for (i = 1; i < 4; i++) {
+		d = this->desired[i] - this->positions[i];
+		if ((d >= 1 && this->positions[i + 1] - this->positions[i] > 1) ||
+		    (d <= -1 && this->positions[i - 1] - this->positions[i] < -1)) {
+			d = (d > 0) ? 1 : -1;
+
+			/* Parabolic prediction */
+			height = this->heights[i] + d / (this->positions[i + 1] - this->positions[i - 1]) *
+				((this->positions[i] - this->positions[i - 1] + d) *
+				 (this->heights[i + 1] - this->heights[i]) /
+				 (this->positions[i + 1] - this->positions[i]) +
+				 (this->positions[i + 1] - this->positions[i] - d) *
+				 (this->heights[i] - this->heights[i - 1]) /
+				 (this->positions[i] - this->positions[i - 1]));
+
+			/* Fall back to a linear prediction */
+			if (height <= this->heights[i - 1] || height >= this->heights[i + 1]) {
+				k = i + (int) d;
+				height = this->heights[i] + d * (this->heights[k] - this->heights[i]) /
+					(this->positions[k] - this->positions[i]);
+			}
+
+			this->heights[i] = height;
+			this->positions[i] += d;
+		}
+	}
+}
+
+/**
+ * Get the estimated quantile.
+ *
+ * @return The estimated quantile.
+ */
+double
+Pandora_Aggregate::getQuantile () const {
+	int rank;
+
+	if (this->count == 0) {
+		return 0;
+	}
+
+	/* Nearest rank over the stored samples */
+	if (this->count <= 5) {
+		rank = (int) ceil (AGGREGATE_QUANTILE * this->count) - 1;
+		if (rank < 0) {
+			rank = 0;
+		}
+		return this->heights[rank];
+	}
+
+	return this->heights[2];
+}
+
+/**
+ * Get the number of samples added since the last reset.
+ *
+ * @return The number of samples.
+ */
+unsigned long
+Pandora_Aggregate::getCount () const {
+	return this->count;
+}
+
+/**
+ * Get the aggregation mode.
+ *
+ * @return The aggregation mode.
+ */
+Aggregate_Mode
+Pandora_Aggregate::getMode () const {
+	return this->mode;
+}
+
+/**
+ * Get the aggregated value.
+ *
+ * @return The aggregated value, 0 if there are no samples.
+ */
+double
+Pandora_Aggregate::getValue () const {
+	if (this->count == 0) {
+		return 0;
+	}
+
+	switch (this->mode) {
+	case AGGREGATE_AVG:
+		return this->sum / this->count;
+	case AGGREGATE_MIN:
+		return this->min;
+	case AGGREGATE_MAX:
+		return this->max;
+	case AGGREGATE_P95:
+		return this->getQuantile ();
+	case AGGREGATE_SUM:
+		return this->sum;
+	default:
+		return 0;
+	}
+}
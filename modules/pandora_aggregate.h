@@ -0,0 +1,82 @@
+/* Constant memory aggregation of module samples.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_AGGREGATE_H__
+#define	__PANDORA_AGGREGATE_H__
+
+#include <string>
+
+using namespace std;
+
+namespace Pandora_Modules {
+
+	/**
+	 * Defines how the samples of a module are aggregated.
+	 */
+	typedef enum {
+		AGGREGATE_NONE, /**< No aggregation, send the latest value */
+		AGGREGATE_AVG,  /**< Arithmetic mean of the samples        */
+		AGGREGATE_MIN,  /**< Lowest sample                         */
+		AGGREGATE_MAX,  /**< Highest sample                        */
+		AGGREGATE_P95,  /**< Estimated 95th percentile             */
+		AGGREGATE_SUM   /**< Sum of the samples                    */
+	} Aggregate_Mode;
+
+	const string aggregate_avg_str = "avg";
+	const string aggregate_min_str = "min";
+	const string aggregate_max_str = "max";
+	const string aggregate_p95_str = "p95";
+	const string aggregate_sum_str = "sum";
+
+	/**
+	 * Accumulates the samples taken between two packet sends.
+	 *
+	 * Memory usage does not depend on the number of samples: the
+	 * percentile is estimated with the P-square algorithm (Jain and
+	 * Chlamtac), which only keeps five markers.
+	 */
+	class Pandora_Aggregate {
+	private:
+		Aggregate_Mode mode;
+		unsigned long  count;
+		double         sum, min, max;
+
+		/* P-square markers */
+		double         heights[5];
+		double         positions[5];
+		double         desired[5];
+		double         increments[5];
+
+		void           addQuantileSample (double value);
+		double         getQuantile       () const;
+	public:
+		Pandora_Aggregate                (Aggregate_Mode mode);
+
+		static Aggregate_Mode
+			parseModeFromString      (string mode);
+
+		void           addSample         (double value);
+		unsigned long  getCount          () const;
+		double         getValue          () const;
+		Aggregate_Mode getMode           () const;
+		void           reset             ();
+	};
+}
+
+#endif
@@ -0,0 +1,336 @@
+/* Configuration check and cost estimation.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_conf_check.h"
+#include "pandora_module_definition.h"
+#include "pandora_pattern_set.h"
+#include "../misc/pandora_conf_loader.h"
+#include "../misc/pandora_timing.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace Pandora;
+using namespace Pandora_Modules;
+
+/**
+ * Creates an empty configuration check.
+ */
+Pandora_Conf_Check::Pandora_Conf_Check () {
+}
+
+/**
+ * Check the conditions of a module definition.
+ *
+ * @param values Conditions, as given in the definition.
+ * @param intensive True for intensive conditions.
+ * @param kind Description of the conditions for the problems found.
+ * @param problems Where the invalid conditions are appended.
+ *
+ * @return Number of valid conditions.
+ */
+static int
+checkConditions (const list<string> &values, bool intensive, string kind,
+		 list<string> &problems) {
+	list<string>::const_iterator iter;
+	Pandora_Pattern_Set          patterns;
+	Condition                    cond;
+	int                          valid = 0;
+
+	for (iter = values.begin (); iter != values.end (); iter++) {
+		if (! Pandora_Module_Definition::parseCondition (*iter, intensive, &cond) ||
+		    (cond.operation == "=~" && patterns.add (cond.string_value, false) < 0)) {
+			problems.push_back ("Invalid " + kind + ": " + *iter);
+		} else {
+			valid++;
+		}
+	}
+
+	return valid;
+}
+
+/**
+ * Check a module definition and add its cost to a section.
+ *
+ * The definition is validated as the module factory does, without
+ * creating the module.
+ *
+ * @param section Section of the definition.
+ * @param definition Module definition.
+ * @param line Line of the file where the definition starts.
+ */
+void
+Pandora_Conf_Check::checkDefinition (Section *section, string definition, int line) {
+	list<string>           problems;
+	list<string>::iterator iter;
+	ostringstream          location;
+	string                 rejected;
+	Module_Kind            kind;
+	double                 weight;
+	int                    interval, commands;
+
+	location << section->file << ":" << line << ": ";
+
+	Pandora_Module_Definition parsed (definition, &problems);
+
+	/* Same reasons as the factory to reject a definition */
+	kind = parsed.getKind ();
+	if (kind == MODULE_0) {
+		rejected = "No module kind (module_exec, module_proc...)";
+	} else if (kind == MODULE_PROC && parsed.isEnabled (TOKEN_WATCHDOG) &&
+		   parsed.getValue (TOKEN_START_COMMAND) == "") {
+		rejected = "Watchdog without module_start_command";
+	} else if (kind != MODULE_PLUGIN &&
+		   Pandora_Module_Definition::parseType (parsed.getValue (TOKEN_TYPE)) == TYPE_0) {
+		rejected = "Bad module type \"" + parsed.getValue (TOKEN_TYPE) + "\"";
+	}
+
+	commands = checkConditions (parsed.getValues (TOKEN_PRECONDITION), false, "precondition", problems);
+	commands += checkConditions (parsed.getValues (TOKEN_CONDITION), false, "condition", problems);
+	checkConditions (parsed.getValues (TOKEN_INTENSIVECONDITION), true, "intensive condition", problems);
+
+	for (iter = problems.begin (); iter != problems.end (); iter++) {
+		this->errors.push_back (location.str () + *iter);
+	}
+
+	if (rejected != "") {
+		this->errors.push_back (location.str () + "Module definition rejected: " + rejected);
+		section->rejected++;
+		return;
+	}
+
+	section->modules++;
+	this->definitions.push_back (definition);
+
+	/* Modules run once every module_interval agent intervals */
+	weight = 1.0;
+	interval = atoi (parsed.getValue (TOKEN_INTERVAL).c_str ());
+	if (interval > 1) {
+		weight /= interval;
+	}
+
+	switch (kind) {
+	case MODULE_PLUGIN:
+		/* Persistent plugins are started once */
+		if (parsed.isEnabled (TOKEN_PERSISTENT)) {
+			break;
+		}
+	case MODULE_EXEC:
+	case MODULE_PING:
+	case MODULE_SNMPGET:
+		section->processes += weight;
+		break;
+	case MODULE_PROC:
+	case MODULE_SERVICE:
+	case MODULE_FREEDISK:
+	case MODULE_FREEDISK_PERCENT:
+	case MODULE_FREEMEMORY:
+	case MODULE_FREEMEMORY_PERCENT:
+	case MODULE_CPUUSAGE:
+	case MODULE_INVENTORY:
+	case MODULE_WMIQUERY:
+		section->wmi_queries += weight;
+		break;
+	case MODULE_REGEXP:
+		section->file_tails += weight;
+		break;
+	default:
+		break;
+	}
+
+	/* Each precondition and condition runs a command */
+	section->processes += weight * commands;
+}
+
+/**
+ * Check the module definitions of a configuration file.
+ *
+ * @param filename Path of the file.
+ * @param main_file True for the main configuration file, the only one
+ *        whose include lines are followed.
+ *
+ * @return Time spent in the file and its includes, in microseconds.
+ */
+unsigned long long
+Pandora_Conf_Check::checkFile (string filename, bool main_file) {
+	Section           *section;
+	string             text, buffer, definition, path_file;
+	unsigned long long start, nested = 0;
+	size_t             pos;
+	int                line = 0, first_line;
+
+	start = Pandora_Timing::getMicroseconds ();
+
+	this->sections.push_back (Section ());
+	section = &(this->sections.back ());
+	section->file = filename;
+	section->modules = section->rejected = 0;
+	section->processes = section->wmi_queries = section->file_tails = 0;
+
+	if (! Pandora_Conf_Loader::getInstance ()->getText (filename, text)) {
+		this->errors.push_back (filename + ": Could not read the file");
+		section->usecs = Pandora_Timing::getMicroseconds () - start;
+		return section->usecs;
+	}
+	istringstream file (text);
+
+	while (! file.eof ()) {
+		getline (file, buffer);
+		line++;
+
+		/* Ignore blank or commented lines */
+		if (buffer[0] == '#' || buffer[0] == '\n' || buffer[0] == '\0') {
+			continue;
+		}
+
+		/* Include, as read by Pandora_Module_List */
+		pos = buffer.find ("include");
+		if (main_file && pos != string::npos) {
+			path_file = buffer.substr (pos + 8);
+			pos = path_file.find ("\"");
+			while (pos != string::npos) {
+				path_file.replace (pos, 1, "");
+				pos = path_file.find ("\"", pos + 1);
+			}
+
+			nested += this->checkFile (path_file, false);
+		}
+
+		/* Module */
+		if (buffer.find ("module_begin") != string::npos) {
+			definition = buffer + "\n";
+			first_line = line;
+			while (! file.eof ()) {
+				getline (file, buffer);
+				line++;
+				definition += buffer + "\n";
+				if (buffer.find ("module_end") != string::npos) {
+					break;
+				}
+			}
+
+			this->checkDefinition (section, definition, first_line);
+			continue;
+		}
+
+		/* Plugin */
+		if (buffer.find ("module_plugin") != string::npos) {
+			this->checkDefinition (section, buffer, line);
+		}
+	}
+
+	section->usecs = Pandora_Timing::getMicroseconds () - start - nested;
+	return section->usecs + nested;
+}
+
+/**
+ * Check a configuration file and its includes.
+ *
+ * @param filename Path of the main configuration file.
+ *
+ * @return True if no problems were found.
+ */
+bool
+Pandora_Conf_Check::check (string filename) {
+	this->filename = filename;
+	this->sections.clear ();
+	this->errors.clear ();
+	this->definitions.clear ();
+
+	this->checkFile (filename, true);
+
+	return this->errors.empty ();
+}
+
+/**
+ * Print the problems found, the parse time of each file and the
+ * estimated cost of the modules.
+ *
+ * @param out Stream to print to.
+ */
+void
+Pandora_Conf_Check::printReport (ostream &out) {
+	list<Section>::iterator section;
+	list<string>::iterator  error;
+	double                  processes = 0, wmi_queries = 0, file_tails = 0;
+	int                     modules = 0, rejected = 0;
+
+	out << fixed << setprecision (1);
+
+	for (error = this->errors.begin (); error != this->errors.end (); error++) {
+		out << *error << endl;
+	}
+	if (! this->errors.empty ()) {
+		out << endl;
+	}
+
+	out << "Parse time:" << endl;
+	for (section = this->sections.begin (); section != this->sections.end (); section++) {
+		out << "\t" << section->file << ": " << section->modules << " modules, ";
+		out << section->rejected << " rejected, ";
+		out << section->usecs / 1000.0 << " ms" << endl;
+
+		modules += section->modules;
+		rejected += section->rejected;
+		processes += section->processes;
+		wmi_queries += section->wmi_queries;
+		file_tails += section->file_tails;
+	}
+
+	out << endl << "Estimated cost per agent interval:" << endl;
+	out << "\tSpawned processes: " << processes << endl;
+	out << "\tWMI queries:       " << wmi_queries << endl;
+	out << "\tFile tails:        " << file_tails << endl;
+
+	out << endl << modules << " modules, " << rejected << " rejected, ";
+	out << this->errors.size () << " problems found" << endl;
+}
+
+/**
+ * Write the accepted module definitions to a single file.
+ *
+ * The definitions of the included files are written in place, so the
+ * snapshot can be used as a configuration without includes.
+ *
+ * @param filename Path of the snapshot.
+ *
+ * @return False if the snapshot could not be written.
+ */
+bool
+Pandora_Conf_Check::writeSnapshot (string filename) {
+	list<string>::iterator iter;
+
+	ofstream file (filename.c_str ());
+	if (! file.is_open ()) {
+		return false;
+	}
+
+	file << "# Module definitions checked from " << this->filename << endl;
+	for (iter = this->definitions.begin (); iter != this->definitions.end (); iter++) {
+		file << endl << *iter;
+		if (iter->empty () || (*iter)[iter->size () - 1] != '\n') {
+			file << endl;
+		}
+	}
+
+	file.close ();
+	return ! file.fail ();
+}
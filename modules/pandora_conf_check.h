@@ -0,0 +1,67 @@
+/* Configuration check and cost estimation.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_CONF_CHECK_H__
+#define	__PANDORA_CONF_CHECK_H__
+
+#include <string>
+#include <list>
+#include <ostream>
+
+using namespace std;
+
+namespace Pandora_Modules {
+	/**
+	 * Checks a configuration file without running the agent.
+	 *
+	 * Every module definition of the file and its includes is parsed
+	 * with Pandora_Module_Definition, like the module factory does,
+	 * and the definitions the agent would reject are reported, along
+	 * with the unknown lines and the invalid conditions. No module is
+	 * created, so the check also runs outside Windows. The cost of
+	 * the modules is estimated as how many processes, WMI queries and
+	 * file tails they need per agent interval.
+	 */
+	class Pandora_Conf_Check {
+	private:
+		typedef struct {
+			string             file;
+			int                modules, rejected;
+			unsigned long long usecs;      /* Parse time, includes excluded */
+			double             processes, wmi_queries, file_tails;
+		} Section;
+
+		list<Section> sections;
+		list<string>  errors;
+		list<string>  definitions;  /* Accepted, in load order */
+		string        filename;
+
+		unsigned long long checkFile     (string filename, bool main_file);
+		void          checkDefinition    (Section *section, string definition,
+						  int line);
+	public:
+		Pandora_Conf_Check               ();
+
+		bool          check              (string filename);
+		void          printReport        (ostream &out);
+		bool          writeSnapshot      (string filename);
+	};
+}
+
+#endif /* __PANDORA_CONF_CHECK_H__ */
@@ -0,0 +1,600 @@
+/* Batched readers of event log records.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_event_reader.h"
+#ifdef _WIN32
+#include "../pandora.h"
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <map>
+
+/* Initial size of the batch buffer */
+#define EVENT_BATCH_SIZE (64 * 1024)
+
+/* Largest record accepted, as ReadEventLog () does */
+#define EVENT_MAX_RECORD 0x7FFFF
+
+/* Length, reserved and record number fields */
+#define EVENT_MIN_RECORD 12
+
+/* Last record read from each log, in the bookmark directory */
+#define BOOKMARK_FILE "logevent_bookmarks.dat"
+
+#ifdef _WIN32
+using namespace Pandora;
+#endif
+using namespace Pandora_Modules;
+
+/* Bookmarks of every reader, by key */
+static map<string, unsigned long> bookmarks;
+static bool                       bookmarks_loaded = false;
+static string                     bookmark_dir;
+
+/**
+ * Read the bookmark file. Each line has a record number followed by
+ * the key of its reader.
+ */
+static void
+loadBookmarks () {
+	ifstream      file;
+	string        line, key;
+	unsigned long number;
+
+	bookmarks_loaded = true;
+
+	file.open ((bookmark_dir + BOOKMARK_FILE).c_str ());
+	while (getline (file, line)) {
+		istringstream fields (line);
+
+		fields >> number;
+		if (fields.fail () || fields.get () != ' ') {
+			continue;
+		}
+
+		getline (fields, key);
+		if (! key.empty ()) {
+			bookmarks[key] = number;
+		}
+	}
+}
+
+/**
+ * Write the bookmark file.
+ *
+ * The file is written aside and then renamed, so a crash never leaves
+ * it half written.
+ */
+static void
+writeBookmarks () {
+	map<string, unsigned long>::iterator iter;
+	ofstream                             file;
+	string                               path, temp_path;
+
+	path = bookmark_dir + BOOKMARK_FILE;
+	temp_path = path + ".tmp";
+
+	file.open (temp_path.c_str ());
+	for (iter = bookmarks.begin (); iter != bookmarks.end (); iter++) {
+		file << iter->second << ' ' << iter->first << '\n';
+	}
+	file.close ();
+	if (file.fail ()) {
+		remove (temp_path.c_str ());
+		return;
+	}
+
+#ifdef _WIN32
+	MoveFileEx (temp_path.c_str (), path.c_str (), MOVEFILE_REPLACE_EXISTING);
+#else
+	rename (temp_path.c_str (), path.c_str ());
+#endif
+}
+
+/**
+ * Creates a reader. The source is not opened until open () is called.
+ */
+Pandora_Event_Reader::Pandora_Event_Reader () {
+	this->position = 0;
+	this->filled = 0;
+	this->is_open = false;
+	this->bookmark = 0;
+	this->saved_bookmark = 0;
+	this->has_bookmark = false;
+}
+
+/**
+ * Destroys the reader. Subclasses must close their source.
+ */
+Pandora_Event_Reader::~Pandora_Event_Reader () {
+}
+
+/**
+ * Get the number of a record.
+ */
+unsigned long
+Pandora_Event_Reader::getRecordNumber (const unsigned char *record) {
+	return (unsigned long) record[8] | ((unsigned long) record[9] << 8) |
+	       ((unsigned long) record[10] << 16) | ((unsigned long) record[11] << 24);
+}
+
+/**
+ * Get the length of a record, in bytes.
+ */
+size_t
+Pandora_Event_Reader::getRecordLength (const unsigned char *record) {
+	return (size_t) record[0] | ((size_t) record[1] << 8) |
+	       ((size_t) record[2] << 16) | ((size_t) record[3] << 24);
+}
+
+/**
+ * Set the directory of the bookmark file, shared by every reader. When
+ * it changes, the bookmarks are read from the new one when they are
+ * next needed.
+ *
+ * @param dir Directory, ending with a separator. By default the
+ *        working directory is used.
+ */
+void
+Pandora_Event_Reader::setBookmarkDir (string dir) {
+	if (dir == bookmark_dir) {
+		return;
+	}
+
+	bookmark_dir = dir;
+	bookmarks.clear ();
+	bookmarks_loaded = false;
+}
+
+/**
+ * Set the key the bookmark is saved with. Without a key the bookmark
+ * is only kept while the reader exists.
+ *
+ * @param key Key of the bookmark, unique for each reader.
+ */
+void
+Pandora_Event_Reader::setBookmarkKey (string key) {
+	this->bookmark_key = key;
+}
+
+/**
+ * Get the number of the last record handed out.
+ */
+unsigned long
+Pandora_Event_Reader::getBookmark () const {
+	return this->bookmark;
+}
+
+/**
+ * Open the source and place the reader after its bookmark.
+ *
+ * @param skip_existing Skip the records already in the log when there
+ *        is no saved bookmark.
+ *
+ * @return False if the source could not be opened.
+ */
+bool
+Pandora_Event_Reader::open (bool skip_existing) {
+	map<string, unsigned long>::iterator iter;
+	unsigned long                        oldest, count, newest;
+
+	if (this->is_open) {
+		return true;
+	}
+
+	if (! this->openSource ()) {
+		return false;
+	}
+	this->is_open = true;
+	this->position = 0;
+	this->filled = 0;
+
+	if (! this->has_bookmark && ! this->bookmark_key.empty ()) {
+		if (! bookmarks_loaded) {
+			loadBookmarks ();
+		}
+
+		iter = bookmarks.find (this->bookmark_key);
+		if (iter != bookmarks.end ()) {
+			this->bookmark = iter->second;
+			this->saved_bookmark = iter->second;
+			this->has_bookmark = true;
+		}
+	}
+
+	/* Keep the bookmark if the range is unknown */
+	if (! this->getRange (oldest, count)) {
+		this->has_bookmark = true;
+		return true;
+	}
+
+	if (count == 0) {
+		/* Every record written from now on is new */
+		this->bookmark = 0;
+	} else {
+		newest = oldest + count - 1;
+		if (! this->has_bookmark) {
+			this->bookmark = skip_existing ? newest : oldest - 1;
+		} else if (this->bookmark > newest || this->bookmark + 1 < oldest) {
+			/* Cleared or overwritten since the bookmark was taken */
+			this->bookmark = oldest - 1;
+		}
+	}
+	this->has_bookmark = true;
+
+	return true;
+}
+
+/**
+ * Close the source. The bookmark is kept for the next open ().
+ */
+void
+Pandora_Event_Reader::close () {
+	if (! this->is_open) {
+		return;
+	}
+
+	this->closeSource ();
+	this->is_open = false;
+	this->position = 0;
+	this->filled = 0;
+}
+
+/**
+ * Check if the source is open.
+ */
+bool
+Pandora_Event_Reader::isOpen () const {
+	return this->is_open;
+}
+
+/**
+ * Read the next batch of records, after the bookmark.
+ *
+ * @return False if there are no new records, or if the source failed.
+ *         The source is closed if the log changed.
+ */
+bool
+Pandora_Event_Reader::fill () {
+	size_t read, needed;
+	int    status;
+
+	if (this->buffer.empty ()) {
+		this->buffer.resize (EVENT_BATCH_SIZE);
+	}
+
+	while (1) {
+		read = 0;
+		needed = 0;
+		status = this->readRecords (this->bookmark + 1, &(this->buffer[0]),
+					    this->buffer.size (), read, needed);
+
+		switch (status) {
+		case EVENT_READ_OK:
+			if (read < EVENT_MIN_RECORD) {
+				return false;
+			}
+			this->position = 0;
+			this->filled = read;
+			return true;
+
+		case EVENT_READ_SMALL:
+			/* Grow the buffer for a single large record */
+			if (needed <= this->buffer.size () || needed > EVENT_MAX_RECORD) {
+				return false;
+			}
+			this->buffer.resize (needed);
+			continue;
+
+		case EVENT_READ_CHANGED:
+			this->close ();
+			return false;
+
+		default:
+			return false;
+		}
+	}
+}
+
+/**
+ * Get the next record after the bookmark, and move the bookmark to it.
+ *
+ * @param record Where the record is stored. It is valid until the next
+ *        call.
+ * @param size Where the length of the record is stored.
+ *
+ * @return False if there are no new records.
+ */
+bool
+Pandora_Event_Reader::next (const unsigned char *&record, size_t &size) {
+	const unsigned char *current;
+	unsigned long        number;
+	size_t               length;
+
+	while (this->is_open) {
+		while (this->position < this->filled) {
+			current = &(this->buffer[this->position]);
+			length = getRecordLength (current);
+
+			/* Truncated batch: read the log again on the next open */
+			if (length < EVENT_MIN_RECORD || length > this->filled - this->position) {
+				this->close ();
+				return false;
+			}
+			this->position += length;
+
+			/* Handed out before a seek */
+			number = getRecordNumber (current);
+			if (number <= this->bookmark) {
+				continue;
+			}
+
+			this->bookmark = number;
+			record = current;
+			size = length;
+			return true;
+		}
+
+		if (! this->fill ()) {
+			return false;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Save the bookmark to the bookmark file, if it moved since it was
+ * last saved.
+ */
+void
+Pandora_Event_Reader::saveBookmark () {
+	if (this->bookmark_key.empty () || ! this->has_bookmark ||
+	    this->bookmark == this->saved_bookmark) {
+		return;
+	}
+
+	if (! bookmarks_loaded) {
+		loadBookmarks ();
+	}
+
+	bookmarks[this->bookmark_key] = this->bookmark;
+	this->saved_bookmark = this->bookmark;
+	writeBookmarks ();
+}
+
+#ifdef _WIN32
+/**
+ * Creates a reader of a Windows event log.
+ *
+ * @param source Name of the event log (System, Application...).
+ */
+Pandora_Event_Log_Reader::Pandora_Event_Log_Reader (string source) {
+	this->source = source;
+	this->log = NULL;
+	this->next_record = 0;
+}
+
+/**
+ * Destroys the reader, closing the event log.
+ */
+Pandora_Event_Log_Reader::~Pandora_Event_Log_Reader () {
+	this->close ();
+}
+
+bool
+Pandora_Event_Log_Reader::openSource () {
+	this->log = OpenEventLog (NULL, this->source.c_str ());
+	if (this->log == NULL) {
+		pandoraDebug ("Could not open event log %s.", this->source.c_str ());
+		return false;
+	}
+
+	this->next_record = 0;
+	return true;
+}
+
+void
+Pandora_Event_Log_Reader::closeSource () {
+	if (this->log != NULL) {
+		CloseEventLog (this->log);
+		this->log = NULL;
+	}
+}
+
+bool
+Pandora_Event_Log_Reader::getRange (unsigned long &oldest, unsigned long &count) {
+	DWORD oldest_record, records;
+
+	if (GetNumberOfEventLogRecords (this->log, &records) == 0) {
+		return false;
+	}
+
+	if (records == 0) {
+		oldest = 0;
+		count = 0;
+		return true;
+	}
+
+	if (GetOldestEventLogRecord (this->log, &oldest_record) == 0) {
+		return false;
+	}
+
+	oldest = oldest_record;
+	count = records;
+	return true;
+}
+
+/**
+ * Read as many records as fit in the buffer. Reads continue
+ * sequentially from the last one, and seek to the record asked for
+ * otherwise.
+ */
+int
+Pandora_Event_Log_Reader::readRecords (unsigned long first, unsigned char *buffer,
+				       size_t size, size_t &read, size_t &needed) {
+	DWORD  flags, bytes_read = 0, bytes_needed = 0, error;
+	size_t offset, length;
+
+	flags = EVENTLOG_FORWARDS_READ;
+	if (first == this->next_record) {
+		flags |= EVENTLOG_SEQUENTIAL_READ;
+	} else {
+		flags |= EVENTLOG_SEEK_READ;
+	}
+
+	if (! ReadEventLog (this->log, flags, first, buffer, (DWORD) size,
+			    &bytes_read, &bytes_needed)) {
+		error = GetLastError ();
+		switch (error) {
+		case ERROR_INSUFFICIENT_BUFFER:
+			needed = bytes_needed;
+			return EVENT_READ_SMALL;
+		case ERROR_HANDLE_EOF:
+			return EVENT_READ_END;
+		case ERROR_INVALID_PARAMETER:
+			/* Seek past the newest record */
+			if (flags & EVENTLOG_SEEK_READ) {
+				return EVENT_READ_END;
+			}
+			break;
+		case ERROR_EVENTLOG_FILE_CORRUPT:
+		case ERROR_EVENTLOG_FILE_CHANGED:
+			pandoraDebug ("Event log %s changed, reopening.", this->source.c_str ());
+			return EVENT_READ_CHANGED;
+		}
+		pandoraDebug ("Error reading event log %s: %d", this->source.c_str (), error);
+		return EVENT_READ_ERROR;
+	}
+
+	read = bytes_read;
+
+	/* A sequential read follows the last record */
+	for (offset = 0; offset + EVENT_MIN_RECORD <= read; offset += length) {
+		length = getRecordLength (buffer + offset);
+		if (length < EVENT_MIN_RECORD) {
+			break;
+		}
+		this->next_record = getRecordNumber (buffer + offset) + 1;
+	}
+
+	return EVENT_READ_OK;
+}
+#endif
+
+/**
+ * Creates a reader of a file of recorded records.
+ *
+ * @param path Path of the file.
+ */
+Pandora_Event_Replay_Reader::Pandora_Event_Replay_Reader (string path) {
+	this->path = path;
+}
+
+/**
+ * Destroys the reader.
+ */
+Pandora_Event_Replay_Reader::~Pandora_Event_Replay_Reader () {
+	this->close ();
+}
+
+bool
+Pandora_Event_Replay_Reader::openSource () {
+	ifstream file (this->path.c_str (), ios::binary);
+	string   contents;
+
+	if (! file.is_open ()) {
+		return false;
+	}
+
+	ostringstream stream;
+	stream << file.rdbuf ();
+	contents = stream.str ();
+	this->data.assign (contents.begin (), contents.end ());
+	return true;
+}
+
+void
+Pandora_Event_Replay_Reader::closeSource () {
+	this->data.clear ();
+}
+
+bool
+Pandora_Event_Replay_Reader::getRange (unsigned long &oldest, unsigned long &count) {
+	size_t offset, length;
+
+	oldest = 0;
+	count = 0;
+	for (offset = 0; offset + EVENT_MIN_RECORD <= this->data.size (); offset += length) {
+		length = getRecordLength (&(this->data[offset]));
+		if (length < EVENT_MIN_RECORD || length > this->data.size () - offset) {
+			break;
+		}
+		if (count == 0) {
+			oldest = getRecordNumber (&(this->data[offset]));
+		}
+		count++;
+	}
+
+	return true;
+}
+
+/**
+ * Copy the records from the one asked for, as many as fit in the
+ * buffer.
+ */
+int
+Pandora_Event_Replay_Reader::readRecords (unsigned long first, unsigned char *buffer,
+					  size_t size, size_t &read, size_t &needed) {
+	size_t offset = 0, length;
+	bool   found = false;
+
+	read = 0;
+	while (offset + EVENT_MIN_RECORD <= this->data.size ()) {
+		length = getRecordLength (&(this->data[offset]));
+		if (length < EVENT_MIN_RECORD || length > this->data.size () - offset) {
+			break;
+		}
+
+		if (! found) {
+			if (getRecordNumber (&(this->data[offset])) < first) {
+				offset += length;
+				continue;
+			}
+			found = true;
+		}
+
+		if (read + length > size) {
+			if (read == 0) {
+				needed = length;
+				return EVENT_READ_SMALL;
+			}
+			break;
+		}
+
+		memcpy (buffer + read, &(this->data[offset]), length);
+		read += length;
+		offset += length;
+	}
+
+	return read > 0 ? EVENT_READ_OK : EVENT_READ_END;
+}
@@ -0,0 +1,139 @@
+/* Batched readers of event log records.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#ifndef	__PANDORA_EVENT_READER_H__
+#define	__PANDORA_EVENT_READER_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Status of Pandora_Event_Reader::readRecords () */
+#define EVENT_READ_OK      0
+#define EVENT_READ_END     1 /* No records from the one asked for */
+#define EVENT_READ_SMALL   2 /* The first record does not fit */
+#define EVENT_READ_CHANGED 3 /* The log was cleared or is corrupt */
+#define EVENT_READ_ERROR   4
+
+namespace Pandora_Modules {
+	/**
+	 * Reader of the records of an event log, in batches.
+	 *
+	 * Each read fills a buffer, kept between reads, with as many
+	 * records as fit, and the records are handed out one by one from
+	 * it. The buffer only grows when a single record does not fit.
+	 *
+	 * The number of the last record handed out is the bookmark of
+	 * the reader. It is saved to a bookmark file, so after a restart
+	 * of the agent the reading resumes with the next record: records
+	 * are neither read again nor skipped. A cleared or overwritten
+	 * log is read from its oldest record.
+	 *
+	 * The records have the layout of EVENTLOGRECORD: the length of
+	 * the record in its first 4 bytes and the record number at offset
+	 * 8. Subclasses provide the source: the Windows event log, or a
+	 * file with recorded records, which can be replayed anywhere.
+	 */
+	class Pandora_Event_Reader {
+	private:
+		vector<unsigned char> buffer;
+		size_t                position, filled;
+		bool                  is_open;
+		unsigned long         bookmark, saved_bookmark;
+		bool                  has_bookmark;
+		string                bookmark_key;
+
+		bool         fill               ();
+	protected:
+		virtual bool openSource         () = 0;
+		virtual void closeSource        () = 0;
+		virtual bool getRange           (unsigned long &oldest,
+						 unsigned long &count) = 0;
+		virtual int  readRecords        (unsigned long first,
+						 unsigned char *buffer, size_t size,
+						 size_t &read, size_t &needed) = 0;
+
+		static unsigned long getRecordNumber (const unsigned char *record);
+		static size_t        getRecordLength (const unsigned char *record);
+	public:
+		Pandora_Event_Reader            ();
+		virtual ~Pandora_Event_Reader   ();
+
+		static void   setBookmarkDir    (string dir);
+		void          setBookmarkKey    (string key);
+		unsigned long getBookmark       () const;
+
+		bool          open              (bool skip_existing);
+		void          close             ();
+		bool          isOpen            () const;
+		bool          next              (const unsigned char *&record,
+						 size_t &size);
+		void          saveBookmark      ();
+	};
+
+#ifdef _WIN32
+	/**
+	 * Reader of a Windows event log.
+	 */
+	class Pandora_Event_Log_Reader : public Pandora_Event_Reader {
+	private:
+		string        source;
+		HANDLE        log;
+		unsigned long next_record; /* Next record of a sequential read */
+	protected:
+		bool openSource  ();
+		void closeSource ();
+		bool getRange    (unsigned long &oldest, unsigned long &count);
+		int  readRecords (unsigned long first, unsigned char *buffer,
+				  size_t size, size_t &read, size_t &needed);
+	public:
+		Pandora_Event_Log_Reader  (string source);
+		~Pandora_Event_Log_Reader ();
+	};
+#endif
+
+	/**
+	 * Reader of a file of recorded event log records, one after the
+	 * other. The file is read again each time the reader is opened,
+	 * so records appended meanwhile are found.
+	 */
+	class Pandora_Event_Replay_Reader : public Pandora_Event_Reader {
+	private:
+		string                path;
+		vector<unsigned char> data;
+	protected:
+		bool openSource  ();
+		void closeSource ();
+		bool getRange    (unsigned long &oldest, unsigned long &count);
+		int  readRecords (unsigned long first, unsigned char *buffer,
+				  size_t size, size_t &read, size_t &needed);
+	public:
+		Pandora_Event_Replay_Reader  (string path);
+		~Pandora_Event_Replay_Reader ();
+	};
+}
+
+#endif /* __PANDORA_EVENT_READER_H__ */
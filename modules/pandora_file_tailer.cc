@@ -0,0 +1,981 @@
+/* Shared reader of the files searched by module_regexp modules.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_file_tailer.h"
+
+#include <sys/stat.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <dirent.h>
+#endif
+
+/* Size of the blocks read from the file */
+#define TAILER_BLOCK_SIZE (64 * 1024)
+
+/* Longer lines are split */
+#define TAILER_MAX_LINE (16 * 1024 * 1024)
+
+/* Defaults for a source with several files */
+#define TAILER_REFRESH  30 /* Seconds between listings */
+#define TAILER_MAX_OPEN 16 /* Files kept open */
+
+/* Offsets reached in each file, in the checkpoint directory */
+#define CHECKPOINT_FILE "regexp_checkpoints.dat"
+
+using namespace Pandora_Modules;
+
+/* Shared tailers, by source */
+static map<string, Pandora_File_Tailer *> tailers;
+
+typedef struct {
+	File_Id   id;
+	long long offset;
+} Checkpoint;
+
+/* Checkpoints of every file tailed, by file */
+static map<string, Checkpoint> checkpoints;
+static bool                    checkpoints_loaded = false;
+static bool                    checkpoints_changed = false;
+static string                  checkpoint_dir;
+
+/**
+ * Check if two identities belong to the same file.
+ */
+static bool
+sameFile (const File_Id &a, const File_Id &b) {
+	return a.volume == b.volume && a.index == b.index;
+}
+
+#ifdef _WIN32
+/**
+ * Get the identity and size of an open file.
+ */
+static bool
+getHandleInfo (HANDLE handle, File_Id &id, long long &size) {
+	BY_HANDLE_FILE_INFORMATION info;
+
+	if (! GetFileInformationByHandle (handle, &info)) {
+		return false;
+	}
+
+	id.volume = info.dwVolumeSerialNumber;
+	id.index = ((unsigned long long) info.nFileIndexHigh << 32) | info.nFileIndexLow;
+	size = ((long long) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	return true;
+}
+#endif
+
+/**
+ * Open a file to be read in binary mode.
+ *
+ * On Windows the file is shared for deletion too, so it can be
+ * renamed (rotated) while it is read.
+ *
+ * @param path Path of the file.
+ *
+ * @return The file, or NULL on error.
+ */
+static FILE *
+openFile (const string &path) {
+#ifdef _WIN32
+	HANDLE handle;
+	FILE  *file;
+	int    fd;
+
+	handle = CreateFile (path.c_str (), GENERIC_READ,
+			     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			     NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+
+	fd = _open_osfhandle ((intptr_t) handle, _O_RDONLY | _O_BINARY);
+	if (fd == -1) {
+		CloseHandle (handle);
+		return NULL;
+	}
+
+	file = _fdopen (fd, "rb");
+	if (file == NULL) {
+		_close (fd);
+	}
+	return file;
+#else
+	return fopen (path.c_str (), "rb");
+#endif
+}
+
+/**
+ * Get the identity and size of an open file.
+ *
+ * @return False on error.
+ */
+static bool
+getFileInfo (FILE *file, File_Id &id, long long &size) {
+#ifdef _WIN32
+	return getHandleInfo ((HANDLE) _get_osfhandle (_fileno (file)), id, size);
+#else
+	struct stat file_stat;
+
+	if (fstat (fileno (file), &file_stat) != 0) {
+		return false;
+	}
+
+	id.volume = file_stat.st_dev;
+	id.index = file_stat.st_ino;
+	size = file_stat.st_size;
+	return true;
+#endif
+}
+
+/**
+ * Get the identity and size of the file a path names.
+ *
+ * @return False if there is no such file.
+ */
+static bool
+getPathInfo (const string &path, File_Id &id, long long &size) {
+#ifdef _WIN32
+	HANDLE handle;
+	bool   found;
+
+	/* No access needed, just the attributes */
+	handle = CreateFile (path.c_str (), 0,
+			     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			     NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	found = getHandleInfo (handle, id, size);
+	CloseHandle (handle);
+	return found;
+#else
+	struct stat file_stat;
+
+	if (stat (path.c_str (), &file_stat) != 0) {
+		return false;
+	}
+
+	id.volume = file_stat.st_dev;
+	id.index = file_stat.st_ino;
+	size = file_stat.st_size;
+	return true;
+#endif
+}
+
+/**
+ * Move to an offset of a file, which may be beyond 2 GB.
+ *
+ * @return False on error.
+ */
+static bool
+seekFile (FILE *file, long long offset) {
+#ifdef _WIN32
+	return fseeko64 (file, offset, SEEK_SET) == 0;
+#else
+	return fseeko (file, offset, SEEK_SET) == 0;
+#endif
+}
+
+/**
+ * Check if a file name matches a pattern with * and ? wildcards.
+ */
+static bool
+wildcardMatch (const char *pattern, const char *name) {
+	const char *star = NULL, *resume = NULL;
+
+	while (*name != '\0') {
+		if (*pattern == '*') {
+			star = pattern++;
+			resume = name;
+		} else if (*pattern == '?' || *pattern == *name) {
+			pattern++;
+			name++;
+		} else if (star != NULL) {
+			pattern = star + 1;
+			name = ++resume;
+		} else {
+			return false;
+		}
+	}
+
+	while (*pattern == '*') {
+		pattern++;
+	}
+	return *pattern == '\0';
+}
+
+/**
+ * Read the checkpoint file. Each line has the volume, file index and
+ * offset of a file, followed by its path.
+ */
+static void
+loadCheckpoints () {
+	ifstream   file;
+	string     line, source;
+	Checkpoint checkpoint;
+
+	checkpoints_loaded = true;
+
+	file.open ((checkpoint_dir + CHECKPOINT_FILE).c_str ());
+	while (getline (file, line)) {
+		istringstream fields (line);
+
+		fields >> checkpoint.id.volume >> checkpoint.id.index >> checkpoint.offset;
+		if (fields.fail () || fields.get () != ' ') {
+			continue;
+		}
+
+		getline (fields, source);
+		if (! source.empty ()) {
+			checkpoints[source] = checkpoint;
+		}
+	}
+}
+
+/**
+ * Find where the last agent run stopped reading a file.
+ *
+ * The file is looked for by path and then by identity, in case it was
+ * renamed in the meantime.
+ *
+ * @param path Path of the file.
+ * @param id Identity of the file.
+ * @param offset Where the offset is stored, if found.
+ * @param rotated Set if the path had a checkpoint for another file.
+ *
+ * @return True if the file had a checkpoint.
+ */
+static bool
+findCheckpoint (const string &path, const File_Id &id, long long &offset, bool &rotated) {
+	map<string, Checkpoint>::iterator iter;
+
+	if (! checkpoints_loaded) {
+		loadCheckpoints ();
+	}
+
+	rotated = false;
+	iter = checkpoints.find (path);
+	if (iter != checkpoints.end ()) {
+		if (sameFile (iter->second.id, id)) {
+			offset = iter->second.offset;
+			return true;
+		}
+		rotated = true;
+	}
+
+	for (iter = checkpoints.begin (); iter != checkpoints.end (); iter++) {
+		if (sameFile (iter->second.id, id)) {
+			offset = iter->second.offset;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Update the checkpoint of a file. It is saved by writeCheckpoints ().
+ */
+static void
+updateCheckpoint (const string &path, const File_Id &id, long long offset) {
+	map<string, Checkpoint>::iterator iter;
+
+	if (! checkpoints_loaded) {
+		loadCheckpoints ();
+	}
+
+	iter = checkpoints.find (path);
+	if (iter != checkpoints.end () && sameFile (iter->second.id, id) &&
+	    iter->second.offset == offset) {
+		return;
+	}
+
+	checkpoints[path].id = id;
+	checkpoints[path].offset = offset;
+	checkpoints_changed = true;
+}
+
+/**
+ * Remove the checkpoint of a file that is no longer read.
+ */
+static void
+forgetCheckpoint (const string &path, const File_Id &id) {
+	map<string, Checkpoint>::iterator iter;
+
+	iter = checkpoints.find (path);
+	if (iter != checkpoints.end () && sameFile (iter->second.id, id)) {
+		checkpoints.erase (iter);
+		checkpoints_changed = true;
+	}
+}
+
+/**
+ * Write the checkpoint file, if any checkpoint changed.
+ *
+ * The file is written aside and then renamed, so a crash never leaves
+ * it half written.
+ */
+static void
+writeCheckpoints () {
+	map<string, Checkpoint>::iterator iter;
+	ofstream                          file;
+	string                            path, temp_path;
+
+	if (! checkpoints_changed) {
+		return;
+	}
+	checkpoints_changed = false;
+
+	path = checkpoint_dir + CHECKPOINT_FILE;
+	temp_path = path + ".tmp";
+
+	file.open (temp_path.c_str ());
+	for (iter = checkpoints.begin (); iter != checkpoints.end (); iter++) {
+		file << iter->second.id.volume << ' ' << iter->second.id.index << ' '
+		     << iter->second.offset << ' ' << iter->first << '\n';
+	}
+	file.close ();
+	if (file.fail ()) {
+		remove (temp_path.c_str ());
+		return;
+	}
+
+#ifdef _WIN32
+	MoveFileEx (temp_path.c_str (), path.c_str (), MOVEFILE_REPLACE_EXISTING);
+#else
+	rename (temp_path.c_str (), path.c_str ());
+#endif
+}
+
+/**
+ * Creates a tailer. The files are opened on the first poll.
+ *
+ * @param source Path of the file, or of the files (see isMultiple ()).
+ * @param from_start Read the whole files on every poll.
+ */
+Pandora_File_Tailer::Pandora_File_Tailer (string source, bool from_start) {
+	struct stat file_stat;
+	size_t      pos;
+
+	this->source = source;
+	this->from_start = from_start;
+	this->multiple = isMultiple (source);
+	this->refresh = 0;
+	this->max_open = 0;
+	this->listed_at = 0;
+	this->listed_once = false;
+	this->pending = 0;
+	this->patterns = NULL;
+
+	if (! this->multiple) {
+		return;
+	}
+
+	/* A directory, or a file name pattern */
+	if (stat (source.c_str (), &file_stat) == 0 && S_ISDIR (file_stat.st_mode)) {
+		this->directory = source;
+		this->file_pattern = "*";
+	} else {
+		pos = source.find_last_of ("\\/");
+		this->directory = (pos == string::npos) ? "" : source.substr (0, pos + 1);
+		this->file_pattern = source.substr (pos + 1);
+		if (this->file_pattern.empty ()) {
+			this->file_pattern = "*";
+		}
+	}
+
+	if (! this->directory.empty () &&
+	    this->directory[this->directory.size () - 1] != '\\' &&
+	    this->directory[this->directory.size () - 1] != '/') {
+		this->directory += (this->directory.find ('/') != string::npos) ? '/' : '\\';
+	}
+}
+
+/**
+ * Destroys the tailer.
+ */
+Pandora_File_Tailer::~Pandora_File_Tailer () {
+	list<Tailed_File>::iterator iter;
+
+	for (iter = this->files.begin (); iter != this->files.end (); iter++) {
+		if (iter->file != NULL) {
+			fclose (iter->file);
+		}
+	}
+	delete this->patterns;
+}
+
+/**
+ * Check if a source covers several files: it names a directory, or
+ * its file name has * or ? wildcards.
+ *
+ * @param source Source of a module_regexp module.
+ *
+ * @return True for several files.
+ */
+bool
+Pandora_File_Tailer::isMultiple (string source) {
+	struct stat file_stat;
+	size_t      pos;
+
+	if (source.empty ()) {
+		return false;
+	}
+
+	pos = source.find_last_of ("\\/");
+	if (pos == source.size () - 1 ||
+	    source.find_first_of ("*?", pos == string::npos ? 0 : pos + 1) != string::npos) {
+		return true;
+	}
+
+	return stat (source.c_str (), &file_stat) == 0 && S_ISDIR (file_stat.st_mode);
+}
+
+/**
+ * Set the directory of the checkpoint file, shared by every tailer.
+ * When it changes, the checkpoints are read from the new one when they
+ * are next needed.
+ *
+ * @param dir Directory, ending with a separator. By default the
+ *        working directory is used.
+ */
+void
+Pandora_File_Tailer::setCheckpointDir (string dir) {
+	if (dir == checkpoint_dir) {
+		return;
+	}
+
+	checkpoint_dir = dir;
+	checkpoints.clear ();
+	checkpoints_loaded = false;
+	checkpoints_changed = false;
+}
+
+/**
+ * Set how the files of a multiple source are listed. When the modules
+ * on the same source ask for different values, the smallest ones are
+ * used.
+ *
+ * @param refresh Seconds between listings, or 0 for the default.
+ * @param max_open Files kept open, or 0 for the default.
+ */
+void
+Pandora_File_Tailer::setListing (int refresh, int max_open) {
+	if (refresh > 0 && (this->refresh == 0 || refresh < this->refresh)) {
+		this->refresh = refresh;
+	}
+	if (max_open > 0 && (this->max_open == 0 || max_open < this->max_open)) {
+		this->max_open = max_open;
+	}
+}
+
+/**
+ * Compile the patterns of the subscribers into a single set.
+ */
+void
+Pandora_File_Tailer::compilePatterns () {
+	list<Pandora_Tailer_Subscriber *>::iterator iter;
+
+	delete this->patterns;
+	this->patterns = new Pandora_Pattern_Set ();
+	this->targets.clear ();
+
+	/* Invalid patterns get no index, and never match */
+	for (iter = this->subscribers.begin (); iter != this->subscribers.end (); iter++) {
+		if (this->patterns->add ((*iter)->getPattern (), true) >= 0) {
+			this->targets.push_back (*iter);
+		}
+	}
+}
+
+/**
+ * Get a tailer for a module.
+ *
+ * @param source Path of the file, or of the files (see isMultiple ()).
+ * @param from_start Read the whole files on every poll.
+ * @param subscriber Module that gets the lines read.
+ *
+ * @return The tailer. It must be released with unsubscribe ().
+ */
+Pandora_File_Tailer *
+Pandora_File_Tailer::subscribe (string source, bool from_start, Pandora_Tailer_Subscriber *subscriber) {
+	map<string, Pandora_File_Tailer *>::iterator iter;
+	Pandora_File_Tailer                         *tailer;
+
+	if (from_start) {
+		tailer = new Pandora_File_Tailer (source, true);
+	} else {
+		iter = tailers.find (source);
+		if (iter != tailers.end ()) {
+			tailer = iter->second;
+		} else {
+			tailer = tailers[source] = new Pandora_File_Tailer (source, false);
+		}
+	}
+
+	tailer->subscribers.push_back (subscriber);
+	delete tailer->patterns;
+	tailer->patterns = NULL;
+	return tailer;
+}
+
+/**
+ * Stop handing lines to a module. The tailer is deleted along with
+ * its last subscriber.
+ *
+ * @param subscriber Subscribed module.
+ */
+void
+Pandora_File_Tailer::unsubscribe (Pandora_Tailer_Subscriber *subscriber) {
+	map<string, Pandora_File_Tailer *>::iterator iter;
+
+	this->subscribers.remove (subscriber);
+	if (! this->subscribers.empty ()) {
+		delete this->patterns;
+		this->patterns = NULL;
+		return;
+	}
+
+	iter = tailers.find (this->source);
+	if (iter != tailers.end () && iter->second == this) {
+		tailers.erase (iter);
+	}
+	delete this;
+}
+
+/**
+ * List the files of a multiple source.
+ *
+ * The files are matched by identity with the ones already known, so a
+ * renamed file keeps its state. The files no longer listed are marked
+ * to be read a last time and dropped.
+ */
+void
+Pandora_File_Tailer::listFiles () {
+	list<Tailed_File>::iterator iter;
+	vector<string>              paths;
+	Tailed_File                 tailed;
+	File_Id                     id;
+	long long                   size;
+	size_t                      i;
+#ifdef _WIN32
+	WIN32_FIND_DATA             file_data;
+	HANDLE                      find;
+#else
+	DIR                        *dir;
+	struct dirent              *entry;
+	struct stat                 file_stat;
+#endif
+
+#ifdef _WIN32
+	find = FindFirstFile ((this->directory + this->file_pattern).c_str (), &file_data);
+	if (find != INVALID_HANDLE_VALUE) {
+		do {
+			if (! (file_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+				paths.push_back (this->directory + file_data.cFileName);
+			}
+		} while (FindNextFile (find, &file_data) != 0);
+		FindClose (find);
+	}
+#else
+	dir = opendir (this->directory.empty () ? "." : this->directory.c_str ());
+	if (dir != NULL) {
+		while ((entry = readdir (dir)) != NULL) {
+			if (entry->d_name[0] != '.' &&
+			    wildcardMatch (this->file_pattern.c_str (), entry->d_name) &&
+			    stat ((this->directory + entry->d_name).c_str (), &file_stat) == 0 &&
+			    S_ISREG (file_stat.st_mode)) {
+				paths.push_back (this->directory + entry->d_name);
+			}
+		}
+		closedir (dir);
+	}
+#endif
+
+	for (iter = this->files.begin (); iter != this->files.end (); iter++) {
+		iter->listed = false;
+	}
+
+	for (i = 0; i < paths.size (); i++) {
+		if (! getPathInfo (paths[i], id, size)) {
+			continue;
+		}
+
+		for (iter = this->files.begin (); iter != this->files.end (); iter++) {
+			if (iter->has_id && ! iter->listed && sameFile (iter->id, id)) {
+				break;
+			}
+		}
+
+		if (iter == this->files.end ()) {
+			tailed.path = paths[i];
+			tailed.file = NULL;
+			tailed.has_id = false;
+			tailed.offset = 0;
+			tailed.last_data = 0;
+			tailed.size = size;
+			tailed.read_size = -1;
+			tailed.is_new = this->listed_once;
+			iter = this->files.insert (this->files.end (), tailed);
+		}
+
+		/* Renamed, the checkpoint follows it */
+		if (iter->path != paths[i]) {
+			forgetCheckpoint (iter->path, iter->id);
+			iter->path = paths[i];
+		}
+		iter->size = size;
+		iter->listed = true;
+	}
+
+	this->listed_at = time (NULL);
+	this->listed_once = true;
+}
+
+/**
+ * Close the files of a multiple source that changed least recently,
+ * so no more than the maximum are kept open. Their state is kept.
+ */
+void
+Pandora_File_Tailer::closeIdle () {
+	vector<pair<time_t, Tailed_File *> > open_files;
+	list<Tailed_File>::iterator          iter;
+	size_t                               max_open, i;
+
+	max_open = (this->max_open > 0) ? this->max_open : TAILER_MAX_OPEN;
+
+	for (iter = this->files.begin (); iter != this->files.end (); iter++) {
+		if (iter->file != NULL) {
+			open_files.push_back (make_pair (iter->last_data, &(*iter)));
+		}
+	}
+	if (open_files.size () <= max_open) {
+		return;
+	}
+
+	sort (open_files.begin (), open_files.end ());
+	for (i = 0; i < open_files.size () - max_open; i++) {
+		fclose (open_files[i].second->file);
+		open_files[i].second->file = NULL;
+	}
+}
+
+/**
+ * Open a file again, at the offset to read next.
+ *
+ * A file that has not been read yet resumes at its checkpoint. Without
+ * one, it starts at the end, unless it was created after the tailer
+ * started. The file is read from the start if it is another one (it
+ * was rotated) or it is now shorter than the offset (it was truncated).
+ *
+ * @param tailed File to open.
+ */
+void
+Pandora_File_Tailer::open (Tailed_File &tailed) {
+	File_Id   id;
+	long long size;
+	bool      rotated;
+
+	if (tailed.file != NULL) {
+		fclose (tailed.file);
+	}
+
+	/* Read in blocks, the stream does not need a buffer of its own */
+	tailed.file = openFile (tailed.path);
+	if (tailed.file == NULL) {
+		return;
+	}
+	setvbuf (tailed.file, NULL, _IONBF, 0);
+
+	/* Read whole on every poll */
+	if (this->from_start) {
+		tailed.offset = 0;
+		return;
+	}
+
+	if (! getFileInfo (tailed.file, id, size)) {
+		fclose (tailed.file);
+		tailed.file = NULL;
+		return;
+	}
+
+	if (tailed.has_id) {
+		if (! sameFile (id, tailed.id) || tailed.offset > size) {
+			tailed.offset = 0;
+		}
+	} else if (findCheckpoint (tailed.path, id, tailed.offset, rotated)) {
+		if (tailed.offset > size) {
+			tailed.offset = 0;
+		}
+	} else {
+		tailed.offset = (rotated || tailed.is_new) ? 0 : size;
+	}
+	tailed.id = id;
+	tailed.has_id = true;
+}
+
+/**
+ * Hand a line of the read buffer to the subscribers it matches.
+ * Empty lines are discarded.
+ *
+ * @param start Offset of the line in the buffer.
+ * @param end Offset of the line feed, or of the end of the line. The
+ *        byte there is overwritten.
+ */
+void
+Pandora_File_Tailer::processLine (size_t start, size_t end) {
+	vector<size_t> matches;
+	const char    *line;
+	size_t         i;
+
+	/* CRLF line endings, as read before in text mode */
+	if (end > start && this->buffer[end - 1] == '\r') {
+		end--;
+	}
+	if (end == start) {
+		return;
+	}
+
+	/* Terminate the line in place, for regexec () */
+	this->buffer[end] = '\0';
+	line = &(this->buffer[start]);
+
+	this->patterns->match (line, end - start, matches);
+	for (i = 0; i < matches.size (); i++) {
+		this->targets[matches[i]]->processMatch (string (line, end - start));
+	}
+}
+
+/**
+ * Read a file from its offset up to its end, handing each complete
+ * line to the subscribers it matches. An incomplete last line is left
+ * in the buffer.
+ *
+ * @param tailed File to read.
+ */
+void
+Pandora_File_Tailer::readLines (Tailed_File &tailed) {
+	const char *newline;
+	size_t      bytes, start, end;
+	long long   offset;
+
+	this->pending = 0;
+	if (! seekFile (tailed.file, tailed.offset)) {
+		fclose (tailed.file);
+		tailed.file = NULL;
+		return;
+	}
+	offset = tailed.offset;
+
+	/* One byte is kept free to terminate the last line */
+	while ((bytes = fread (&(this->buffer[this->pending]), 1,
+			       this->buffer.size () - this->pending - 1, tailed.file)) > 0) {
+		this->pending += bytes;
+
+		start = 0;
+		while (start < this->pending &&
+		       (newline = (const char *) memchr (&(this->buffer[start]), '\n',
+							 this->pending - start)) != NULL) {
+			end = newline - &(this->buffer[0]);
+			this->processLine (start, end);
+			start = end + 1;
+		}
+
+		/* A line that does not fit in the buffer */
+		if (start == 0 && this->pending == this->buffer.size () - 1) {
+			if (this->buffer.size () < TAILER_MAX_LINE) {
+				this->buffer.resize (this->buffer.size () * 2);
+			} else {
+				this->processLine (0, this->pending);
+				tailed.offset += this->pending;
+				this->pending = 0;
+			}
+			continue;
+		}
+
+		/* Keep the incomplete line for the next read */
+		if (start > 0) {
+			memmove (&(this->buffer[0]), &(this->buffer[start]), this->pending - start);
+			this->pending -= start;
+			tailed.offset += start;
+		}
+	}
+
+	/* Clear the EOF flag */
+	clearerr (tailed.file);
+
+	if (tailed.offset != offset) {
+		tailed.last_data = time (NULL);
+	}
+}
+
+/**
+ * Read the new lines of a file.
+ *
+ * @param tailed File to read.
+ *
+ * @return False if the file could not be opened.
+ */
+bool
+Pandora_File_Tailer::pollFile (Tailed_File &tailed) {
+	File_Id   id;
+	long long size;
+
+	this->pending = 0;
+
+	if (tailed.file == NULL || ferror (tailed.file)) {
+		this->open (tailed);
+	}
+
+	/* Read the file from the start if it was truncated */
+	if (tailed.file != NULL && ! this->from_start &&
+	    getFileInfo (tailed.file, id, size) && size < tailed.offset) {
+		this->open (tailed);
+	}
+
+	/* Check again, in case an open failed */
+	if (tailed.file == NULL) {
+		return false;
+	}
+
+	this->readLines (tailed);
+	if (tailed.file == NULL) {
+		return false;
+	}
+
+	/* Next time the file will be opened again and read from the start,
+	   so the last line is complete */
+	if (this->from_start) {
+		if (this->pending > 0) {
+			this->processLine (0, this->pending);
+		}
+		this->pending = 0;
+		fclose (tailed.file);
+		tailed.file = NULL;
+		return true;
+	}
+
+	/* Rotated: the old file has been read to the end, so its last line
+	   is complete. Go on with the new one. A multiple source finds the
+	   new file in its listing instead */
+	if (! this->multiple && getPathInfo (tailed.path, id, size) && ! sameFile (id, tailed.id)) {
+		if (this->pending > 0) {
+			this->processLine (0, this->pending);
+		}
+		this->open (tailed);
+		if (tailed.file != NULL) {
+			this->readLines (tailed);
+		}
+	}
+
+	updateCheckpoint (tailed.path, tailed.id, tailed.offset);
+	return true;
+}
+
+/**
+ * Read the new lines of the files and hand them to the subscribers
+ * they match.
+ *
+ * A closed file of a multiple source is only read again when the
+ * listing shows that its size changed.
+ *
+ * @return False if the file of a single source could not be opened.
+ */
+bool
+Pandora_File_Tailer::poll () {
+	list<Tailed_File>::iterator iter;
+	Tailed_File                 tailed;
+	bool                        read = true;
+	int                         refresh;
+
+	if (this->patterns == NULL) {
+		this->compilePatterns ();
+	}
+
+	if (this->buffer.empty ()) {
+		this->buffer.resize (TAILER_BLOCK_SIZE);
+	}
+
+	if (! this->multiple) {
+		if (this->files.empty ()) {
+			tailed.path = this->source;
+			tailed.file = NULL;
+			tailed.has_id = false;
+			tailed.offset = 0;
+			tailed.last_data = 0;
+			tailed.size = 0;
+			tailed.read_size = 0;
+			tailed.is_new = false;
+			tailed.listed = true;
+			this->files.push_back (tailed);
+		}
+		read = this->pollFile (this->files.front ());
+		writeCheckpoints ();
+		return read;
+	}
+
+	refresh = (this->refresh > 0) ? this->refresh : TAILER_REFRESH;
+	if (! this->listed_once || time (NULL) - this->listed_at >= refresh) {
+		this->listFiles ();
+	}
+
+	iter = this->files.begin ();
+	while (iter != this->files.end ()) {
+		if (iter->file == NULL && iter->has_id && iter->listed &&
+		    ! this->from_start && iter->size == iter->read_size) {
+			iter++;
+			continue;
+		}
+		iter->read_size = iter->size;
+
+		read = this->pollFile (*iter);
+
+		/* Gone from the listing: read to the end, so its last line is
+		   complete */
+		if (! iter->listed) {
+			if (read && this->pending > 0) {
+				this->processLine (0, this->pending);
+			}
+			if (iter->file != NULL) {
+				fclose (iter->file);
+			}
+			if (iter->has_id) {
+				forgetCheckpoint (iter->path, iter->id);
+			}
+			iter = this->files.erase (iter);
+			continue;
+		}
+		iter++;
+	}
+
+	this->closeIdle ();
+	writeCheckpoints ();
+	return true;
+}
@@ -0,0 +1,149 @@
+/* Shared reader of the files searched by module_regexp modules.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_FILE_TAILER_H__
+#define	__PANDORA_FILE_TAILER_H__
+
+#include "pandora_pattern_set.h"
+#include <sys/types.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <list>
+#include <vector>
+
+using namespace std;
+
+namespace Pandora_Modules {
+	/**
+	 * Receiver of the lines of a tailer that match its pattern, such
+	 * as a module_regexp module.
+	 */
+	class Pandora_Tailer_Subscriber {
+	public:
+		virtual        ~Pandora_Tailer_Subscriber () {}
+
+		virtual string getPattern   () const = 0;
+		virtual void   processMatch (const string &line) = 0;
+	};
+
+	/**
+	 * Identity of a file, kept when it is renamed: volume serial
+	 * number and file index on Windows, device and inode elsewhere.
+	 */
+	typedef struct {
+		unsigned long long volume;
+		unsigned long long index;
+	} File_Id;
+
+	/**
+	 * Read state of one of the files of a tailer.
+	 */
+	typedef struct {
+		string    path;
+		FILE     *file;      /* NULL while closed */
+		File_Id   id;
+		bool      has_id;
+		long long offset;    /* First byte not processed yet */
+		time_t    last_data; /* Last time new lines were read */
+		long long size;      /* Size found by the last listing */
+		long long read_size; /* Listed size when last read */
+		bool      is_new;    /* Created after the first listing */
+		bool      listed;    /* Found by the last listing */
+	} Tailed_File;
+
+	/**
+	 * Reader of the new lines of a file, or of the files of a
+	 * directory.
+	 *
+	 * The module_regexp modules on the same source share a tailer:
+	 * each new line is read once and matched against the patterns of
+	 * every subscribed module in a single pass (see
+	 * Pandora_Pattern_Set). The lines are handed to the modules they
+	 * match, which keep them until they run. A module that does
+	 * not seek the end of the file (module_noseekeof) rereads it from
+	 * the start on every run, so it gets a tailer of its own.
+	 *
+	 * The file is read in large blocks and split into lines in place:
+	 * the matcher gets pointers into the read buffer, and only the
+	 * lines that match are copied. A line that is still being written
+	 * (no line feed yet) is read again on the next poll, once it is
+	 * complete.
+	 *
+	 * The file is followed by identity. When its path names another
+	 * file (it was rotated), the old file is read to the end before
+	 * the new one is read from the start. The offset reached in each
+	 * file is saved to a checkpoint file, so after a restart of the
+	 * agent the reading resumes there instead of at the end.
+	 *
+	 * A source with wildcards (C:\logs\app*.log) or naming a
+	 * directory covers all the files it matches. The directory is
+	 * listed again every few seconds, and each file found is followed
+	 * by identity, so a file renamed within the source keeps its
+	 * offset. Files created after the first listing are read from the
+	 * start. Only the files that changed last are kept open.
+	 */
+	class Pandora_File_Tailer {
+	private:
+		string                        source;
+		bool                          from_start;
+
+		/* Directory and file name pattern, for a multiple source */
+		bool                          multiple;
+		string                        directory;
+		string                        file_pattern;
+		int                           refresh;
+		int                           max_open;
+		time_t                        listed_at;
+		bool                          listed_once;
+
+		list<Tailed_File>             files;
+
+		/* Read buffer, with the start of an incomplete line first */
+		vector<char>                  buffer;
+		size_t                        pending;
+
+		list<Pandora_Tailer_Subscriber *> subscribers;
+
+		/* Patterns of the subscribers, rebuilt when they change */
+		Pandora_Pattern_Set          *patterns;
+		vector<Pandora_Tailer_Subscriber *> targets;
+
+		Pandora_File_Tailer          (string source, bool from_start);
+		~Pandora_File_Tailer         ();
+		void      compilePatterns    ();
+		void      listFiles          ();
+		void      closeIdle          ();
+		void      open               (Tailed_File &tailed);
+		bool      pollFile           (Tailed_File &tailed);
+		void      readLines          (Tailed_File &tailed);
+		void      processLine        (size_t start, size_t end);
+	public:
+		static Pandora_File_Tailer *subscribe (string source, bool from_start,
+						       Pandora_Tailer_Subscriber *subscriber);
+		static bool isMultiple       (string source);
+		static void setCheckpointDir (string dir);
+		void      unsubscribe        (Pandora_Tailer_Subscriber *subscriber);
+		void      setListing         (int refresh, int max_open);
+
+		bool      poll               ();
+	};
+}
+
+#endif /* __PANDORA_FILE_TAILER_H__ */
@@ -0,0 +1,310 @@
+/* Literal prefilter for regular expressions.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_literal_filter.h"
+
+#include <cstring>
+#include <cctype>
+
+using namespace Pandora_Modules;
+
+/**
+ * Guess how common a byte is in log lines.
+ *
+ * @param c The byte.
+ *
+ * @return Higher for more common bytes.
+ */
+static int
+getFrequency (unsigned char c) {
+	if (c == ' ' || c == 'e' || c == 't' || c == 'a' || c == 'o' ||
+	    c == 'i' || c == 'n' || c == 's' || c == 'r') {
+		return 3;
+	}
+	if (islower (c) || isdigit (c)) {
+		return 2;
+	}
+	if (isupper (c)) {
+		return 1;
+	}
+	return 0;
+}
+
+/* Elements of a pattern, as seen by the literal extraction */
+#define ELEMENT_CHAR        0 /* A plain character */
+#define ELEMENT_OPTIONAL    1 /* Makes the previous character optional */
+#define ELEMENT_REPEAT      2 /* Repeats the previous character */
+#define ELEMENT_ALTERNATION 3
+#define ELEMENT_OTHER       4 /* Wildcards, anchors, groups, sets... */
+
+/**
+ * Skip a group, up to its closing parenthesis.
+ *
+ * @param pattern Regular expression.
+ * @param extended True for extended syntax, false for basic.
+ * @param pos Position after the opening parenthesis, moved past the
+ *        closing one.
+ */
+static void
+skipGroup (const string &pattern, bool extended, size_t &pos) {
+	int depth = 1;
+
+	while (pos < pattern.size () && depth > 0) {
+		if (pattern[pos] == '\\' && pos + 1 < pattern.size ()) {
+			if (! extended && pattern[pos + 1] == '(') {
+				depth++;
+			} else if (! extended && pattern[pos + 1] == ')') {
+				depth--;
+			}
+			pos += 2;
+			continue;
+		}
+		if (extended && pattern[pos] == '(') {
+			depth++;
+		} else if (extended && pattern[pos] == ')') {
+			depth--;
+		}
+		pos++;
+	}
+}
+
+/**
+ * Skip a bracket expression, up to its closing bracket.
+ *
+ * Character classes ([:digit:]), equivalence classes ([=a=]) and
+ * collating symbols ([.-.]) are skipped as a whole, since their
+ * closing bracket does not close the expression.
+ *
+ * @param pattern Regular expression.
+ * @param pos Position after the opening bracket, moved past the
+ *        closing one.
+ */
+static void
+skipBracket (const string &pattern, size_t &pos) {
+	size_t end;
+
+	/* A "]" right after "[" or "[^" is part of the set */
+	if (pos < pattern.size () && pattern[pos] == '^') {
+		pos++;
+	}
+	if (pos < pattern.size () && pattern[pos] == ']') {
+		pos++;
+	}
+
+	while (pos < pattern.size ()) {
+		if (pattern[pos] == ']') {
+			pos++;
+			return;
+		}
+		if (pattern[pos] == '[' && pos + 1 < pattern.size () &&
+		    (pattern[pos + 1] == ':' || pattern[pos + 1] == '=' || pattern[pos + 1] == '.')) {
+			end = pattern.find (string (1, pattern[pos + 1]) + "]", pos + 2);
+			if (end == string::npos) {
+				break;
+			}
+			pos = end + 2;
+			continue;
+		}
+		pos++;
+	}
+
+	pos = pattern.size ();
+}
+
+/**
+ * Read the next element of a pattern.
+ *
+ * @param pattern Regular expression.
+ * @param extended True for extended syntax, false for basic.
+ * @param pos Position of the element, moved past it.
+ * @param c Where the character is stored, for ELEMENT_CHAR.
+ *
+ * @return The kind of element.
+ */
+static int
+nextElement (const string &pattern, bool extended, size_t &pos, char &c) {
+	c = pattern[pos++];
+
+	if (c == '\\') {
+		if (pos >= pattern.size ()) {
+			return ELEMENT_OTHER;
+		}
+		c = pattern[pos++];
+
+		/* Operators of the basic syntax */
+		if (! extended) {
+			switch (c) {
+			case '|':
+				return ELEMENT_ALTERNATION;
+			case '?':
+				return ELEMENT_OPTIONAL;
+			case '+':
+				return ELEMENT_REPEAT;
+			case '{':
+				pos = pattern.find ("\\}", pos);
+				pos = (pos == string::npos) ? pattern.size () : pos + 2;
+				return ELEMENT_OPTIONAL;
+			case '(':
+				skipGroup (pattern, extended, pos);
+				return ELEMENT_OTHER;
+			}
+		}
+
+		/* Escaped punctuation is literal; \w, \d, \1... and the
+		   word and buffer anchors (\<, \>, \`, \') are not */
+		if (isalnum ((unsigned char) c) || c == '<' || c == '>' || c == '`' || c == '\'') {
+			return ELEMENT_OTHER;
+		}
+		return ELEMENT_CHAR;
+	}
+
+	switch (c) {
+	case '[':
+		skipBracket (pattern, pos);
+		return ELEMENT_OTHER;
+	case '*':
+		return ELEMENT_OPTIONAL;
+	case '.':
+	case '^':
+	case '$':
+		return ELEMENT_OTHER;
+	}
+
+	if (extended) {
+		switch (c) {
+		case '|':
+			return ELEMENT_ALTERNATION;
+		case '?':
+			return ELEMENT_OPTIONAL;
+		case '+':
+			return ELEMENT_REPEAT;
+		case '{':
+			pos = pattern.find ('}', pos);
+			pos = (pos == string::npos) ? pattern.size () : pos + 1;
+			return ELEMENT_OPTIONAL;
+		case '(':
+			/* Groups may be optional or contain alternations */
+			skipGroup (pattern, extended, pos);
+			return ELEMENT_OTHER;
+		case ')':
+			return ELEMENT_OTHER;
+		}
+	}
+
+	return ELEMENT_CHAR;
+}
+
+/**
+ * Extracts the required literal of a pattern.
+ *
+ * @param pattern Regular expression.
+ * @param extended True for extended syntax (REG_EXTENDED), false for
+ *        basic.
+ */
+Pandora_Literal_Filter::Pandora_Literal_Filter (const string &pattern, bool extended) {
+	string run;
+	size_t pos = 0, i;
+	char   c;
+
+	this->anchor = 0;
+
+	/* Inline options may change how the literals match */
+	if (extended && pattern.find ("(?") != string::npos) {
+		return;
+	}
+
+	while (pos < pattern.size ()) {
+		switch (nextElement (pattern, extended, pos, c)) {
+		case ELEMENT_CHAR:
+			run += c;
+			continue;
+		case ELEMENT_ALTERNATION:
+			/* A top level alternation: no text is required */
+			this->literal.erase ();
+			return;
+		case ELEMENT_OPTIONAL:
+			if (! run.empty ()) {
+				run.erase (run.size () - 1);
+			}
+			break;
+		}
+
+		if (run.size () > this->literal.size ()) {
+			this->literal = run;
+		}
+		run.erase ();
+	}
+
+	if (run.size () > this->literal.size ()) {
+		this->literal = run;
+	}
+
+	for (i = 1; i < this->literal.size (); i++) {
+		if (getFrequency (this->literal[i]) < getFrequency (this->literal[this->anchor])) {
+			this->anchor = i;
+		}
+	}
+}
+
+/**
+ * Get the literal required by the pattern.
+ *
+ * @return The literal, empty if the pattern does not require one.
+ */
+string
+Pandora_Literal_Filter::getLiteral () const {
+	return this->literal;
+}
+
+/**
+ * Check if a text may match the pattern.
+ *
+ * @param text Text to check.
+ * @param size Size of the text.
+ *
+ * @return False if the text does not contain the required literal.
+ */
+bool
+Pandora_Literal_Filter::mayMatch (const char *text, size_t size) const {
+	const char *pos, *end;
+	size_t      length = this->literal.size ();
+
+	if (length == 0) {
+		return true;
+	}
+	if (size < length) {
+		return false;
+	}
+
+	/* Candidates for the anchor byte, with room for the whole literal */
+	pos = text + this->anchor;
+	end = text + size - length + this->anchor + 1;
+	while (pos < end) {
+		pos = (const char *) memchr (pos, this->literal[this->anchor], end - pos);
+		if (pos == NULL) {
+			return false;
+		}
+		if (memcmp (pos - this->anchor, this->literal.data (), length) == 0) {
+			return true;
+		}
+		pos++;
+	}
+
+	return false;
+}
@@ -0,0 +1,54 @@
+/* Literal prefilter for regular expressions.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_LITERAL_FILTER_H__
+#define	__PANDORA_LITERAL_FILTER_H__
+
+#include <string>
+
+using namespace std;
+
+namespace Pandora_Modules {
+	/**
+	 * Text that any match of a regular expression must contain.
+	 *
+	 * The pattern is scanned for runs of plain characters that are
+	 * not optional and not inside a group or an alternation, and the
+	 * longest one is kept. A line without it cannot match, so the
+	 * regular expression only has to be run on the lines that pass
+	 * the filter. Patterns without such a run (or with constructs the
+	 * scan does not understand) pass every line.
+	 *
+	 * The search looks for the least common looking byte of the
+	 * literal with memchr (), which is vectorized by the C library,
+	 * and compares the rest around each candidate.
+	 */
+	class Pandora_Literal_Filter {
+	private:
+		string literal;
+		size_t anchor; /* Offset of the byte searched with memchr () */
+	public:
+		Pandora_Literal_Filter        (const string &pattern, bool extended);
+
+		string getLiteral             () const;
+		bool   mayMatch               (const char *text, size_t size) const;
+	};
+}
+
+#endif /* __PANDORA_LITERAL_FILTER_H__ */
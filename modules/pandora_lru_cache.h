@@ -0,0 +1,140 @@
+/* Least recently used cache.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_LRU_CACHE_H__
+#define	__PANDORA_LRU_CACHE_H__
+
+#include <string>
+#include <list>
+#include <map>
+
+using namespace std;
+
+namespace Pandora_Modules {
+	/**
+	 * Cache of a bounded number of values, by key.
+	 *
+	 * When the cache is full, inserting a value evicts the least
+	 * recently used one, which is handed back to the caller so the
+	 * resources it holds (a library, a handle...) can be released.
+	 * Lookups are counted, to report the hit rate.
+	 */
+	template <class T>
+	class Pandora_Lru_Cache {
+	private:
+		typedef pair<string, T>                    Entry;
+		typedef typename list<Entry>::iterator     Entry_Iterator;
+
+		list<Entry>                 entries; /* Most recently used first */
+		map<string, Entry_Iterator> index;
+		size_t                      capacity;
+		unsigned long               hits, misses;
+	public:
+		/**
+		 * Creates an empty cache.
+		 *
+		 * @param capacity Values kept at most.
+		 */
+		Pandora_Lru_Cache (size_t capacity) {
+			this->capacity = capacity > 0 ? capacity : 1;
+			this->hits = 0;
+			this->misses = 0;
+		}
+
+		/**
+		 * Look for a value, and mark it as the most recently used.
+		 *
+		 * @param key Key of the value.
+		 * @param value Where the value is copied, if found.
+		 *
+		 * @return True if the value was found.
+		 */
+		bool
+		find (const string &key, T &value) {
+			typename map<string, Entry_Iterator>::iterator iter;
+
+			iter = this->index.find (key);
+			if (iter == this->index.end ()) {
+				this->misses++;
+				return false;
+			}
+
+			this->hits++;
+			this->entries.splice (this->entries.begin (), this->entries, iter->second);
+			value = iter->second->second;
+			return true;
+		}
+
+		/**
+		 * Insert or replace a value, as the most recently used.
+		 *
+		 * @param key Key of the value.
+		 * @param value Value to insert.
+		 * @param evicted Where the value removed from the cache is
+		 *        copied, if any: the least recently used value when
+		 *        the cache is full, or the value replaced.
+		 *
+		 * @return True if a value was removed from the cache.
+		 */
+		bool
+		insert (const string &key, const T &value, T &evicted) {
+			typename map<string, Entry_Iterator>::iterator iter;
+			Entry_Iterator                                  last;
+
+			iter = this->index.find (key);
+			if (iter != this->index.end ()) {
+				evicted = iter->second->second;
+				iter->second->second = value;
+				this->entries.splice (this->entries.begin (), this->entries, iter->second);
+				return true;
+			}
+
+			this->entries.push_front (Entry (key, value));
+			this->index[key] = this->entries.begin ();
+			if (this->entries.size () <= this->capacity) {
+				return false;
+			}
+
+			last = this->entries.end ();
+			last--;
+			evicted = last->second;
+			this->index.erase (last->first);
+			this->entries.erase (last);
+			return true;
+		}
+
+		/**
+		 * Get the number of lookups that found a value.
+		 */
+		unsigned long
+		getHits () const {
+			return this->hits;
+		}
+
+		/**
+		 * Get the number of lookups that did not find a value.
+		 */
+		unsigned long
+		getMisses () const {
+			return this->misses;
+		}
+	};
+}
+
+#endif /* __PANDORA_LRU_CACHE_H__ */
@@ -0,0 +1,211 @@
+/* Compiled module_macro substitution.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_macros.h"
+
+#include <map>
+#include <algorithm>
+
+/* Plans kept before the cache is flushed */
+#define MAX_MACRO_PLANS 256
+
+/* Macros from which the names are looked up in the index */
+#define MACRO_INDEX_MIN 64
+
+#define MACRO_HASH_BASE 131
+
+/* Bits of the filter of name hashes */
+#define MACRO_FILTER_SIZE 65536
+
+using namespace Pandora_Modules;
+
+/**
+ * Compiles a set of macros.
+ *
+ * @param macros Macro lines, in the form "name value". Lines without
+ *        a value are ignored.
+ */
+Pandora_Macros::Pandora_Macros (list<string> &macros) {
+	list<string>::iterator iter;
+	unsigned int           hash, power;
+	size_t                 pos, i, j;
+
+	for (iter = macros.begin (); iter != macros.end (); iter++) {
+		pos = iter->find (" ");
+		if (pos == string::npos || pos == 0) {
+			continue;
+		}
+		this->names.push_back (iter->substr (0, pos));
+		this->values.push_back (iter->substr (pos + 1));
+	}
+
+	this->filter.resize (MACRO_FILTER_SIZE, false);
+	for (i = 0; i < this->names.size (); i++) {
+		hash = 0;
+		for (j = 0; j < this->names[i].size (); j++) {
+			hash = hash * MACRO_HASH_BASE + (unsigned char) this->names[i][j];
+		}
+		this->index.push_back (make_pair (hash, i));
+		this->filter[hash % MACRO_FILTER_SIZE] = true;
+		this->lengths.push_back (this->names[i].size ());
+	}
+	sort (this->index.begin (), this->index.end ());
+
+	/* Distinct name lengths, shortest first */
+	sort (this->lengths.begin (), this->lengths.end ());
+	this->lengths.erase (unique (this->lengths.begin (), this->lengths.end ()), this->lengths.end ());
+	for (i = 0; i < this->lengths.size (); i++) {
+		power = 1;
+		for (j = 0; j < this->lengths[i]; j++) {
+			power *= MACRO_HASH_BASE;
+		}
+		this->powers.push_back (power);
+	}
+}
+
+/**
+ * Get the compiled plan of a set of macros.
+ *
+ * @param macros Macro lines, in the form "name value".
+ *
+ * @return The plan. It belongs to the cache and must not be deleted.
+ */
+Pandora_Macros *
+Pandora_Macros::getCompiled (list<string> &macros) {
+	static map<string, Pandora_Macros *>    plans;
+	map<string, Pandora_Macros *>::iterator plan;
+	list<string>::iterator                  iter;
+	string                                  key;
+
+	for (iter = macros.begin (); iter != macros.end (); iter++) {
+		key += *iter;
+		key += '\n';
+	}
+
+	plan = plans.find (key);
+	if (plan != plans.end ()) {
+		return plan->second;
+	}
+
+	if (plans.size () >= MAX_MACRO_PLANS) {
+		for (plan = plans.begin (); plan != plans.end (); plan++) {
+			delete plan->second;
+		}
+		plans.clear ();
+	}
+
+	return plans[key] = new Pandora_Macros (macros);
+}
+
+/**
+ * Mark the macros whose name occurs in a part of a field.
+ *
+ * @param field Field value.
+ * @param from First position of the part.
+ * @param to Position after the part.
+ * @param first Only macros from this index on are marked.
+ * @param found Flags of the macros, by index.
+ */
+void
+Pandora_Macros::findNames (const string &field, size_t from, size_t to,
+			   size_t first, vector<bool> &found) const {
+	vector<pair<unsigned int, size_t> >::const_iterator entry;
+	vector<unsigned int> prefix (to - from + 1);
+	unsigned int         hash;
+	size_t               pos, i, j, len;
+
+	/* Prefix hashes, to get the hash of any substring */
+	prefix[0] = 0;
+	for (pos = from; pos < to; pos++) {
+		prefix[pos - from + 1] = prefix[pos - from] * MACRO_HASH_BASE + (unsigned char) field[pos];
+	}
+
+	for (pos = 0; pos < to - from; pos++) {
+		for (j = 0; j < this->lengths.size (); j++) {
+			len = this->lengths[j];
+			if (pos + len > to - from) {
+				break;
+			}
+
+			hash = prefix[pos + len] - prefix[pos] * this->powers[j];
+			if (! this->filter[hash % MACRO_FILTER_SIZE]) {
+				continue;
+			}
+			entry = lower_bound (this->index.begin (), this->index.end (), make_pair (hash, (size_t) 0));
+			for (; entry != this->index.end () && entry->first == hash; entry++) {
+				i = entry->second;
+				if (i >= first && ! found[i] && this->names[i].size () == len &&
+				    field.compare (from + pos, len, this->names[i]) == 0) {
+					found[i] = true;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Replace the macros of a field.
+ *
+ * Macros are applied in the order they are defined, each one replacing
+ * its first occurrence in the field as left by the previous ones, so a
+ * value may contain macros defined after it.
+ *
+ * @param field Field value, replaced in place.
+ */
+void
+Pandora_Macros::apply (string &field) const {
+	vector<bool> found;
+	size_t       i, pos, from, to, max_len;
+
+	/* Few macros: searching for each one is cheaper than indexing */
+	if (this->names.size () < MACRO_INDEX_MIN) {
+		for (i = 0; i < this->names.size (); i++) {
+			pos = field.find (this->names[i]);
+			if (pos != string::npos) {
+				field.replace (pos, this->names[i].size (), this->values[i]);
+			}
+		}
+		return;
+	}
+
+	/* Only the macros found in the field are searched for */
+	found.resize (this->names.size (), false);
+	this->findNames (field, 0, field.size (), 0, found);
+
+	max_len = this->lengths.empty () ? 0 : this->lengths.back ();
+	for (i = 0; i < this->names.size (); i++) {
+		if (! found[i]) {
+			continue;
+		}
+
+		pos = field.find (this->names[i]);
+		if (pos == string::npos) {
+			continue;
+		}
+		field.replace (pos, this->names[i].size (), this->values[i]);
+
+		/* The new text may form the names of later macros */
+		from = pos + 1 > max_len ? pos + 1 - max_len : 0;
+		to = pos + this->values[i].size () + max_len - 1;
+		if (to > field.size ()) {
+			to = field.size ();
+		}
+		this->findNames (field, from, to, i + 1, found);
+	}
+}
@@ -0,0 +1,64 @@
+/* Compiled module_macro substitution.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_MACROS_H__
+#define	__PANDORA_MACROS_H__
+
+#include <string>
+#include <list>
+#include <vector>
+
+using namespace std;
+
+namespace Pandora_Modules {
+	/**
+	 * Substitution plan for the module_macro lines of a definition.
+	 *
+	 * The macro lines are split once. With many macros, the names are
+	 * also indexed by length and hash, so a single pass over a field
+	 * finds which macros it contains, and only those are searched for.
+	 * The result is the same as searching for every macro in turn: only
+	 * the first occurrence of each macro is replaced, and the text
+	 * inserted by a macro is searched for the macros defined after it.
+	 *
+	 * Plans are cached by macro set: modules instantiated from the same
+	 * template share the same plan.
+	 */
+	class Pandora_Macros {
+	private:
+		vector<string>                      names;
+		vector<string>                      values;
+		vector<size_t>                      lengths;
+		vector<unsigned int>                powers;
+		vector<bool>                        filter; /* Name hashes present */
+		/* (name hash, macro index), sorted */
+		vector<pair<unsigned int, size_t> > index;
+
+		Pandora_Macros              (list<string> &macros);
+		void           findNames    (const string &field, size_t from,
+					     size_t to, size_t first,
+					     vector<bool> &found) const;
+	public:
+		static Pandora_Macros *getCompiled (list<string> &macros);
+
+		void           apply        (string &field) const;
+	};
+}
+
+#endif /* __PANDORA_MACROS_H__ */
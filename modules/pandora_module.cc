@@ -21,12 +21,14 @@
 #include "pandora_module.h"
 #include "../pandora_strutils.h"
 #include "../pandora.h"
+#include "../misc/pandora_variables.h"
+#include "../misc/pandora_process_runner.h"
+#include "../misc/pandora_log_xml.h"
 
 #include <iostream>
+#include <limits.h>
 #include <sstream>
 
-#define BUFSIZE 4096 
-
 using namespace Pandora;
 using namespace Pandora_Modules;
 using namespace Pandora_Strutils;
@@ -45,7 +47,6 @@ Pandora_Module::Pandora_Module (string name) {
 	this->module_timeout  = 15000;
 	this->max             = 0;
 	this->min             = 0;
-	this->post_process    = "";
 	this->has_limits      = false;
 	this->has_min         = false;
 	this->has_max         = false;
@@ -55,29 +56,19 @@ Pandora_Module::Pandora_Module (string name) {
     this->precondition_list  = NULL;
     this->condition_list  = NULL;
 	this->cron            = NULL;
-	this->min_critical    = "";
-	this->max_critical    = "";
-	this->min_warning     = "";
-	this->max_warning     = "";
-	this->disabled        = "";
-	this->min_ff_event    = "";
 	this->intensive_condition_list = NULL;
+	this->condition_patterns = NULL;
 	this->intensive_interval = 1;
 	this->timestamp       = 0;
 	this->intensive_match = 0;
-	this->unit            = "";
-	this->module_group    = "";
-	this->custom_id       = "";
-	this->str_warning     = "";
-	this->str_critical    = "";
-	this->critical_instructions = "";
-	this->warning_instructions = "";
-	this->unknown_instructions = "";
-	this->tags = "";
-	this->critical_inverse = "";
-	this->warning_inverse = "";
-	this->quiet = "";
-	this->module_ff_interval = "";
+	this->aggregate       = NULL;
+	this->metadata        = Module_Metadata::intern (Module_Metadata ());
+	this->log_max_bytes   = 0;
+	this->log_max_lines   = 0;
+	this->log_bytes       = 0;
+	this->log_lines       = 0;
+	this->log_dropped_bytes = 0;
+	this->log_dropped_lines = 0;
 }
 
 /** 
@@ -86,25 +77,20 @@ Pandora_Module::Pandora_Module (string name) {
  * Should be redefined by child classes.
  */
 Pandora_Module::~Pandora_Module () {
-	Condition *cond = NULL;
-	Condition *precond = NULL;
 	list<Condition *>::iterator iter;
 	list<Condition *>::iterator iter_pre;
 
 	/* Clean data lists */
 	this->cleanDataList ();
 
+	Module_Metadata::release (this->metadata);
+
 	/* Clean precondition list */
 	if (this->precondition_list != NULL && this->precondition_list->size () > 0) {
 		iter_pre = this->precondition_list->begin ();
 		for (iter_pre = this->precondition_list->begin ();
 		     iter_pre != this->precondition_list->end ();
 		     iter_pre++) {
-			/* Free regular expressions */
-			precond = *iter_pre;
-			if (precond->string_value != "") {
-				regfree (&(precond->regexp));
-			}
 			delete (*iter_pre);
 		}
 		delete (this->precondition_list);
@@ -117,11 +103,6 @@ Pandora_Module::~Pandora_Module () {
 		for (iter = this->condition_list->begin ();
 		     iter != this->condition_list->end ();
 		     iter++) {
-			/* Free regular expressions */
-			cond = *iter;
-			if (cond->string_value != "") {
-				regfree (&(cond->regexp));
-			}
 			delete (*iter);
 		}
 		delete (this->condition_list);
@@ -134,22 +115,26 @@ Pandora_Module::~Pandora_Module () {
 		for (iter = this->intensive_condition_list->begin ();
 		     iter != this->intensive_condition_list->end ();
 		     iter++) {
-			/* Free regular expressions */
-			cond = *iter;
-			if (cond->string_value != "") {
-				regfree (&(cond->regexp));
-			}
 			delete (*iter);
 		}
 		delete (this->intensive_condition_list);
 		this->intensive_condition_list = NULL;
 	}
+
+	/* Free regular expressions */
+	delete (this->condition_patterns);
 	
 	/* Clean the module cron */
 	if (this->cron != NULL) {
 		delete (this->cron);
 		this->cron = NULL;
 	}
+
+	/* Clean the module aggregate */
+	if (this->aggregate != NULL) {
+		delete (this->aggregate);
+		this->aggregate = NULL;
+	}
 }
 
 
@@ -171,6 +156,9 @@ Pandora_Module::cleanDataList () {
 		delete this->data_list;
 		this->data_list = NULL;
 	}
+
+	this->log_bytes = 0;
+	this->log_lines = 0;
 	if (this->inventory_list) {
 		if (this->inventory_list->size () > 0) {
 			iter = this->inventory_list->begin ();
@@ -195,25 +183,7 @@ Pandora_Module::cleanDataList () {
  */
 Module_Type
 Pandora_Module::parseModuleTypeFromString (string type) {
-	if (type == module_generic_data_str || type == "") {
-		return TYPE_GENERIC_DATA;
-	} else if (type == module_generic_data_inc_str) {
-		return TYPE_GENERIC_DATA_INC;
-	} else if (type == module_generic_data_string_str) {
-		return TYPE_GENERIC_DATA_STRING;
-	} else if (type == module_generic_proc_str) {
-		return TYPE_GENERIC_PROC;
-	} else if (type == module_async_data_str) {
-		return TYPE_ASYNC_DATA;
-	} else if (type == module_async_proc_str) {
-		return TYPE_ASYNC_PROC;
-	} else if (type == module_async_string_str) {
-		return TYPE_ASYNC_STRING;
-	} else if (type == module_log_str) {
-		return TYPE_LOG;
-	} else {
-		return TYPE_0;
-	}
+	return Pandora_Module_Definition::parseType (type);
 }
 
 /** 
@@ -256,7 +226,7 @@ Pandora_Module::parseModuleKindFromString (string kind) {
 	} else if (kind == module_plugin_str) {
 		return MODULE_PLUGIN;
 	} else if (kind == module_ping_str) {
-		return MODULE_PING;
+		return MODULE_PING;
 	} else if (kind == module_snmpget_str) {
 		return MODULE_SNMPGET;
 	} else {
@@ -375,33 +345,81 @@ Pandora_Module::getDataOutput (Pandora_Data *data) {
 }
 
 /** 
- * Export the module output to en environment variable.
+ * Export the module output to the variable store.
+ *
+ * The value is passed to the children of the modules that depend on it.
  */
 void
 Pandora_Module::exportDataOutput () {
 	Pandora_Data *pandora_data = NULL;
-	string putenv_str, module_data;
+	Pandora_Variables *variables = Pandora_Variables::getInstance ();
 
-	/* putenv expects a string of the form name=value */
-	putenv_str = this->save + "=";
-	
 	/* No data */
 	if ( (!this->has_output) || this->data_list == NULL) {
-		putenv (putenv_str.c_str ());
+		variables->setValue (this->save, "");
 		return;
 	}
 
 	/* Get the module data */
 	pandora_data = data_list->front ();
 	if (pandora_data == NULL) {
-		putenv (putenv_str.c_str ());
+		variables->setValue (this->save, "");
 		return;
 	}
-	module_data = pandora_data->getValue ();
-	putenv_str += module_data;
 
-	/* Save it as an environment variable */
-	putenv (putenv_str.c_str ());
+	/* Save it in the variable store */
+	variables->setValue (this->save, pandora_data->getValue ());
+}
+
+/** 
+ * Check if more log data fits in the limits of the module, after the
+ * data collected since the last XML.
+ *
+ * @param bytes Size of the new data.
+ * @param lines Entries of the new data.
+ *
+ * @return True if it fits.
+ */
+bool
+Pandora_Module::fitsLogLimits (size_t bytes, size_t lines) const {
+	return (this->log_max_bytes == 0 || this->log_bytes + bytes <= this->log_max_bytes) &&
+	       (this->log_max_lines == 0 || this->log_lines + lines <= this->log_max_lines);
+}
+
+/** 
+ * Count a log entry discarded past the limits, to be reported in the
+ * XML.
+ *
+ * @param bytes Size of the entry.
+ */
+void
+Pandora_Module::dropLogOutput (size_t bytes) {
+	this->log_dropped_bytes += bytes;
+	this->log_dropped_lines++;
+}
+
+/** 
+ * Check an output of a log module against its limits. The outputs
+ * past them are counted, to be reported in the XML, and discarded.
+ *
+ * @param output Output to add.
+ *
+ * @return False if the output must be discarded.
+ */
+bool
+Pandora_Module::acceptLogOutput (const string &output) {
+	if (this->module_type != TYPE_LOG) {
+		return true;
+	}
+
+	if (! this->fitsLogLimits (output.size (), 1)) {
+		this->dropLogOutput (output.size ());
+		return false;
+	}
+
+	this->log_bytes += output.size ();
+	this->log_lines++;
+	return true;
 }
 
 /** 
@@ -416,11 +434,25 @@ void
 Pandora_Module::setOutput (string output) {
 	Pandora_Data *data;
 
+	if (! this->acceptLogOutput (output)) {
+		return;
+	}
+
 	if (this->data_list == NULL)
 		this->data_list = new list<Pandora_Data *> ();
 	data = new Pandora_Data (output, this->module_name);
 	this->data_list->push_back (data);
 	this->latest_output = output;
+
+	/* Accumulate the sample until the next packet is sent */
+	if (this->aggregate != NULL) {
+		try {
+			this->aggregate->addSample (Pandora_Strutils::strtodouble (output));
+		} catch (Pandora_Strutils::Invalid_Conversion e) {
+			pandoraDebug ("%s: Discarding non numeric sample from aggregate",
+				      this->module_name.c_str ());
+		}
+	}
 }
 
 
@@ -437,6 +469,10 @@ void
 Pandora_Module::setOutput (string output, SYSTEMTIME *system_time) {
 	Pandora_Data *data;
 
+	if (! this->acceptLogOutput (output)) {
+		return;
+	}
+
 	if (this->data_list == NULL)
 		this->data_list = new list<Pandora_Data *> ();
 	data = new Pandora_Data (output, system_time, this->module_name);
@@ -478,6 +514,102 @@ Pandora_Module::run () {
 	has_output = true;
 }
 
+/** 
+ * Check whether the module will execute on the next call to run.
+ * 
+ * @return True if the execution interval is fulfilled.
+ */
+bool
+Pandora_Module::isIntervalFulfilled () const {
+	return this->executions % this->intensive_interval == 0;
+}
+
+/** 
+ * Add the duration of a module operation to its histogram.
+ * 
+ * @param kind Measured operation.
+ * @param usecs Duration in microseconds.
+ */
+void
+Pandora_Module::addTiming (Timing_Kind kind, unsigned long long usecs) {
+	this->timings[kind].add (usecs);
+}
+
+/** 
+ * Get the histogram of durations of a module operation.
+ * 
+ * @param kind Measured operation.
+ *
+ * @return The histogram.
+ */
+const Pandora_Timing::Histogram *
+Pandora_Module::getTiming (Timing_Kind kind) const {
+	return &(this->timings[kind]);
+}
+
+/**
+ * Get the XML of a log module, and clean its data.
+ *
+ * The entries are concatenated in the data of a <log_module>
+ * element. When it does not fit in max_size bytes, it is split in
+ * several elements with the same source, at line ends if possible.
+ * The entries discarded past the module limits are reported in the
+ * first element.
+ *
+ * @param max_size Maximum size of each element, or 0 for a single
+ *        element.
+ * @param chunks Where the elements are added.
+ */
+void
+Pandora_Module::getLogXml (size_t max_size, list<string> &chunks) {
+	list<Pandora_Data *>::iterator iter;
+	string                         dropped, data;
+
+	if (this->log_dropped_lines > 0) {
+		dropped = "\t<dropped_lines><![CDATA[" + longtostr ((long) this->log_dropped_lines);
+		dropped += "]]></dropped_lines>\n\t<dropped_bytes><![CDATA[";
+		dropped += longtostr ((long) this->log_dropped_bytes) + "]]></dropped_bytes>\n";
+	}
+
+	for (iter = this->data_list->begin (); iter != this->data_list->end (); iter++) {
+		try {
+			data += this->getDataOutput (*iter);
+		} catch (Output_Error e) {
+			continue;
+		}
+	}
+
+	Pandora_Log_Xml::split (this->module_name, dropped, data, max_size, chunks);
+
+	this->log_dropped_bytes = 0;
+	this->log_dropped_lines = 0;
+	this->cleanDataList ();
+}
+
+/**
+ * Get the XML of the module, split in several elements if it is a log
+ * module with too much data for a single packet.
+ *
+ * @param max_size Maximum size of each log element, or 0 for a single
+ *        element.
+ * @param chunks Where the elements are added. Nothing is added if the
+ *        module has no data.
+ */
+void
+Pandora_Module::getXmlChunks (size_t max_size, list<string> &chunks) {
+	string xml;
+
+	if (this->module_type == TYPE_LOG && this->has_output && this->data_list != NULL) {
+		this->getLogXml (max_size, chunks);
+		return;
+	}
+
+	xml = this->getXml ();
+	if (! xml.empty ()) {
+		chunks.push_back (xml);
+	}
+}
+
 /** 
  * Get the XML output of the value.
  *
@@ -510,44 +642,12 @@ Pandora_Module::getXml () {
 	
 	/* Log module */
 	if (this->module_type == TYPE_LOG) {
-		module_xml = "<log_module>\n\t<source><![CDATA[";
-		module_xml += this->module_name;
-		module_xml += "]]></source>\n\t<data><![CDATA[";
+		list<string> chunks;
 
-		if (this->data_list && this->data_list->size () > 1) {
-			list<Pandora_Data *>::iterator iter;
-			
-			iter = this->data_list->begin ();
-			for (iter = this->data_list->begin ();
-			     iter != this->data_list->end ();
-			     iter++) {
-				data = *iter;
-				
-				try {
-					data_clean = strreplace (this->getDataOutput (data),
-								 "%", "%%" );
-				} catch (Output_Error e) {
-					continue;
-				}
-				
-				module_xml += data_clean;
-			}
-		} else {
-			data = data_list->front ();
-			try {
-				data_clean = strreplace (this->getDataOutput (data), "%", "%%" );
-				module_xml += data_clean;
-
-			} catch (Output_Error e) {
-			}
-		}
-		module_xml += "]]></data></log_module>";
-		
-		/* Clean up */
-		this->cleanDataList ();
+		this->getLogXml (0, chunks);
 
 		pandoraDebug ("%s getXML end", module_name.c_str ());
-		return module_xml;
+		return chunks.front ();
 	}
 
 	/* Compose the module XML */
@@ -587,147 +687,164 @@ Pandora_Module::getXml () {
 	}
 	
 	/* Post process */
-	if (this->post_process != "") {
+	if (this->metadata->post_process != "") {
 		module_xml += "\t<post_process><![CDATA[";
-		module_xml += this->post_process;
+		module_xml += this->metadata->post_process;
 		module_xml += "]]></post_process>\n";
 	}
 
 	/* Min critical */
-	if (this->min_critical != "") {
+	if (this->metadata->min_critical != "") {
 		module_xml += "\t<min_critical><![CDATA[";
-		module_xml += this->min_critical;
+		module_xml += this->metadata->min_critical;
 		module_xml += "]]></min_critical>\n";
 	}
 
 	/* Max critical */
-	if (this->max_critical != "") {
+	if (this->metadata->max_critical != "") {
 		module_xml += "\t<max_critical><![CDATA[";
-		module_xml += this->max_critical;
+		module_xml += this->metadata->max_critical;
 		module_xml += "]]></max_critical>\n";
 	}
 
 	/* Min warning */
-	if (this->min_warning != "") {
+	if (this->metadata->min_warning != "") {
 		module_xml += "\t<min_warning><![CDATA[";
-		module_xml += this->min_warning;
+		module_xml += this->metadata->min_warning;
 		module_xml += "]]></min_warning>\n";
 	}
 
 	/* Max warning */
-	if (this->max_warning != "") {
+	if (this->metadata->max_warning != "") {
 		module_xml += "\t<max_warning><![CDATA[";
-		module_xml += this->max_warning;
+		module_xml += this->metadata->max_warning;
 		module_xml += "]]></max_warning>\n";
 	}
 
 	/* Disabled */
-	if (this->disabled != "") {
+	if (this->metadata->disabled != "") {
 		module_xml += "\t<disabled><![CDATA[";
-		module_xml += this->disabled;
+		module_xml += this->metadata->disabled;
 		module_xml += "]]></disabled>\n";
 	}
 
 	/* Min ff event */
-	if (this->min_ff_event != "") {
+	if (this->metadata->min_ff_event != "") {
 		module_xml += "\t<min_ff_event><![CDATA[";
-		module_xml += this->min_ff_event;
+		module_xml += this->metadata->min_ff_event;
 		module_xml += "]]></min_ff_event>\n";
 	}
 
 	/* Unit */
-	if (this->unit != "") {
+	if (this->metadata->unit != "") {
 		module_xml += "\t<unit><![CDATA[";
-		module_xml += this->unit;
+		module_xml += this->metadata->unit;
 		module_xml += "]]></unit>\n";
 	}
 	
 	/* Module group */
-	if (this->module_group != "") {
+	if (this->metadata->module_group != "") {
 		module_xml += "\t<module_group>";
-		module_xml += this->module_group;
+		module_xml += this->metadata->module_group;
 		module_xml += "</module_group>\n";
 	}
 	
 	/* Custom ID */
-	if (this->custom_id != "") {
+	if (this->metadata->custom_id != "") {
 		module_xml += "\t<custom_id>";
-		module_xml += this->custom_id;
+		module_xml += this->metadata->custom_id;
 		module_xml += "</custom_id>\n";
 	}
 	
 	/* Str warning */
-	if (this->str_warning != "") {
+	if (this->metadata->str_warning != "") {
 		module_xml += "\t<str_warning>";
-		module_xml += this->str_warning;
+		module_xml += this->metadata->str_warning;
 		module_xml += "</str_warning>\n";
 	}
 	
 	/* Str critical */
-	if (this->str_critical != "") {
+	if (this->metadata->str_critical != "") {
 		module_xml += "\t<str_critical>";
-		module_xml += this->str_critical;
+		module_xml += this->metadata->str_critical;
 		module_xml += "</str_critical>\n";
 	}
 	
 	/* Critical instructions */
-	if (this->critical_instructions != "") {
+	if (this->metadata->critical_instructions != "") {
 		module_xml += "\t<critical_instructions>";
-		module_xml += this->critical_instructions;
+		module_xml += this->metadata->critical_instructions;
 		module_xml += "</critical_instructions>\n";
 	}
 	
 	/* Warning instructions */
-	if (this->warning_instructions != "") {
+	if (this->metadata->warning_instructions != "") {
 		module_xml += "\t<warning_instructions>";
-		module_xml += this->warning_instructions;
+		module_xml += this->metadata->warning_instructions;
 		module_xml += "</warning_instructions>\n";
 	}
 	
 	/* Unknown instructions */
-	if (this->unknown_instructions != "") {
+	if (this->metadata->unknown_instructions != "") {
 		module_xml += "\t<unknown_instructions>";
-		module_xml += this->unknown_instructions;
+		module_xml += this->metadata->unknown_instructions;
 		module_xml += "</unknown_instructions>\n";
 	}
 	
 	/* Tags */
-	if (this->tags != "") {
+	if (this->metadata->tags != "") {
 		module_xml += "\t<tags>";
-		module_xml += this->tags;
+		module_xml += this->metadata->tags;
 		module_xml += "</tags>\n";
 	}
 	
 	/* Critical inverse */
-	if (this->critical_inverse != "") {
+	if (this->metadata->critical_inverse != "") {
 		module_xml += "\t<critical_inverse>";
-		module_xml += this->critical_inverse;
+		module_xml += this->metadata->critical_inverse;
 		module_xml += "</critical_inverse>\n";
 	}
 	
 	/* Warning inverse */
-	if (this->warning_inverse != "") {
+	if (this->metadata->warning_inverse != "") {
 		module_xml += "\t<warning_inverse>";
-		module_xml += this->warning_inverse;
+		module_xml += this->metadata->warning_inverse;
 		module_xml += "</warning_inverse>\n";
 	}
 	
 	/* Quiet */
-	if (this->quiet != "") {
+	if (this->metadata->quiet != "") {
 		module_xml += "\t<quiet>";
-		module_xml += this->quiet;
+		module_xml += this->metadata->quiet;
 		module_xml += "</quiet>\n";
 	}
 	
 	/* Module FF interval */
-	if (this->module_ff_interval != "") {
+	if (this->metadata->module_ff_interval != "") {
 		module_xml += "\t<module_ff_interval>";
-		module_xml += this->module_ff_interval;
+		module_xml += this->metadata->module_ff_interval;
 		module_xml += "</module_ff_interval>\n";
 	}
 
     /* Write module data */
-	if (this->data_list && this->data_list->size () > 1) {
+	if (this->aggregate != NULL && this->aggregate->getCount () > 0) {
+		ostringstream aggregate_value;
+
+		/* Send the aggregated samples instead of the latest one */
+		aggregate_value.precision (15);
+		aggregate_value << this->aggregate->getValue ();
+		this->aggregate->reset ();
+
+		try {
+			Pandora_Data aggregate_data (aggregate_value.str (), this->module_name);
+
+			data_clean = strreplace (this->getDataOutput (&aggregate_data), "%", "%%" );
+			module_xml += "\t<data><![CDATA[";
+			module_xml += data_clean;
+			module_xml += "]]></data>\n";
+		} catch (Module_Exception e) {
+		}
+	} else if (this->data_list && this->data_list->size () > 1) {
 		list<Pandora_Data *>::iterator iter;
 
 		module_xml += "\t<datalist>\n";
@@ -809,7 +926,7 @@ Pandora_Module::setMin (int value) {
  */
 void
 Pandora_Module::setPostProcess (string value) {
-	this->post_process = value;
+	this->setMetadataField (&Module_Metadata::post_process, value);
 }
 
 /** 
@@ -819,7 +936,7 @@ Pandora_Module::setPostProcess (string value) {
  */
 void
 Pandora_Module::setMinCritical (string value) {
-	this->min_critical = value;
+	this->setMetadataField (&Module_Metadata::min_critical, value);
 }
 
 /** 
@@ -829,7 +946,7 @@ Pandora_Module::setMinCritical (string value) {
  */
 void
 Pandora_Module::setMaxCritical (string value) {
-	this->max_critical = value;
+	this->setMetadataField (&Module_Metadata::max_critical, value);
 }
 
 /** 
@@ -839,7 +956,7 @@ Pandora_Module::setMaxCritical (string value) {
  */
 void
 Pandora_Module::setMinWarning (string value) {
-	this->min_warning = value;
+	this->setMetadataField (&Module_Metadata::min_warning, value);
 }
 
 /** 
@@ -849,7 +966,7 @@ Pandora_Module::setMinWarning (string value) {
  */
 void
 Pandora_Module::setMaxWarning (string value) {
-	this->max_warning = value;
+	this->setMetadataField (&Module_Metadata::max_warning, value);
 }
 
 /** 
@@ -859,7 +976,7 @@ Pandora_Module::setMaxWarning (string value) {
  */
 void
 Pandora_Module::setDisabled (string value) {
-	this->disabled = value;
+	this->setMetadataField (&Module_Metadata::disabled, value);
 }
 
 /** 
@@ -869,7 +986,7 @@ Pandora_Module::setDisabled (string value) {
  */
 void
 Pandora_Module::setMinFFEvent (string value) {
-	this->min_ff_event = value;
+	this->setMetadataField (&Module_Metadata::min_ff_event, value);
 }
 
 /** 
@@ -879,7 +996,7 @@ Pandora_Module::setMinFFEvent (string value) {
  */
 void
 Pandora_Module::setUnit (string value) {
-	this->unit = value;
+	this->setMetadataField (&Module_Metadata::unit, value);
 }
 
 /** 
@@ -889,7 +1006,7 @@ Pandora_Module::setUnit (string value) {
  */
 void
 Pandora_Module::setModuleGroup (string value) {
-	this->module_group = value;
+	this->setMetadataField (&Module_Metadata::module_group, value);
 }
 
 /** 
@@ -899,7 +1016,7 @@ Pandora_Module::setModuleGroup (string value) {
  */
 void
 Pandora_Module::setCustomId (string value) {
-	this->custom_id = value;
+	this->setMetadataField (&Module_Metadata::custom_id, value);
 }
 
 /** 
@@ -909,7 +1026,7 @@ Pandora_Module::setCustomId (string value) {
  */
 void
 Pandora_Module::setStrWarning (string value) {
-	this->str_warning = value;
+	this->setMetadataField (&Module_Metadata::str_warning, value);
 }
 
 /** 
@@ -919,7 +1036,7 @@ Pandora_Module::setStrWarning (string value) {
  */
 void
 Pandora_Module::setStrCritical (string value) {
-	this->str_critical = value;
+	this->setMetadataField (&Module_Metadata::str_critical, value);
 }
 
 /** 
@@ -929,7 +1046,7 @@ Pandora_Module::setStrCritical (string value) {
  */
 void
 Pandora_Module::setCriticalInstructions (string value) {
-	this->critical_instructions = value;
+	this->setMetadataField (&Module_Metadata::critical_instructions, value);
 }
 
 /** 
@@ -939,7 +1056,7 @@ Pandora_Module::setCriticalInstructions (string value) {
  */
 void
 Pandora_Module::setWarningInstructions (string value) {
-	this->warning_instructions = value;
+	this->setMetadataField (&Module_Metadata::warning_instructions, value);
 }
 
 /** 
@@ -949,7 +1066,7 @@ Pandora_Module::setWarningInstructions (string value) {
  */
 void
 Pandora_Module::setUnknownInstructions (string value) {
-	this->unknown_instructions = value;
+	this->setMetadataField (&Module_Metadata::unknown_instructions, value);
 }
 
 /** 
@@ -959,7 +1076,7 @@ Pandora_Module::setUnknownInstructions (string value) {
  */
 void
 Pandora_Module::setTags (string value) {
-	this->tags = value;
+	this->setMetadataField (&Module_Metadata::tags, value);
 }
 
 /** 
@@ -969,7 +1086,7 @@ Pandora_Module::setTags (string value) {
  */
 void
 Pandora_Module::setCriticalInverse (string value) {
-	this->critical_inverse = value;
+	this->setMetadataField (&Module_Metadata::critical_inverse, value);
 }
 
 /** 
@@ -979,7 +1096,7 @@ Pandora_Module::setCriticalInverse (string value) {
  */
 void
 Pandora_Module::setWarningInverse (string value) {
-	this->warning_inverse = value;
+	this->setMetadataField (&Module_Metadata::warning_inverse, value);
 }
 
 /** 
@@ -989,7 +1106,7 @@ Pandora_Module::setWarningInverse (string value) {
  */
 void
 Pandora_Module::setQuiet (string value) {
-	this->quiet = value;
+	this->setMetadataField (&Module_Metadata::quiet, value);
 }
 
 /** 
@@ -999,7 +1116,50 @@ Pandora_Module::setQuiet (string value) {
  */
 void
 Pandora_Module::setModuleFFInterval (string value) {
-	this->module_ff_interval = value;
+	this->setMetadataField (&Module_Metadata::module_ff_interval, value);
+}
+
+/** 
+ * Set all the metadata fields of the module at once.
+ *
+ * The module shares the metadata with any other module with the
+ * same values.
+ *
+ * @param metadata Metadata values.
+ */
+void
+Pandora_Module::setMetadata (const Module_Metadata &metadata) {
+	const Module_Metadata *previous = this->metadata;
+
+	this->metadata = Module_Metadata::intern (metadata);
+	Module_Metadata::release (previous);
+}
+
+/** 
+ * Set a single metadata field of the module.
+ *
+ * @param field Field to set.
+ * @param value Value of the field.
+ */
+void
+Pandora_Module::setMetadataField (string Module_Metadata::*field, string value) {
+	Module_Metadata metadata = *this->metadata;
+
+	metadata.*field = value;
+	this->setMetadata (metadata);
+}
+
+/** 
+ * Limit the data a log module collects until its XML is sent. The
+ * entries past the limits are discarded and counted.
+ *
+ * @param max_bytes Maximum bytes, or 0 for no limit.
+ * @param max_lines Maximum entries, or 0 for no limit.
+ */
+void
+Pandora_Module::setLogLimits (int max_bytes, int max_lines) {
+	this->log_max_bytes = (max_bytes > 0) ? max_bytes : 0;
+	this->log_max_lines = (max_lines > 0) ? max_lines : 0;
 }
 
 /** 
@@ -1060,7 +1220,8 @@ Pandora_Module::setIntensiveInterval (int intensive_interval) {
 /** 
  * Set the execution timeout.
  * 
- * @param timeout Execution timeout.
+ * @param timeout Execution timeout, in seconds. Values too big to be
+ *        stored in milliseconds, such as INT_MAX, mean no timeout.
  */
 void
 Pandora_Module::setTimeout (int timeout) {
@@ -1070,7 +1231,11 @@ Pandora_Module::setTimeout (int timeout) {
 	}
 	
 	/* WaitForSingleObject expects milliseconds */
-	this->module_timeout = timeout * 1000;
+	if (timeout > INT_MAX / 1000) {
+		this->module_timeout = INT_MAX;
+	} else {
+		this->module_timeout = timeout * 1000;
+	}
 }
 
 /** 
@@ -1123,6 +1288,26 @@ Pandora_Module::setSave (string save) {
 	this->save = save;
 }
 
+/** 
+ * Set the aggregation mode of the module.
+ *
+ * Every sample taken between two packet sends is accumulated and the
+ * aggregated value is sent instead of the latest sample.
+ * 
+ * @param mode Aggregation mode. AGGREGATE_NONE disables aggregation.
+ */
+void
+Pandora_Module::setAggregate (Aggregate_Mode mode) {
+	if (this->aggregate != NULL) {
+		delete (this->aggregate);
+		this->aggregate = NULL;
+	}
+
+	if (mode != AGGREGATE_NONE) {
+		this->aggregate = new Pandora_Aggregate (mode);
+	}
+}
+
 /** 
  * Get the name of the environment variable where the module data will be saved.
  * 
@@ -1133,16 +1318,78 @@ Pandora_Module::getSave () {
 	return this->save;
 }
 
+/** 
+ * Adds a variable saved by other module that this module needs.
+ *
+ * The module will run after the modules that save the variable and the
+ * variable will be passed to its children.
+ * 
+ * @param variable Name of the variable.
+ */
+void
+Pandora_Module::addDependency (string variable) {
+	list<string>::iterator iter;
+
+	for (iter = this->dependencies.begin (); iter != this->dependencies.end (); iter++) {
+		if (*iter == variable) {
+			return;
+		}
+	}
+
+	this->dependencies.push_back (variable);
+}
+
+/** 
+ * Get the variables this module depends on.
+ * 
+ * @return The list of variable names.
+ */
+list<string> *
+Pandora_Module::getDependencies () {
+	return &(this->dependencies);
+}
+
+/** 
+ * Set the configuration text the module was created from.
+ * 
+ * @param definition Module definition.
+ */
+void
+Pandora_Module::setDefinition (string definition) {
+	this->definition = definition;
+}
+
+/** 
+ * Get the configuration text the module was created from.
+ * 
+ * @return The module definition.
+ */
+string
+Pandora_Module::getDefinition () {
+	return this->definition;
+}
+
+/** 
+ * Get the environment block for the children of the module.
+ * 
+ * @return The environment block, to be passed to CreateProcess.
+ */
+string
+Pandora_Module::getEnvironment () {
+	return Pandora_Variables::getInstance ()->getEnvironmentBlock (&(this->dependencies));
+}
+
 /** 
  * Adds a new condition to a condition list.
  * 
  * @param condition Condition string.
  * @param condition_list Pointer to the condition list.
+ *
+ * @return False if the condition is not valid.
  */
-void
+bool
 Pandora_Module::addGenericCondition (string condition, list<Condition *> **condition_list) {
 	Condition *cond;
-	char operation[256], string_value[1024], command[1024];
 
 	/* Create the condition list if it does not exist */
 	if (*condition_list == NULL) {
@@ -1152,74 +1399,89 @@ Pandora_Module::addGenericCondition (string condition, list<Condition *> **condi
 	/* Create the new condition */
 	cond = new Condition;
 	if (cond == NULL) {
-		return;
+		return false;
+	}
+
+	if (! Pandora_Module_Definition::parseCondition (condition, false, cond)) {
+		pandoraLog ("Invalid condition: %s", condition.c_str ());
+		delete (cond);
+		return false;
 	}
-	cond->value_1 = 0;
-	cond->value_2 = 0;
+	cond->command = "cmd.exe /c \"" + cond->command + "\"";
 
-	/* Numeric comparison */
-	if (sscanf (condition.c_str (), "%255s %lf %1023[^\n]s", operation, &(cond->value_1), command) == 3) {
-		cond->operation = operation;
-		cond->command = command;
-		cond->command = command;
-		cond->command = "cmd.exe /c \"" + cond->command + "\"";
-		(*condition_list)->push_back (cond);		
 	/* Regular expression */
-	} else if (sscanf (condition.c_str (), "=~ %1023s %1023[^\n]s", string_value, command) == 2) {
-		cond->operation = "=~";
-		cond->string_value = string_value;
-		cond->command = command;
-		cond->command = "cmd.exe /c \"" + cond->command + "\"";
-		if (regcomp (&(cond->regexp), string_value, 0) != 0) {
-			pandoraDebug ("Invalid regular expression %s", string_value);
+	if (cond->operation == "=~") {
+		if (this->condition_patterns == NULL) {
+			this->condition_patterns = new Pandora_Pattern_Set ();
+		}
+		cond->pattern = this->condition_patterns->add (cond->string_value, false);
+		if (cond->pattern < 0) {
+			pandoraDebug ("Invalid regular expression %s", cond->string_value.c_str ());
 			delete (cond);
-			return;
+			return false;
 		}
-		(*condition_list)->push_back (cond);		
-	/* Interval */
-	} else if (sscanf (condition.c_str (), "(%lf , %lf) %1023[^\n]s", &(cond->value_1), &(cond->value_2), command) == 3) {
-		cond->operation = "()";
-		cond->command = command;
-		cond->command = "cmd.exe /c \"" + cond->command + "\"";
-		(*condition_list)->push_back (cond);
-	} else {
-		pandoraLog ("Invalid condition: %s", condition.c_str ());
-		delete (cond);
-		return;
 	}
-
-	return;
+
+	(*condition_list)->push_back (cond);
+	return true;
 }
 
 /** 
  * Adds a new module condition.
  * 
  * @param condition Condition string.
+ *
+ * @return False if the condition is not valid.
  */
-void
+bool
 Pandora_Module::addCondition (string condition) {
-	addGenericCondition (condition, &(this->condition_list));
+	return addGenericCondition (condition, &(this->condition_list));
 }
 
 /** 
  * Adds a new module pre-condition.
  * 
  * @param condition Condition string.
+ *
+ * @return False if the condition is not valid.
  */
-void
+bool
 Pandora_Module::addPreCondition (string condition) {
-	addGenericCondition (condition, &(this->precondition_list));
+	return addGenericCondition (condition, &(this->precondition_list));
+}
+
+/** 
+ * Get the number of conditions that run a command.
+ *
+ * Preconditions and conditions spawn a process each time they are
+ * evaluated, unlike intensive conditions.
+ *
+ * @return Number of preconditions and conditions.
+ */
+int
+Pandora_Module::getCommandConditionCount () {
+	int count = 0;
+
+	if (this->precondition_list != NULL) {
+		count += this->precondition_list->size ();
+	}
+	if (this->condition_list != NULL) {
+		count += this->condition_list->size ();
+	}
+
+	return count;
 }
 
 /** 
  * Adds a new module intensive condition.
  * 
  * @param condition Condition string.
+ *
+ * @return False if the condition is not valid.
  */
-void
+bool
 Pandora_Module::addIntensiveCondition (string condition) {
 	Condition *cond;
-	char operation[256], string_value[1024], command[1024];
 
 	/* Create the condition list if it does not exist */
 	if (this->intensive_condition_list == NULL) {
@@ -1229,34 +1491,30 @@ Pandora_Module::addIntensiveCondition (string condition) {
 	/* Create the new condition */
 	cond = new Condition;
 	if (cond == NULL) {
-		return;
+		return false;
+	}
+
+	if (! Pandora_Module_Definition::parseCondition (condition, true, cond)) {
+		pandoraDebug ("Invalid intensive condition: %s", condition.c_str ());
+		delete (cond);
+		return false;
 	}
-	cond->value_1 = 0;
-	cond->value_2 = 0;
 
-	/* Numeric comparison */
-	if (sscanf (condition.c_str (), "%255s %lf", operation, &(cond->value_1)) == 2) {
-		cond->operation = operation;
-		(this->intensive_condition_list)->push_back (cond);		
 	/* Regular expression */
-	} else if (sscanf (condition.c_str (), "=~ %1023s", string_value) == 1) {
-		cond->operation = "=~";
-		cond->string_value = string_value;
-		if (regcomp (&(cond->regexp), string_value, 0) != 0) {
-			pandoraDebug ("Invalid regular expression %s", string_value);
+	if (cond->operation == "=~") {
+		if (this->condition_patterns == NULL) {
+			this->condition_patterns = new Pandora_Pattern_Set ();
+		}
+		cond->pattern = this->condition_patterns->add (cond->string_value, false);
+		if (cond->pattern < 0) {
+			pandoraDebug ("Invalid regular expression %s", cond->string_value.c_str ());
 			delete (cond);
-			return;
+			return false;
 		}
-		(this->intensive_condition_list)->push_back (cond);		
-	/* Interval */
-	} else if (sscanf (condition.c_str (), "(%lf , %lf)", &(cond->value_1), &(cond->value_2)) == 2) {
-		cond->operation = "()";
-		(this->intensive_condition_list)->push_back (cond);
-	} else {
-		pandoraDebug ("Invalid intensive condition: %s", condition.c_str ());
-		delete (cond);
-		return;
 	}
+
+	(this->intensive_condition_list)->push_back (cond);
+	return true;
 }
 
 /** 
@@ -1264,145 +1522,47 @@ Pandora_Module::addIntensiveCondition (string condition) {
  */
 int
 Pandora_Module::evaluatePreconditions () {
-	STARTUPINFO         si;
-	PROCESS_INFORMATION pi;
-	DWORD               retval, dwRet;
-	SECURITY_ATTRIBUTES attributes;
-	HANDLE              out, new_stdout, out_read, job;
-	string              working_dir;
 	Condition *precond = NULL;
 	double double_output;
 	list<Condition *>::iterator iter;
-	unsigned char run;
 	string output;
+	int result;
 	
 	if (this->precondition_list != NULL && this->precondition_list->size () > 0) {
 
-		iter = this->precondition_list->begin ();
 		for (iter = this->precondition_list->begin ();
 		     iter != this->precondition_list->end ();
 		     iter++) {
 				
 			precond = *iter;
-			run = 0;	
-			
-	
-			/* Set the bInheritHandle flag so pipe handles are inherited. */
-			attributes.nLength = sizeof (SECURITY_ATTRIBUTES); 
-			attributes.bInheritHandle = TRUE; 
-			attributes.lpSecurityDescriptor = NULL; 
-
-			/* Create a job to kill the child tree if it become zombie */
-			/* CAUTION: In order to compile this, WINVER should be defined to 0x0500.
-			This may need no change, since it was redefined by the 
-			program, but if needed, the macro is defined 
-			in <windef.h> */
-			job = CreateJobObject (&attributes, this->module_name.c_str ());
-			if (job == NULL) {
-				pandoraLog ("evaluatePreconditions: CreateJobObject failed. Err: %d", GetLastError ());
-				return 0;
-			}
-
-			/* Get the handle to the current STDOUT. */
-			out = GetStdHandle (STD_OUTPUT_HANDLE); 
-
-			if (! CreatePipe (&out_read, &new_stdout, &attributes, 0)) {
-				pandoraLog ("evaluatePreconditions: CreatePipe failed. Err: %d", GetLastError ());
-				return 0;
-			}
-
-			/* Ensure the read handle to the pipe for STDOUT is not inherited */
-			SetHandleInformation (out_read, HANDLE_FLAG_INHERIT, 0);
-
-			/* Set up members of the STARTUPINFO structure. */
-			ZeroMemory (&si, sizeof (si));
-			GetStartupInfo (&si);
-
-			si.cb = sizeof (si);
-			si.dwFlags     = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-			si.wShowWindow = SW_HIDE;
-			si.hStdError   = new_stdout;
-			si.hStdOutput  = new_stdout;
-
-			/* Set up members of the PROCESS_INFORMATION structure. */
-			ZeroMemory (&pi, sizeof (pi));
 			pandoraDebug ("Executing pre-condition: %s", precond->command.c_str ());
 
-			/* Set the working directory of the process. It's "utils" directory
-			to find the GNU W32 tools */
-			working_dir = getPandoraInstallDir () + "util\\";
+			/* The working directory is "util", to find the GNU W32 tools */
+			Pandora_Process_Runner runner (precond->command);
+			runner.setWorkingDir (getPandoraInstallDir () + "util\\");
+			runner.setEnvironment (this->getEnvironment ());
+			runner.setTimeout (this->getTimeout ());
 
-			/* Create the child process. */
-			if (! CreateProcess (NULL, (CHAR *) precond->command.c_str (), NULL,
-			     NULL, TRUE, CREATE_SUSPENDED | CREATE_NO_WINDOW, NULL,
-			     working_dir.c_str (), &si, &pi)) {
+			result = runner.run ();
+			if (result == RUNNER_ERROR) {
 				pandoraLog ("evaluatePreconditions: %s CreateProcess failed. Err: %d",
-			    this->module_name.c_str (), GetLastError ());
-			} else {
-				char          buffer[BUFSIZE + 1];
-				unsigned long read, avail;
-	
-				if (! AssignProcessToJobObject (job, pi.hProcess)) {
-					pandoraLog ("evaluatePreconditions: could not assign proccess to job (error %d)",
-				    GetLastError ());
-				}
-				ResumeThread (pi.hThread);
-	
-				/*string output;*/
-				output = "";
-				int tickbase = GetTickCount();
-				while ( (dwRet = WaitForSingleObject (pi.hProcess, 500)) != WAIT_ABANDONED ) {
-					PeekNamedPipe (out_read, buffer, BUFSIZE, &read, &avail, NULL);
-						if (avail > 0) {
-							ReadFile (out_read, buffer, BUFSIZE, &read, NULL);
-							buffer[read] = '\0';
-							output += (char *) buffer;
-					}
-				
-				try {
-					double_output = Pandora_Strutils::strtodouble (output);
-				} catch (Pandora_Strutils::Invalid_Conversion e) {
-					double_output = 0;
-				}
-	
-				if (dwRet == WAIT_OBJECT_0) { 
-					break;
-				} else if(this->getTimeout() < GetTickCount() - tickbase) {
-					/* STILL_ACTIVE */
-					TerminateProcess(pi.hThread, STILL_ACTIVE);
-					pandoraLog ("evaluatePreconditions: %s timed out (retcode: %d)", this->module_name.c_str (), STILL_ACTIVE);
-					break;
-				}
-			}
-	
-			GetExitCodeProcess (pi.hProcess, &retval);
-	
-			if (retval != 0) {
-				if (! TerminateJobObject (job, 0)) {
-					pandoraLog ("evaluatePreconditions: TerminateJobObject failed. (error %d)",
-					GetLastError ());
-				}
-	            if (retval != STILL_ACTIVE) {
-					pandoraLog ("evaluatePreconditions: %s did not executed well (retcode: %d)",
-	                this->module_name.c_str (), retval);
-	            }
-				/* Close job, process and thread handles. */
-				CloseHandle (job);
-				CloseHandle (pi.hProcess);
-				CloseHandle (pi.hThread);
-				CloseHandle (new_stdout);
-				CloseHandle (out_read);
+					    this->module_name.c_str (), GetLastError ());
+				return 0;
+			} else if (result == RUNNER_TIMEOUT) {
+				pandoraLog ("evaluatePreconditions: %s timed out (retcode: %d)", this->module_name.c_str (), STILL_ACTIVE);
+				return 0;
+			} else if (runner.getExitCode () != 0) {
+				pandoraLog ("evaluatePreconditions: %s did not executed well (retcode: %d)",
+					    this->module_name.c_str (), runner.getExitCode ());
 				return 0;
 			}
-		
-			/* Close job, process and thread handles. */
-			CloseHandle (job);
-			CloseHandle (pi.hProcess);
-			CloseHandle (pi.hThread);
-		}
 
-			CloseHandle (new_stdout);
-			CloseHandle (out_read);
+			output = runner.getOutput ();
+			try {
+				double_output = Pandora_Strutils::strtodouble (output);
+			} catch (Pandora_Strutils::Invalid_Conversion e) {
+				double_output = 0;
+			}
 		
 			if (evaluateCondition (output, double_output, precond) == 0) {
 				return 0;
@@ -1423,8 +1583,6 @@ Pandora_Module::evaluateConditions () {
 	string string_value;
 	Condition *cond = NULL;
 	list<Condition *>::iterator iter;
-	PROCESS_INFORMATION pi;
-	STARTUPINFO         si;
 	Pandora_Data *pandora_data = NULL;
 	regex_t regex;
 
@@ -1455,16 +1613,14 @@ Pandora_Module::evaluateConditions () {
 			run = 0;
 			
 			if (evaluateCondition (string_value, double_value, cond) == 1) {
-				/* Run the condition command */
-				ZeroMemory (&si, sizeof (si));
-				ZeroMemory (&pi, sizeof (pi));
-				if (CreateProcess (NULL , (CHAR *)cond->command.c_str (), NULL, NULL, FALSE,
-				    CREATE_NO_WINDOW, NULL, NULL, &si, &pi) == 0) {
+				/* Run the condition command. Its output is not used */
+				Pandora_Process_Runner runner (cond->command);
+				runner.setEnvironment (this->getEnvironment ());
+				runner.setTimeout (this->module_timeout);
+				runner.setMaxOutput (1);
+				if (runner.run () == RUNNER_ERROR) {
 				    return;
 				}
-				WaitForSingleObject(pi.hProcess, this->module_timeout);
-				CloseHandle (pi.hProcess);
-				CloseHandle (pi.hThread);
 			}
 		}
 	}
@@ -1675,7 +1831,7 @@ int Pandora_Module::evaluateCondition (string string_value, double double_value,
 	    (condition->operation == "<" && double_value < condition->value_1) ||
 	    (condition->operation == "=" && double_value == condition->value_1) ||
 	    (condition->operation == "!=" && double_value != condition->value_1) ||
-	    (condition->operation == "=~" && regexec (&(condition->regexp), string_value.c_str(), 0, NULL, 0) == 0) ||
+	    (condition->operation == "=~" && this->condition_patterns->matches (condition->pattern, string_value)) ||
 		(condition->operation == "()" && double_value > condition->value_1 && double_value < condition->value_2)) {
 			return 1;
 	}
@@ -23,6 +23,11 @@
 
 #include "../pandora.h"
 #include "pandora_data.h"
+#include "pandora_aggregate.h"
+#include "pandora_module_metadata.h"
+#include "pandora_pattern_set.h"
+#include "pandora_module_definition.h"
+#include "../misc/pandora_timing.h"
 #include "boost/regex.h"
 #include <list>
 #include <string>
@@ -36,73 +41,15 @@ using namespace Pandora;
 namespace Pandora_Modules {
 
 	/**
-	 * Defines the type of the module.
-	 *
-	 * The type of a module is the value type the module can have.
+	 * Defines the module operations whose duration is measured.
 	 */
 	typedef enum {
-		TYPE_0,                  /**< Invalid value               */
-		TYPE_GENERIC_DATA,       /**< The value is an integer     */
-		TYPE_GENERIC_DATA_INC,   /**< The value is an integer with
-					  *  incremental diferences       */
-		TYPE_GENERIC_PROC,       /**< The value is a 0 or a 1     */
-		TYPE_GENERIC_DATA_STRING, /**< The value is a string       */
-		TYPE_ASYNC_DATA, /**< Asynchronous generic_data */
-		TYPE_ASYNC_PROC, /**< Asynchronous generic_proc */
-		TYPE_ASYNC_STRING, /**< Asynchronous generic_data_string */
-		TYPE_LOG /**< Log data */
-	} Module_Type;
-
-	const string module_generic_data_str        = "generic_data";
-	const string module_generic_data_inc_str    = "generic_data_inc";
-	const string module_generic_proc_str        = "generic_proc";
-	const string module_generic_data_string_str = "generic_data_string";
-	const string module_async_data_str          = "async_data";
-	const string module_async_proc_str          = "async_proc";
-	const string module_async_string_str        = "async_string";
-	const string module_log_str                 = "log";
-
-	/**
-	 * Defines the kind of the module.
-	 *
-	 * The kind of a module is the work the module does.
-	 */
-	typedef enum {
-		MODULE_0,         /**< Invalid kind                    */
-		MODULE_EXEC,      /**< The module run a custom command */
-		MODULE_PROC,      /**< The module checks for a running
-				   *   process                         */
-		MODULE_SERVICE,   /**< The module checks for a running
-				   *   service                         */
-		MODULE_FREEDISK,  /**< The module checks the free      */
-		MODULE_FREEDISK_PERCENT,  /**< The module checks the free      */
-		MODULE_CPUUSAGE,  /**< The module checks the CPU usage */
-		MODULE_INVENTORY, /**< The module gets the inventory of the machine */
-		MODULE_FREEMEMORY, /**< The module checks the percentage of 
-				   *   freememory in the system        */
-		MODULE_FREEMEMORY_PERCENT, /**< The module checks the amount of 
-				   *   freememory in the system        */
-		MODULE_LOGEVENT,       /**< The module checks for log events */	
-		MODULE_WMIQUERY,       /**< The module runs WQL queries */		
-		MODULE_PERFCOUNTER,    /**< The module reads performance counters */
-		MODULE_TCPCHECK,       /**< The module checks whether a tcp port is open */
-		MODULE_REGEXP,         /**< The module searches a file for matches of a regular expression */
-		MODULE_PLUGIN,          /**< Plugin */
-		MODULE_PING,            /**< Ping module */
-		MODULE_SNMPGET          /**< SNMP get module */
-	} Module_Kind;
-	
-	/**
-	 * Defines the structure that holds module conditions.
-	 */
-	typedef struct {
-		double value_1;
-		double value_2;
-		string string_value;
-		string operation;
-		string command;
-		regex_t regexp;
-	} Condition;
+		TIMING_RUN,           /**< Module execution          */
+		TIMING_PRECONDITIONS, /**< Preconditions evaluation  */
+		TIMING_CONDITIONS,    /**< Condition actions         */
+		TIMING_XML,           /**< XML generation            */
+		TIMING_MAX
+	} Timing_Kind;
 
 	/**
 	 * Defines the structure that holds the module cron.
@@ -162,8 +109,6 @@ namespace Pandora_Modules {
 		int                   module_timeout;
 		int                   executions;
 		int                   max, min;
-		string                min_critical, max_critical, min_warning, max_warning;
-		string                post_process, disabled, min_ff_event;
 		bool                  has_limits, has_min, has_max;
 		Module_Type           module_type;
 		string                module_kind_str;
@@ -173,12 +118,26 @@ namespace Pandora_Modules {
 		list<Condition *>     *precondition_list;
 		Cron				  *cron;
 		list<Condition *>     *intensive_condition_list;
+		Pandora_Pattern_Set   *condition_patterns;
 		time_t                timestamp;
 		unsigned char         intensive_match;
 		int                   intensive_interval;
-		string                unit, custom_id, str_warning, str_critical;
-		string 		      module_group, warning_inverse, critical_inverse, quiet, module_ff_interval;
-		string                critical_instructions, warning_instructions, unknown_instructions, tags;
+		const Module_Metadata *metadata;
+		Pandora_Aggregate     *aggregate;
+		list<string>          dependencies;
+
+		/* Log data collected until the next XML, its limits and what
+		   was dropped past them */
+		size_t                log_max_bytes, log_max_lines;
+		size_t                log_bytes, log_lines;
+		unsigned long         log_dropped_bytes, log_dropped_lines;
+		Pandora_Timing::Histogram timings[TIMING_MAX];
+		string                definition;
+
+		void                  setMetadataField (string Module_Metadata::*field,
+							string value);
+		bool                  acceptLogOutput  (const string &output);
+		void                  getLogXml        (size_t max_size, list<string> &chunks);
 
 	protected:
 		
@@ -217,6 +176,8 @@ namespace Pandora_Modules {
 		
 		string getDataOutput (Pandora_Data *data);
 		void   cleanDataList ();
+		bool   fitsLogLimits (size_t bytes, size_t lines) const;
+		void   dropLogOutput (size_t bytes);
 	public:
 		Pandora_Module                    (string name);
 		virtual ~Pandora_Module           ();
@@ -236,6 +197,7 @@ namespace Pandora_Modules {
 		string       getSave ();
 
 		virtual string getXml      ();
+		void           getXmlChunks (size_t max_size, list<string> &chunks);
 
 		
 		virtual void run           ();
@@ -278,15 +240,27 @@ namespace Pandora_Modules {
 		void        setWarningInverse  (string value);
 		void        setQuiet       (string value);
 		void        setModuleFFInterval  (string value);
+		void        setMetadata    (const Module_Metadata &metadata);
+		void        setLogLimits   (int max_bytes, int max_lines);
 		
 		void        setAsync       (bool async);
 		void        setSave        (string save);
+		void        setAggregate   (Aggregate_Mode mode);
+		void        addDependency  (string variable);
+		list<string> *getDependencies ();
+		string      getEnvironment ();
+		bool        isIntervalFulfilled () const;
+		void        addTiming      (Timing_Kind kind, unsigned long long usecs);
+		const Pandora_Timing::Histogram *getTiming (Timing_Kind kind) const;
+		void        setDefinition  (string definition);
+		string      getDefinition  ();
 
 		void        exportDataOutput ();
-		void        addGenericCondition (string condition, list<Condition *> **condition_list);
-		void		addCondition    (string precondition);
-		void		addPreCondition    (string precondition);
-		void		addIntensiveCondition    (string intensivecondition);
+		bool        addGenericCondition (string condition, list<Condition *> **condition_list);
+		bool		addCondition    (string precondition);
+		bool		addPreCondition    (string precondition);
+		bool		addIntensiveCondition    (string intensivecondition);
+		int         getCommandConditionCount ();
 		int 		evaluatePreconditions ();
 		void		evaluateConditions ();
 		int         checkCron ();
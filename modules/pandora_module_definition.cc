@@ -0,0 +1,420 @@
+/* Parsing of module definitions.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_module_definition.h"
+#include "pandora_macros.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+using namespace Pandora_Modules;
+
+/* Every module definition token */
+static const char *all_tokens[] = {
+	TOKEN_NAME, TOKEN_TYPE, TOKEN_INTERVAL, TOKEN_EXEC, TOKEN_PROC,
+	TOKEN_SERVICE, TOKEN_FREEDISK, TOKEN_FREEDISK_PERCENT, TOKEN_FREEMEMORY,
+	TOKEN_FREEMEMORY_PERCENT, TOKEN_CPUUSAGE, TOKEN_INVENTORY, TOKEN_MAX,
+	TOKEN_MIN, TOKEN_POST_PROCESS, TOKEN_MIN_CRITICAL, TOKEN_MAX_CRITICAL,
+	TOKEN_MIN_WARNING, TOKEN_MAX_WARNING, TOKEN_DISABLED, TOKEN_MIN_FF_EVENT,
+	TOKEN_DESCRIPTION, TOKEN_LOGEVENT, TOKEN_SOURCE, TOKEN_EVENTTYPE,
+	TOKEN_EVENTCODE, TOKEN_PATTERN, TOKEN_APPLICATION, TOKEN_ASYNC,
+	TOKEN_WATCHDOG, TOKEN_START_COMMAND, TOKEN_WMIQUERY, TOKEN_WMICOLUMN,
+	TOKEN_RETRIES, TOKEN_STARTDELAY, TOKEN_RETRYDELAY, TOKEN_PERFCOUNTER,
+	TOKEN_COOKED, TOKEN_TCPCHECK, TOKEN_PORT, TOKEN_TIMEOUT, TOKEN_REGEXP,
+	TOKEN_REGEXP_REFRESH, TOKEN_REGEXP_MAX_FILES, TOKEN_PLUGIN, TOKEN_SAVE,
+	TOKEN_CONDITION, TOKEN_CRONTAB, TOKEN_CRONINTERVAL, TOKEN_PRECONDITION,
+	TOKEN_NOSEEKEOF, TOKEN_PING, TOKEN_PING_COUNT, TOKEN_PING_TIMEOUT,
+	TOKEN_SNMPGET, TOKEN_SNMPVERSION, TOKEN_SNMPCOMMUNITY, TOKEN_SNMPAGENT,
+	TOKEN_SNMPOID, TOKEN_ADVANCEDOPTIONS, TOKEN_INTENSIVECONDITION,
+	TOKEN_UNIT, TOKEN_MODULE_GROUP, TOKEN_CUSTOM_ID, TOKEN_STR_WARNING,
+	TOKEN_STR_CRITICAL, TOKEN_CRITICAL_INSTRUCTIONS,
+	TOKEN_WARNING_INSTRUCTIONS, TOKEN_UNKNOWN_INSTRUCTIONS, TOKEN_TAGS,
+	TOKEN_CRITICAL_INVERSE, TOKEN_WARNING_INVERSE, TOKEN_QUIET,
+	TOKEN_MODULE_FF_INTERVAL, TOKEN_AGGREGATE, TOKEN_DEPENDS, TOKEN_MACRO,
+	TOKEN_MAX_OUTPUT, TOKEN_MAX_LINES, TOKEN_OUTPUT_TAIL, TOKEN_PERSISTENT
+};
+
+#define NUM_TOKENS (sizeof (all_tokens) / sizeof (const char *))
+
+/* The tokens that identify the kind of a module, in order of precedence */
+static const struct {
+	const char  *token;
+	Module_Kind  kind;
+} kind_tokens[] = {
+	{ TOKEN_EXEC,               MODULE_EXEC },
+	{ TOKEN_PROC,               MODULE_PROC },
+	{ TOKEN_SERVICE,            MODULE_SERVICE },
+	{ TOKEN_FREEDISK,           MODULE_FREEDISK },
+	{ TOKEN_FREEDISK_PERCENT,   MODULE_FREEDISK_PERCENT },
+	{ TOKEN_FREEMEMORY,         MODULE_FREEMEMORY },
+	{ TOKEN_FREEMEMORY_PERCENT, MODULE_FREEMEMORY_PERCENT },
+	{ TOKEN_CPUUSAGE,           MODULE_CPUUSAGE },
+	{ TOKEN_INVENTORY,          MODULE_INVENTORY },
+	{ TOKEN_LOGEVENT,           MODULE_LOGEVENT },
+	{ TOKEN_WMIQUERY,           MODULE_WMIQUERY },
+	{ TOKEN_PERFCOUNTER,        MODULE_PERFCOUNTER },
+	{ TOKEN_TCPCHECK,           MODULE_TCPCHECK },
+	{ TOKEN_REGEXP,             MODULE_REGEXP },
+	{ TOKEN_PLUGIN,             MODULE_PLUGIN },
+	{ TOKEN_PING,               MODULE_PING },
+	{ TOKEN_SNMPGET,            MODULE_SNMPGET }
+};
+
+static bool
+compareTokens (const char *a, const char *b) {
+	return strcmp (a, b) < 0;
+}
+
+/**
+ * Get the module definition tokens, sorted for a binary search.
+ *
+ * @return The sorted tokens.
+ */
+static const vector<const char *> &
+getSortedTokens () {
+	static vector<const char *> tokens;
+
+	if (tokens.empty ()) {
+		tokens.assign (all_tokens, all_tokens + NUM_TOKENS);
+		sort (tokens.begin (), tokens.end (), compareTokens);
+	}
+
+	return tokens;
+}
+
+/**
+ * Get the index of a token in the sorted tokens.
+ *
+ * @param keyword Token, including the separator if any.
+ *
+ * @return The index, or -1 if it is not a token.
+ */
+static int
+getTokenIndex (const char *keyword) {
+	const vector<const char *> &tokens = getSortedTokens ();
+	int                         low = 0, high = tokens.size () - 1, mid, cmp;
+
+	while (low <= high) {
+		mid = (low + high) / 2;
+		cmp = strcmp (keyword, tokens[mid]);
+		if (cmp == 0) {
+			return mid;
+		} else if (cmp < 0) {
+			high = mid - 1;
+		} else {
+			low = mid + 1;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Find the token of a module definition line.
+ *
+ * The keyword of the line is looked up with a binary search. Tokens
+ * without separator (like module_macro) are matched as prefixes.
+ *
+ * @param line Module definition line.
+ *
+ * @return The index of the token, or -1 if the line has no known token.
+ */
+static int
+findToken (const string &line) {
+	const vector<const char *> &tokens = getSortedTokens ();
+	string                      keyword;
+	size_t                      pos;
+	int                         index;
+
+	pos = line.find (' ');
+	keyword = (pos == string::npos) ? line : line.substr (0, pos + 1);
+
+	index = getTokenIndex (keyword.c_str ());
+	if (index >= 0) {
+		return index;
+	}
+
+	for (index = 0; index < (int) tokens.size (); index++) {
+		pos = strlen (tokens[index]);
+		if (tokens[index][pos - 1] != ' ' && line.compare (0, pos, tokens[index]) == 0) {
+			return index;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Remove the leading and trailing blanks of a line.
+ *
+ * @param line Line.
+ *
+ * @return The trimmed line.
+ */
+static string
+trimLine (const string &line) {
+	size_t begin, end;
+
+	begin = line.find_first_not_of (" \t\r\n");
+	if (begin == string::npos) {
+		return "";
+	}
+	end = line.find_last_not_of (" \t\r\n");
+
+	return line.substr (begin, end - begin + 1);
+}
+
+/**
+ * Parses a module definition.
+ *
+ * @param definition Module definition readed from the configuration file.
+ * @param errors Where the unknown lines are appended. May be NULL.
+ */
+Pandora_Module_Definition::Pandora_Module_Definition (const string &definition,
+						      list<string> *errors) {
+	list<string>::iterator iter;
+	Pandora_Macros        *macros;
+	string                 line, value;
+	size_t                 begin, end;
+	int                    index, macro_index;
+	size_t                 i;
+
+	this->values.resize (NUM_TOKENS);
+
+	for (begin = 0; begin < definition.size (); begin = end + 1) {
+		end = definition.find ('\n', begin);
+		if (end == string::npos) {
+			end = definition.size ();
+		}
+
+		line = trimLine (definition.substr (begin, end - begin));
+		index = findToken (line);
+		if (index >= 0) {
+			value = line.substr (strlen (getSortedTokens ()[index]));
+			if (value == "") {
+				value = " ";
+			}
+			this->values[index].push_back (value);
+		} else if (errors != NULL && line != "" && line[0] != '#' &&
+			   line.compare (0, 12, "module_begin") != 0 &&
+			   line.compare (0, 10, "module_end") != 0) {
+			errors->push_back ("Unknown token: " + line);
+		}
+	}
+
+	/* Subst macros */
+	macro_index = getTokenIndex (TOKEN_MACRO);
+	if (this->values[macro_index].size () > 0) {
+		macros = Pandora_Macros::getCompiled (this->values[macro_index]);
+
+		for (i = 0; i < this->values.size (); i++) {
+			if ((int) i == macro_index) {
+				continue;
+			}
+
+			for (iter = this->values[i].begin (); iter != this->values[i].end (); iter++) {
+				macros->apply (*iter);
+			}
+		}
+	}
+}
+
+/**
+ * Get the value of a token.
+ *
+ * @param token Token, one of the TOKEN_ defines.
+ *
+ * @return The value of the first occurrence of the token, or an empty
+ *         string if it is not in the definition.
+ */
+string
+Pandora_Module_Definition::getValue (const char *token) const {
+	int index = getTokenIndex (token);
+
+	if (index < 0 || this->values[index].empty ()) {
+		return "";
+	}
+
+	return this->values[index].front ();
+}
+
+/**
+ * Get the values of every occurrence of a token, like the conditions.
+ *
+ * @param token Token, one of the TOKEN_ defines.
+ *
+ * @return The values, in definition order.
+ */
+const list<string> &
+Pandora_Module_Definition::getValues (const char *token) const {
+	static const list<string> empty;
+	int                       index = getTokenIndex (token);
+
+	if (index < 0) {
+		return empty;
+	}
+
+	return this->values[index];
+}
+
+/**
+ * Check whether a token is set to an enabled value.
+ *
+ * @param token Token, one of the TOKEN_ defines.
+ *
+ * @return True if its value is enabled, see isEnabled (string).
+ */
+bool
+Pandora_Module_Definition::isEnabled (const char *token) const {
+	return isEnabled (this->getValue (token));
+}
+
+/**
+ * Get the kind of the module, given by the first kind token found in
+ * order of precedence.
+ *
+ * @return The kind of the module, or MODULE_0 if it has no kind token.
+ */
+Module_Kind
+Pandora_Module_Definition::getKind () const {
+	size_t i;
+
+	for (i = 0; i < sizeof (kind_tokens) / sizeof (kind_tokens[0]); i++) {
+		if (this->getValue (kind_tokens[i].token) != "") {
+			return kind_tokens[i].kind;
+		}
+	}
+
+	return MODULE_0;
+}
+
+/**
+ * Check whether a value is one of the enabled values, like "1" or "on".
+ *
+ * @param value Value.
+ *
+ * @return True if the value is enabled.
+ */
+bool
+Pandora_Module_Definition::isEnabled (const string &value) {
+	static string enabled_values[] = {"enabled", "1", "on", "yes", "si", "s\xc3\xad", "ok", "true", ""};
+	int i = 0;
+
+	while (enabled_values[i] != "") {
+		if (enabled_values[i] == value) {
+			return true;
+		}
+		i++;
+	}
+	return false;
+}
+
+/** 
+ * Get the Module_Type from a string type.
+ * 
+ * @param type String type.
+ * 
+ * @return The Module_Type which represents the type.
+ */
+Module_Type
+Pandora_Module_Definition::parseType (const string &type) {
+	if (type == module_generic_data_str || type == "") {
+		return TYPE_GENERIC_DATA;
+	} else if (type == module_generic_data_inc_str) {
+		return TYPE_GENERIC_DATA_INC;
+	} else if (type == module_generic_data_string_str) {
+		return TYPE_GENERIC_DATA_STRING;
+	} else if (type == module_generic_proc_str) {
+		return TYPE_GENERIC_PROC;
+	} else if (type == module_async_data_str) {
+		return TYPE_ASYNC_DATA;
+	} else if (type == module_async_proc_str) {
+		return TYPE_ASYNC_PROC;
+	} else if (type == module_async_string_str) {
+		return TYPE_ASYNC_STRING;
+	} else if (type == module_log_str) {
+		return TYPE_LOG;
+	} else {
+		return TYPE_0;
+	}
+}
+
+/** 
+ * Parse a module condition.
+ *
+ * Conditions are either a comparison ("> 10 command"), a regular
+ * expression ("=~ pattern command") or an interval
+ * ("(10 , 20) command"). Intensive conditions have no command.
+ *
+ * @param condition Condition string.
+ * @param intensive True for an intensive condition.
+ * @param cond Where the condition is stored. The string value is only
+ *        set for regular expressions, and is not compiled.
+ *
+ * @return False if the condition is not valid.
+ */
+bool
+Pandora_Module_Definition::parseCondition (const string &condition, bool intensive,
+					   Condition *cond) {
+	char operation[256], string_value[1024], command[1024];
+
+	cond->value_1 = 0;
+	cond->value_2 = 0;
+	cond->pattern = -1;
+	cond->string_value = "";
+	cond->command = "";
+
+	if (intensive) {
+		/* Numeric comparison */
+		if (sscanf (condition.c_str (), "%255s %lf", operation, &(cond->value_1)) == 2) {
+			cond->operation = operation;
+		/* Regular expression */
+		} else if (sscanf (condition.c_str (), "=~ %1023s", string_value) == 1) {
+			cond->operation = "=~";
+			cond->string_value = string_value;
+		/* Interval */
+		} else if (sscanf (condition.c_str (), "(%lf , %lf)", &(cond->value_1), &(cond->value_2)) == 2) {
+			cond->operation = "()";
+		} else {
+			return false;
+		}
+
+		return true;
+	}
+
+	/* Numeric comparison */
+	if (sscanf (condition.c_str (), "%255s %lf %1023[^\n]s", operation, &(cond->value_1), command) == 3) {
+		cond->operation = operation;
+		cond->command = command;
+	/* Regular expression */
+	} else if (sscanf (condition.c_str (), "=~ %1023s %1023[^\n]s", string_value, command) == 2) {
+		cond->operation = "=~";
+		cond->string_value = string_value;
+		cond->command = command;
+	/* Interval */
+	} else if (sscanf (condition.c_str (), "(%lf , %lf) %1023[^\n]s", &(cond->value_1), &(cond->value_2), command) == 3) {
+		cond->operation = "()";
+		cond->command = command;
+	} else {
+		return false;
+	}
+
+	return true;
+}
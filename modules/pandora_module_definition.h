@@ -0,0 +1,211 @@
+/* Parsing of module definitions.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_MODULE_DEFINITION_H__
+#define	__PANDORA_MODULE_DEFINITION_H__
+
+#include <string>
+#include <list>
+#include <vector>
+
+using namespace std;
+
+/* Module definition tokens. Tokens without separator (like module_macro)
+   are matched as prefixes */
+#define TOKEN_NAME          ("module_name ")
+#define TOKEN_TYPE          ("module_type ")
+#define TOKEN_INTERVAL      ("module_interval ")
+#define TOKEN_EXEC          ("module_exec ")
+#define TOKEN_PROC          ("module_proc ")
+#define TOKEN_SERVICE       ("module_service ")
+#define TOKEN_FREEDISK      ("module_freedisk ")
+#define TOKEN_FREEDISK_PERCENT      ("module_freepercentdisk ")
+#define TOKEN_FREEMEMORY    ("module_freememory")
+#define TOKEN_FREEMEMORY_PERCENT    ("module_freepercentmemory")
+#define TOKEN_CPUUSAGE      ("module_cpuusage ")
+#define TOKEN_INVENTORY     ("module_inventory")
+#define TOKEN_MAX           ("module_max ")
+#define TOKEN_MIN           ("module_min ")
+#define TOKEN_POST_PROCESS  ("module_postprocess ")
+#define TOKEN_MIN_CRITICAL  ("module_min_critical ")
+#define TOKEN_MAX_CRITICAL  ("module_max_critical ")
+#define TOKEN_MIN_WARNING   ("module_min_warning ")
+#define TOKEN_MAX_WARNING   ("module_max_warning ")
+#define TOKEN_DISABLED      ("module_disabled ")
+#define TOKEN_MIN_FF_EVENT  ("module_min_ff_event ")
+#define TOKEN_DESCRIPTION   ("module_description ")
+#define TOKEN_LOGEVENT      ("module_logevent")
+#define TOKEN_SOURCE        ("module_source ")
+#define TOKEN_EVENTTYPE     ("module_eventtype ")
+#define TOKEN_EVENTCODE     ("module_eventcode ")
+#define TOKEN_PATTERN       ("module_pattern ")
+#define TOKEN_APPLICATION   ("module_application ")
+#define TOKEN_ASYNC         ("module_async")
+#define TOKEN_WATCHDOG      ("module_watchdog ")
+#define TOKEN_START_COMMAND ("module_start_command ")
+#define TOKEN_WMIQUERY      ("module_wmiquery ")
+#define TOKEN_WMICOLUMN     ("module_wmicolumn ")
+#define TOKEN_RETRIES       ("module_retries ")
+#define TOKEN_STARTDELAY    ("module_startdelay ")
+#define TOKEN_RETRYDELAY    ("module_retrydelay ")
+#define TOKEN_PERFCOUNTER   ("module_perfcounter ")
+#define TOKEN_COOKED        ("module_cooked ")
+#define TOKEN_TCPCHECK      ("module_tcpcheck ")
+#define TOKEN_PORT          ("module_port ")
+#define TOKEN_TIMEOUT       ("module_timeout ")
+#define TOKEN_REGEXP        ("module_regexp ")
+#define TOKEN_REGEXP_REFRESH ("module_regexp_refresh ")
+#define TOKEN_REGEXP_MAX_FILES ("module_regexp_max_files ")
+#define TOKEN_PLUGIN        ("module_plugin ")
+#define TOKEN_SAVE          ("module_save ")
+#define TOKEN_CONDITION     ("module_condition ")
+#define TOKEN_CRONTAB       ("module_crontab ")
+#define TOKEN_CRONINTERVAL  ("module_cron_interval ")
+#define TOKEN_PRECONDITION  ("module_precondition ")
+#define TOKEN_NOSEEKEOF     ("module_noseekeof ")
+#define TOKEN_PING          ("module_ping ")
+#define TOKEN_PING_COUNT    ("module_ping_count ")
+#define TOKEN_PING_TIMEOUT  ("module_ping_timeout ")
+#define TOKEN_SNMPGET       ("module_snmpget")
+#define TOKEN_SNMPVERSION   ("module_snmp_version ")
+#define TOKEN_SNMPCOMMUNITY ("module_snmp_community ")
+#define TOKEN_SNMPAGENT     ("module_snmp_agent ")
+#define TOKEN_SNMPOID       ("module_snmp_oid ")
+#define TOKEN_ADVANCEDOPTIONS ("module_advanced_options ")
+#define TOKEN_INTENSIVECONDITION ("module_intensive_condition ")
+#define TOKEN_UNIT ("module_unit ")
+#define TOKEN_MODULE_GROUP ("module_group ")
+#define TOKEN_CUSTOM_ID ("module_custom_id ")
+#define TOKEN_STR_WARNING ("module_str_warning ")
+#define TOKEN_STR_CRITICAL ("module_str_critical ")
+#define TOKEN_CRITICAL_INSTRUCTIONS ("module_critical_instructions ")
+#define TOKEN_WARNING_INSTRUCTIONS ("module_warning_instructions ")
+#define TOKEN_UNKNOWN_INSTRUCTIONS ("module_unknown_instructions ")
+#define TOKEN_TAGS ("module_tags ")
+#define TOKEN_CRITICAL_INVERSE ("module_critical_inverse ")
+#define TOKEN_WARNING_INVERSE ("module_warning_inverse ")
+#define TOKEN_QUIET ("module_quiet ")
+#define TOKEN_MODULE_FF_INTERVAL ("module_ff_interval ")
+#define TOKEN_AGGREGATE ("module_aggregate ")
+#define TOKEN_DEPENDS ("module_depends ")
+#define TOKEN_MACRO ("module_macro")
+#define TOKEN_MAX_OUTPUT ("module_max_output ")
+#define TOKEN_MAX_LINES ("module_max_lines ")
+#define TOKEN_OUTPUT_TAIL ("module_output_tail ")
+#define TOKEN_PERSISTENT ("module_persistent ")
+
+namespace Pandora_Modules {
+
+	/**
+	 * Defines the type of the module.
+	 *
+	 * The type of a module is the value type the module can have.
+	 */
+	typedef enum {
+		TYPE_0,                  /**< Invalid value               */
+		TYPE_GENERIC_DATA,       /**< The value is an integer     */
+		TYPE_GENERIC_DATA_INC,   /**< The value is an integer with
+					  *  incremental diferences       */
+		TYPE_GENERIC_PROC,       /**< The value is a 0 or a 1     */
+		TYPE_GENERIC_DATA_STRING, /**< The value is a string       */
+		TYPE_ASYNC_DATA, /**< Asynchronous generic_data */
+		TYPE_ASYNC_PROC, /**< Asynchronous generic_proc */
+		TYPE_ASYNC_STRING, /**< Asynchronous generic_data_string */
+		TYPE_LOG /**< Log data */
+	} Module_Type;
+
+	const string module_generic_data_str        = "generic_data";
+	const string module_generic_data_inc_str    = "generic_data_inc";
+	const string module_generic_proc_str        = "generic_proc";
+	const string module_generic_data_string_str = "generic_data_string";
+	const string module_async_data_str          = "async_data";
+	const string module_async_proc_str          = "async_proc";
+	const string module_async_string_str        = "async_string";
+	const string module_log_str                 = "log";
+
+	/**
+	 * Defines the kind of the module.
+	 *
+	 * The kind of a module is the work the module does.
+	 */
+	typedef enum {
+		MODULE_0,         /**< Invalid kind                    */
+		MODULE_EXEC,      /**< The module run a custom command */
+		MODULE_PROC,      /**< The module checks for a running
+				   *   process                         */
+		MODULE_SERVICE,   /**< The module checks for a running
+				   *   service                         */
+		MODULE_FREEDISK,  /**< The module checks the free      */
+		MODULE_FREEDISK_PERCENT,  /**< The module checks the free      */
+		MODULE_CPUUSAGE,  /**< The module checks the CPU usage */
+		MODULE_INVENTORY, /**< The module gets the inventory of the machine */
+		MODULE_FREEMEMORY, /**< The module checks the percentage of 
+				   *   freememory in the system        */
+		MODULE_FREEMEMORY_PERCENT, /**< The module checks the amount of 
+				   *   freememory in the system        */
+		MODULE_LOGEVENT,       /**< The module checks for log events */	
+		MODULE_WMIQUERY,       /**< The module runs WQL queries */		
+		MODULE_PERFCOUNTER,    /**< The module reads performance counters */
+		MODULE_TCPCHECK,       /**< The module checks whether a tcp port is open */
+		MODULE_REGEXP,         /**< The module searches a file for matches of a regular expression */
+		MODULE_PLUGIN,          /**< Plugin */
+		MODULE_PING,            /**< Ping module */
+		MODULE_SNMPGET          /**< SNMP get module */
+	} Module_Kind;
+
+	/**
+	 * Defines the structure that holds module conditions.
+	 */
+	typedef struct {
+		double value_1;
+		double value_2;
+		string string_value;
+		string operation;
+		string command;
+		int pattern; /* Index in the module condition patterns, for =~ */
+	} Condition;
+
+	/**
+	 * Values of the tokens of a module definition.
+	 *
+	 * The lines are split into tokens with the sorted token table, and
+	 * the module_macro lines are applied to every value. This does not
+	 * depend on the Windows modules, so a definition can be checked
+	 * without creating its module.
+	 */
+	class Pandora_Module_Definition {
+	private:
+		vector<list<string> > values; /* Every value, by token index */
+	public:
+		Pandora_Module_Definition        (const string &definition,
+						  list<string> *errors);
+
+		string              getValue     (const char *token) const;
+		const list<string> &getValues    (const char *token) const;
+		bool                isEnabled    (const char *token) const;
+		Module_Kind         getKind      () const;
+
+		static bool         isEnabled      (const string &value);
+		static Module_Type  parseType      (const string &type);
+		static bool         parseCondition (const string &condition,
+						    bool intensive, Condition *cond);
+	};
+}
+
+#endif /* __PANDORA_MODULE_DEFINITION_H__ */
@@ -20,14 +20,19 @@
 
 #include "pandora_module_exec.h"
 #include "../pandora_strutils.h"
+#include "../misc/pandora_exec_worker.h"
+#include "../misc/pandora_output_buffer.h"
+#include "../misc/pandora_process_runner.h"
 #include <windows.h> 
-
-#define BUFSIZE 4096 
+#include <cctype>
 
 using namespace Pandora;
 using namespace Pandora_Strutils;
 using namespace Pandora_Modules;
 
+/* Appended (or prepended, when the end is kept) to truncated output */
+#define TRUNCATION_MARKER "[output truncated]"
+
 /** 
  * Creates a Pandora_Module_Exec object.
  * 
@@ -37,152 +42,188 @@ using namespace Pandora_Modules;
 Pandora_Module_Exec::Pandora_Module_Exec (string name, string exec)
 					 : Pandora_Module (name) {
 	this->module_exec = "cmd.exe /c \"" + exec + "\"";
+	this->module_command = exec;
 	this->proc = 0;
+	this->max_output = 0;
+	this->max_lines = 0;
+	this->keep_last = false;
 	this->setKind (module_exec_str);
 }
 
+/** 
+ * Limit the output kept from the command.
+ *
+ * The limits are enforced while the output is read, so a command
+ * that writes too much does not grow the agent memory.
+ *
+ * @param max_output Bytes, 0 for no limit.
+ * @param max_lines Lines, 0 for no limit.
+ * @param keep_last Keep the end of the output instead of the
+ *        beginning, for log-like commands.
+ */
 void
-Pandora_Module_Exec::run () {
-	STARTUPINFO         si;
-	PROCESS_INFORMATION pi;
-	DWORD               retval, dwRet;
-	SECURITY_ATTRIBUTES attributes;
-	HANDLE              out, new_stdout, out_read, job;
-	string              working_dir;
+Pandora_Module_Exec::setOutputLimits (size_t max_output, size_t max_lines, bool keep_last) {
+	this->max_output = max_output;
+	this->max_lines = max_lines;
+	this->keep_last = keep_last;
+}
 
-	try {
-		Pandora_Module::run ();
-	} catch (Interval_Not_Fulfilled e) {
-		this->has_output = false;
-		return;
+/** 
+ * Apply the output limits to a buffer the output is read into.
+ *
+ * @param output Buffer for the output of the command.
+ */
+void
+Pandora_Module_Exec::limitOutput (Pandora_Output_Buffer &output) {
+	output.setLimits (this->max_output, this->max_lines, this->keep_last);
+}
+
+/** 
+ * Cut a truncated plugin output to its complete module elements.
+ *
+ * @param output Plugin XML, cut in place.
+ * @param keep_last Whether the end of the output was kept, so the
+ *        beginning is the broken part.
+ *
+ * @return False if no complete module element is left.
+ */
+static bool
+cutPluginOutput (string &output, bool keep_last) {
+	size_t begin = 0, end, pos;
+
+	/* The first element kept starts after the cut */
+	if (keep_last) {
+		for (begin = output.find ("<module"); begin != string::npos;
+		     begin = output.find ("<module", begin + 1)) {
+			pos = begin + 7;
+			if (pos < output.size () && (output[pos] == '>' || isspace ((unsigned char) output[pos]))) {
+				break;
+			}
+		}
+		if (begin == string::npos) {
+			return false;
+		}
 	}
 
-	/* Set the bInheritHandle flag so pipe handles are inherited. */
-	attributes.nLength = sizeof (SECURITY_ATTRIBUTES); 
-	attributes.bInheritHandle = TRUE; 
-	attributes.lpSecurityDescriptor = NULL; 
-
-	/* Create a job to kill the child tree if it become zombie */
-	/* CAUTION: In order to compile this, WINVER should be defined to 0x0500.
-	   This may need no change, since it was redefined by the 
-	   program, but if needed, the macro is defined 
-	   in <windef.h> */
-	job = CreateJobObject (&attributes, this->module_name.c_str ());
-	if (job == NULL) {
-		pandoraLog ("CreateJobObject bad. Err: %d", GetLastError ());
-		this->has_output = false;
-		return;
+	end = output.rfind ("</module>");
+	if (end == string::npos || end < begin) {
+		return false;
 	}
 
-	/* Get the handle to the current STDOUT. */
-	out = GetStdHandle (STD_OUTPUT_HANDLE); 
+	output = output.substr (begin, end + 9 - begin);
+	return true;
+}
 
-	if (! CreatePipe (&out_read, &new_stdout, &attributes, 0)) {
-		pandoraLog ("CreatePipe failed. Err: %d", GetLastError ());
+/** 
+ * Set the module output from the result of the command.
+ *
+ * @param output Output of the command.
+ * @param truncated Whether the output exceeded the limits.
+ * @param retval Exit code of the command, STILL_ACTIVE if it timed out.
+ */
+void
+Pandora_Module_Exec::setResult (string output, bool truncated, unsigned long retval) {
+	if (retval != 0) {
+		if (retval != STILL_ACTIVE && this->proc == 0) {
+			pandoraLog ("Pandora_Module_Exec: %s did not executed well (retcode: %d)",
+			this->module_name.c_str (), retval);
+		}
 		this->has_output = false;
+	}
 
-		CloseHandle (job);
-		return;
+	// Proc mode
+	if (this->proc == 1) {
+		if (retval == 0) {
+			this->setOutput ("1");
+		} else {
+			this->setOutput ("0");
+			this->has_output = true;
+		}
 	}
+	// Command output mode
+	else if (!output.empty()) {
+		if (truncated) {
+			pandoraDebug ("Pandora_Module_Exec: %s output truncated", this->module_name.c_str ());
+
+			/* A marker would break the XML of plugins, which
+			   keep their complete modules only */
+			if (this->getModuleKind () != MODULE_PLUGIN) {
+				output = this->keep_last ? TRUNCATION_MARKER "\n" + output
+							 : output + "\n" TRUNCATION_MARKER;
+			} else if (! cutPluginOutput (output, this->keep_last)) {
+				pandoraLog ("Pandora_Module_Exec: %s output exceeds the limits without a complete module, discarded",
+					    this->module_name.c_str ());
+				this->has_output = false;
+				return;
+			}
+		}
 
-	/* Ensure the read handle to the pipe for STDOUT is not inherited */
-	SetHandleInformation (out_read, HANDLE_FLAG_INHERIT, 0);
+		this->setOutput (output);
+	} else {
+		this->setOutput ("");
+	}
+}
+
+void
+Pandora_Module_Exec::run () {
+	Pandora_Exec_Worker *worker;
+	Pandora_Output_Buffer output;
+	int                 result, status;
 
-	/* Set up members of the STARTUPINFO structure. */
-	ZeroMemory (&si, sizeof (si));
-	GetStartupInfo (&si);
+	try {
+		Pandora_Module::run ();
+	} catch (Interval_Not_Fulfilled e) {
+		this->has_output = false;
+		return;
+	}
 
-	si.cb = sizeof (si);
-	si.dwFlags     = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-	si.wShowWindow = SW_HIDE;
-	si.hStdError   = new_stdout;
-	si.hStdOutput  = new_stdout;
+	/* Run the command in the persistent shell, if enabled. Commands
+	   that need variables saved by other modules get their own process */
+	worker = Pandora_Exec_Worker::getInstance ();
+	if (worker->isEnabled () && this->getDependencies ()->empty ()) {
+		pandoraDebug ("Executing in worker: %s", this->module_command.c_str ());
+		this->limitOutput (output);
+
+		/* The shell is restarted if the variables or PATH changed */
+		worker->setEnvironment (this->getEnvironment ());
+		result = worker->execute (this->module_command, this->getTimeout (), output, status);
+		if (result == WORKER_OK) {
+			this->setResult (output.getData (), output.isTruncated (), status);
+			return;
+		} else if (result == WORKER_TIMEOUT) {
+			pandoraLog ("Pandora_Module_Exec: %s timed out, restarting the worker (%lu restarts)",
+				    this->module_name.c_str (), worker->getRestarts ());
+			this->setResult ("", false, STILL_ACTIVE);
+			return;
+		} else if (result == WORKER_FAILED) {
+			pandoraLog ("Pandora_Module_Exec: %s made the worker exit, restarting it (%lu restarts)",
+				    this->module_name.c_str (), worker->getRestarts ());
+			this->setResult ("", false, status);
+			return;
+		}
+		pandoraDebug ("Pandora_Module_Exec: %s could not run in the worker", this->module_name.c_str ());
+	}
 
-	/* Set up members of the PROCESS_INFORMATION structure. */
-	ZeroMemory (&pi, sizeof (pi));
 	pandoraDebug ("Executing: %s", this->module_exec.c_str ());
 
-	/* Set the working directory of the process. It's "utils" directory
-	   to find the GNU W32 tools */
-	working_dir = getPandoraInstallDir () + "util\\";
-
-	/* Create the child process. */
-	if (! CreateProcess (NULL, (CHAR *) this->module_exec.c_str (), NULL,
-			     NULL, TRUE, CREATE_SUSPENDED | CREATE_NO_WINDOW, NULL,
-			     working_dir.c_str (), &si, &pi)) {
+	/* The working directory is "util", to find the GNU W32 tools */
+	Pandora_Process_Runner runner (this->module_exec);
+	runner.setWorkingDir (getPandoraInstallDir () + "util\\");
+	runner.setEnvironment (this->getEnvironment ());
+	runner.setTimeout (this->getTimeout ());
+	runner.setMaxOutput (this->max_output);
+	runner.setMaxLines (this->max_lines);
+	runner.setKeepLast (this->keep_last);
+
+	result = runner.run ();
+	if (result == RUNNER_ERROR) {
 		pandoraLog ("Pandora_Module_Exec: %s CreateProcess failed. Err: %d",
 			    this->module_name.c_str (), GetLastError ());
 		this->has_output = false;
-
-		/* Close job */
-		CloseHandle (job);
-	} else {
-		char          buffer[BUFSIZE + 1];
-		unsigned long read, avail;
-	
-		if (! AssignProcessToJobObject (job, pi.hProcess)) {
-			pandoraLog ("Could not assigned proccess to job (error %d)",
-				    GetLastError ());
-		}
-		ResumeThread (pi.hThread);
-	
-		string output;
-		int tickbase = GetTickCount();
-		while ( (dwRet = WaitForSingleObject (pi.hProcess, 500)) != WAIT_ABANDONED ) {
-			PeekNamedPipe (out_read, buffer, BUFSIZE, &read, &avail, NULL);
-			if (avail > 0) {
-				ReadFile (out_read, buffer, BUFSIZE, &read, NULL);
-				buffer[read] = '\0';
-				output += (char *) buffer;
-			}
-
-			if (dwRet == WAIT_OBJECT_0) { 
-				break;
-			} else if(this->getTimeout() < GetTickCount() - tickbase) {
-				/* STILL_ACTIVE */
-				TerminateProcess(pi.hProcess, STILL_ACTIVE);
-				pandoraLog ("Pandora_Module_Exec: %s timed out (retcode: %d)", this->module_name.c_str (), STILL_ACTIVE);
-				break;
-			}
-		}
-
-		GetExitCodeProcess (pi.hProcess, &retval);
-
-		if (retval != 0) {
-			if (! TerminateJobObject (job, 0)) {
-				pandoraLog ("TerminateJobObject failed. (error %d)",
-					    GetLastError ());
-			}
-			if (retval != STILL_ACTIVE && this->proc == 0) {
-				pandoraLog ("Pandora_Module_Exec: %s did not executed well (retcode: %d)",
-				this->module_name.c_str (), retval);
-			}
-			this->has_output = false;
-		}
-
-		// Proc mode
-		if (this->proc == 1) {
-			if (retval == 0) {
-				this->setOutput ("1");
-			} else {
-				this->setOutput ("0");
-				this->has_output = true;
-			}
-		}
-		// Command output mode
-		else if (!output.empty()) {
-			this->setOutput (output);
-		} else {
-			this->setOutput ("");
-		}
-	
-		/* Close job, process and thread handles. */
-		CloseHandle (job);
-		CloseHandle (pi.hProcess);
-		CloseHandle (pi.hThread);
+		return;
+	} else if (result == RUNNER_TIMEOUT) {
+		pandoraLog ("Pandora_Module_Exec: %s timed out (retcode: %d)", this->module_name.c_str (), STILL_ACTIVE);
 	}
 
-	CloseHandle (new_stdout);
-	CloseHandle (out_read);
+	this->setResult (runner.getOutput (), runner.isTruncated (), runner.getExitCode ());
 }
-
@@ -22,6 +22,7 @@
 #define	__PANDORA_MODULE_EXEC_H__
 
 #include "pandora_module.h"
+#include "../misc/pandora_output_buffer.h"
 
 namespace Pandora_Modules {
 	/**
@@ -33,11 +34,20 @@ namespace Pandora_Modules {
 	 */
 	class Pandora_Module_Exec : public Pandora_Module {
 	private:
+		size_t max_output;
+		size_t max_lines;
+		bool   keep_last;
+	protected:
 		string module_exec;        
+		string module_command;
+
+		void   limitOutput (Pandora_Output_Buffer &output);
+		void   setResult (string output, bool truncated, unsigned long retval);
 	public:
 		unsigned char proc;
 		Pandora_Module_Exec    (string name, string exec);
 		
+		void   setOutputLimits (size_t max_output, size_t max_lines, bool keep_last);
 		void   run       ();
 	};
 }
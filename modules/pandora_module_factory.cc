@@ -39,100 +39,45 @@
 #include "pandora_module_ping.h"
 #include "pandora_module_snmpget.h"
 #include "../pandora_strutils.h"
+#include "../misc/pandora_variables.h"
+#include "pandora_module_definition.h"
 #include <list>
 
 using namespace Pandora;
 using namespace Pandora_Modules;
 using namespace Pandora_Strutils;
 
-#define TOKEN_NAME          ("module_name ")
-#define TOKEN_TYPE          ("module_type ")
-#define TOKEN_INTERVAL      ("module_interval ")
-#define TOKEN_EXEC          ("module_exec ")
-#define TOKEN_PROC          ("module_proc ")
-#define TOKEN_SERVICE       ("module_service ")
-#define TOKEN_FREEDISK      ("module_freedisk ")
-#define TOKEN_FREEDISK_PERCENT      ("module_freepercentdisk ")
-#define TOKEN_FREEMEMORY    ("module_freememory")
-#define TOKEN_FREEMEMORY_PERCENT    ("module_freepercentmemory")
-#define TOKEN_CPUUSAGE      ("module_cpuusage ")
-#define TOKEN_INVENTORY     ("module_inventory")
-#define TOKEN_MAX           ("module_max ")
-#define TOKEN_MIN           ("module_min ")
-#define TOKEN_POST_PROCESS  ("module_postprocess ")
-#define TOKEN_MIN_CRITICAL  ("module_min_critical ")
-#define TOKEN_MAX_CRITICAL  ("module_max_critical ")
-#define TOKEN_MIN_WARNING   ("module_min_warning ")
-#define TOKEN_MAX_WARNING   ("module_max_warning ")
-#define TOKEN_DISABLED      ("module_disabled ")
-#define TOKEN_MIN_FF_EVENT  ("module_min_ff_event ")
-#define TOKEN_DESCRIPTION   ("module_description ")
-#define TOKEN_LOGEVENT      ("module_logevent")
-#define TOKEN_SOURCE        ("module_source ")
-#define TOKEN_EVENTTYPE     ("module_eventtype ")
-#define TOKEN_EVENTCODE     ("module_eventcode ")
-#define TOKEN_PATTERN       ("module_pattern ")
-#define TOKEN_APPLICATION   ("module_application ")
-#define TOKEN_ASYNC         ("module_async")
-#define TOKEN_WATCHDOG      ("module_watchdog ")
-#define TOKEN_START_COMMAND ("module_start_command ")
-#define TOKEN_WMIQUERY      ("module_wmiquery ")
-#define TOKEN_WMICOLUMN     ("module_wmicolumn ")
-#define TOKEN_RETRIES       ("module_retries ")
-#define TOKEN_STARTDELAY    ("module_startdelay ")
-#define TOKEN_RETRYDELAY    ("module_retrydelay ")
-#define TOKEN_PERFCOUNTER   ("module_perfcounter ")
-#define TOKEN_COOKED        ("module_cooked ")
-#define TOKEN_TCPCHECK      ("module_tcpcheck ")
-#define TOKEN_PORT          ("module_port ")
-#define TOKEN_TIMEOUT       ("module_timeout ")
-#define TOKEN_REGEXP        ("module_regexp ")
-#define TOKEN_PLUGIN        ("module_plugin ")
-#define TOKEN_SAVE          ("module_save ")
-#define TOKEN_CONDITION     ("module_condition ")
-#define TOKEN_CRONTAB       ("module_crontab ")
-#define TOKEN_CRONINTERVAL  ("module_cron_interval ")
-#define TOKEN_PRECONDITION  ("module_precondition ")
-#define TOKEN_NOSEEKEOF     ("module_noseekeof ")
-#define TOKEN_PING          ("module_ping ")
-#define TOKEN_PING_COUNT    ("module_ping_count ")
-#define TOKEN_PING_TIMEOUT  ("module_ping_timeout ")
-#define TOKEN_SNMPGET       ("module_snmpget")
-#define TOKEN_SNMPVERSION   ("module_snmp_version ")
-#define TOKEN_SNMPCOMMUNITY ("module_snmp_community ")
-#define TOKEN_SNMPAGENT     ("module_snmp_agent ")
-#define TOKEN_SNMPOID       ("module_snmp_oid ")
-#define TOKEN_ADVANCEDOPTIONS ("module_advanced_options ")
-#define TOKEN_INTENSIVECONDITION ("module_intensive_condition ")
-#define TOKEN_UNIT ("module_unit ")
-#define TOKEN_MODULE_GROUP ("module_group ")
-#define TOKEN_CUSTOM_ID ("module_custom_id ")
-#define TOKEN_STR_WARNING ("module_str_warning ")
-#define TOKEN_STR_CRITICAL ("module_str_critical ")
-#define TOKEN_CRITICAL_INSTRUCTIONS ("module_critical_instructions ")
-#define TOKEN_WARNING_INSTRUCTIONS ("module_warning_instructions ")
-#define TOKEN_UNKNOWN_INSTRUCTIONS ("module_unknown_instructions ")
-#define TOKEN_TAGS ("module_tags ")
-#define TOKEN_CRITICAL_INVERSE ("module_critical_inverse ")
-#define TOKEN_WARNING_INVERSE ("module_warning_inverse ")
-#define TOKEN_QUIET ("module_quiet ")
-#define TOKEN_MODULE_FF_INTERVAL ("module_ff_interval ")
-#define TOKEN_MACRO ("module_macro")
-	
-string
-parseLine (string line, string token) {
-	int pos;
-	string retstr = "";
-	
-	pos = line.find (token);
-	if (pos == 0) {
-		retstr = line.substr (token.length ());
-		if (retstr == "") {
-			retstr = " ";
+/**
+ * Set the output limits of a module that runs a command.
+ *
+ * @param module The module.
+ * @param max_output Value of module_max_output, in bytes.
+ * @param max_lines Value of module_max_lines.
+ * @param output_tail Value of module_output_tail.
+ */
+static void
+setOutputLimits (Pandora_Module_Exec *module, string max_output,
+		 string max_lines, string output_tail) {
+	int bytes = 0, lines = 0;
+
+	try {
+		if (max_output != "") {
+			bytes = strtoint (max_output);
+		}
+		if (max_lines != "") {
+			lines = strtoint (max_lines);
 		}
+	} catch (Invalid_Conversion e) {
+		bytes = lines = -1;
 	}
 
-	return retstr;
+	if (bytes < 0 || lines < 0) {
+		pandoraLog ("Invalid output limit in module \"%s\"",
+			    module->getName ().c_str ());
+		return;
+	}
+
+	module->setOutputLimits (bytes, lines, is_enabled (output_tail));
 }
 
 /** 
@@ -145,8 +90,22 @@ parseLine (string line, string token) {
  */
 Pandora_Module *
 Pandora_Module_Factory::getModuleFromDefinition (string definition) {
-	list<string>           tokens;
-	list<string>::iterator iter;
+	return getModuleFromDefinition (definition, NULL);
+}
+
+/** 
+ * Creates a Pandora_Module object based on a string definition,
+ * reporting the problems found in it.
+ *
+ * @param definition Module definition readed from the configuration file.
+ * @param errors Where the unknown lines and the invalid conditions are
+ *        appended. May be NULL.
+ * 
+ * @return A new Pandora_Module object. NULL if the definition is
+ *         incorrect.
+ */
+Pandora_Module *
+Pandora_Module_Factory::getModuleFromDefinition (string definition, list<string> *errors) {
 	string                 module_name, module_type, module_exec;
 	string                 module_min, module_max, module_description;
 	string                 module_interval, module_proc, module_service;
@@ -160,913 +119,128 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 	string                 module_retries, module_startdelay, module_retrydelay;
 	string                 module_perfcounter, module_tcpcheck;
 	string                 module_port, module_timeout, module_regexp;
-	string                 module_plugin, module_save, module_condition, module_precondition;
+	string                 module_plugin, module_save;
 	string                 module_crontab, module_cron_interval, module_post_process;
 	string                 module_min_critical, module_max_critical, module_min_warning, module_max_warning;
 	string                 module_disabled, module_min_ff_event, module_noseekeof;
 	string                 module_ping, module_ping_count, module_ping_timeout;
 	string                 module_snmpget, module_snmp_version, module_snmp_community, module_snmp_agent, module_snmp_oid;
-	string                 module_advanced_options, module_cooked, module_intensive_condition;
+	string                 module_advanced_options, module_cooked;
 	string                 module_unit, module_group, module_custom_id, module_str_warning, module_str_critical;
 	string                 module_critical_instructions, module_warning_instructions, module_unknown_instructions, module_tags;
 	string                 module_critical_inverse, module_warning_inverse, module_quiet, module_ff_interval;
-	string                 macro;
+	string                 module_aggregate, module_depends;
+	string                 module_max_output, module_max_lines, module_output_tail;
+	string                 module_persistent;
+	string                 module_regexp_refresh, module_regexp_max_files;
 	Pandora_Module        *module;
+	Module_Metadata        metadata;
 	bool                   numeric;
 	Module_Type            type;
 	long                    agent_interval;
-	list<string>           macro_list;
-	list<string>::iterator macro_iter;
 	list<string>           condition_list, precondition_list, intensive_condition_list;
 	list<string>::iterator condition_iter, precondition_iter, intensive_condition_iter;
+	list<string>           dependency_list;
+	list<string>::iterator dependency_iter;
 	Pandora_Windows_Service *service = NULL;
 
-	module_name          = "";
-	module_type          = "";
-	module_min           = "";
-	module_max           = "";
-	module_description   = "";
-	module_interval      = "";
-	module_exec          = "";
-	module_proc          = "";
-	module_service       = "";
-	module_logevent      = "";
-	module_source        = "";
-	module_eventtype     = "";
-	module_eventcode     = "";
-	module_pattern       = "";
-	module_application   = "";
-	module_async         = "";
-	module_watchdog      = "";
-	module_start_command = "";
-	module_wmiquery      = "";
-	module_wmicolumn     = "";
-	module_retries       = "";
-	module_startdelay    = "";
-	module_retrydelay    = "";
-	module_perfcounter   = "";
-	module_tcpcheck      = "";
-	module_port          = "";
-	module_timeout       = "";
-	module_regexp        = "";
-	module_plugin        = "";
-	module_save          = "";
-	module_condition     = "";
-	module_crontab       = "";
-	module_cron_interval = "";
-	module_post_process  = "";
-	module_precondition  = "";
-	module_min_critical  = "";
-	module_max_critical  = "";
-	module_min_warning   = "";
-	module_max_warning   = "";
-	module_disabled      = "";
-	module_min_ff_event  = "";
-	module_noseekeof     = "";
-	module_ping          = "";
-	module_ping_count    = "";
-	module_ping_timeout  = "";
-	module_snmpget       = "";
-    module_snmp_version  = "";
-    module_snmp_community = "";
-    module_snmp_agent    = "";
-    module_snmp_oid      = "";
-    module_advanced_options = "";
-    module_cooked        = "";
-    module_intensive_condition = "";
-	module_unit          = "";
-	module_group         = "";
-	module_custom_id     = "";
-	module_str_warning   = "";
-	module_str_critical  = "";
-	module_critical_instructions = "";
-	module_warning_instructions = "";
-	module_unknown_instructions = "";
-	module_tags          = "";
-	module_critical_inverse = "";
-	module_warning_inverse = "";
-	module_quiet         = "";
-	module_ff_interval   = "";
-	macro   = "";
-    
-	stringtok (tokens, definition, "\n");
-	
-	/* Pick the first and the last value of the token list */
-	iter = tokens.begin ();
-	while (iter != tokens.end()) {
-		string line;
-		
-		line = trim (*iter);
-
-		if (module_name == "") {
-			module_name = parseLine (line, TOKEN_NAME);
-		}
-		if (module_type == "") {
-			module_type = parseLine (line, TOKEN_TYPE);
-		}
-		if (module_precondition == "") {
-			module_precondition = parseLine (line, TOKEN_PRECONDITION);
-			
-			/* Queue the precondition and keep looking for more */
-			if (module_precondition != "") {
-				precondition_list.push_back (module_precondition);
-				module_precondition = "";
-			}
-		}
-		if (module_interval == "") {
-			module_interval = parseLine (line, TOKEN_INTERVAL);
-		}
-		if (module_exec == "") {
-			module_exec = parseLine (line, TOKEN_EXEC);
-		}
-		if (module_proc == "") {
-			module_proc = parseLine (line, TOKEN_PROC);
-		}
-		if (module_service == "") {
-			module_service = parseLine (line, TOKEN_SERVICE);
-		}
-		if (module_freedisk == "") {
-			module_freedisk = parseLine (line, TOKEN_FREEDISK);
-		}
-		if (module_freedisk_percent == "") {
-			module_freedisk_percent = parseLine (line, TOKEN_FREEDISK_PERCENT);
-		}
-		if (module_freememory == "") {
-			module_freememory = parseLine (line, TOKEN_FREEMEMORY);
-		}
-		if (module_freememory_percent == "") {
-			module_freememory_percent = parseLine (line, TOKEN_FREEMEMORY_PERCENT);
-		}
-		if (module_cpuusage == "") {
-			module_cpuusage = parseLine (line, TOKEN_CPUUSAGE);
-		}
-		if (module_inventory == "") {
-			module_inventory = parseLine (line, TOKEN_INVENTORY);
-		}
-		if (module_max == "") {
-			module_max = parseLine (line, TOKEN_MAX);
-		}
-		if (module_min == "") {
-			module_min = parseLine (line, TOKEN_MIN);
-		}
-		if (module_post_process == "") {
-			module_post_process = parseLine (line, TOKEN_POST_PROCESS);
-		}
-		if (module_min_critical == "") {
-			module_min_critical = parseLine (line, TOKEN_MIN_CRITICAL);
-		}
-		if (module_max_critical == "") {
-			module_max_critical = parseLine (line, TOKEN_MAX_CRITICAL);
-		}
-		if (module_min_warning == "") {
-			module_min_warning = parseLine (line, TOKEN_MIN_WARNING);
-		}
-		if (module_max_warning == "") {
-			module_max_warning = parseLine (line, TOKEN_MAX_WARNING);
-		}
-		if (module_disabled == "") {
-			module_disabled = parseLine (line, TOKEN_DISABLED);
-		}
-		if (module_min_ff_event == "") {
-			module_min_ff_event = parseLine (line, TOKEN_MIN_FF_EVENT);
-		}
-		if (module_description == "") {
-			module_description = parseLine (line, TOKEN_DESCRIPTION);
-		}
-		if (module_logevent == "") {
-			module_logevent = parseLine (line, TOKEN_LOGEVENT);
-		}
-		if (module_source == "") {
-			module_source = parseLine (line, TOKEN_SOURCE);
-		}
-		if (module_eventtype == "") {
-			module_eventtype = parseLine (line, TOKEN_EVENTTYPE);
-		}
-		if (module_eventcode == "") {
-			module_eventcode = parseLine (line, TOKEN_EVENTCODE);
-		}
-		if (module_pattern == "") {
-			module_pattern = parseLine (line, TOKEN_PATTERN);
-		}
-		if (module_application == "") {
-			module_application = parseLine (line, TOKEN_APPLICATION);
-		}
-		if (module_async == "") {
-			module_async = parseLine (line, TOKEN_ASYNC);
-		}
-		if (module_start_command == "") {
-			module_start_command = parseLine (line, TOKEN_START_COMMAND);
-		}
-		if (module_watchdog == "") {
-			module_watchdog = parseLine (line, TOKEN_WATCHDOG);
-		}
-		if (module_wmiquery == "") {
-			module_wmiquery = parseLine (line, TOKEN_WMIQUERY);
-		}
-		if (module_wmicolumn == "") {
-			module_wmicolumn = parseLine (line, TOKEN_WMICOLUMN);
-		}
-		if (module_retries == "") {
-			module_retries = parseLine (line, TOKEN_RETRIES);
-		}
-		if (module_startdelay == "") {
-			module_startdelay = parseLine (line, TOKEN_STARTDELAY);
-		}
-		if (module_retrydelay == "") {
-			module_retrydelay = parseLine (line, TOKEN_RETRYDELAY);
-		}
-		if (module_perfcounter == "") {
-			module_perfcounter = parseLine (line, TOKEN_PERFCOUNTER);
-		}
-		if (module_tcpcheck == "") {
-			module_tcpcheck = parseLine (line, TOKEN_TCPCHECK);
-		}
-		if (module_port == "") {
-			module_port = parseLine (line, TOKEN_PORT);
-		}
-		if (module_timeout == "") {
-			module_timeout = parseLine (line, TOKEN_TIMEOUT);
-		}
-		if (module_regexp == "") {
-			module_regexp = parseLine (line, TOKEN_REGEXP);
-		}
-		if (module_plugin == "") {
-			module_plugin = parseLine (line, TOKEN_PLUGIN);
-		}
-		if (module_save == "") {
-			module_save = parseLine (line, TOKEN_SAVE);
-		}
-		if (module_condition == "") {
-			module_condition = parseLine (line, TOKEN_CONDITION);
-			
-			/* Queue the condition and keep looking for more */
-			if (module_condition != "") {
-				condition_list.push_back (module_condition);
-				module_condition = "";
-			}
-		}
-		if (module_crontab == "") {
-			module_crontab = parseLine (line, TOKEN_CRONTAB);
-		}
-		if (module_cron_interval == "") {
-			module_cron_interval = parseLine (line, TOKEN_CRONINTERVAL);
-		}
-		if (module_noseekeof == "") {
-			module_noseekeof = parseLine (line, TOKEN_NOSEEKEOF);
-		}
-		if (module_ping == "") {
-			module_ping = parseLine (line, TOKEN_PING);
-		}
-		if (module_ping_count == "") {
-			module_ping_count = parseLine (line, TOKEN_PING_COUNT);
-		}
-		if (module_ping_timeout == "") {
-			module_ping_timeout = parseLine (line, TOKEN_PING_TIMEOUT);
-		}
-		if (module_snmpget == "") {
-			module_snmpget = parseLine (line, TOKEN_SNMPGET);
-		}
-		if (module_snmp_version == "") {
-			module_snmp_version = parseLine (line, TOKEN_SNMPVERSION);
-		}
-		if (module_snmp_community == "") {
-			module_snmp_community = parseLine (line, TOKEN_SNMPCOMMUNITY);
-		}
-		if (module_snmp_agent == "") {
-			module_snmp_agent = parseLine (line, TOKEN_SNMPAGENT);
-		}
-		if (module_snmp_oid == "") {
-			module_snmp_oid = parseLine (line, TOKEN_SNMPOID);
-		}
-		if (module_advanced_options == "") {
-			module_advanced_options = parseLine (line, TOKEN_ADVANCEDOPTIONS);
-		}
-		if (module_cooked == "") {
-			module_cooked = parseLine (line, TOKEN_COOKED);
-		}
-		if (module_intensive_condition == "") {
-			module_intensive_condition = parseLine (line, TOKEN_INTENSIVECONDITION);
-
-			/* Queue the condition and keep looking for more */
-			if (module_intensive_condition != "") {
-				intensive_condition_list.push_back (module_intensive_condition);
-				module_intensive_condition = "";
-			}
-		}
-		if (module_unit == "") {
-			module_unit = parseLine (line, TOKEN_UNIT);
-		}
-		if (module_group == "") {
-			module_group = parseLine (line, TOKEN_MODULE_GROUP);
-		}
-		if (module_custom_id == "") {
-			module_custom_id = parseLine (line, TOKEN_CUSTOM_ID);
-		}
-		if (module_str_warning == "") {
-			module_str_warning = parseLine (line, TOKEN_STR_WARNING);
-		}
-		if (module_str_critical == "") {
-			module_str_critical = parseLine (line, TOKEN_STR_CRITICAL);
-		}
-		if (module_critical_instructions == "") {
-			module_critical_instructions = parseLine (line, TOKEN_CRITICAL_INSTRUCTIONS);
-		}
-		if (module_warning_instructions == "") {
-			module_warning_instructions = parseLine (line, TOKEN_WARNING_INSTRUCTIONS);
-		}
-		if (module_unknown_instructions == "") {
-			module_unknown_instructions = parseLine (line, TOKEN_UNKNOWN_INSTRUCTIONS);
-		}
-		if (module_tags == "") {
-			module_tags = parseLine (line, TOKEN_TAGS);
-		}
-		if (module_critical_inverse == "") {
-			module_critical_inverse = parseLine (line, TOKEN_CRITICAL_INVERSE);
-		}
-		if (module_warning_inverse == "") {
-			module_warning_inverse = parseLine (line, TOKEN_WARNING_INVERSE);
-		}
-		if (module_quiet == "") {
-			module_quiet = parseLine (line, TOKEN_QUIET);
-		}
-		if (module_ff_interval == "") {
-			module_ff_interval = parseLine (line, TOKEN_MODULE_FF_INTERVAL);
-		}
-		if (macro == "") {
-			macro = parseLine (line, TOKEN_MACRO);
-			
-			/* Queue the macro and keep looking for more */
-			if (macro != "") {
-				macro_list.push_back (macro);
-				macro = "";
-			}
-		}
-	
-		iter++;
-	}
-	
-	/* Subst macros */
-	int pos, pos_macro;
-	string macro_name, macro_value;
-	
-	if (macro_list.size () > 0) {
-		macro_iter = macro_list.begin ();
-		for (macro_iter = macro_list.begin ();
-		     macro_iter != macro_list.end ();
-		     macro_iter++) {
-				
-			macro_name = *macro_iter;
-			
-			// At this point macro_name is "macro_name macro_value"
-			pos = macro_name.find (" ");
-			if(pos != string::npos) {
-				// Split name of the macro y value
-				macro_value = macro_name.substr (pos + 1);
-				macro_name.erase(pos, macro_name.size () - pos);
-				
-				// Replace macros
-				if (module_name != "") {
-					pos_macro = module_name.find(macro_name);
-					if (pos_macro != string::npos){
-						module_name.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_type != "") {
-					pos_macro = module_type.find(macro_name);
-					if (pos_macro != string::npos){
-						module_type.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (precondition_list.size () > 0) {
-					precondition_iter = precondition_list.begin ();
-					for (precondition_iter = precondition_list.begin ();
-					     precondition_iter != precondition_list.end ();
-					     precondition_iter++) {
-
-						pos_macro = precondition_iter->find(macro_name);
-						if (pos_macro != string::npos){
-							precondition_iter->replace(pos_macro, macro_name.size(), macro_value);
-						}
-
-					}
-				}
-
-				if (module_precondition != "") {
-					pos_macro = module_precondition.find(macro_name);
-					if (pos_macro != string::npos){
-						module_precondition.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_interval != "") {
-					pos_macro = module_interval.find(macro_name);
-					if (pos_macro != string::npos){
-						module_interval.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_exec != "") {
-					pos_macro = module_exec.find(macro_name);
-					if (pos_macro != string::npos){
-						module_exec.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_proc != "") {
-					pos_macro = module_proc.find(macro_name);
-					if (pos_macro != string::npos){
-						module_proc.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_service != "") {
-					pos_macro = module_service.find(macro_name);
-					if (pos_macro != string::npos){
-						module_service.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_freedisk != "") {
-					pos_macro = module_freedisk.find(macro_name);
-					if (pos_macro != string::npos){
-						module_freedisk.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_freedisk_percent != "") {
-					pos_macro = module_freedisk_percent.find(macro_name);
-					if (pos_macro != string::npos){
-						module_freedisk_percent.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_freememory != "") {
-					pos_macro = module_freememory.find(macro_name);
-					if (pos_macro != string::npos){
-						module_freememory.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_freememory_percent != "") {
-					pos_macro = module_freememory_percent.find(macro_name);
-					if (pos_macro != string::npos){
-						module_freememory_percent.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_cpuusage != "") {
-					pos_macro = module_cpuusage.find(macro_name);
-					if (pos_macro != string::npos){
-						module_cpuusage.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_inventory != "") {
-					pos_macro = module_inventory.find(macro_name);
-					if (pos_macro != string::npos){
-						module_inventory.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_max != "") {
-					pos_macro = module_max.find(macro_name);
-					if (pos_macro != string::npos){
-						module_max.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_min != "") {
-					pos_macro = module_min.find(macro_name);
-					if (pos_macro != string::npos){
-						module_min.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_post_process != "") {
-					pos_macro = module_post_process.find(macro_name);
-					if (pos_macro != string::npos){
-						module_post_process.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_min_critical != "") {
-					pos_macro = module_min_critical.find(macro_name);
-					if (pos_macro != string::npos){
-						module_min_critical.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_max_critical != "") {
-					pos_macro = module_max_critical.find(macro_name);
-					if (pos_macro != string::npos){
-						module_max_critical.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_min_warning != "") {
-					pos_macro = module_min_warning.find(macro_name);
-					if (pos_macro != string::npos){
-						module_min_warning.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_max_warning != "") {
-					pos_macro = module_max_warning.find(macro_name);
-					if (pos_macro != string::npos){
-						module_max_warning.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_disabled != "") {
-					pos_macro = module_disabled.find(macro_name);
-					if (pos_macro != string::npos){
-						module_disabled.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_min_ff_event != "") {
-					pos_macro = module_min_ff_event.find(macro_name);
-					if (pos_macro != string::npos){
-						module_min_ff_event.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_description != "") {
-					pos_macro = module_description.find(macro_name);
-					if (pos_macro != string::npos){
-						module_description.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_logevent != "") {
-					pos_macro = module_logevent.find(macro_name);
-					if (pos_macro != string::npos){
-						module_logevent.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_source != "") {
-					pos_macro = module_source.find(macro_name);
-					if (pos_macro != string::npos){
-						module_source.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_eventtype != "") {
-					pos_macro = module_eventtype.find(macro_name);
-					if (pos_macro != string::npos){
-						module_eventtype.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_eventcode != "") {
-					pos_macro = module_eventcode.find(macro_name);
-					if (pos_macro != string::npos){
-						module_eventcode.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_pattern != "") {
-					pos_macro = module_pattern.find(macro_name);
-					if (pos_macro != string::npos){
-						module_pattern.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_application != "") {
-					pos_macro = module_application.find(macro_name);
-					if (pos_macro != string::npos){
-						module_application.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_async != "") {
-					pos_macro = module_async.find(macro_name);
-					if (pos_macro != string::npos){
-						module_async.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_start_command != "") {
-					pos_macro = module_start_command.find(macro_name);
-					if (pos_macro != string::npos){
-						module_start_command.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_watchdog != "") {
-					pos_macro = module_watchdog.find(macro_name);
-					if (pos_macro != string::npos){
-						module_watchdog.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_wmiquery != "") {
-					pos_macro = module_wmiquery.find(macro_name);
-					if (pos_macro != string::npos){
-						module_wmiquery.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_wmicolumn != "") {
-					pos_macro = module_wmicolumn.find(macro_name);
-					if (pos_macro != string::npos){
-						module_wmicolumn.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_retries != "") {
-					pos_macro = module_retries.find(macro_name);
-					if (pos_macro != string::npos){
-						module_retries.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_startdelay != "") {
-					pos_macro = module_startdelay.find(macro_name);
-					if (pos_macro != string::npos){
-						module_startdelay.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_retrydelay != "") {
-					pos_macro = module_retrydelay.find(macro_name);
-					if (pos_macro != string::npos){
-						module_retrydelay.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_perfcounter != "") {
-					pos_macro = module_perfcounter.find(macro_name);
-					if (pos_macro != string::npos){
-						module_perfcounter.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_tcpcheck != "") {
-					pos_macro = module_tcpcheck.find(macro_name);
-					if (pos_macro != string::npos){
-						module_tcpcheck.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_port != "") {
-					pos_macro = module_port.find(macro_name);
-					if (pos_macro != string::npos){
-						module_port.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_timeout != "") {
-					pos_macro = module_timeout.find(macro_name);
-					if (pos_macro != string::npos){
-						module_timeout.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_regexp != "") {
-					pos_macro = module_regexp.find(macro_name);
-					if (pos_macro != string::npos){
-						module_regexp.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_plugin != "") {
-					pos_macro = module_plugin.find(macro_name);
-					if (pos_macro != string::npos){
-						module_plugin.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_save != "") {
-					pos_macro = module_save.find(macro_name);
-					if (pos_macro != string::npos){
-						module_save.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (condition_list.size () > 0) {
-					condition_iter = condition_list.begin ();
-					for (condition_iter = condition_list.begin ();
-						condition_iter != condition_list.end ();
-						condition_iter++) {
-
-						pos_macro = condition_iter->find(macro_name);
-						if (pos_macro != string::npos){
-							condition_iter->replace(pos_macro, macro_name.size(), macro_value);
-						}
-					}
-				}
-
-				if (module_crontab != "") {
-					pos_macro = module_crontab.find(macro_name);
-					if (pos_macro != string::npos){
-						module_crontab.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_cron_interval != "") {
-					pos_macro = module_cron_interval.find(macro_name);
-					if (pos_macro != string::npos){
-						module_cron_interval.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_noseekeof != "") {
-					pos_macro = module_noseekeof.find(macro_name);
-					if (pos_macro != string::npos){
-						module_noseekeof.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_ping != "") {
-					pos_macro = module_ping.find(macro_name);
-					if (pos_macro != string::npos){
-						module_ping.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_ping_count != "") {
-					pos_macro = module_ping_count.find(macro_name);
-					if (pos_macro != string::npos){
-						module_ping_count.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_ping_timeout != "") {
-					pos_macro = module_ping_timeout.find(macro_name);
-					if (pos_macro != string::npos){
-						module_ping_timeout.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_snmpget != "") {
-					pos_macro = module_snmpget.find(macro_name);
-					if (pos_macro != string::npos){
-						module_snmpget.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_snmp_version != "") {
-					pos_macro = module_snmp_version.find(macro_name);
-					if (pos_macro != string::npos){
-						module_snmp_version.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_snmp_community != "") {
-					pos_macro = module_snmp_community.find(macro_name);
-					if (pos_macro != string::npos){
-						module_snmp_community.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_snmp_agent != "") {
-					pos_macro = module_snmp_agent.find(macro_name);
-					if (pos_macro != string::npos){
-						module_snmp_agent.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_snmp_oid != "") {
-					pos_macro = module_snmp_oid.find(macro_name);
-					if (pos_macro != string::npos){
-						module_snmp_oid.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_advanced_options != "") {
-					pos_macro = module_advanced_options.find(macro_name);
-					if (pos_macro != string::npos){
-						module_advanced_options.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_cooked != "") {
-					pos_macro = module_cooked.find(macro_name);
-					if (pos_macro != string::npos){
-						module_cooked.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (intensive_condition_list.size () > 0) {
-					intensive_condition_iter = intensive_condition_list.begin ();
-					for (intensive_condition_iter = intensive_condition_list.begin ();
-						intensive_condition_iter != intensive_condition_list.end ();
-						intensive_condition_iter++) {
-							
-						pos_macro = intensive_condition_iter->find(macro_name);
-						if (pos_macro != string::npos){
-							intensive_condition_iter->replace(pos_macro, macro_name.size(), macro_value);
-						}
-					}
-				}
-
-				if (module_unit != "") {
-					pos_macro = module_unit.find(macro_name);
-					if (pos_macro != string::npos){
-						module_unit.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_group != "") {
-					pos_macro = module_group.find(macro_name);
-					if (pos_macro != string::npos){
-						module_group.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_custom_id != "") {
-					pos_macro = module_custom_id.find(macro_name);
-					if (pos_macro != string::npos){
-						module_custom_id.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_str_warning != "") {
-					pos_macro = module_str_warning.find(macro_name);
-					if (pos_macro != string::npos){
-						module_str_warning.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_str_critical != "") {
-					pos_macro = module_str_critical.find(macro_name);
-					if (pos_macro != string::npos){
-						module_str_critical.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_critical_instructions != "") {
-					pos_macro = module_critical_instructions.find(macro_name);
-					if (pos_macro != string::npos){
-						module_critical_instructions.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_warning_instructions != "") {
-					pos_macro = module_warning_instructions.find(macro_name);
-					if (pos_macro != string::npos){
-						module_warning_instructions.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_unknown_instructions != "") {
-					pos_macro = module_unknown_instructions.find(macro_name);
-					if (pos_macro != string::npos){
-						module_unknown_instructions.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_tags != "") {
-					pos_macro = module_tags.find(macro_name);
-					if (pos_macro != string::npos){
-						module_tags.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_critical_inverse != "") {
-					pos_macro = module_critical_inverse.find(macro_name);
-					if (pos_macro != string::npos){
-						module_critical_inverse.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_warning_inverse != "") {
-					pos_macro = module_warning_inverse.find(macro_name);
-					if (pos_macro != string::npos){
-						module_warning_inverse.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_quiet != "") {
-					pos_macro = module_quiet.find(macro_name);
-					if (pos_macro != string::npos){
-						module_quiet.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-
-				if (module_ff_interval != "") {
-					pos_macro = module_ff_interval.find(macro_name);
-					if (pos_macro != string::npos){
-						module_ff_interval.replace(pos_macro, macro_name.size(), macro_value);
-					}
-				}
-			}
-		}
-	}
+	Pandora_Module_Definition parsed (definition, errors);
+	Module_Kind            kind;
+
+	/* Values of the tokens, macros already applied */
+	module_advanced_options = parsed.getValue (TOKEN_ADVANCEDOPTIONS);
+	module_aggregate = parsed.getValue (TOKEN_AGGREGATE);
+	module_application = parsed.getValue (TOKEN_APPLICATION);
+	module_async = parsed.getValue (TOKEN_ASYNC);
+	condition_list = parsed.getValues (TOKEN_CONDITION);
+	module_cooked = parsed.getValue (TOKEN_COOKED);
+	module_cpuusage = parsed.getValue (TOKEN_CPUUSAGE);
+	module_critical_instructions = parsed.getValue (TOKEN_CRITICAL_INSTRUCTIONS);
+	module_critical_inverse = parsed.getValue (TOKEN_CRITICAL_INVERSE);
+	module_cron_interval = parsed.getValue (TOKEN_CRONINTERVAL);
+	module_crontab = parsed.getValue (TOKEN_CRONTAB);
+	module_custom_id = parsed.getValue (TOKEN_CUSTOM_ID);
+	module_depends = parsed.getValue (TOKEN_DEPENDS);
+	module_description = parsed.getValue (TOKEN_DESCRIPTION);
+	module_disabled = parsed.getValue (TOKEN_DISABLED);
+	module_eventcode = parsed.getValue (TOKEN_EVENTCODE);
+	module_eventtype = parsed.getValue (TOKEN_EVENTTYPE);
+	module_exec = parsed.getValue (TOKEN_EXEC);
+	module_ff_interval = parsed.getValue (TOKEN_MODULE_FF_INTERVAL);
+	module_freedisk = parsed.getValue (TOKEN_FREEDISK);
+	module_freememory = parsed.getValue (TOKEN_FREEMEMORY);
+	module_freedisk_percent = parsed.getValue (TOKEN_FREEDISK_PERCENT);
+	module_freememory_percent = parsed.getValue (TOKEN_FREEMEMORY_PERCENT);
+	module_group = parsed.getValue (TOKEN_MODULE_GROUP);
+	intensive_condition_list = parsed.getValues (TOKEN_INTENSIVECONDITION);
+	module_interval = parsed.getValue (TOKEN_INTERVAL);
+	module_inventory = parsed.getValue (TOKEN_INVENTORY);
+	module_logevent = parsed.getValue (TOKEN_LOGEVENT);
+	module_max = parsed.getValue (TOKEN_MAX);
+	module_max_critical = parsed.getValue (TOKEN_MAX_CRITICAL);
+	module_max_lines = parsed.getValue (TOKEN_MAX_LINES);
+	module_max_output = parsed.getValue (TOKEN_MAX_OUTPUT);
+	module_max_warning = parsed.getValue (TOKEN_MAX_WARNING);
+	module_min = parsed.getValue (TOKEN_MIN);
+	module_min_critical = parsed.getValue (TOKEN_MIN_CRITICAL);
+	module_min_ff_event = parsed.getValue (TOKEN_MIN_FF_EVENT);
+	module_min_warning = parsed.getValue (TOKEN_MIN_WARNING);
+	module_name = parsed.getValue (TOKEN_NAME);
+	module_noseekeof = parsed.getValue (TOKEN_NOSEEKEOF);
+	module_output_tail = parsed.getValue (TOKEN_OUTPUT_TAIL);
+	module_pattern = parsed.getValue (TOKEN_PATTERN);
+	module_perfcounter = parsed.getValue (TOKEN_PERFCOUNTER);
+	module_persistent = parsed.getValue (TOKEN_PERSISTENT);
+	module_ping = parsed.getValue (TOKEN_PING);
+	module_ping_count = parsed.getValue (TOKEN_PING_COUNT);
+	module_ping_timeout = parsed.getValue (TOKEN_PING_TIMEOUT);
+	module_plugin = parsed.getValue (TOKEN_PLUGIN);
+	module_port = parsed.getValue (TOKEN_PORT);
+	module_post_process = parsed.getValue (TOKEN_POST_PROCESS);
+	precondition_list = parsed.getValues (TOKEN_PRECONDITION);
+	module_proc = parsed.getValue (TOKEN_PROC);
+	module_quiet = parsed.getValue (TOKEN_QUIET);
+	module_regexp = parsed.getValue (TOKEN_REGEXP);
+	module_regexp_max_files = parsed.getValue (TOKEN_REGEXP_MAX_FILES);
+	module_regexp_refresh = parsed.getValue (TOKEN_REGEXP_REFRESH);
+	module_retries = parsed.getValue (TOKEN_RETRIES);
+	module_retrydelay = parsed.getValue (TOKEN_RETRYDELAY);
+	module_save = parsed.getValue (TOKEN_SAVE);
+	module_service = parsed.getValue (TOKEN_SERVICE);
+	module_snmp_agent = parsed.getValue (TOKEN_SNMPAGENT);
+	module_snmp_community = parsed.getValue (TOKEN_SNMPCOMMUNITY);
+	module_snmp_oid = parsed.getValue (TOKEN_SNMPOID);
+	module_snmp_version = parsed.getValue (TOKEN_SNMPVERSION);
+	module_snmpget = parsed.getValue (TOKEN_SNMPGET);
+	module_source = parsed.getValue (TOKEN_SOURCE);
+	module_start_command = parsed.getValue (TOKEN_START_COMMAND);
+	module_startdelay = parsed.getValue (TOKEN_STARTDELAY);
+	module_str_critical = parsed.getValue (TOKEN_STR_CRITICAL);
+	module_str_warning = parsed.getValue (TOKEN_STR_WARNING);
+	module_tags = parsed.getValue (TOKEN_TAGS);
+	module_tcpcheck = parsed.getValue (TOKEN_TCPCHECK);
+	module_timeout = parsed.getValue (TOKEN_TIMEOUT);
+	module_type = parsed.getValue (TOKEN_TYPE);
+	module_unit = parsed.getValue (TOKEN_UNIT);
+	module_unknown_instructions = parsed.getValue (TOKEN_UNKNOWN_INSTRUCTIONS);
+	module_warning_instructions = parsed.getValue (TOKEN_WARNING_INSTRUCTIONS);
+	module_warning_inverse = parsed.getValue (TOKEN_WARNING_INVERSE);
+	module_watchdog = parsed.getValue (TOKEN_WATCHDOG);
+	module_wmicolumn = parsed.getValue (TOKEN_WMICOLUMN);
+	module_wmiquery = parsed.getValue (TOKEN_WMIQUERY);
+	kind = parsed.getKind ();
 
 	/* Create module objects */
-	if (module_exec != "") {
+	if (kind == MODULE_EXEC) {
 		module = new Pandora_Module_Exec (module_name,
 						  module_exec);
+		setOutputLimits ((Pandora_Module_Exec *) module, module_max_output,
+				 module_max_lines, module_output_tail);
 		if (module_timeout != "") {
 			module->setTimeout (atoi (module_timeout.c_str ()));
 		}
 		
-	} else if (module_proc != "") {
+	} else if (kind == MODULE_PROC) {
 		module = new Pandora_Module_Proc (module_name,
 						  module_proc);
 		if (module_watchdog != "") {
@@ -1092,7 +266,7 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 				module_proc->setRetryDelay (atoi(module_retrydelay.c_str ()));
 			}
 		}
-	} else if (module_service != "") {
+	} else if (kind == MODULE_SERVICE) {
 		module = new Pandora_Module_Service (module_name,
 						     module_service);
 		if (module_watchdog != "") {
@@ -1101,17 +275,17 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 			module_service = (Pandora_Module_Service *) module;
 			module_service->setWatchdog (is_enabled (module_watchdog));
 		}
-	} else if (module_freedisk != "") {
+	} else if (kind == MODULE_FREEDISK) {
 		module = new Pandora_Module_Freedisk (module_name,
 						      module_freedisk);
-	} else if (module_freedisk_percent != "") {
+	} else if (kind == MODULE_FREEDISK_PERCENT) {
 		module = new Pandora_Module_Freedisk_Percent (module_name,
 						      module_freedisk_percent);
-	} else if (module_freememory != "") {
+	} else if (kind == MODULE_FREEMEMORY) {
 		module = new Pandora_Module_Freememory (module_name);
-	} else if (module_freememory_percent != "") {
+	} else if (kind == MODULE_FREEMEMORY_PERCENT) {
 		module = new Pandora_Module_Freememory_Percent (module_name);
-	} else if (module_cpuusage != "") {
+	} else if (kind == MODULE_CPUUSAGE) {
 		int cpu_id;
 
 		try {
@@ -1123,27 +297,39 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 		module = new Pandora_Module_Cpuusage (module_name,
 						      cpu_id);
 
-	} else if (module_inventory != "") {
+	} else if (kind == MODULE_INVENTORY) {
 		module = new Pandora_Module_Inventory (module_name, module_inventory);
-	} else if (module_logevent != "") {
+	} else if (kind == MODULE_LOGEVENT) {
 		module = new Pandora_Module_Logevent (module_name,
 						      module_source,
 						      module_eventtype,
 						      module_eventcode,
 						      module_pattern,
 						      module_application);
-	} else if (module_wmiquery != "") {
+	} else if (kind == MODULE_WMIQUERY) {
 		module = new Pandora_Module_WMIQuery (module_name,
 						      module_wmiquery, module_wmicolumn);
-	} else if (module_perfcounter != "") {
+	} else if (kind == MODULE_PERFCOUNTER) {
 		module = new Pandora_Module_Perfcounter (module_name, module_perfcounter, module_cooked);
-	} else if (module_tcpcheck != "") {
+	} else if (kind == MODULE_TCPCHECK) {
 		module = new Pandora_Module_Tcpcheck (module_name, module_tcpcheck, module_port, module_timeout);
-	} else if (module_regexp != "") {
+	} else if (kind == MODULE_REGEXP) {
 		module = new Pandora_Module_Regexp (module_name, module_regexp, module_pattern, (unsigned char) atoi (module_noseekeof.c_str ()));
-	} else if (module_plugin != "") {
+		if (module_regexp_refresh != "" || module_regexp_max_files != "") {
+			((Pandora_Module_Regexp *) module)->setListing (atoi (module_regexp_refresh.c_str ()),
+									atoi (module_regexp_max_files.c_str ()));
+		}
+	} else if (kind == MODULE_PLUGIN) {
 		module = new Pandora_Module_Plugin (module_name, module_plugin);
-	} else if (module_ping != "") {
+		setOutputLimits ((Pandora_Module_Exec *) module, module_max_output,
+				 module_max_lines, module_output_tail);
+		if (is_enabled (module_persistent)) {
+			((Pandora_Module_Plugin *) module)->setPersistent (true);
+			if (module_timeout != "") {
+				module->setTimeout (atoi (module_timeout.c_str ()));
+			}
+		}
+	} else if (kind == MODULE_PING) {
 		if (module_ping_count == "") {
 			module_ping_count = "1";
 		}
@@ -1155,7 +341,7 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 		if (module_timeout != "") {
 			module->setTimeout (atoi (module_timeout.c_str ()));
 		}
-	} else if (module_snmpget != "") {
+	} else if (kind == MODULE_SNMPGET) {
 		if (module_snmp_version == "") {
 			module_snmp_version = "1";
 		}
@@ -1196,7 +382,9 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 		for (precondition_iter = precondition_list.begin ();
 		     precondition_iter != precondition_list.end ();
 		     precondition_iter++) {
-			module->addPreCondition (*precondition_iter);
+			if (! module->addPreCondition (*precondition_iter) && errors != NULL) {
+				errors->push_back ("Invalid precondition: " + *precondition_iter);
+			}
 		}
 	}
 	
@@ -1206,7 +394,50 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 		for (condition_iter = condition_list.begin ();
 		     condition_iter != condition_list.end ();
 		     condition_iter++) {
-			module->addCondition (*condition_iter);
+			if (! module->addCondition (*condition_iter) && errors != NULL) {
+				errors->push_back ("Invalid condition: " + *condition_iter);
+			}
+		}
+	}
+
+	/* Variables saved by other modules, either referenced with the
+	   %NAME% syntax or listed with module_depends */
+	Pandora_Variables::getReferences (module_exec, dependency_list);
+	Pandora_Variables::getReferences (module_plugin, dependency_list);
+	for (precondition_iter = precondition_list.begin ();
+	     precondition_iter != precondition_list.end ();
+	     precondition_iter++) {
+		Pandora_Variables::getReferences (*precondition_iter, dependency_list);
+	}
+	for (condition_iter = condition_list.begin ();
+	     condition_iter != condition_list.end ();
+	     condition_iter++) {
+		Pandora_Variables::getReferences (*condition_iter, dependency_list);
+	}
+	stringtok (dependency_list, module_depends, " \t,");
+	for (dependency_iter = dependency_list.begin ();
+	     dependency_iter != dependency_list.end ();
+	     dependency_iter++) {
+		module->addDependency (*dependency_iter);
+	}
+
+	/* Module aggregate. Only numeric data can be aggregated */
+	if (module_aggregate != "") {
+		Aggregate_Mode aggregate_mode;
+
+		aggregate_mode = Pandora_Aggregate::parseModeFromString (trim (module_aggregate));
+		type = Pandora_Module::parseModuleTypeFromString (module_type);
+		if (aggregate_mode == AGGREGATE_NONE) {
+			pandoraLog ("Invalid aggregate \"%s\" for module %s",
+				    module_aggregate.c_str (),
+				    module_name.c_str ());
+			module_aggregate = "";
+		} else if (module_plugin != "" || (type != TYPE_GENERIC_DATA && type != TYPE_GENERIC_DATA_INC)) {
+			pandoraLog ("Module %s is not generic_data or generic_data_inc, aggregate ignored",
+				    module_name.c_str ());
+			module_aggregate = "";
+		} else {
+			module->setAggregate (aggregate_mode);
 		}
 	}
 
@@ -1231,10 +462,13 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 		for (intensive_condition_iter = intensive_condition_list.begin ();
 		     intensive_condition_iter != intensive_condition_list.end ();
 		     intensive_condition_iter++) {
-			module->addIntensiveCondition (*intensive_condition_iter);
+			if (! module->addIntensiveCondition (*intensive_condition_iter) && errors != NULL) {
+				errors->push_back ("Invalid intensive condition: " + *intensive_condition_iter);
+			}
 		}
-	/* Adjust the module interval for non-intensive modules */
-	} else {
+	/* Adjust the module interval for non-intensive modules. Aggregated
+	   modules are sampled every intensive interval */
+	} else if (module_aggregate == "") {
 		service = Pandora_Windows_Service::getInstance ();
 		module->setIntensiveInterval (module->getInterval () * (service->getInterval () / service->getIntensiveInterval ()));
 	}
@@ -1264,9 +498,17 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 			break;
 		case TYPE_GENERIC_DATA_STRING:
 		case TYPE_ASYNC_STRING:
+			module->setType (module_type);
+			numeric = false;
+			
+			break;
 		case TYPE_LOG:
 			module->setType (module_type);
 			numeric = false;
+
+			/* Data collected until the next packet */
+			module->setLogLimits (atoi (module_max_output.c_str ()),
+					      atoi (module_max_lines.c_str ()));
 			
 			break;
 		default:
@@ -1307,85 +549,28 @@ Pandora_Module_Factory::getModuleFromDefinition (string definition) {
 		}
 	}
 	
-	if (module_post_process != "") {
-		module->setPostProcess (module_post_process);
-	}
-
-	if (module_min_critical != "") {
-		module->setMinCritical (module_min_critical);
-	}
-
-	if (module_max_critical != "") {
-		module->setMaxCritical (module_max_critical);
-	}
-
-	if (module_min_warning != "") {
-		module->setMinWarning (module_min_warning);
-	}
-
-	if (module_max_warning != "") {
-		module->setMaxWarning (module_max_warning);
-	}
-
-	if (module_disabled != "") {
-		module->setDisabled (module_disabled);
-	}
-
-	if (module_min_ff_event != "") {
-		module->setMinFFEvent (module_min_ff_event);
-	}
-	
-	if (module_unit != "") {
-		module->setUnit (module_unit);
-	}
-	
-	if (module_group != "") {
-		module->setModuleGroup (module_group);
-	}
-	
-	if (module_custom_id != "") {
-		module->setCustomId (module_custom_id);
-	}
-	
-	if (module_str_warning != "") {
-		module->setStrWarning (module_str_warning);
-	}
-	
-	if (module_str_critical != "") {
-		module->setStrCritical (module_str_critical);
-	}
-	
-	if (module_critical_instructions != "") {
-		module->setCriticalInstructions (module_critical_instructions);
-	}
-	
-	if (module_warning_instructions != "") {
-		module->setWarningInstructions (module_warning_instructions);
-	}
-	
-	if (module_unknown_instructions != "") {
-		module->setUnknownInstructions (module_unknown_instructions);
-	}
-	
-	if (module_tags != "") {
-		module->setTags (module_tags);
-	}
-	
-	if (module_critical_inverse != "") {
-		module->setCriticalInverse (module_critical_inverse);
-	}
-	
-	if (module_warning_inverse != "") {
-		module->setWarningInverse (module_warning_inverse);
-	}
-	
-	if (module_quiet != "") {
-		module->setQuiet (module_quiet);
-	}
-	
-	if (module_ff_interval != "") {
-		module->setModuleFFInterval (module_ff_interval);
-	}
+	/* Modules with the same thresholds, tags, instructions... share them */
+	metadata.post_process = module_post_process;
+	metadata.min_critical = module_min_critical;
+	metadata.max_critical = module_max_critical;
+	metadata.min_warning = module_min_warning;
+	metadata.max_warning = module_max_warning;
+	metadata.disabled = module_disabled;
+	metadata.min_ff_event = module_min_ff_event;
+	metadata.unit = module_unit;
+	metadata.module_group = module_group;
+	metadata.custom_id = module_custom_id;
+	metadata.str_warning = module_str_warning;
+	metadata.str_critical = module_str_critical;
+	metadata.critical_instructions = module_critical_instructions;
+	metadata.warning_instructions = module_warning_instructions;
+	metadata.unknown_instructions = module_unknown_instructions;
+	metadata.tags = module_tags;
+	metadata.critical_inverse = module_critical_inverse;
+	metadata.warning_inverse = module_warning_inverse;
+	metadata.quiet = module_quiet;
+	metadata.module_ff_interval = module_ff_interval;
+	module->setMetadata (metadata);
 	
 	return module;
 }
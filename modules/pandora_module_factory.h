@@ -33,6 +33,8 @@ using namespace Pandora_Modules;
  */
 namespace Pandora_Module_Factory {
 	Pandora_Module * getModuleFromDefinition (string definition);
+	Pandora_Module * getModuleFromDefinition (string definition,
+						  list<string> *errors);
 }
 
 #endif
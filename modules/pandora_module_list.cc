@@ -37,22 +37,52 @@
 #include "pandora_module_plugin.h"
 #include "pandora_module_ping.h"
 #include "pandora_module_snmpget.h"
+#include "../misc/pandora_conf_loader.h"
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <vector>
+#include <map>
+#include <set>
 
 using namespace std;
+using namespace Pandora;
 
 /**
  * Additional configuration file.
+ *
+ * The module definitions of the file are kept with its fingerprint. If
+ * the file has not changed since the previous list was loaded, its
+ * definitions are taken from there instead of reading it again.
  */
 void
 Pandora_Modules::Pandora_Module_List::parseModuleConf (string path_file, list<Pandora_Module *> *modules) {
-	ifstream     file_conf (path_file.c_str ());
-	string       buffer;
+	map<string, Conf_Definitions>::iterator cached;
+	list<string>::iterator                  iter;
+	Conf_Definitions                       *conf_definitions;
+	string       buffer, text;
 	int pos;
 	
-	if (!file_conf.is_open ()) {
+	conf_definitions = &(this->files[path_file]);
+	conf_definitions->md5 = Pandora_Conf_Loader::getInstance ()->getMd5 (path_file);
+	conf_definitions->definitions.clear ();
+
+	if (this->cached_files != NULL) {
+		cached = this->cached_files->find (path_file);
+		if (cached != this->cached_files->end () && cached->second.md5 == conf_definitions->md5) {
+			conf_definitions->definitions = cached->second.definitions;
+			for (iter = conf_definitions->definitions.begin (); iter != conf_definitions->definitions.end (); iter++) {
+				this->parseModuleDefinition (*iter);
+			}
+			return;
+		}
+	}
+
+	if (!Pandora_Conf_Loader::getInstance ()->getText (path_file, text)) {
 		return;
 	}
+	istringstream file_conf (text);
 	
 	/* Read and set the file */
 	while (!file_conf.eof ()) {
@@ -77,20 +107,23 @@ Pandora_Modules::Pandora_Module_List::parseModuleConf (string path_file, list<Pa
 					str_module += buffer + "\n";
 				}
 				
-				this->parseModuleDefinition (str_module);
+				conf_definitions->definitions.push_back (str_module);
 				continue;
 			}
 			
 			/* Plugin */
 			pos = buffer.find ("module_plugin");  
 			if (pos != string::npos) {
-				this->parseModuleDefinition (buffer);
+				conf_definitions->definitions.push_back (buffer);
 				continue;
 			}
 			
 		}
 	}
-	file_conf.close ();
+
+	for (iter = conf_definitions->definitions.begin (); iter != conf_definitions->definitions.end (); iter++) {
+		this->parseModuleDefinition (*iter);
+	}
 	return;
 }
 /** 
@@ -102,15 +135,90 @@ Pandora_Modules::Pandora_Module_List::parseModuleConf (string path_file, list<Pa
  *        module definitions.
  */
 Pandora_Modules::Pandora_Module_List::Pandora_Module_List (string filename) {
-	ifstream     file (filename.c_str ());
-	string       buffer;
-	int pos;
+	this->modules = new list<Pandora_Module *> ();
+	this->reusable = NULL;
+	this->cached_files = NULL;
+
+	this->load (filename);
+
+	current = new std::list<Pandora_Module *>::iterator ();
+	(*current) = modules->begin ();
+}
+
+/** 
+ * Read the modules of a file, keeping the unchanged modules of a
+ * previous list.
+ *
+ * The modules whose definition has not changed are moved from the
+ * previous list to the new one with all their state (file offsets,
+ * event log positions, cron and intensive state, asynchronous
+ * threads...). Only the new or modified modules are created. The
+ * modules left in the previous list are the ones that were removed or
+ * changed, and are destroyed with it.
+ *
+ * @param filename Path to the configuration file that includes the
+ *        module definitions.
+ * @param previous List loaded from the same file before, may be NULL.
+ */
+Pandora_Modules::Pandora_Module_List::Pandora_Module_List (string filename, Pandora_Module_List *previous) {
+	multimap<string, Pandora_Module *>::iterator reuse_iter;
+	list<Pandora_Module *>::iterator             iter;
+	int                                          kept;
 
 	this->modules = new list<Pandora_Module *> ();
-	
-	if (!file.is_open ()) {
+	this->reusable = NULL;
+
+	this->cached_files = NULL;
+
+	if (previous != NULL) {
+		this->cached_files = &(previous->files);
+		this->reusable = new multimap<string, Pandora_Module *> ();
+		for (iter = previous->modules->begin (); iter != previous->modules->end (); iter++) {
+			this->reusable->insert (make_pair ((*iter)->getDefinition (), *iter));
+		}
+	}
+
+	this->load (filename);
+
+	if (previous != NULL) {
+		kept = previous->modules->size () - this->reusable->size ();
+		pandoraDebug ("%s: %d modules kept, %d created, %d removed", filename.c_str (),
+			      kept, (int) this->modules->size () - kept, (int) this->reusable->size ());
+
+		/* Leave only the discarded modules in the previous list */
+		previous->modules->clear ();
+		for (reuse_iter = this->reusable->begin (); reuse_iter != this->reusable->end (); reuse_iter++) {
+			previous->modules->push_back (reuse_iter->second);
+		}
+		(*(previous->current)) = previous->modules->begin ();
+
+		delete this->reusable;
+		this->reusable = NULL;
+		this->cached_files = NULL;
+	}
+
+	current = new std::list<Pandora_Module *>::iterator ();
+	(*current) = modules->begin ();
+}
+
+/** 
+ * Read the module definitions of a file.
+ *
+ * @param filename Path to the configuration file that includes the
+ *        module definitions.
+ */
+void
+Pandora_Modules::Pandora_Module_List::load (string filename) {
+	string       buffer, text;
+	int pos;
+
+	/* Only the fingerprint, to detect changes */
+	this->files[filename].md5 = Pandora_Conf_Loader::getInstance ()->getMd5 (filename);
+
+	if (!Pandora_Conf_Loader::getInstance ()->getText (filename, text)) {
 		return;
 	}
+	istringstream file (text);
 	
 	/* Read and set the file */
 	while (!file.eof ()) {
@@ -166,10 +274,11 @@ Pandora_Modules::Pandora_Module_List::Pandora_Module_List (string filename) {
 
 		}
 	}
-	file.close ();
 	
-	current = new std::list<Pandora_Module *>::iterator ();
-	(*current) = modules->begin ();
+	this->sortByDependencies ();
+
+	pandoraDebug ("%s: %d modules, %lu distinct metadata sets in use", filename.c_str (),
+		      (int) this->modules->size (), Module_Metadata::getPoolSize ());
 }
 
 /** 
@@ -177,6 +286,8 @@ Pandora_Modules::Pandora_Module_List::Pandora_Module_List (string filename) {
  */
 Pandora_Modules::Pandora_Module_List::Pandora_Module_List () {
 	this->modules = new list<Pandora_Module *> ();
+	this->reusable = NULL;
+	this->cached_files = NULL;
 	current = new std::list<Pandora_Module *>::iterator ();
 	(*current) = modules->begin ();
 }
@@ -233,10 +344,22 @@ Pandora_Modules::Pandora_Module_List::parseModuleDefinition (string definition)
     Pandora_Module_Plugin     *module_plugin;
     Pandora_Module_Ping       *module_ping;
     Pandora_Module_SNMPGet    *module_snmpget;
+	multimap<string, Pandora_Module *>::iterator reuse_iter;
+
+	/* Unchanged module of the previous list */
+	if (this->reusable != NULL) {
+		reuse_iter = this->reusable->find (definition);
+		if (reuse_iter != this->reusable->end ()) {
+			modules->push_back (reuse_iter->second);
+			this->reusable->erase (reuse_iter);
+			return;
+		}
+	}
 
 	module = Pandora_Module_Factory::getModuleFromDefinition (definition);
 	
 	if (module != NULL) {
+		module->setDefinition (definition);
 		switch (module->getModuleKind ()) {
 		case MODULE_EXEC:
 			module_exec = (Pandora_Module_Exec *) module;
@@ -323,6 +446,105 @@ Pandora_Modules::Pandora_Module_List::parseModuleDefinition (string definition)
 }
 
 
+/** 
+ * Sort the modules so that the modules that save a variable run before
+ * the modules that depend on it.
+ *
+ * The sort is stable: modules without dependencies between them keep
+ * the order of the configuration file. Modules in a dependency cycle
+ * are left in their original order.
+ */
+void
+Pandora_Modules::Pandora_Module_List::sortByDependencies () {
+	vector<Pandora_Module *>           module_vector;
+	vector<list<int> >                 dependants;
+	vector<int>                        pending;
+	map<string, list<int> >            savers;
+	map<string, list<int> >::iterator  saver_iter;
+	list<string>                      *dependencies;
+	list<string>::iterator             dependency_iter;
+	list<int>::iterator                iter;
+	set<int>                           ready;
+	string                             name;
+	bool                               has_dependencies = false;
+	int                                i, j;
+
+	module_vector.assign (modules->begin (), modules->end ());
+
+	/* Modules that save each variable */
+	for (i = 0; i < (int) module_vector.size (); i++) {
+		name = module_vector[i]->getSave ();
+		if (name != "") {
+			/* Variable names are case insensitive */
+			transform (name.begin (), name.end (), name.begin (), ::toupper);
+			savers[name].push_back (i);
+		}
+	}
+
+	if (savers.empty ()) {
+		return;
+	}
+
+	/* Build the dependency graph */
+	dependants.resize (module_vector.size ());
+	pending.assign (module_vector.size (), 0);
+	for (i = 0; i < (int) module_vector.size (); i++) {
+		dependencies = module_vector[i]->getDependencies ();
+		for (dependency_iter = dependencies->begin ();
+		     dependency_iter != dependencies->end ();
+		     dependency_iter++) {
+			name = *dependency_iter;
+			transform (name.begin (), name.end (), name.begin (), ::toupper);
+			saver_iter = savers.find (name);
+			if (saver_iter == savers.end ()) {
+				continue;
+			}
+			for (iter = saver_iter->second.begin (); iter != saver_iter->second.end (); iter++) {
+				if (*iter != i) {
+					dependants[*iter].push_back (i);
+					pending[i]++;
+					has_dependencies = true;
+				}
+			}
+		}
+	}
+
+	if (! has_dependencies) {
+		return;
+	}
+
+	/* Always pick the first module in file order whose dependencies
+	   have already run */
+	modules->clear ();
+	for (i = 0; i < (int) module_vector.size (); i++) {
+		if (pending[i] == 0) {
+			ready.insert (i);
+		}
+	}
+	while (! ready.empty ()) {
+		i = *(ready.begin ());
+		ready.erase (ready.begin ());
+		modules->push_back (module_vector[i]);
+		module_vector[i] = NULL;
+
+		for (iter = dependants[i].begin (); iter != dependants[i].end (); iter++) {
+			j = *iter;
+			if (--pending[j] == 0) {
+				ready.insert (j);
+			}
+		}
+	}
+
+	/* Dependency cycles */
+	for (i = 0; i < (int) module_vector.size (); i++) {
+		if (module_vector[i] != NULL) {
+			pandoraLog ("Module %s has a circular variable dependency",
+				    module_vector[i]->getName ().c_str ());
+			modules->push_back (module_vector[i]);
+		}
+	}
+}
+
 /** 
  * Get the Pandora_Module that is pointed by the internal current pointer.
  * 
@@ -394,3 +616,26 @@ Pandora_Modules::Pandora_Module_List::isFirst () {
 	}
 	return *current == modules->begin ();
 }
+
+/** 
+ * Check if the configuration file or any of its include files have
+ * changed since the list was loaded.
+ *
+ * Only the files whose size or modification time have changed are
+ * read again to compare their fingerprint.
+ *
+ * @return True if the list should be loaded again.
+ */
+bool
+Pandora_Modules::Pandora_Module_List::hasChanged () {
+	map<string, Conf_Definitions>::iterator iter;
+
+	for (iter = this->files.begin (); iter != this->files.end (); iter++) {
+		if (Pandora_Conf_Loader::getInstance ()->getMd5 (iter->first) != iter->second.md5) {
+			pandoraLog ("Configuration file %s has changed", iter->first.c_str ());
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -25,11 +25,20 @@
 #include "pandora_module.h"
 #include <string>
 #include <list>
+#include <map>
 
 using namespace std;
 using namespace Pandora;
 
 namespace Pandora_Modules {
+	/**
+	 * Module definitions read from a configuration file.
+	 */
+	typedef struct {
+		string       md5;         /* Fingerprint of the file contents */
+		list<string> definitions;
+	} Conf_Definitions;
+
 	/**
 	 * Class to handle a list of Pandora_Module objects.
 	 *
@@ -40,10 +49,17 @@ namespace Pandora_Modules {
 	private:
 		list<Pandora_Module *>           *modules;
 		list<Pandora_Module *>::iterator *current;
+		multimap<string, Pandora_Module *> *reusable;
+		map<string, Conf_Definitions>       files;
+		map<string, Conf_Definitions>      *cached_files;
+		void             load                  (string filename);
 		void		 parseModuleConf (string path_file, list<Pandora_Module *> *modules);
 		void             parseModuleDefinition (string definition);
+		void             sortByDependencies    ();
 	public:
 		Pandora_Module_List                    (string filename);
+		Pandora_Module_List                    (string filename,
+							Pandora_Module_List *previous);
 		Pandora_Module_List                    ();
 		
 		~Pandora_Module_List                   ();
@@ -63,6 +79,8 @@ namespace Pandora_Modules {
 		
 		bool             isLast                ();
 		bool             isFirst               ();
+
+		bool             hasChanged            ();
 	};
 }
 #endif /* __PANDORA_MODULE_LIST_H__ */
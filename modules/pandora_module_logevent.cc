@@ -25,6 +25,7 @@
 #include <time.h>
 
 #include "pandora_module_logevent.h"
+#include "pandora_lru_cache.h"
 #include "../windows/pandora_wmi.h"
 #include "../pandora_windows_service.h"
 #include "pandora_module_logevent.h"
@@ -44,6 +45,13 @@ static EvtCloseT EvtCloseF = NULL;
 static EvtFormatMessageT EvtFormatMessageF = NULL;
 static EvtOpenPublisherMetadataT EvtOpenPublisherMetadataF = NULL;
 
+// Caches of the event descriptions, shared by all the modules
+static Pandora_Lru_Cache<string> message_files (MESSAGE_FILE_CACHE_SIZE);
+static Pandora_Lru_Cache<HMODULE> message_modules (MESSAGE_MODULE_CACHE_SIZE);
+static Pandora_Lru_Cache<string> message_templates (MESSAGE_TEMPLATE_CACHE_SIZE);
+static Pandora_Lru_Cache<EVT_HANDLE> publishers (PUBLISHER_CACHE_SIZE);
+static EVT_HANDLE render_context = NULL;
+
 /** 
  * Creates a Pandora_Module_Logevent object.
  * 
@@ -85,8 +93,7 @@ Pandora_Module_Logevent::Pandora_Module_Logevent (string name, string source, st
 		}
 	}
 	this->application = application;
-	this->log_event = NULL;
-	this->first_run = 1;
+	this->reader = NULL;
 	this->setKind (module_logevent_str);
 
     // Load Wevtapi.dll and some functions   	
@@ -151,6 +158,13 @@ Pandora_Module_Logevent::Pandora_Module_Logevent (string name, string source, st
     }
 }
 
+/**
+ * Destroys a Pandora_Module_Logevent object.
+ */
+Pandora_Module_Logevent::~Pandora_Module_Logevent () {
+	delete this->reader;
+}
+
 void
 Pandora_Module_Logevent::run () {
 	string value;
@@ -169,7 +183,7 @@ Pandora_Module_Logevent::run () {
 	this->openLogEvent();
     
 	// Read events
-	this->getLogEvents (event_list, 0);
+	this->getLogEvents (event_list);
 
 	// No data
 	if (event_list.size () < 1) {
@@ -191,35 +205,31 @@ Pandora_Module_Logevent::run () {
 }
 
 /** 
- * Opens a handle to the module event log.
+ * Opens the module event log, after the last event read.
  *
- * @return A handle to the event log.
+ * @return False if the event log could not be opened.
  */
-HANDLE
+bool
 Pandora_Module_Logevent::openLogEvent () {
-    list<string> event_list;
 
-    // Check whether the event log is already open
-    if (this->log_event != NULL) {
-       return NULL;
+    if (this->reader == NULL) {
+        Pandora_Event_Reader::setBookmarkDir (getPandoraInstallDir ());
+        this->reader = new Pandora_Event_Log_Reader (this->source);
+        this->reader->setBookmarkKey (this->source + " " + this->getName ());
     }
 
-    // Open the event log
-    this->log_event = OpenEventLog (NULL, this->source.c_str ());
-    if (this->log_event == NULL) {
-        pandoraLog ("Could not open event log file '%s'", this->source.c_str ());
-        return NULL;
+    // Check whether the event log is already open
+    if (this->reader->isOpen ()) {
+       return true;
     }
 
-    // Discard existing events the first time the module is executed
-    if (this->first_run == 1) {
-		this->first_run = 0;
-		if (Pandora::getPandoraDebug() == false) {
-			this->getLogEvents (event_list, 1);
-		}
+    // Existing events are discarded unless the last run left a bookmark
+    if (! this->reader->open (Pandora::getPandoraDebug () == false)) {
+        pandoraLog ("Could not open event log file '%s'", this->source.c_str ());
+        return false;
     }
 
-    return this->log_event;
+    return true;
 }
 
 /** 
@@ -228,29 +238,25 @@ Pandora_Module_Logevent::openLogEvent () {
 void
 Pandora_Module_Logevent::closeLogEvent () {
     
-    if (this->log_event == NULL) {
+    if (this->reader == NULL) {
        return;
     }
 
     // Close the event log
-    CloseEventLog (this->log_event);
-    this->log_event = NULL;
+    this->reader->close ();
 }
 
 /** 
- * Reads available events from the event log.
+ * Reads the events written since the last call, in batches.
  */
 int
-Pandora_Module_Logevent::getLogEvents (list<string> &event_list, unsigned char discard) {
+Pandora_Module_Logevent::getLogEvents (list<string> &event_list) {
 	char message[BUFFER_SIZE], timestamp[TIMESTAMP_LEN + 1];
 	struct tm *time_info = NULL;
 	time_t epoch;
-	BYTE *buffer = NULL, *new_buffer = NULL;
-	DWORD to_read, read, needed;
+	const unsigned char *record;
+	size_t size;
 	EVENTLOGRECORD *pevlr = NULL;
-	LPCTSTR source_name;
-	bool rc = false;
-	DWORD last_error;
 	UINT offset;
 	TCHAR lp_name[_MAX_PATH + 1];
 	DWORD cch_name = _MAX_PATH + 1;
@@ -258,157 +264,110 @@ Pandora_Module_Logevent::getLogEvents (list<string> &event_list, unsigned char d
 	DWORD cch_referenced_domain_name = _MAX_PATH + 1;
 	SID_NAME_USE pe_use;
 	string description;
+	int described = 0;
 	
-	if (this->log_event == NULL) {
+	if (this->reader == NULL || ! this->reader->isOpen ()) {
 	    return -1;
 	}
 	
-	// Initialize the event record buffer
-	to_read = BUFFER_SIZE;
-	buffer = (BYTE *) malloc (sizeof (BYTE) * BUFFER_SIZE);
-	if (buffer == NULL) {
-	    	return -1;
-	}
-	pevlr = (EVENTLOGRECORD *) buffer;
-	
-	// Read events
-	while (1) {
-		rc = ReadEventLog (this->log_event, EVENTLOG_FORWARDS_READ | EVENTLOG_SEQUENTIAL_READ, 0, pevlr, to_read, &read, &needed);
-		if (!rc) {
-
-			// Get error details
-			last_error = GetLastError();
-
-			// Not enough space in the buffer
-			if(last_error == ERROR_INSUFFICIENT_BUFFER) {
-
-				// Initialize the new event record buffer
-				to_read = needed;
-				new_buffer = (BYTE *) realloc (buffer, sizeof (BYTE) * needed);
-				if (new_buffer == NULL) {
-					free ((void *) buffer);
-					return -1;
-				}
-				
-				buffer = new_buffer;
-				pevlr = (EVENTLOGRECORD *) buffer;
-
-				// Try to read the event again
-				continue;
-			// File corrupted or cleared
-			} else if (last_error == ERROR_EVENTLOG_FILE_CORRUPT || last_error == ERROR_EVENTLOG_FILE_CHANGED) {
-				closeLogEvent ();
-				free ((void *) buffer);
-				return -1;
-			}
-			// Unknown error
-			else {
-				free ((void *) buffer);
-				return -1;
-			}
-		}
-		
-		// No more events
-		if (read == 0) {
-			free ((void *) buffer);
-			return 0;
-		}
-		
-		// Discard existing events
-		if (discard == 1) {
+	// Read events. The log is closed if it was cleared or is corrupt
+	while (this->reader->next (record, size)) {
+		pevlr = (EVENTLOGRECORD *) record;
+
+		// Cheap filters first, formatting the description is expensive
+		if (filterRecord (pevlr) != 0) {
 			continue;
 		}
-
-		// Process read events
-		while (read > 0) {           
-	    
-			// Retrieve the event description (LOAD_LIBRARY_AS_IMAGE_RESOURCE | LOAD_LIBRARY_AS_DATAFILE)
-			description = getEventDescriptionXPATH (pevlr);
-			if (description == "") {				
-				getEventDescription (pevlr, message, 0x20 | 0x02);
+		described++;
+
+		// Retrieve the event description (LOAD_LIBRARY_AS_IMAGE_RESOURCE | LOAD_LIBRARY_AS_DATAFILE)
+		description = getEventDescriptionXPATH (pevlr);
+		if (description == "") {				
+			getEventDescription (pevlr, message, 0x20 | 0x02);
+			if (message[0] == '\0') {
+				// Retrieve the event description (DONT_RESOLVE_DLL_REFERENCES)
+				getEventDescription (pevlr, message, DONT_RESOLVE_DLL_REFERENCES);
 				if (message[0] == '\0') {
-					// Retrieve the event description (DONT_RESOLVE_DLL_REFERENCES)
-					getEventDescription (pevlr, message, DONT_RESOLVE_DLL_REFERENCES);
-					if (message[0] == '\0') {
-						description = "N/A";
-					} else {
-						description = message;
-					}
+					description = "N/A";
 				} else {
 					description = message;
 				}
+			} else {
+				description = message;
 			}
+		}
 
-			// Filter the event
-			if (filterEvent (pevlr, description) == 0) {
-			
-			    // Generate a timestamp for the event
-			    epoch = pevlr->TimeGenerated;
-			    time_info = localtime (&epoch);
-			    strftime (timestamp, TIMESTAMP_LEN + 1, "%Y-%m-%d %H:%M:%S", time_info);
+		// Filter the event
+		if (filterEvent (description) == 0) {
+		
+		    // Generate a timestamp for the event
+		    epoch = pevlr->TimeGenerated;
+		    time_info = localtime (&epoch);
+		    strftime (timestamp, TIMESTAMP_LEN + 1, "%Y-%m-%d %H:%M:%S", time_info);
 
 
-				// Print the event timestamp
-			    std::stringstream event;
+			// Print the event timestamp
+		    std::stringstream event;
+			event << timestamp;
+			
+			// Print additional information for log modules
+		    if (this->getModuleType() == TYPE_LOG) {
+			
+				// Add the timestamp to the log (the previous timestamp will be stripped)
+				event << "[Timestamp: ";
 				event << timestamp;
+				event << "]";
+				
+				// Retrieve the event id
+			    event << "[ID: ";
+			    event << (pevlr->EventID & 0x3FFFFFFF);
+				event << "]";
 				
-				// Print additional information for log modules
-			    if (this->getModuleType() == TYPE_LOG) {
+				// Retrieve the source name
+				offset = sizeof(EVENTLOGRECORD);
+				event << " [Source: ";
+				event << (LPTSTR)((LPBYTE)pevlr + offset);
+				event << "]";
 				
-					// Add the timestamp to the log (the previous timestamp will be stripped)
-					event << "[Timestamp: ";
-					event << timestamp;
-					event << "]";
-					
-					// Retrieve the event id
-				    event << "[ID: ";
-				    event << (pevlr->EventID & 0x3FFFFFFF);
-					event << "]";
-					
-					// Retrieve the source name
-					offset = sizeof(EVENTLOGRECORD);
-					event << " [Source: ";
-					event << (LPTSTR)((LPBYTE)pevlr + offset);
-					event << "]";
-					
-					// Retrieve the computer name
-					offset += strlen((LPTSTR)((LPBYTE)pevlr + offset)) + sizeof(TCHAR);
-					event << " [Computer: ";
-					event << (LPTSTR)((LPBYTE)pevlr + offset);
-					event << "]";
-					
-					// Retrieve the user name
-					event << " [User: ";
-					if(pevlr->UserSidLength > 0) {
-						if (LookupAccountSid(0, (PSID)((LPBYTE)pevlr + pevlr->UserSidOffset),
-	                        lp_name, &cch_name, lp_referenced_domain_name, &cch_referenced_domain_name, &pe_use) != 0) {
-							event << lp_name;	
-						} else {
-							event << "N/A";
-						}
+				// Retrieve the computer name
+				offset += strlen((LPTSTR)((LPBYTE)pevlr + offset)) + sizeof(TCHAR);
+				event << " [Computer: ";
+				event << (LPTSTR)((LPBYTE)pevlr + offset);
+				event << "]";
+				
+				// Retrieve the user name
+				event << " [User: ";
+				if(pevlr->UserSidLength > 0) {
+					if (LookupAccountSid(0, (PSID)((LPBYTE)pevlr + pevlr->UserSidOffset),
+                        lp_name, &cch_name, lp_referenced_domain_name, &cch_referenced_domain_name, &pe_use) != 0) {
+						event << lp_name;	
 					} else {
 						event << "N/A";
 					}
-					event << "]";						
+				} else {
+					event << "N/A";
 				}
-				
-				// Print the event description
-				event << " ";
-				event << description;
-			     
-			    // Add the event to the list
-			    event_list.push_back (event.str());
+				event << "]";						
 			}
-
-			// Move to the next event
-			read -= pevlr->Length;
-			pevlr = (EVENTLOGRECORD *) ((LPBYTE) pevlr + pevlr->Length);
+			
+			// Print the event description
+			event << " ";
+			event << description;
+		     
+		    // Add the event to the list
+		    event_list.push_back (event.str());
 		}
-
-		pevlr = (EVENTLOGRECORD *) buffer;
 	}
 
-	free ((void *) buffer);
+	// The next run, even after a restart, resumes after the last event read
+	this->reader->saveBookmark ();
+
+	if (described > 0) {
+		pandoraDebug ("Event description caches: templates %lu hits %lu misses, message DLLs %lu hits %lu misses, publishers %lu hits %lu misses",
+		              message_templates.getHits (), message_templates.getMisses (),
+		              message_modules.getHits (), message_modules.getMisses (),
+		              publishers.getHits (), publishers.getMisses ());
+	}
 	return 0;
 }
 
@@ -429,6 +388,133 @@ Pandora_Module_Logevent::timestampToSystemtime (string timestamp, SYSTEMTIME *sy
     system_time->wSecond = atoi (timestamp.substr (17, 2).c_str());
 }
 
+/**
+ * Get a message DLL, loading it if it is not in the cache.
+ *
+ * @param path Path of the DLL.
+ * @param flags LoadLibraryEx flags.
+ *
+ * @return The DLL, or NULL if it could not be loaded. It belongs to
+ *         the cache and must not be freed.
+ */
+static HMODULE
+getMessageModule (const string &path, DWORD flags) {
+    HMODULE module, evicted;
+    string key;
+
+    key = longtostr (flags) + " " + path;
+    if (message_modules.find (key, module)) {
+        return module;
+    }
+
+    module = LoadLibraryEx (path.c_str (), 0, flags);
+    if (module == NULL) {
+        pandoraDebug("LoadLibraryEx error %d. Exe file path %s.", GetLastError(), path.c_str ());
+        return NULL;
+    }
+
+    if (message_modules.insert (key, module, evicted)) {
+        FreeLibrary (evicted);
+    }
+    return module;
+}
+
+/**
+ * Get the message DLLs of an event source, separated by ';'.
+ *
+ * @param log Event log name.
+ * @param source_name Event source.
+ * @param message_file Where the DLLs are stored.
+ *
+ * @return False if the source has no message DLLs.
+ */
+static bool
+getMessageFile (const string &log, LPCSTR source_name, string &message_file) {
+    TCHAR exe_file[_MAX_PATH + 1], exe_file_path[_MAX_PATH + 1];
+    HKEY hk = (HKEY)0;
+    TCHAR key_name[_MAX_PATH + 1];
+    DWORD max_path, type;
+    string key, evicted;
+
+    key = log + "\\" + source_name;
+    if (message_files.find (key, message_file)) {
+        return true;
+    }
+
+    // Read the key that points to the message file
+    wsprintf (key_name, "SYSTEM\\CurrentControlSet\\Services\\EventLog\\%s\\%s", log.c_str (), source_name);
+    if (RegOpenKeyEx (HKEY_LOCAL_MACHINE, key_name, 0L, KEY_READ, &hk) != NOERROR) {
+       return false;
+    }
+    max_path = _MAX_PATH + 1;
+    if (RegQueryValueEx (hk, "EventMessageFile", 0, &type, (LPBYTE)exe_file, &max_path) != NOERROR) {
+        RegCloseKey(hk);
+        return false;
+    }
+    RegCloseKey(hk);
+    if (ExpandEnvironmentStrings (exe_file, exe_file_path, _MAX_PATH + 1) == 0) {
+        strncpy(exe_file_path, exe_file, _MAX_PATH + 1);
+    }
+
+    message_file = exe_file_path;
+    message_files.insert (key, message_file, evicted);
+    return true;
+}
+
+/**
+ * Get the message of an event id, with its inserts (%1, %2...) not
+ * replaced. Events without a message are cached too.
+ *
+ * @param log Event log name.
+ * @param source_name Event source.
+ * @param event_id Event id.
+ * @param flags LoadLibraryEx flags.
+ *
+ * @return The message, or an empty string if not found.
+ */
+static string
+getMessageTemplate (const string &log, LPCSTR source_name, DWORD event_id, DWORD flags) {
+    string key, message_file, message_template, path, evicted;
+    HMODULE module;
+    LPTSTR buffer;
+    size_t start, end;
+
+    key = log + "\\" + source_name + "\\" + longtostr (event_id) + "\\" + longtostr (flags);
+    if (message_templates.find (key, message_template)) {
+        return message_template;
+    }
+
+    if (! getMessageFile (log, source_name, message_file)) {
+        return message_template;
+    }
+
+    // Look in every DLL, the last one with the message wins
+    for (start = 0; start <= message_file.size (); start = end + 1) {
+        end = message_file.find (';', start);
+        if (end == string::npos) {
+            end = message_file.size ();
+        }
+
+        path = message_file.substr (start, end - start);
+        module = path.empty () ? NULL : getMessageModule (path, flags);
+        if (module == NULL) {
+            continue;
+        }
+
+        buffer = NULL;
+        if (FormatMessage (FORMAT_MESSAGE_FROM_HMODULE | FORMAT_MESSAGE_IGNORE_INSERTS | FORMAT_MESSAGE_ALLOCATE_BUFFER,
+                           module, event_id, 0, (LPTSTR) &buffer, 0, NULL) > 0) {
+            message_template = buffer;
+        }
+        if (buffer != NULL) {
+            LocalFree (buffer);
+        }
+    }
+
+    message_templates.insert (key, message_template, evicted);
+    return message_template;
+}
+
 /**
  * Retrieves the description of the given event.
  *
@@ -438,39 +524,30 @@ Pandora_Module_Logevent::timestampToSystemtime (string timestamp, SYSTEMTIME *sy
 void
 Pandora_Module_Logevent::getEventDescription (PEVENTLOGRECORD pevlr, char *message, DWORD flags) {
     int i, j, len, offset;
-    LPBYTE data = 0;
-    HMODULE module = 0;
-    TCHAR exe_file[_MAX_PATH + 1], exe_file_path[_MAX_PATH + 1];
-    HKEY hk = (HKEY)0;
-    TCHAR key_name[_MAX_PATH + 1];
-    DWORD max_path, type;
     LPCSTR source_name;
     TCHAR **strings = NULL;
-    char *dll_start = NULL, *dll_end = NULL, *exe_file_path_end = NULL;
+    string message_template;
 
     message[0] = 0;
 
     // Read the source name
     source_name = (LPCTSTR) ((LPBYTE) pevlr + sizeof(EVENTLOGRECORD));
 
-    // Read the key that points to the message file
-    wsprintf (key_name, "SYSTEM\\CurrentControlSet\\Services\\EventLog\\%s\\%s", this->source.c_str (), source_name);
-    if (RegOpenKeyEx (HKEY_LOCAL_MACHINE, key_name, 0L, KEY_READ, &hk) != NOERROR) {
-       return;
-    }
-    max_path = _MAX_PATH + 1;
-    if (RegQueryValueEx (hk, "EventMessageFile", 0, &type, (LPBYTE)exe_file, &max_path) != NOERROR) {
-        RegCloseKey(hk);
+    // Get the message of the event id, from the cache if possible
+    message_template = getMessageTemplate (this->source, source_name, pevlr->EventID, flags);
+    if (message_template.empty ()) {
         return;
     }
-    if (ExpandEnvironmentStrings (exe_file, exe_file_path, _MAX_PATH + 1) == 0) {
-        strncpy(exe_file_path, exe_file, _MAX_PATH + 1);
+
+    // No strings to insert
+    if (pevlr->NumStrings == 0) {
+        FormatMessage (FORMAT_MESSAGE_FROM_STRING | FORMAT_MESSAGE_IGNORE_INSERTS, message_template.c_str (), 0, 0, (LPTSTR)message, BUFFER_SIZE, NULL);
+        return;
     }
 
     // Get the event strings
     strings = (TCHAR**)malloc (pevlr->NumStrings * sizeof(TCHAR *));
     if (strings == NULL) {
-        RegCloseKey(hk);
         return;
     }
 
@@ -480,55 +557,23 @@ Pandora_Module_Logevent::getEventDescription (PEVENTLOGRECORD pevlr, char *messa
         strings[i] = (TCHAR *) malloc ((len + 1) * sizeof(TCHAR));
         if (strings[i] == NULL) {
            for (j = 0; j < i; j++) {
-               if (strings[j] != NULL) {
-                   free ((void *)strings[j]);
-               }
+               free ((void *)strings[j]);
            }
+           free ((void *)strings);
+           return;
         }
 		strcpy(strings[i], (TCHAR *)pevlr + offset);
 		offset += len + 1;
     }
 
-    // Move to the first DLL
-    dll_start = (char *) exe_file_path;
-    dll_end = strchr (exe_file_path, ';');
-    if (dll_end != NULL) {
-	*dll_end = '\0';
-    }
-    exe_file_path_end = ((char *) exe_file_path) + _MAX_PATH * sizeof (TCHAR);
-
-    while (1) {
-        // Load the DLL
-        module = LoadLibraryEx (dll_start, 0, flags);
-        if(module == NULL) {
-            pandoraDebug("LoadLibraryEx error %d. Exe file path %s.", GetLastError(), exe_file_path);
-        } else {
-            // Get the description
-            FormatMessage (FORMAT_MESSAGE_FROM_HMODULE | FORMAT_MESSAGE_ARGUMENT_ARRAY, module, pevlr->EventID, 0, (LPTSTR)message, BUFFER_SIZE, strings);
-	}
-
-	// No more DLLs
-	if (dll_end == NULL || dll_end >= exe_file_path_end) {
-		break;
-	}
-
-    	// Move to the next DLL
-	dll_start = dll_end + sizeof (TCHAR);
-		dll_end = strchr (dll_start, ';');
-		if (dll_end != NULL) {
-			*dll_end = '\0';
-		}
-	}
+    // Get the description
+    FormatMessage (FORMAT_MESSAGE_FROM_STRING | FORMAT_MESSAGE_ARGUMENT_ARRAY, message_template.c_str (), 0, 0, (LPTSTR)message, BUFFER_SIZE, strings);
 
     // Clean up 
     for (i = 0; i < pevlr->NumStrings; i++) {
-        if (strings[i] != NULL) {
-            free ((void *)strings[i]);
-        }
+        free ((void *)strings[i]);
     }
     free ((void *)strings);
-    FreeLibrary(module);
-    RegCloseKey(hk);
 }
 
 /**
@@ -554,7 +599,8 @@ Pandora_Module_Logevent::getEventDescriptionXPATH (PEVENTLOGRECORD pevlr) {
 	DWORD dwPropertyCount = 0;
 	LPWSTR pwsMessage = NULL;
 	EVT_HANDLE hProviderMetadata = NULL;
-    string query, path, description;
+	EVT_HANDLE evicted = NULL;
+    string query, path, description, provider;
 	
 	// Wevtapi.dll not available
 	if (WINEVENT == NULL) {
@@ -580,14 +626,17 @@ Pandora_Module_Logevent::getEventDescriptionXPATH (PEVENTLOGRECORD pevlr) {
 		return description;
 	}
 
-	// Extract data from the event
-	hContext = EvtCreateRenderContextF(count, (LPCWSTR*)ppValues, EvtRenderContextValues);
-    if (NULL == hContext) {
-		pandoraDebug ("EvtCreateRenderContext error: %d", GetLastError());
-		EvtCloseF(hEvents[0]);
-		EvtCloseF(hResults);
-		return description;
+	// Extract data from the event. The render context is created once
+	if (render_context == NULL) {
+		render_context = EvtCreateRenderContextF(count, (LPCWSTR*)ppValues, EvtRenderContextValues);
+		if (NULL == render_context) {
+			pandoraDebug ("EvtCreateRenderContext error: %d", GetLastError());
+			EvtCloseF(hEvents[0]);
+			EvtCloseF(hResults);
+			return description;
+		}
 	}
+	hContext = render_context;
 	
 	if (! EvtRenderF(hContext, hEvents[0], EvtRenderEventValues, dwBufferSize, pRenderedValues, &dwBufferUsed, &dwPropertyCount)) {
 		if ((status = GetLastError()) == ERROR_INSUFFICIENT_BUFFER) {
@@ -598,7 +647,6 @@ Pandora_Module_Logevent::getEventDescriptionXPATH (PEVENTLOGRECORD pevlr) {
 			}
 			else {
 				pandoraDebug ("EvtRender error: %d", status);
-				EvtCloseF(hContext);
 				EvtCloseF(hEvents[0]);
 				EvtCloseF(hResults);
 				return description;
@@ -607,30 +655,32 @@ Pandora_Module_Logevent::getEventDescriptionXPATH (PEVENTLOGRECORD pevlr) {
 
 		if (ERROR_SUCCESS != (status = GetLastError())) {
 			pandoraDebug ("EvtRender error: %d", status);
-			EvtCloseF(hContext);
 			EvtCloseF(hEvents[0]);
 			EvtCloseF(hResults);
 			return description;
 		}
 	}
 
-	// Get the handle to the provider's metadata that contains the message strings
-    hProviderMetadata = EvtOpenPublisherMetadataF(NULL, pRenderedValues[0].StringVal, NULL, 0, 0);
-    if (hProviderMetadata == NULL) {
-		pandoraDebug ("EvtOpenPublisherMetadata error: %d", GetLastError());
-		free(pRenderedValues);
-		EvtCloseF(hContext);
-		EvtCloseF(hEvents[0]);
-		EvtCloseF(hResults);
-		return description;
+	// Get the handle to the provider's metadata that contains the message strings, from the cache if possible
+	provider = strUnicodeToAnsi (pRenderedValues[0].StringVal);
+	if (! publishers.find (provider, hProviderMetadata)) {
+		hProviderMetadata = EvtOpenPublisherMetadataF(NULL, pRenderedValues[0].StringVal, NULL, 0, 0);
+		if (hProviderMetadata == NULL) {
+			pandoraDebug ("EvtOpenPublisherMetadata error: %d", GetLastError());
+			free(pRenderedValues);
+			EvtCloseF(hEvents[0]);
+			EvtCloseF(hResults);
+			return description;
+		}
+		if (publishers.insert (provider, hProviderMetadata, evicted)) {
+			EvtCloseF(evicted);
+		}
 	}
 
 	// Read the event message
 	pwsMessage = GetMessageString(hProviderMetadata, hEvents[0], EvtFormatMessageEvent);
     if (pwsMessage == NULL) {
 		free(pRenderedValues);
-		EvtCloseF(hProviderMetadata);
-		EvtCloseF(hContext);
 		EvtCloseF(hEvents[0]);
 		EvtCloseF(hResults);
 		return description;
@@ -642,8 +692,6 @@ Pandora_Module_Logevent::getEventDescriptionXPATH (PEVENTLOGRECORD pevlr) {
 	// Cleanup
 	free(pwsMessage);
 	free(pRenderedValues);
-	EvtCloseF(hProviderMetadata);
-	EvtCloseF(hContext);
 	EvtCloseF(hEvents[0]);
 	EvtCloseF(hResults);
 	return description;
@@ -697,14 +745,14 @@ Pandora_Module_Logevent::GetMessageString(EVT_HANDLE hMetadata, EVT_HANDLE hEven
 }
 
 /**
- * Filters the given event according to the module parameters.
+ * Filters the given event by the fields of its record, before its
+ * description is formatted.
  *
  * @param event Event log record.
- * @param event Event description.22
  * @return Returns 0 if the event matches the filters, -1 otherwise.
  */
 int
-Pandora_Module_Logevent::filterEvent (PEVENTLOGRECORD pevlr, string description) {
+Pandora_Module_Logevent::filterRecord (PEVENTLOGRECORD pevlr) {
     LPCSTR source_name;
 
     // Event ID filter
@@ -723,6 +771,18 @@ Pandora_Module_Logevent::filterEvent (PEVENTLOGRECORD pevlr, string description)
         return -1;
     }
 
+    return 0;
+}
+
+/**
+ * Filters the given event by its description.
+ *
+ * @param event Event description.
+ * @return Returns 0 if the event matches the filters, -1 otherwise.
+ */
+int
+Pandora_Module_Logevent::filterEvent (string description) {
+
     // Pattern filter
     if (! this->pattern.empty () && regexec (&this->regexp, description.c_str (), 0, NULL, 0) != 0) {
         return -1;
@@ -23,6 +23,7 @@
 #define	__PANDORA_MODULE_LOGEVENT_H__
 
 #include "pandora_module.h"
+#include "pandora_event_reader.h"
 #include "boost/regex.h"
 #include "../windows/winevt.h"
 
@@ -32,6 +33,12 @@
 // Length of a timestamp string YYYY-MM-DD HH:MM:SS
 #define	TIMESTAMP_LEN 19
 
+// Entries of the event description caches
+#define	MESSAGE_FILE_CACHE_SIZE 256      // Message DLLs of each source
+#define	MESSAGE_MODULE_CACHE_SIZE 32     // Message DLLs loaded
+#define	MESSAGE_TEMPLATE_CACHE_SIZE 1024 // Messages of each source and event id
+#define	PUBLISHER_CACHE_SIZE 32          // Publisher metadata opened
+
 // The EventID property equals the InstanceId with the top two bits masked off.
 // See: http://msdn.microsoft.com/en-us/library/system.diagnostics.eventlogentry.eventid.aspx
 //#define EVENT_ID_MASK 0x3FFFFFFF
@@ -60,24 +67,25 @@ namespace Pandora_Modules {
 		regex_t regexp;
 		unsigned long id;
 		int type;
-		unsigned char first_run;
 		string source;
 		string application;
 		string pattern;
-		HANDLE log_event;
+		Pandora_Event_Reader *reader;
 		HANDLE messages_dll;
 
-        HANDLE openLogEvent ();
+        bool openLogEvent ();
         void closeLogEvent ();
-        int getLogEvents (list<string> &event_list, unsigned char discard);
+        int getLogEvents (list<string> &event_list);
         void timestampToSystemtime (string timestamp, SYSTEMTIME *system_time);
         void getEventDescription (PEVENTLOGRECORD pevlr, char *message, DWORD flags);
 		string getEventDescriptionXPATH (PEVENTLOGRECORD pevlr);
-        int filterEvent (PEVENTLOGRECORD pevlr, string description);
+        int filterRecord (PEVENTLOGRECORD pevlr);
+        int filterEvent (string description);
 		LPWSTR GetMessageString(EVT_HANDLE hMetadata, EVT_HANDLE hEvent, EVT_FORMAT_MESSAGE_FLAGS FormatId);
 
 	public:
 		Pandora_Module_Logevent (string name, string source, string type, string id, string pattern, string application);
+		~Pandora_Module_Logevent ();
 		void run ();
 	};
 }
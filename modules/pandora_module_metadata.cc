@@ -0,0 +1,133 @@
+/* Metadata shared between modules.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_module_metadata.h"
+
+#include <map>
+
+using namespace Pandora_Modules;
+
+/* Fields compared when looking up the pool */
+static string Module_Metadata::* const metadata_fields[] = {
+	&Module_Metadata::min_critical,
+	&Module_Metadata::max_critical,
+	&Module_Metadata::min_warning,
+	&Module_Metadata::max_warning,
+	&Module_Metadata::post_process,
+	&Module_Metadata::disabled,
+	&Module_Metadata::min_ff_event,
+	&Module_Metadata::unit,
+	&Module_Metadata::custom_id,
+	&Module_Metadata::str_warning,
+	&Module_Metadata::str_critical,
+	&Module_Metadata::module_group,
+	&Module_Metadata::warning_inverse,
+	&Module_Metadata::critical_inverse,
+	&Module_Metadata::quiet,
+	&Module_Metadata::module_ff_interval,
+	&Module_Metadata::critical_instructions,
+	&Module_Metadata::warning_instructions,
+	&Module_Metadata::unknown_instructions,
+	&Module_Metadata::tags
+};
+
+/* Interned instances and the number of modules using them */
+static map<Module_Metadata, unsigned long> *
+getPool () {
+	static map<Module_Metadata, unsigned long> *pool = NULL;
+
+	if (pool == NULL) {
+		pool = new map<Module_Metadata, unsigned long> ();
+	}
+	return pool;
+}
+
+/**
+ * Compares two metadata instances field by field.
+ *
+ * @param metadata Metadata to compare with.
+ *
+ * @return True if this instance sorts before the given one.
+ */
+bool
+Module_Metadata::operator< (const Module_Metadata &metadata) const {
+	size_t i;
+	int    cmp;
+
+	for (i = 0; i < sizeof (metadata_fields) / sizeof (metadata_fields[0]); i++) {
+		cmp = (this->*metadata_fields[i]).compare (metadata.*metadata_fields[i]);
+		if (cmp != 0) {
+			return cmp < 0;
+		}
+	}
+	return false;
+}
+
+/**
+ * Get the shared instance with the given values.
+ *
+ * @param metadata Metadata values.
+ *
+ * @return The shared instance. It must be released with release ()
+ *         when it is no longer used.
+ */
+const Module_Metadata *
+Module_Metadata::intern (const Module_Metadata &metadata) {
+	map<Module_Metadata, unsigned long>::iterator iter;
+
+	iter = getPool ()->insert (make_pair (metadata, 0UL)).first;
+	iter->second++;
+	return &(iter->first);
+}
+
+/**
+ * Drop a reference to a shared instance.
+ *
+ * The instance is removed from the pool when no module uses it.
+ *
+ * @param metadata Instance returned by intern ().
+ */
+void
+Module_Metadata::release (const Module_Metadata *metadata) {
+	map<Module_Metadata, unsigned long>::iterator iter;
+
+	if (metadata == NULL) {
+		return;
+	}
+
+	iter = getPool ()->find (*metadata);
+	if (iter == getPool ()->end ()) {
+		return;
+	}
+
+	iter->second--;
+	if (iter->second == 0) {
+		getPool ()->erase (iter);
+	}
+}
+
+/**
+ * Get the number of distinct metadata instances in use.
+ *
+ * @return Number of interned instances.
+ */
+unsigned long
+Module_Metadata::getPoolSize () {
+	return getPool ()->size ();
+}
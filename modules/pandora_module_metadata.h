@@ -0,0 +1,54 @@
+/* Metadata shared between modules.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_MODULE_METADATA_H__
+#define	__PANDORA_MODULE_METADATA_H__
+
+#include <string>
+
+using namespace std;
+
+namespace Pandora_Modules {
+	/**
+	 * Thresholds, instructions, tags and the rest of the descriptive
+	 * fields of a module, which the agent only copies to the XML.
+	 *
+	 * Large module populations usually repeat the same values, so the
+	 * metadata is interned: modules with identical fields point to the
+	 * same reference counted instance instead of holding their own
+	 * copies. An interned instance must never be modified; copy it,
+	 * change the copy and intern it again.
+	 */
+	class Module_Metadata {
+	public:
+		string min_critical, max_critical, min_warning, max_warning;
+		string post_process, disabled, min_ff_event;
+		string unit, custom_id, str_warning, str_critical;
+		string module_group, warning_inverse, critical_inverse, quiet, module_ff_interval;
+		string critical_instructions, warning_instructions, unknown_instructions, tags;
+
+		bool   operator<               (const Module_Metadata &metadata) const;
+
+		static const Module_Metadata *intern  (const Module_Metadata &metadata);
+		static void                   release (const Module_Metadata *metadata);
+		static unsigned long          getPoolSize ();
+	};
+}
+
+#endif /* __PANDORA_MODULE_METADATA_H__ */
@@ -26,6 +26,10 @@ using namespace Pandora;
 using namespace Pandora_Strutils;
 using namespace Pandora_Modules;
 
+/* Persistent plugin protocol */
+#define PLUGIN_REQUEST "collect\n"
+#define PLUGIN_END     "<!-- pandora_end -->"
+
 /** 
  * Creates a Pandora_Module_Plugin object.
  * 
@@ -36,6 +40,95 @@ Pandora_Module_Plugin::Pandora_Module_Plugin (string name, string plugin)
 					 : Pandora_Module_Exec ("plugin", plugin) {
 	this->setKind (module_plugin_str);
 	this->setTimeout (INT_MAX);
+	this->persistent = false;
+	this->started = false;
+}
+
+/** 
+ * Keep the plugin running between runs.
+ *
+ * A persistent plugin that hangs would block the module loop, so its
+ * timeout is set to PLUGIN_PERSISTENT_TIMEOUT; call setTimeout ()
+ * afterwards to change it.
+ *
+ * @param persistent True to start the plugin once and request a
+ *        collection on each run.
+ */
+void
+Pandora_Module_Plugin::setPersistent (bool persistent) {
+	this->persistent = persistent;
+	if (persistent) {
+		this->setTimeout (PLUGIN_PERSISTENT_TIMEOUT);
+	} else {
+		this->process.stop ();
+		this->setTimeout (INT_MAX);
+	}
+}
+
+/** 
+ * Check if the plugin is kept running between runs.
+ *
+ * @return True if the plugin is persistent.
+ */
+bool
+Pandora_Module_Plugin::isPersistent () const {
+	return this->persistent;
+}
+
+/** 
+ * Run the plugin, or request a collection from it if persistent.
+ */
+void
+Pandora_Module_Plugin::run () {
+	Pandora_Output_Buffer output;
+	string                trailer;
+	int                   result;
+
+	if (! this->persistent) {
+		Pandora_Module_Exec::run ();
+		return;
+	}
+
+	try {
+		Pandora_Module::run ();
+	} catch (Interval_Not_Fulfilled e) {
+		this->has_output = false;
+		return;
+	}
+
+	/* Start the plugin, or start it again if it died */
+	if (! this->process.isRunning ()) {
+		if (this->started) {
+			pandoraLog ("Pandora_Module_Plugin: %s is not running, restarting it",
+				    this->module_command.c_str ());
+		}
+		pandoraDebug ("Starting persistent plugin: %s", this->module_exec.c_str ());
+		if (! this->process.start (this->module_exec, getPandoraInstallDir () + "util\\",
+					   this->getEnvironment ())) {
+			pandoraLog ("Pandora_Module_Plugin: %s could not be started. Err: %d",
+				    this->module_command.c_str (), GetLastError ());
+			this->has_output = false;
+			return;
+		}
+		this->started = true;
+	}
+
+	this->limitOutput (output);
+	if (! this->process.write (PLUGIN_REQUEST)) {
+		result = PIPE_ERROR;
+	} else {
+		result = this->process.readUntil (PLUGIN_END, this->getTimeout (), output, trailer);
+	}
+	if (result != PIPE_OK) {
+		pandoraLog ("Pandora_Module_Plugin: %s %s, it will be restarted",
+			    this->module_command.c_str (),
+			    (result == PIPE_TIMEOUT) ? "timed out" : "died");
+		this->process.stop ();
+		this->has_output = false;
+		return;
+	}
+
+	this->setResult (output.getData (), output.isTruncated (), 0);
 }
 
 /** 
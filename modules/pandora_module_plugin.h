@@ -21,6 +21,10 @@
 #define	__PANDORA_MODULE_PLUGIN_H__
 
 #include "pandora_module_exec.h"
+#include "../misc/pandora_pipe_process.h"
+
+/* Seconds a persistent plugin has to answer, unless module_timeout is set */
+#define PLUGIN_PERSISTENT_TIMEOUT 30
 
 namespace Pandora_Modules {
 	/**
@@ -29,10 +33,25 @@ namespace Pandora_Modules {
 	 *
 	 * Any custom order that want to be executed can be put in
 	 * the <code>util</code> directory into the Pandora agent path.
+	 *
+	 * A persistent plugin is started once and kept running. On each
+	 * run the agent writes a "collect" line to its standard input,
+	 * and the plugin answers with its module XML followed by a
+	 * "<!-- pandora_end -->" line. If the plugin dies, it is started
+	 * again on the next run, as it is if it does not answer within
+	 * the module timeout. Since the plugin is started only once,
+	 * the variables saved by other modules are those of its start.
 	 */
 	class Pandora_Module_Plugin : public Pandora_Module_Exec {
+	private:
+		bool                 persistent;
+		bool                 started;
+		Pandora_Pipe_Process process;
 	public:
 		Pandora_Module_Plugin    (string name, string plugin);
+		void           setPersistent (bool persistent);
+		bool           isPersistent  () const;
+		void           run       ();
 		virtual string getXml    ();
 	};
 }
@@ -38,25 +38,34 @@ using namespace Pandora_Modules;
  */
 Pandora_Module_Regexp::Pandora_Module_Regexp (string name, string source, string pattern, unsigned char no_seek_eof)
 	: Pandora_Module (name) {
+    regex_t regexp;
  
     this->source = source;
+    this->pattern = pattern;
 	this->no_seek_eof = no_seek_eof;
 	
-    // Compile the regular expression
-    if (regcomp (&this->regexp, pattern.c_str (), REG_EXTENDED) != 0) {
+    // Check the regular expression, the tailer compiles its own copy
+    if (regcomp (&regexp, pattern.c_str (), REG_EXTENDED) != 0) {
        pandoraLog ("Invalid regular expression %s", pattern.c_str ());
+    } else {
+       regfree (&regexp);
     }
  
-    // Check whether the file can be opened
-    this->file.open (source.c_str ());
-    if (this->file.is_open ()) {
-		this->file.close ();
-    } else {
-        pandoraLog ("Error opening file %s", source.c_str ());
+    // Check whether the file can be opened, the files of a directory
+    // or wildcard source are listed later
+    if (! Pandora_File_Tailer::isMultiple (source)) {
+        ifstream file (source.c_str ());
+        if (file.is_open ()) {
+            file.close ();
+        } else {
+            pandoraLog ("Error opening file %s", source.c_str ());
+        }
     }
  
-	// Set file size to 0
-	this->size = 0;
+	this->count = 0;
+	this->matches_bytes = 0;
+	Pandora_File_Tailer::setCheckpointDir (getPandoraInstallDir ());
+	this->tailer = Pandora_File_Tailer::subscribe (source, no_seek_eof == 1, this);
 	
 	this->setKind (module_regexp_str);
 }
@@ -65,19 +74,72 @@ Pandora_Module_Regexp::Pandora_Module_Regexp (string name, string source, string
  * Pandora_Module_Regexp destructor.
  */
 Pandora_Module_Regexp::~Pandora_Module_Regexp () {
-	regfree (&this->regexp);
-	if (this->file.is_open ()) {
-		this->file.close();
-	}
+	this->tailer->unsubscribe (this);
+}
+
+/** 
+ * Get the regular expression of the module.
+ *
+ * @return The extended regular expression.
+ */
+string
+Pandora_Module_Regexp::getPattern () const {
+	return this->pattern;
+}
+
+/** 
+ * Set how the files of a directory or wildcard source are listed.
+ *
+ * @param refresh Seconds between listings, or 0 for the default.
+ * @param max_open Files kept open, or 0 for the default.
+ */
+void
+Pandora_Module_Regexp::setListing (int refresh, int max_open) {
+	this->tailer->setListing (refresh, max_open);
+}
+
+/** 
+ * Keep a line of the file that matches the pattern until the module runs.
+ *
+ * The tailer keeps reading for the other modules on the file while
+ * this one does not run, so the kept lines are bound by the limits of
+ * the module and REGEXP_MAX_MATCHES. The lines past them are dropped,
+ * and counted in the XML of log modules.
+ *
+ * @param line Line read from the file.
+ */
+void
+Pandora_Module_Regexp::processMatch (const string &line) {
+    Module_Type type;
+    string entry;
+
+    this->count++;
+
+    type = this->getTypeInt ();
+    if (type == TYPE_GENERIC_DATA_STRING || type == TYPE_ASYNC_STRING) {
+        entry = line;
+    } else if (type == TYPE_LOG) {
+        entry = line + '\n';
+    } else {
+        return;
+    }
+
+    if (this->matches.size () >= REGEXP_MAX_MATCHES ||
+        ! this->fitsLogLimits (this->matches_bytes + entry.size (), this->matches.size () + 1)) {
+        if (type == TYPE_LOG) {
+            this->dropLogOutput (entry.size ());
+        }
+        return;
+    }
+
+    this->matches.push_back (entry);
+    this->matches_bytes += entry.size ();
 }
 
 void
 Pandora_Module_Regexp::run () {
-    int count;
-	string line;
 	ostringstream output;
     Module_Type type;
-	struct stat file_stat; 
    
     type = this->getTypeInt ();
 
@@ -88,82 +150,27 @@ Pandora_Module_Regexp::run () {
 		return;
 	}
 
-    // Check if the file could be opened
-    if (! file.is_open () || ! file.good ()) {
-        this->restart (this->no_seek_eof);
+    // Read the new lines, for every module on the same file
+    if (! this->tailer->poll ()) {
+        pandoraLog ("Error opening file %s", this->source.c_str ());
+        return;
     }
-	
-	// Check if the file was truncated
-	if (this->no_seek_eof == 0 && stat (this->source.c_str (), &file_stat ) == 0) {
-		if (file_stat.st_size < this->size) {
-			this->restart (1);
-		}
-		
-		// Save current file size
-		this->size = file_stat.st_size;
-	}
-
-	// Check again, in case an open or a restart failed
-    if (! file.is_open () || ! file.good ()) {
-		return;
-	}
-
-    // Read new lines
-    count = 0;
-    while (! file.eof ()) {
-        getline (file, line);
-        
-        // Discard empty lines
-        if (line.empty ()) {
-            continue;
-        }
 
-        // Try to match the line with the regexp
-        if (regexec (&this->regexp, line.c_str (), 0, NULL, 0) == 0) {
-            if (type == TYPE_GENERIC_DATA_STRING || type == TYPE_ASYNC_STRING) {
-                this->setOutput (line);
-            } else if (type == TYPE_LOG) {
-				this->setOutput (line + '\n');
-			}
-            count++;
-        }
-    }
-    
     // Set output according to the module type
     if (type == TYPE_GENERIC_DATA_STRING || type == TYPE_ASYNC_STRING || type == TYPE_LOG) {
-        // Already set
+        while (! this->matches.empty ()) {
+            this->setOutput (this->matches.front ());
+            this->matches.pop_front ();
+        }
     }
     else if (type == TYPE_GENERIC_PROC || type == TYPE_ASYNC_PROC) {
-        this->setOutput (count > 0 ? "1" : "0");
+        this->setOutput (this->count > 0 ? "1" : "0");
     } else {
-        output << count;
+        output << this->count;
         this->setOutput (output.str ());
     }
 
-    // Clear the EOF flag
-    file.clear ();
-    
-    // Next time the file will be opened again and read from the start
-    if (this->no_seek_eof == 1) {
-		this->file.close();
-	}
-}
-
-/**
- * Closes, re-opens and seeks to the end of the current file.
- */
-void
-Pandora_Module_Regexp::restart (unsigned char no_seek_eof) {
-	if (this->file.is_open ()) {
-		this->file.close ();
-	}
-    this->file.open (this->source.c_str ());
-    if (this->file.is_open ()) {
-		if (no_seek_eof == 0) {
-			this->file.seekg (0, ios_base::end);
-		}
-        return;
-    }
-    
-    pandoraLog ("Error opening file %s", this->source.c_str ());
+    this->matches.clear ();
+    this->matches_bytes = 0;
+    this->count = 0;
 }
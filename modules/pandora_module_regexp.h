@@ -23,32 +23,46 @@
 #define	__PANDORA_MODULE_REGEXP_H__
 
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <sys/stat.h>
+#include <list>
 
 #include "pandora_module.h"
-#include "boost/regex.h"
+#include "pandora_file_tailer.h"
+
+/* Matches kept until the module runs, besides the limits of log
+   modules (module_max_output and module_max_lines) */
+#define REGEXP_MAX_MATCHES 10000
 
 namespace Pandora_Modules {
     
 	/**
 	 * This module searches a file for matches of a regular expression.
+	 *
+	 * The new lines of the file are read by a tailer shared with the
+	 * other modules on the same file, which matches each line against
+	 * the patterns of all of them at once. The matches are kept until
+	 * the module runs, within the limits of the module.
+	 *
+	 * The source may also be a directory, or have wildcards in its
+	 * file name, to search all the files it covers.
 	 */
 
-	class Pandora_Module_Regexp : public Pandora_Module {
+	class Pandora_Module_Regexp : public Pandora_Module, public Pandora_Tailer_Subscriber {
 	private:
         string source;
-        ifstream file;
-        regex_t regexp;
-        off_t size;
+        string pattern;
         unsigned char no_seek_eof;
-        void restart (unsigned char seek_eof);
-        
+        Pandora_File_Tailer *tailer;
+        int count;
+        list<string> matches;
+        size_t matches_bytes;
 
 	public:
 		Pandora_Module_Regexp (string name, string source, string pattern, unsigned char no_seek_eof);
 		virtual ~Pandora_Module_Regexp ();
+		string getPattern () const;
+		void setListing (int refresh, int max_open);
+		void processMatch (const string &line);
 		void run ();
 	};
 }
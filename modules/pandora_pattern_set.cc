@@ -0,0 +1,301 @@
+/* Set of regular expressions matched in a single pass.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_pattern_set.h"
+
+#include <queue>
+
+/* Per pattern results of the last text */
+#define RESULT_NO_MATCH  0 /* Checked, or its literal is missing */
+#define RESULT_CANDIDATE 1 /* Its literal was found, not checked yet */
+#define RESULT_MATCH     2
+
+/* Above this number of literals, the automaton is used */
+#define MAX_MEMCHR_LITERALS 4
+
+using namespace Pandora_Modules;
+
+/**
+ * Creates an empty set.
+ */
+Pandora_Pattern_Set::Pandora_Pattern_Set () {
+	this->compiled = false;
+	this->has_text = false;
+}
+
+/**
+ * Destroys the set and its compiled expressions.
+ */
+Pandora_Pattern_Set::~Pandora_Pattern_Set () {
+	size_t i;
+
+	for (i = 0; i < this->regexps.size (); i++) {
+		regfree (this->regexps[i]);
+		delete this->regexps[i];
+	}
+}
+
+/**
+ * Add a pattern to the set.
+ *
+ * @param pattern Regular expression.
+ * @param extended True for extended syntax (REG_EXTENDED), false for
+ *        basic.
+ *
+ * @return Index of the pattern in the set, -1 if it is not valid.
+ */
+int
+Pandora_Pattern_Set::add (const string &pattern, bool extended) {
+	regex_t *regexp;
+
+	regexp = new regex_t;
+	if (regcomp (regexp, pattern.c_str (), extended ? REG_EXTENDED : 0) != 0) {
+		delete regexp;
+		return -1;
+	}
+
+	this->regexps.push_back (regexp);
+	this->filters.push_back (Pandora_Literal_Filter (pattern, extended));
+	if (! this->filters.back ().getLiteral ().empty ()) {
+		this->literal_patterns.push_back (this->regexps.size () - 1);
+	}
+
+	this->compiled = false;
+	this->has_text = false;
+	return this->regexps.size () - 1;
+}
+
+/**
+ * Get the number of patterns of the set.
+ *
+ * @return Number of patterns.
+ */
+size_t
+Pandora_Pattern_Set::getSize () const {
+	return this->regexps.size ();
+}
+
+/**
+ * Build the automaton of the literals.
+ *
+ * The bytes that do not appear in any literal share the same class,
+ * which keeps the table small enough for the processor cache. The
+ * transitions of every state are resolved through the failure links
+ * beforehand, so matching takes one lookup per byte.
+ */
+void
+Pandora_Pattern_Set::compile () {
+	vector<int>  failure;
+	queue<int>   pending;
+	string       literal;
+	size_t       i, j;
+	int          state, next, c, width;
+
+	/* Byte classes: 0 for the bytes of no literal */
+	this->classes.assign (256, 0);
+	width = 1;
+	for (i = 0; i < this->literal_patterns.size (); i++) {
+		literal = this->filters[this->literal_patterns[i]].getLiteral ();
+		for (j = 0; j < literal.size (); j++) {
+			if (this->classes[(unsigned char) literal[j]] == 0) {
+				this->classes[(unsigned char) literal[j]] = width++;
+			}
+		}
+	}
+	this->width = width;
+
+	this->transitions.assign (width, -1);
+	this->found.assign (1, vector<size_t> ());
+
+	/* Trie of the literals */
+	for (i = 0; i < this->literal_patterns.size (); i++) {
+		literal = this->filters[this->literal_patterns[i]].getLiteral ();
+		state = 0;
+		for (j = 0; j < literal.size (); j++) {
+			c = this->classes[(unsigned char) literal[j]];
+			if (this->transitions[state * width + c] < 0) {
+				this->transitions[state * width + c] = this->found.size ();
+				this->transitions.resize (this->transitions.size () + width, -1);
+				this->found.push_back (vector<size_t> ());
+			}
+			state = this->transitions[state * width + c];
+		}
+		this->found[state].push_back (this->literal_patterns[i]);
+	}
+
+	/* Failure links, breadth first */
+	failure.assign (this->found.size (), 0);
+	for (c = 0; c < width; c++) {
+		next = this->transitions[c];
+		if (next < 0) {
+			this->transitions[c] = 0;
+		} else {
+			pending.push (next);
+		}
+	}
+	while (! pending.empty ()) {
+		state = pending.front ();
+		pending.pop ();
+
+		this->found[state].insert (this->found[state].end (),
+					   this->found[failure[state]].begin (),
+					   this->found[failure[state]].end ());
+
+		for (c = 0; c < width; c++) {
+			next = this->transitions[state * width + c];
+			if (next < 0) {
+				this->transitions[state * width + c] = this->transitions[failure[state] * width + c];
+			} else {
+				failure[next] = this->transitions[failure[state] * width + c];
+				pending.push (next);
+			}
+		}
+	}
+
+	/* Store the offset of the next state in the table, shifted to flag
+	   the states that found a literal in the lowest bit */
+	for (i = 0; i < this->transitions.size (); i++) {
+		next = this->transitions[i];
+		this->transitions[i] = next * width * 2 + (this->found[next].empty () ? 0 : 1);
+	}
+
+	this->compiled = true;
+}
+
+/**
+ * Find the patterns that may match a text.
+ *
+ * @param text Text to scan.
+ * @param size Length of the text.
+ */
+void
+Pandora_Pattern_Set::scan (const char *text, size_t size) {
+	const vector<size_t> *patterns;
+	const unsigned char  *data, *classes;
+	const int            *table;
+	size_t                i, j;
+	int                   entry, offset = 0;
+
+	/* Patterns without a literal are always candidates */
+	this->results.assign (this->regexps.size (), RESULT_CANDIDATE);
+	for (i = 0; i < this->literal_patterns.size (); i++) {
+		this->results[this->literal_patterns[i]] = RESULT_NO_MATCH;
+	}
+
+	/* A few memchr () passes are faster than the automaton */
+	if (this->literal_patterns.size () <= MAX_MEMCHR_LITERALS) {
+		for (i = 0; i < this->literal_patterns.size (); i++) {
+			j = this->literal_patterns[i];
+			if (this->filters[j].mayMatch (text, size)) {
+				this->results[j] = RESULT_CANDIDATE;
+			}
+		}
+		return;
+	}
+
+	if (! this->compiled) {
+		this->compile ();
+	}
+
+	/* Plain pointers, so they stay in registers */
+	table = &(this->transitions[0]);
+	classes = &(this->classes[0]);
+	data = (const unsigned char *) text;
+
+	for (i = 0; i < size; i++) {
+		entry = table[offset + classes[data[i]]];
+		offset = entry >> 1;
+		if (entry & 1) {
+			patterns = &(this->found[offset / this->width]);
+			for (j = 0; j < patterns->size (); j++) {
+				this->results[(*patterns)[j]] = RESULT_CANDIDATE;
+			}
+		}
+	}
+}
+
+/**
+ * Check a candidate pattern with its regular expression.
+ *
+ * @param index Index of the pattern.
+ * @param text Text scanned, terminated by a NUL byte.
+ *
+ * @return True if the pattern matches the text.
+ */
+bool
+Pandora_Pattern_Set::verify (size_t index, const char *text) {
+	if (this->results[index] == RESULT_CANDIDATE) {
+		this->results[index] = (regexec (this->regexps[index], text, 0, NULL, 0) == 0)
+				       ? RESULT_MATCH : RESULT_NO_MATCH;
+	}
+	return this->results[index] == RESULT_MATCH;
+}
+
+/**
+ * Check if a pattern matches a text.
+ *
+ * A new text is scanned for all the patterns at once, and each
+ * pattern is verified the first time it is asked for.
+ *
+ * @param index Index of the pattern.
+ * @param text Text to check.
+ *
+ * @return True if the pattern matches the text.
+ */
+bool
+Pandora_Pattern_Set::matches (size_t index, const string &text) {
+	if (index >= this->regexps.size ()) {
+		return false;
+	}
+
+	if (! this->has_text || text != this->text) {
+		this->scan (text.c_str (), text.size ());
+		this->text = text;
+		this->has_text = true;
+	}
+
+	return this->verify (index, text.c_str ());
+}
+
+/**
+ * Get all the patterns that match a text.
+ *
+ * The text is not copied, so it can point into a read buffer.
+ *
+ * @param text Text to check. It must be terminated by a NUL byte.
+ * @param size Length of the text.
+ * @param matches Where the indexes of the matching patterns are
+ *        stored, in ascending order.
+ */
+void
+Pandora_Pattern_Set::match (const char *text, size_t size, vector<size_t> &matches) {
+	size_t i;
+
+	matches.clear ();
+
+	/* Not kept for matches (), it would be a copy for each line */
+	this->has_text = false;
+	this->scan (text, size);
+
+	for (i = 0; i < this->regexps.size (); i++) {
+		if (this->verify (i, text)) {
+			matches.push_back (i);
+		}
+	}
+}
@@ -0,0 +1,82 @@
+/* Set of regular expressions matched in a single pass.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_PATTERN_SET_H__
+#define	__PANDORA_PATTERN_SET_H__
+
+#include "pandora_literal_filter.h"
+#include "boost/regex.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Pandora_Modules {
+	/**
+	 * Regular expressions matched against the same texts.
+	 *
+	 * The literals required by the patterns (see
+	 * Pandora_Literal_Filter) are compiled into an Aho-Corasick
+	 * automaton, so a single pass over a text finds which patterns
+	 * may match it. Only those, and the patterns without a literal,
+	 * are verified with regexec (). With only a few literals, each one
+	 * is searched with memchr () instead, which is faster.
+	 *
+	 * The results for the last text are cached, so the conditions of
+	 * a module that check the same value scan it only once.
+	 */
+	class Pandora_Pattern_Set {
+	private:
+		vector<regex_t *>              regexps;
+		vector<Pandora_Literal_Filter> filters;
+		vector<size_t>                 literal_patterns;
+
+		/* Automaton: byte classes, offsets of the next states (one per
+		   class and state) and patterns found in each state */
+		bool                           compiled;
+		vector<unsigned char>          classes;
+		int                            width;
+		vector<int>                    transitions;
+		vector<vector<size_t> >        found;
+
+		/* Results for the last text */
+		string                         text;
+		bool                           has_text;
+		vector<char>                   results;
+
+		Pandora_Pattern_Set           (const Pandora_Pattern_Set &);
+		Pandora_Pattern_Set &operator= (const Pandora_Pattern_Set &);
+
+		void       compile            ();
+		void       scan               (const char *text, size_t size);
+		bool       verify             (size_t index, const char *text);
+	public:
+		Pandora_Pattern_Set           ();
+		~Pandora_Pattern_Set          ();
+
+		int        add                (const string &pattern, bool extended);
+		size_t     getSize            () const;
+
+		bool       matches            (size_t index, const string &text);
+		void       match              (const char *text, size_t size,
+					       vector<size_t> &matches);
+	};
+}
+
+#endif /* __PANDORA_PATTERN_SET_H__ */
@@ -19,8 +19,10 @@
 */
 
 #include <fstream>
+#include <sstream>
 #include "pandora_agent_conf.h"
 #include "pandora_strutils.h"
+#include "misc/pandora_conf_loader.h"
 #include <iostream>
 #include "pandora.h"
 
@@ -56,16 +58,39 @@ Pandora::Pandora_Agent_Conf::getInstance () {
 
 /**
  * Additional configuration file.
+ *
+ * The collections of each include file are kept with its fingerprint,
+ * so an unchanged file is not parsed again.
  */
 void
 Pandora::Pandora_Agent_Conf::parseFile(string path_file, Collection *aux){
-	ifstream     file_conf (path_file.c_str ());
-	string buffer;
+	map<string, pair<string, list<string> > >::iterator cached;
+	list<string>           *names;
+	list<string>::iterator  iter;
+	string buffer, text, md5;
 	int pos;
 
-	if (!file_conf.is_open ()) {
+	md5 = Pandora_Conf_Loader::getInstance ()->getMd5 (path_file);
+	cached = this->include_collections.find (path_file);
+	if (cached != this->include_collections.end () && cached->second.first == md5) {
+		names = &(cached->second.second);
+		for (iter = names->begin (); iter != names->end (); iter++) {
+			aux = new Collection();
+			aux->name = *iter;
+			aux->verify = 0;
+			collection_list->push_back (*aux);
+			delete aux;
+		}
+		return;
+	}
+
+	this->include_collections[path_file] = make_pair (md5, list<string> ());
+	names = &(this->include_collections[path_file].second);
+
+	if (!Pandora_Conf_Loader::getInstance ()->getText (path_file, text)) {
 		return;
 	}
+	istringstream file_conf (text);
 	
 	/* Read and set the file */
 	while (!file_conf.eof ()) {
@@ -92,13 +117,14 @@ Pandora::Pandora_Agent_Conf::parseFile(string path_file, Collection *aux){
 				if ( collection_name.find("..") == string::npos ) {
 					aux->verify = 0;
 					collection_list->push_back (*aux);
+					names->push_back (aux->name);
 				}
+				delete aux;
 				continue;
 			}
 		}
 	}
 	
-	file_conf.close();
 	return;
 }
 
@@ -109,14 +135,16 @@ Pandora::Pandora_Agent_Conf::parseFile(string path_file, Collection *aux){
  */
 void
 writeBrokerConf(string path_broker, string filename, string name_broker){
-	ifstream     file_conf (filename.c_str ());
 	ofstream     file_broker ((Pandora::getPandoraInstallDir ()+path_broker).c_str ());
-	string       buffer;
+	string       buffer, text;
 	string		 comp;
 	int pos;
 	int i; 
 	int ok;
 	
+	Pandora_Conf_Loader::getInstance ()->getText (filename, text);
+	istringstream file_conf (text);
+
 	/* Read and set the file */
 	while (!file_conf.eof ()) {
 		/* Set the value from each line */
@@ -147,7 +175,6 @@ writeBrokerConf(string path_broker, string filename, string name_broker){
 		file_broker << buffer;
 		
 	}
-	file_conf.close ();
 	file_broker.close();
 }
 
@@ -156,11 +183,14 @@ Pandora::Pandora_Agent_Conf::setFile (string *all_conf){
 	string       buffer, filename;
 	int pos;
 	Collection *aux;
+	string       text;
+	bool         loaded;
 	
 	filename = Pandora::getPandoraInstallDir ();
 	filename += "pandora_agent.conf";
 
-	ifstream     file (filename.c_str ());
+	loaded = Pandora_Conf_Loader::getInstance ()->getText (filename, text);
+	istringstream file (text);
 
 	if (this->key_values)
 		delete this->key_values;
@@ -170,7 +200,7 @@ Pandora::Pandora_Agent_Conf::setFile (string *all_conf){
 		delete this->collection_list;
 	this->collection_list = new list<Collection> ();
 	
-	if (!file.is_open ()) {
+	if (!loaded) {
 		return;
 	}
 	
@@ -250,7 +280,6 @@ Pandora::Pandora_Agent_Conf::setFile (string *all_conf){
 			}
 		}
 	}
-	file.close ();
 }
 
 /**
@@ -266,10 +295,13 @@ Pandora::Pandora_Agent_Conf::setFile (string *all_conf){
  */
 void
 Pandora::Pandora_Agent_Conf::setFile (string filename) {
-	ifstream     file (filename.c_str ());
-	string       buffer;
+	string       buffer, text;
 	int pos;
 	Collection *aux;
+	bool         loaded;
+
+	loaded = Pandora_Conf_Loader::getInstance ()->getText (filename, text);
+	istringstream file (text);
 	
 	if (this->key_values)
 		delete this->key_values;
@@ -279,7 +311,7 @@ Pandora::Pandora_Agent_Conf::setFile (string filename) {
 		delete this->collection_list;
 	this->collection_list = new list<Collection> ();
 	
-	if (!file.is_open ()) {
+	if (!loaded) {
 		return;
 	}
 	
@@ -338,7 +370,6 @@ Pandora::Pandora_Agent_Conf::setFile (string filename) {
 			}
 		}
 	}
-	file.close ();
 }
 
 /**
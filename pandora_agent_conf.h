@@ -24,6 +24,7 @@
 #include "pandora.h"
 #include <string>
 #include <list>
+#include <map>
 
 using namespace std;
 
@@ -46,6 +47,8 @@ namespace Pandora {
 		list<Collection> *collection_list;	
 		list<Collection>::iterator collection_it;
 		bool broker_enabled;
+		/* Include file -> (fingerprint, collection names) */
+		map<string, pair<string, list<string> > > include_collections;
 
 		Pandora_Agent_Conf             ();
 	public:
@@ -0,0 +1,53 @@
+/* Configuration checker for systems other than Windows.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include <iostream>
+#include "modules/pandora_conf_check.h"
+
+using namespace std;
+
+/**
+ * Check a configuration file like pandora_agent --check-config does,
+ * so configurations can be validated before being deployed.
+ *
+ * Usage: pandora_check_config <file> [<snapshot>]
+ */
+int
+main (int argc, char *argv[]) {
+	Pandora_Modules::Pandora_Conf_Check conf_check;
+	bool                                valid;
+
+	if (argc < 2 || argc > 3) {
+		cout << "Usage: " << argv[0] << " <file> [<snapshot>]" << endl;
+		cout << "Check a configuration file and estimate its cost per interval," << endl;
+		cout << "optionally writing the accepted module definitions to <snapshot>." << endl;
+		return 1;
+	}
+
+	valid = conf_check.check (argv[1]);
+	conf_check.printReport (cout);
+
+	/* Optional snapshot of the accepted module definitions */
+	if (argc == 3 && ! conf_check.writeSnapshot (argv[2])) {
+		cout << "Could not write " << argv[2] << endl;
+		valid = false;
+	}
+
+	return valid ? 0 : 1;
+}
@@ -26,10 +26,15 @@
 #include "ssh/pandora_ssh_client.h"
 #include "ftp/pandora_ftp_client.h"
 #include "misc/pandora_file.h"
+#include "misc/pandora_variables.h"
+#include "misc/pandora_conf_loader.h"
+#include "misc/pandora_exec_worker.h"
+#include "misc/pandora_process_runner.h"
 #include "windows/pandora_windows_info.h"
 #include "udp_server/udp_server.h"
 
 #include <iostream>
+#include <map>
 #include <cstdlib>
 #include <ctime>
 #include <direct.h>
@@ -38,10 +43,9 @@
 #include <sys/stat.h>
 #include <pandora_agent_conf.h>
 #include <fstream>
+#include <sstream>
 #include <unistd.h>
 
-#define BUFSIZE 4096
-
 using namespace std;
 using namespace Pandora;
 using namespace Pandora_Modules;
@@ -80,6 +84,7 @@ Pandora_Windows_Service::setValues (const char * svc_name,
 	this->udp_server            = NULL;
 	this->tentacle_proxy        = false;
 	this->intensive_interval    = 60000;
+	this->packet_size           = 0;
 }
 
 /** 
@@ -99,9 +104,8 @@ Pandora_Windows_Service::~Pandora_Windows_Service () {
 		delete (UDP_Server *)udp_server;
 	}
 
-	if (this->modules != NULL) {
-		delete this->modules;
-	}
+	this->clearModules ();
+	Pandora_Exec_Worker::getInstance ()->setEnabled (false);
 	pandoraLog ("Pandora agent stopped");
 }
 
@@ -124,19 +128,15 @@ Pandora_Windows_Service::start () {
 
 void
 Pandora_Windows_Service::pandora_init_broker (string file_conf) {
-	string interval, debug, transfer_interval, util_dir, path, env, name_agent;
+	string interval, debug, transfer_interval, util_dir, path, env;
 	string udp_server_enabled, udp_server_port, udp_server_addr, udp_server_auth_addr;
 	int pos;
 
-	name_agent = "PANDORA_AGENT=" + checkAgentName(file_conf);
-	putenv(name_agent.c_str());
+	Pandora_Variables::getInstance ()->setGlobal ("PANDORA_AGENT", checkAgentName(file_conf));
 	
 	this->conf = Pandora::Pandora_Agent_Conf::getInstance ();
 	this->conf->setFile (file_conf);
-	if (this->modules != NULL) {
-		delete this->modules;
-	}
-	this->modules = new Pandora_Module_List (file_conf);
+	this->loadModules (file_conf);
 	
 	pandoraDebug ("Pandora broker agent started");
 }
@@ -147,10 +147,12 @@ Pandora_Windows_Service::count_broker_agents(){
 	string       filename;
 	int pos;
 	int 		 num = 0;
+	string       text;
 	
 	filename = Pandora::getPandoraInstallDir ();
 	filename += "pandora_agent.conf";
-	ifstream     file (filename.c_str ());
+	Pandora_Conf_Loader::getInstance ()->getText (filename, text);
+	istringstream file (text);
 	
 	/* Read and set the file */
 	while (!file.eof ()) {
@@ -166,20 +168,20 @@ Pandora_Windows_Service::count_broker_agents(){
 				}
 		}
 	}
-	file.close ();
 	return num;
 }
 
 void
 Pandora_Windows_Service::check_broker_agents(string *all_conf){
-	string       buffer, filename;
+	string       buffer, filename, text;
 	int pos;
 	int pos_file = 0;
 	
 	filename = Pandora::getPandoraInstallDir ();
 	filename += "pandora_agent.conf";
 
-	ifstream     file (filename.c_str ());
+	Pandora_Conf_Loader::getInstance ()->getText (filename, text);
+	istringstream file (text);
 	
 		while (!file.eof ()) {
 		/* Set the value from each line */
@@ -199,7 +201,6 @@ Pandora_Windows_Service::check_broker_agents(string *all_conf){
 					}
 			}
 		}
-	file.close();
 }
 
 
@@ -207,11 +208,13 @@ void
 Pandora_Windows_Service::pandora_init () {
 	string conf_file, interval, debug, intensive_interval, util_dir, path, env;
 	string udp_server_enabled, udp_server_port, udp_server_addr, udp_server_auth_addr;
-	string name_agent, name;
+	string name;
 	string proxy_mode, server_ip;
 	string *all_conf;
 	int pos, num;
+	long old_interval, old_intensive_interval;
 	static unsigned char first_run = 1;
+	Pandora_Exec_Worker *worker;
                 
 	conf_file = Pandora::getPandoraInstallDir ();
 	conf_file += "pandora_agent.conf";
@@ -221,11 +224,10 @@ Pandora_Windows_Service::pandora_init () {
 	
 	this->conf = Pandora::Pandora_Agent_Conf::getInstance ();
 	this->conf->setFile (all_conf);
-	if (this->modules != NULL) {
-		delete this->modules;
-	}
 
 	/* Get the interval value (in seconds) and set it to the service */
+	old_interval = this->interval;
+	old_intensive_interval = this->intensive_interval;
 	interval = conf->getValue ("interval");
 	intensive_interval = conf->getValue ("intensive_interval");
 
@@ -251,16 +253,19 @@ Pandora_Windows_Service::pandora_init () {
 		
 	this->setSleepTime (this->intensive_interval);
 
-	// Read modules
-	this->modules = new Pandora_Module_List (conf_file);
+	// Read modules. Module intervals depend on the agent ones, so
+	// no module is kept if they changed
+	if (this->interval != old_interval || this->intensive_interval != old_intensive_interval) {
+		this->clearModules ();
+	}
+	this->loadModules (conf_file);
 	delete []all_conf;
 	
 	name = checkAgentName(conf_file);
 	if (name.empty ()) {
 		name = Pandora_Windows_Info::getSystemName ();
 	}
-	name_agent = "PANDORA_AGENT=" + name;
-	putenv(name_agent.c_str());
+	Pandora_Variables::getInstance ()->setGlobal ("PANDORA_AGENT", name);
 	
 	debug = conf->getValue ("debug");
 	setPandoraDebug (is_enabled (debug));
@@ -284,24 +289,35 @@ Pandora_Windows_Service::pandora_init () {
 	if (first_run == 1) {
 		first_run = 0;
 
-		// Add the util subdirectory to the PATH
+		// Add the util subdirectory to the PATH. The agent environment
+		// is only changed here, before any other thread is started, so
+		// that the agent tools (tentacle_client.exe, unzip.exe...) are found
 		util_dir = Pandora::getPandoraInstallDir ();
 		util_dir += "util";
 		path = getenv ("PATH");
-		env = "PATH=" + path + ";" + util_dir;
-		putenv (env.c_str ());
+		env = path + ";" + util_dir;
+		SetEnvironmentVariable ("PATH", env.c_str ());
+		Pandora_Variables::getInstance ()->addPath (util_dir);
 
 		// Set the seed for rand
 		srand ((unsigned) time (0));
 
 		pandoraLog ("Pandora agent started");
 	}
+
+	/* Persistent shell for the exec modules, with the same working
+	   directory as the separate processes. Its environment is set
+	   before each command. */
+	worker = Pandora_Exec_Worker::getInstance ();
+	worker->setWorkingDir (Pandora::getPandoraInstallDir () + "util\\");
+	worker->setEnabled (is_enabled (conf->getValue ("exec_worker")));
+
+	/* Limit of commands run at the same time, 0 for no limit */
+	Pandora_Process_Runner::setMaxProcesses (atoi (conf->getValue ("max_processes").c_str ()));
 }
 
 int
 Pandora_Windows_Service::killTentacleProxy() {
-	PROCESS_INFORMATION pi;
-	STARTUPINFO         si;		
 	string kill_cmd;
 	
 	if (this->tentacle_proxy == false) {
@@ -310,10 +326,8 @@ Pandora_Windows_Service::killTentacleProxy() {
 	
 	kill_cmd = "taskkill.exe /F /IM tentacle_server.exe";
 	
-	ZeroMemory (&si, sizeof (si));
-	ZeroMemory (&pi, sizeof (pi));
-	if (CreateProcess (NULL , (CHAR *)kill_cmd.c_str (), NULL, NULL, FALSE,
-		CREATE_NO_WINDOW, NULL, NULL, &si, &pi) == 0) {
+	Pandora_Process_Runner runner (kill_cmd);
+	if (runner.run () == RUNNER_ERROR) {
 		return -1;
 	}
 		
@@ -517,126 +531,29 @@ Pandora_Windows_Service::getXmlHeader () {
 string
 Pandora_Windows_Service::getCoordinatesFromGisExec (string gis_exec)
 {
-	PROCESS_INFORMATION pi;
-	STARTUPINFO         si;	
-
-	DWORD               retval, dwRet;
-	SECURITY_ATTRIBUTES attributes;
-	HANDLE              out, new_stdout, out_read, job;
-	string              working_dir;
-	string output = "";
-	int timeout = 30;
-		
-	/* Set the bInheritHandle flag so pipe handles are inherited. */
-	attributes.nLength = sizeof (SECURITY_ATTRIBUTES); 
-	attributes.bInheritHandle = TRUE; 
-	attributes.lpSecurityDescriptor = NULL;
-
-	/* Create a job to kill the child tree if it become zombie */
-	/* CAUTION: In order to compile this, WINVER should be defined to 0x0500.
-	This may need no change, since it was redefined by the 
-	program, but if needed, the macro is defined 
-	in <windef.h> */
-
-	job = CreateJobObject (&attributes, NULL);
-
-	if (job == NULL) {
-		pandoraLog ("getCoordinatesFromGisExec: CreateJobObject failed. Err: %d", GetLastError ());
-		return "";
-	}
-
-	/* Get the handle to the current STDOUT. */
-	out = GetStdHandle (STD_OUTPUT_HANDLE); 
-
-	if (! CreatePipe (&out_read, &new_stdout, &attributes, 0)) {
-		pandoraLog ("getCoordinatesFromGisExec: CreatePipe failed. Err: %d", GetLastError ());
-		return "";
-	}
+	int timeout = 30000; /* Milliseconds */
+	int result;
 
-	/* Ensure the read handle to the pipe for STDOUT is not inherited */
-	SetHandleInformation (out_read, HANDLE_FLAG_INHERIT, 0);
-
-	
-	ZeroMemory (&si, sizeof (si));
-	GetStartupInfo (&si);
+	pandoraDebug ("Executing gis_exec: %s", gis_exec.c_str ());
 
-	si.cb = sizeof (si);
-	si.dwFlags     = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-	si.wShowWindow = SW_HIDE;
-	si.hStdError   = new_stdout;
-	si.hStdOutput  = new_stdout;
+	Pandora_Process_Runner runner (gis_exec);
+	runner.setTimeout (timeout);
 
-	/* Set up members of the PROCESS_INFORMATION structure. */
-	ZeroMemory (&pi, sizeof (pi));
-	
-	pandoraDebug ("Executing gis_exec: %s", gis_exec.c_str ());
-	
-	/* Create the child process. */
-	if (CreateProcess (NULL , (CHAR *)gis_exec.c_str (), NULL, NULL, TRUE,
-		CREATE_SUSPENDED | CREATE_NO_WINDOW, NULL, NULL, &si, &pi) == 0) {
+	result = runner.run ();
+	if (result == RUNNER_ERROR) {
 		pandoraLog ("getCoordinatesFromGisExec: %s CreateProcess failed. Err: %d",
 		gis_exec.c_str (), GetLastError ());
 		return "";
-	} else {
-		char          buffer[BUFSIZE + 1];
-		unsigned long read, avail;
-
-		if (! AssignProcessToJobObject (job, pi.hProcess)) {
-			pandoraLog ("getCoordinatesFromGisExec: could not assign proccess to job (error %d)",
-			GetLastError ());
-		}
-		ResumeThread (pi.hThread);
-
-		/*string output;*/
-		int tickbase = GetTickCount();
-		while ( (dwRet = WaitForSingleObject (pi.hProcess, 500)) != WAIT_ABANDONED ) {
-			PeekNamedPipe (out_read, buffer, BUFSIZE, &read, &avail, NULL);
-			if (avail > 0) {
-				ReadFile (out_read, buffer, BUFSIZE, &read, NULL);
-				buffer[read] = '\0';
-				output += (char *) buffer;
-			}
-	
-			if (dwRet == WAIT_OBJECT_0) { 
-				break;
-			} else if(timeout < GetTickCount() - tickbase) {
-				/* STILL_ACTIVE */
-				TerminateProcess(pi.hThread, STILL_ACTIVE);
-				pandoraLog ("getCoordinatesFromGisExec: %s timed out (retcode: %d)", gis_exec.c_str (), STILL_ACTIVE);
-				break;
-			}
-		}
-
-		GetExitCodeProcess (pi.hProcess, &retval);
-
-		if (retval != 0) {
-			if (! TerminateJobObject (job, 0)) {
-				pandoraLog ("getCoordinatesFromGisExec: TerminateJobObject failed. (error %d)",
-				GetLastError ());
-			}
-			if (retval != STILL_ACTIVE) {
-				pandoraLog ("getCoordinatesFromGisExec: %s did not executed well (retcode: %d)",
-				gis_exec.c_str (), retval);
-			}
-			/* Close job, process and thread handles. */
-			CloseHandle (job);
-			CloseHandle (pi.hProcess);
-			CloseHandle (pi.hThread);
-			CloseHandle (new_stdout);
-			CloseHandle (out_read);
-			return "";
-		}
-	
-		/* Close job, process and thread handles. */
-		CloseHandle (job);
-		CloseHandle (pi.hProcess);
-		CloseHandle (pi.hThread);
+	} else if (result == RUNNER_TIMEOUT) {
+		pandoraLog ("getCoordinatesFromGisExec: %s timed out (retcode: %d)", gis_exec.c_str (), STILL_ACTIVE);
+		return "";
+	} else if (runner.getExitCode () != 0) {
+		pandoraLog ("getCoordinatesFromGisExec: %s did not executed well (retcode: %d)",
+		gis_exec.c_str (), runner.getExitCode ());
+		return "";
 	}
 
-	CloseHandle (new_stdout);
-	CloseHandle (out_read);
-
-	return output;
+	return runner.getOutput ();
 }
 
 int
@@ -647,11 +564,8 @@ Pandora_Windows_Service::copyTentacleDataFile (string host,
 					       string pass,
 					       string opts)
 {
-	DWORD    rc;
 	string  var, filepath;
 	string	tentacle_cmd, working_dir;
-	PROCESS_INFORMATION pi;
-	STARTUPINFO         si;
 	int tentacle_timeout = 0;
 
 	var = conf->getValue ("temporal");
@@ -687,39 +601,21 @@ Pandora_Windows_Service::copyTentacleDataFile (string host,
 		      filepath.c_str (), host.c_str ());
 	pandoraDebug ("Command %s", tentacle_cmd.c_str());
 
-	ZeroMemory (&si, sizeof (si));
-	ZeroMemory (&pi, sizeof (pi));
-	if (CreateProcess (NULL , (CHAR *)tentacle_cmd.c_str (), NULL, NULL, FALSE,
-	    CREATE_NO_WINDOW, NULL, NULL, &si, &pi) == 0) {
-		return -1;
-	}
+	Pandora_Process_Runner runner (tentacle_cmd);
 
-	/* close thread handle, because it won't be used */
-	CloseHandle (pi.hThread);
-	
 	/* Timeout */
 	tentacle_timeout = atoi (conf->getValue ("tentacle_timeout").c_str ());
-	if (tentacle_timeout <= 0) {
-		tentacle_timeout = INFINITE;
-	} else {
+	if (tentacle_timeout > 0) {
 		/* Convert to milliseconds */
-		tentacle_timeout *= 1000;
-	}
-
-    if (WaitForSingleObject(pi.hProcess, tentacle_timeout) == WAIT_TIMEOUT) {
-		TerminateProcess(pi.hProcess, STILL_ACTIVE);
-		CloseHandle (pi.hProcess);
-		return -1;
+		runner.setTimeout (tentacle_timeout * 1000);
 	}
 
 	/* Get the return code of the tentacle client*/	
-    GetExitCodeProcess (pi.hProcess, &rc);
-	if (rc != 0) {
-		CloseHandle (pi.hProcess);
+	if (runner.run () != RUNNER_OK || runner.getExitCode () != 0) {
+		pandoraDebug ("Tentacle client output: %s", runner.getOutput ().c_str ());
 		return -1;
 	}
 
-	CloseHandle (pi.hProcess);
 	return 0;
 }
 
@@ -1032,8 +928,6 @@ Pandora_Windows_Service::copyLocalDataFile (string remote_path,
 int
 Pandora_Windows_Service::unzipCollection(string zip_path, string dest_dir) {
 	string	unzip_cmd, dest_cmd;
-	PROCESS_INFORMATION pi;
-	STARTUPINFO         si;
 	mode_t mode;
 	DWORD rc;
 	
@@ -1051,24 +945,17 @@ Pandora_Windows_Service::unzipCollection(string zip_path, string dest_dir) {
 	/* Build the command to launch the Tentacle client */
 	unzip_cmd = "unzip.exe \"" + zip_path + "\" -d \"" + dest_dir + "\"";
 	
-	ZeroMemory (&si, sizeof (si));
-	ZeroMemory (&pi, sizeof (pi));
-	if (CreateProcess (NULL , (CHAR *)unzip_cmd.c_str (), NULL, NULL, FALSE,
-	    CREATE_NO_WINDOW, NULL, NULL, &si, &pi) == 0) {
+	Pandora_Process_Runner runner (unzip_cmd);
+	if (runner.run () != RUNNER_OK) {
 		return -1;
 	}
 
-	/* Get the return code of the tentacle client*/
-    WaitForSingleObject(pi.hProcess, INFINITE);
-    GetExitCodeProcess (pi.hProcess, &rc);
-    
-	if (rc != 0) {
-		CloseHandle (pi.hProcess);
+	/* Get the return code of the unzip command */
+	if (runner.getExitCode () != 0) {
 		pandoraLog ("Pandora_Windows_Service::unzipCollection: Can not unzip file %s", zip_path.c_str());
 		return -1;
 	}
 
-	CloseHandle (pi.hProcess);
 	return 0;	
 }
 /*
@@ -1125,7 +1012,7 @@ Pandora_Windows_Service::checkCollections () {
 	int flag, i;
 	char *coll_md5 = NULL, *server_coll_md5 = NULL;
 	string collection_name, collections_dir, collection_path, collection_md5, tmp;
-	string collection_zip, install_dir, temp_dir, dest_dir, path, env;
+	string collection_zip, install_dir, temp_dir, dest_dir;
 
 	/*Get collections directory*/
 	install_dir = Pandora::getPandoraInstallDir ();
@@ -1145,29 +1032,9 @@ Pandora_Windows_Service::checkCollections () {
 		collection_name = conf->getCurrentCollectionName();	
 
 		if(! conf->getCurrentCollectionVerify() ) {	
-			int found;
-
-			/*Add the collection directory to the path (if not exists in %path%)*/
+			/*Add the collection directory to the path of the module commands*/
 			collection_path = collections_dir + collection_name;
-			path = getenv ("PATH");
-
-			/* check if the path is just included in the middle of %path% */
-			tmp = collection_path + ";";	/* Added a separator */
-			if(path.find(tmp) == string::npos) {
-
-				/* check if the path is the last entry of %path% */
-				if( ((found = path.rfind(collection_path)) != string::npos)
-				   && ((found + collection_path.length()) == path.length()) )
-				{
-					/* included already (at the tail of %path%) */
-					;
-				}
-				else {
-					/* it's new ! */
-					env = "PATH=" + path + ";" + collection_path;
-					putenv (env.c_str ());
-				}
-			}
+			Pandora_Variables::getInstance ()->addPath (collection_path);
 
 			conf->setCurrentCollectionVerify();
 		}
@@ -1342,12 +1209,57 @@ Pandora_Windows_Service::checkCollections () {
 	purgeDiskCollections ();
 }
 
+/**
+ * Load the modules of an agent configuration file and make them the
+ * current modules.
+ *
+ * A module list is kept for each configuration file (main agent and
+ * broker agents), so that the modules whose definition did not change
+ * since the last load keep their state.
+ *
+ * @param conf_file Path of the configuration file.
+ */
+void
+Pandora_Windows_Service::loadModules (string conf_file) {
+	map<string, Pandora_Module_List *>::iterator iter;
+	Pandora_Module_List                         *previous = NULL;
+
+	iter = this->module_lists.find (conf_file);
+	if (iter != this->module_lists.end ()) {
+		previous = iter->second;
+	}
+
+	this->modules = new Pandora_Module_List (conf_file, previous);
+	this->module_lists[conf_file] = this->modules;
+
+	/* Destroys the removed and changed modules */
+	if (previous != NULL) {
+		delete previous;
+	}
+}
+
+/**
+ * Destroy the modules of every configuration file.
+ */
+void
+Pandora_Windows_Service::clearModules () {
+	map<string, Pandora_Module_List *>::iterator iter;
+
+	for (iter = this->module_lists.begin (); iter != this->module_lists.end (); iter++) {
+		delete iter->second;
+	}
+	this->module_lists.clear ();
+	this->modules = NULL;
+}
+
 string
 Pandora_Windows_Service::checkAgentName(string filename){
 	string name_agent = "";
-	string       buffer;
+	string       buffer, text;
 	int pos;
-	ifstream     file (filename.c_str ());
+
+	Pandora_Conf_Loader::getInstance ()->getText (filename, text);
+	istringstream file (text);
 
 	while (!file.eof ()) {
 		getline (file, buffer);
@@ -1361,15 +1273,15 @@ Pandora_Windows_Service::checkAgentName(string filename){
 			}
 		}
 	}
-	file.close();
 	return name_agent;
 }
 int
 Pandora_Windows_Service::checkConfig (string file) {
 	int i, conf_size;
 	char *conf_str = NULL, *remote_conf_str = NULL, *remote_conf_md5 = NULL;
-	char agent_md5[33], conf_md5[33], flag;
+	char agent_md5[33], flag;
 	string agent_name, conf_tmp_file, md5_tmp_file, temp_dir, tmp;
+	string conf_data, conf_md5;
 
 	tmp = conf->getValue ("remote_config");
 	if (tmp != "1") {
@@ -1398,17 +1310,12 @@ Pandora_Windows_Service::checkConfig (string file) {
 
 	Pandora_File::md5 (tmp.c_str(), tmp.size(), agent_md5);
 
-	/* Calculate md5 hashes */
-	try {
-		conf_size = Pandora_File::readBinFile (file, &conf_str);
-		Pandora_File::md5 (conf_str, conf_size, conf_md5);
-	} catch (...) {
+	/* The md5 is calculated when the file is loaded */
+	if (! Pandora_Conf_Loader::getInstance ()->getData (file, conf_data) || conf_data.empty ()) {
 		pandoraDebug ("Pandora_Windows_Service::checkConfig: Error calculating configuration md5");
-		if (conf_str != NULL) {
-			delete[] conf_str;
-		}
 		return 0;
 	}
+	conf_md5 = Pandora_Conf_Loader::getInstance ()->getMd5 (file);
 
 	/* Compose file names from the agent name hash */
 	conf_tmp_file = agent_md5;
@@ -1424,26 +1331,22 @@ Pandora_Windows_Service::checkConfig (string file) {
 		try {
 			tmp = temp_dir;
 			tmp += conf_tmp_file;
-			Pandora_File::writeBinFile (tmp, conf_str, conf_size);
+			Pandora_File::writeBinFile (tmp, conf_data.c_str (), conf_data.size ());
 			copyDataFile (conf_tmp_file);
 			Pandora_File::removeFile (tmp);
 		
 			tmp = temp_dir;
 			tmp += md5_tmp_file;
-			Pandora_File::writeBinFile (tmp, conf_md5, 32);
+			Pandora_File::writeBinFile (tmp, conf_md5.c_str (), 32);
 			copyDataFile (md5_tmp_file);
 			Pandora_File::removeFile (tmp);
 		} catch (...) {
 			pandoraDebug ("Pandora_Windows_Service::checkConfig: Error uploading configuration to server");
 		}
 	
-		delete[] conf_str;
 		return 0;
 	}
 
-	delete[] conf_str;
-	conf_str = NULL;
-
 	/* Read remote configuration file md5 */
 	try {
 		tmp = temp_dir;
@@ -1488,6 +1391,7 @@ Pandora_Windows_Service::checkConfig (string file) {
 		Pandora_File::removeFile (tmp);
 		/* Save new configuration */
 		Pandora_File::writeBinFile (file, conf_str, conf_size);
+		Pandora_Conf_Loader::getInstance ()->invalidate (file);
 	} catch (...) {
 		pandoraDebug("Pandora_Windows_Service::checkConfig: Error retrieving configuration file from server");
 		if (conf_str != NULL) {
@@ -1502,22 +1406,142 @@ Pandora_Windows_Service::checkConfig (string file) {
 	return 1;
 }
 
+/**
+ * Build the XML of a self-monitoring module.
+ *
+ * @param name Module name.
+ * @param type Module type.
+ * @param value Module data.
+ * @param unit Module unit. May be empty.
+ *
+ * @return The module XML.
+ */
+static string
+getAgentModuleXml (string name, string type, string value, string unit) {
+	string module_xml;
+
+	module_xml = "<module>\n\t<name><![CDATA[";
+	module_xml += name;
+	module_xml += "]]></name>\n\t<type><![CDATA[";
+	module_xml += type;
+	module_xml += "]]></type>\n";
+	if (unit != "") {
+		module_xml += "\t<unit><![CDATA[";
+		module_xml += unit;
+		module_xml += "]]></unit>\n";
+	}
+	module_xml += "\t<data><![CDATA[";
+	module_xml += value;
+	module_xml += "]]></data>\n</module>\n";
+
+	return module_xml;
+}
+
+/**
+ * Build the XML of the modules that monitor the agent itself.
+ *
+ * The durations and sizes are the ones of the previous cycle, as the
+ * current one has not finished when the XML is built.
+ *
+ * @return The XML of the self-monitoring modules.
+ */
+string
+Pandora_Windows_Service::getSelfMonitoringXml () {
+	string                      module_xml, slowest, temporal;
+	multimap<unsigned long long, string>           run_times;
+	multimap<unsigned long long, string>::reverse_iterator iter;
+	const Pandora_Timing::Histogram *timing;
+	WIN32_FIND_DATA             file_data;
+	HANDLE                      find;
+	int                         buffered = 0, i;
+
+	module_xml += getAgentModuleXml ("Agent cycle time", "generic_data",
+					 longtostr ((long) (this->cycle_timing.getLast () / 1000)), "ms");
+	module_xml += getAgentModuleXml ("Agent packet size", "generic_data",
+					 longtostr ((long) this->packet_size), "bytes");
+	module_xml += getAgentModuleXml ("Agent transfer time", "generic_data",
+					 longtostr ((long) (this->transfer_timing.getLast () / 1000)), "ms");
+
+	/* Slowest modules, by average run time */
+	if (this->modules != NULL) {
+		this->modules->goFirst ();
+		while (! this->modules->isLast ()) {
+			Pandora_Module *module;
+
+			module = this->modules->getCurrentValue ();
+			timing = module->getTiming (TIMING_RUN);
+			if (timing->getCount () > 0) {
+				run_times.insert (make_pair (timing->getAverage (),
+							     module->getName () + ": " + timing->toString ()));
+			}
+			this->modules->goNext ();
+		}
+	}
+	for (iter = run_times.rbegin (), i = 0; iter != run_times.rend () && i < 5; iter++, i++) {
+		if (i > 0) {
+			slowest += "; ";
+		}
+		slowest += iter->second;
+	}
+	module_xml += getAgentModuleXml ("Agent slowest modules", "generic_data_string",
+					 slowest, "");
+
+	/* Packets waiting in the buffer */
+	temporal = this->conf->getValue ("temporal");
+	if (temporal != "" && temporal[temporal.length () - 1] != '\\') {
+		temporal += "\\";
+	}
+	find = FindFirstFile ((temporal + "*.data").c_str (), &file_data);
+	if (find != INVALID_HANDLE_VALUE) {
+		do {
+			buffered++;
+		} while (FindNextFile (find, &file_data) != 0);
+		FindClose (find);
+	}
+	module_xml += getAgentModuleXml ("Agent buffered packets", "generic_data",
+					 inttostr (buffered), "");
+
+	return module_xml;
+}
+
 int
 Pandora_Windows_Service::sendXml (Pandora_Module_List *modules) {
-    int rc = 0, xml_buffer;
-    string            data_xml;
-	string            xml_filename, random_integer;
-	string            tmp_filename, tmp_filepath;
-	string            encoding;
+	return this->sendXml (modules, false);
+}
+
+/**
+ * Build the XML of a module list and send it to the server.
+ *
+ * When the XML is bigger than xml_max_size kilobytes, it is split in
+ * several packets, each one with the agent header. Only log modules
+ * are split themselves, into several <log_module> elements.
+ *
+ * @param modules Modules to include in the XML.
+ * @param self_monitoring Whether the agent self-monitoring modules
+ *        are included too.
+ *
+ * @return 0 on success, an error code otherwise.
+ */
+int
+Pandora_Windows_Service::sendXml (Pandora_Module_List *modules, bool self_monitoring) {
+    int rc = 0, packet_rc, xml_buffer;
+    string            header_xml, data_xml, self_xml, max_size_str;
+	string            closing = "</agent_data>";
+	list<string>      packets, chunks;
+	list<string>::iterator iter;
 	static HANDLE     mutex = 0; 
-    ULARGE_INTEGER    free_bytes;
     double            min_free_bytes = 0;
+	size_t            max_size, log_max_size;
 	Pandora_Agent_Conf *conf = NULL;
-	FILE              *conf_fh = NULL;
+	unsigned long long start;
 
 	conf = this->getConf ();
 	min_free_bytes = 1024 * atoi (conf->getValue ("temporal_min_size").c_str ());
 	xml_buffer = atoi (conf->getValue ("xml_buffer").c_str ());
+
+	/* Packet size limit, 0 for none */
+	max_size_str = conf->getValue ("xml_max_size");
+	max_size = 1024 * ((max_size_str == "") ? DEFAULT_XML_MAX_SIZE : atoi (max_size_str.c_str ()));
 	
 	if (mutex == 0) {
 		mutex = CreateMutex (NULL, FALSE, NULL);
@@ -1526,7 +1550,7 @@ Pandora_Windows_Service::sendXml (Pandora_Module_List *modules) {
 	/* Wait for the mutex to be opened */
 	WaitForSingleObject (mutex, INFINITE);
 	
-	data_xml = getXmlHeader ();
+	header_xml = getXmlHeader ();
 	
 	/* Write custom fields */
 	int c = 1;
@@ -1539,12 +1563,12 @@ Pandora_Windows_Service::sendXml (Pandora_Module_List *modules) {
 	string token_value = conf->getValue (token_value_token);
 	
 	if(token_name != "" && token_value != "") {
-		data_xml += "<custom_fields>\n";
+		header_xml += "<custom_fields>\n";
 		while(token_name != "" && token_value != "") {
-			data_xml += "	<field>\n";
-			data_xml += "		<name><![CDATA["+ token_name +"]]></name>\n";
-			data_xml += "		<value><![CDATA["+ token_value +"]]></value>\n";
-			data_xml += "	</field>\n";
+			header_xml += "	<field>\n";
+			header_xml += "		<name><![CDATA["+ token_name +"]]></name>\n";
+			header_xml += "		<value><![CDATA["+ token_value +"]]></value>\n";
+			header_xml += "	</field>\n";
 			
 			c++;
 			sprintf(token_name_token, "custom_field%d_name", c);
@@ -1552,10 +1576,20 @@ Pandora_Windows_Service::sendXml (Pandora_Module_List *modules) {
 			token_name = conf->getValue (token_name_token);
 			token_value = conf->getValue (token_value_token);
 		}
-		data_xml += "</custom_fields>\n";
+		header_xml += "</custom_fields>\n";
+	}
+
+	/* Room left for a log element in a packet, after the header and
+	   the closing tag */
+	log_max_size = 0;
+	if (max_size > 0) {
+		log_max_size = (max_size > header_xml.size () + closing.size () + MIN_LOG_CHUNK_SIZE)
+			       ? max_size - header_xml.size () - closing.size ()
+			       : MIN_LOG_CHUNK_SIZE;
 	}
 	
 	/* Write module data */
+	data_xml = header_xml;
 	if (modules != NULL) {
 		modules->goFirst ();
 	
@@ -1563,24 +1597,91 @@ Pandora_Windows_Service::sendXml (Pandora_Module_List *modules) {
 			Pandora_Module *module;
 			
 			module = modules->getCurrentValue ();			
-			data_xml += module->getXml ();
+			start = Pandora_Timing::getMicroseconds ();
+			chunks.clear ();
+			module->getXmlChunks (log_max_size, chunks);
+			module->addTiming (TIMING_XML, Pandora_Timing::getMicroseconds () - start);
+
+			/* Start a new packet when the next element does not fit */
+			for (iter = chunks.begin (); iter != chunks.end (); iter++) {
+				if (max_size > 0 && data_xml.size () > header_xml.size () &&
+				    data_xml.size () + iter->size () + closing.size () > max_size) {
+					packets.push_back (data_xml + closing);
+					data_xml = header_xml;
+				}
+				data_xml += *iter;
+			}
 			modules->goNext ();
 		}
 	}
 	
-	/* Close the XML header */
-	data_xml += "</agent_data>";
+	if (self_monitoring && is_enabled (conf->getValue ("self_monitoring"))) {
+		self_xml = this->getSelfMonitoringXml ();
+		if (max_size > 0 && data_xml.size () > header_xml.size () &&
+		    data_xml.size () + self_xml.size () + closing.size () > max_size) {
+			packets.push_back (data_xml + closing);
+			data_xml = header_xml;
+		}
+		data_xml += self_xml;
+	}
 	
+	/* Close the XML header */
+	packets.push_back (data_xml + closing);
+
+	if (packets.size () > 1) {
+		pandoraDebug ("XML split in %d packets", (int) packets.size ());
+	}
+
+	/* After a failure, the rest of the packets are only buffered */
+	this->packet_size = 0;
+	for (iter = packets.begin (); iter != packets.end (); iter++) {
+		packet_rc = this->sendPacket (*iter, rc == 0, xml_buffer, min_free_bytes);
+		if (rc == 0) {
+			rc = packet_rc;
+		}
+		this->packet_size += iter->size ();
+	}
+
+	/* Send any buffered data files */
+	if (getPandoraDebug () == false && xml_buffer == 1) {
+		this->sendBufferedXml (conf->getValue ("temporal"));
+	}
+
+	ReleaseMutex (mutex);
+
+	return rc;
+}
+
+/**
+ * Write a packet to the temporal directory and send it to the server.
+ *
+ * @param data_xml Packet contents.
+ * @param send Whether the packet is sent now, or just buffered.
+ * @param xml_buffer Whether packets that could not be sent are kept.
+ * @param min_free_bytes Free space needed to keep a packet.
+ *
+ * @return 0 on success, an error code otherwise.
+ */
+int
+Pandora_Windows_Service::sendPacket (const string &data_xml, bool send, int xml_buffer,
+				     double min_free_bytes) {
+	int                rc = 0;
+	string             xml_filename, random_integer;
+	string             tmp_filename, tmp_filepath;
+	ULARGE_INTEGER     free_bytes;
+	FILE              *conf_fh = NULL;
+	unsigned long long start;
+
 	/* Generate temporal filename */
 	random_integer = inttostr (rand());
-	tmp_filename = conf->getValue ("agent_name");
+	tmp_filename = this->conf->getValue ("agent_name");
 	
 	if (tmp_filename == "") {
 		tmp_filename = Pandora_Windows_Info::getSystemName ();
 	}
 	tmp_filename += "." + random_integer + ".data";
 
-	xml_filename = conf->getValue ("temporal");
+	xml_filename = this->conf->getValue ("temporal");
 	if (xml_filename[xml_filename.length () - 1] != '\\') {
 		xml_filename += "\\";
 	}
@@ -1592,7 +1693,6 @@ Pandora_Windows_Service::sendXml (Pandora_Module_List *modules) {
 	if (conf_fh == NULL) {
 		pandoraLog ("Error when saving the XML in %s",
 			    tmp_filepath.c_str ());
-		ReleaseMutex (mutex);
 		return PANDORA_EXCEPTION;
 	}
 	fprintf (conf_fh, "%s", data_xml.c_str ());
@@ -1600,20 +1700,21 @@ Pandora_Windows_Service::sendXml (Pandora_Module_List *modules) {
 
 	/* Only send if debug is not activated */
 	if (getPandoraDebug () == false) {
-		rc = this->copyDataFile (tmp_filename);
+		if (send) {
+			start = Pandora_Timing::getMicroseconds ();
+			rc = this->copyDataFile (tmp_filename);
+			this->transfer_timing.add (Pandora_Timing::getMicroseconds () - start);
+		} else {
+			rc = PANDORA_EXCEPTION;
+		}
         
 		/* Delete the file if successfully copied, buffer disabled or not enough space available */
 		if (rc == 0 || xml_buffer == 0 || (GetDiskFreeSpaceEx (tmp_filepath.c_str (), &free_bytes, NULL, NULL) != 0 && free_bytes.QuadPart < min_free_bytes)) {
 			Pandora_File::removeFile (tmp_filepath);
 		}
-
-		/* Send any buffered data files */
-		if (xml_buffer == 1) {
-			this->sendBufferedXml (conf->getValue ("temporal"));
-		}
 	}
 
-	ReleaseMutex (mutex);
+	return rc;
 }
 
 void
@@ -1657,6 +1758,9 @@ Pandora_Windows_Service::pandora_run_broker (string config) {
 	string server_addr;
 	unsigned char data_flag = 0;
 	unsigned char intensive_match;
+	unsigned long long start, elapsed;
+	int preconditions;
+	bool due;
 	
 	pandoraDebug ("Run begin");
 
@@ -1664,7 +1768,8 @@ Pandora_Windows_Service::pandora_run_broker (string config) {
 
 	/* Check for configuration changes */
 	if (getPandoraDebug () == false) {
-		if (this->checkConfig (config) == 1) {
+		if (this->checkConfig (config) == 1 ||
+		    (this->modules != NULL && this->modules->hasChanged ())) {
 			pandora_init_broker (config);
 		}
 		this->checkCollections ();
@@ -1681,7 +1786,10 @@ Pandora_Windows_Service::pandora_run_broker (string config) {
 			module = this->modules->getCurrentValue ();
 			
 			/* Check preconditions */
-			if (module->evaluatePreconditions () == 0) {
+			start = Pandora_Timing::getMicroseconds ();
+			preconditions = module->evaluatePreconditions ();
+			module->addTiming (TIMING_PRECONDITIONS, Pandora_Timing::getMicroseconds () - start);
+			if (preconditions == 0) {
 				pandoraDebug ("Preconditions not matched for module %s", module->getName ().c_str ());
 				module->setNoOutput ();
 				this->modules->goNext ();
@@ -1697,7 +1805,14 @@ Pandora_Windows_Service::pandora_run_broker (string config) {
 			}
 			
 			pandoraDebug ("Run %s", module->getName ().c_str ());
+			due = module->isIntervalFulfilled ();
+			start = Pandora_Timing::getMicroseconds ();
 			module->run ();
+			if (due) {
+				elapsed = Pandora_Timing::getMicroseconds () - start;
+				module->addTiming (TIMING_RUN, elapsed);
+				pandoraDebug ("%s ran in %lu ms", module->getName ().c_str (), (unsigned long) (elapsed / 1000));
+			}
 			if (! module->hasOutput ()) {
 				module->setNoOutput ();
 				this->modules->goNext ();
@@ -1723,7 +1838,9 @@ Pandora_Windows_Service::pandora_run_broker (string config) {
 			}
 			
 			/* Evaluate module conditions */
+			start = Pandora_Timing::getMicroseconds ();
 			module->evaluateConditions ();
+			module->addTiming (TIMING_CONDITIONS, Pandora_Timing::getMicroseconds () - start);
 			
 			/* At least one module has data */
 			data_flag = 1;
@@ -1757,9 +1874,13 @@ Pandora_Windows_Service::pandora_run (int forced_run) {
 	static bool startup = true;
 	unsigned char data_flag = 0;
 	unsigned char intensive_match;
+	unsigned long long start, elapsed, cycle_start;
+	int preconditions;
+	bool due;
 	
 	pandoraDebug ("Run begin");
 	
+	cycle_start = Pandora_Timing::getMicroseconds ();
 	conf = this->getConf ();
 	
 	/* process only once at startup */
@@ -1782,7 +1903,9 @@ Pandora_Windows_Service::pandora_run (int forced_run) {
 		conf_file = Pandora::getPandoraInstallDir ();
 		conf_file += "pandora_agent.conf";
 		
-		if (this->checkConfig (conf_file) == 1) {
+		/* Remote configuration or local edits */
+		if (this->checkConfig (conf_file) == 1 ||
+		    (this->modules != NULL && this->modules->hasChanged ())) {
 			this->pandora_init ();
 		}
 		this->checkCollections ();
@@ -1801,7 +1924,10 @@ Pandora_Windows_Service::pandora_run (int forced_run) {
 			module = this->modules->getCurrentValue ();
 			
 			/* Check preconditions */
-			if (module->evaluatePreconditions () == 0) {
+			start = Pandora_Timing::getMicroseconds ();
+			preconditions = module->evaluatePreconditions ();
+			module->addTiming (TIMING_PRECONDITIONS, Pandora_Timing::getMicroseconds () - start);
+			if (preconditions == 0) {
 				pandoraDebug ("Preconditions not matched for module %s", module->getName ().c_str ());
 				module->setNoOutput ();
 				this->modules->goNext ();
@@ -1817,7 +1943,14 @@ Pandora_Windows_Service::pandora_run (int forced_run) {
 			}
 			
 			pandoraDebug ("Run %s", module->getName ().c_str ());
+			due = module->isIntervalFulfilled ();
+			start = Pandora_Timing::getMicroseconds ();
 			module->run ();
+			if (due) {
+				elapsed = Pandora_Timing::getMicroseconds () - start;
+				module->addTiming (TIMING_RUN, elapsed);
+				pandoraDebug ("%s ran in %lu ms", module->getName ().c_str (), (unsigned long) (elapsed / 1000));
+			}
 			if (! module->hasOutput ()) {
 				module->setNoOutput ();
 				this->modules->goNext ();
@@ -1843,7 +1976,9 @@ Pandora_Windows_Service::pandora_run (int forced_run) {
 			}
 			
 			/* Evaluate module conditions */
+			start = Pandora_Timing::getMicroseconds ();
 			module->evaluateConditions ();
+			module->addTiming (TIMING_CONDITIONS, Pandora_Timing::getMicroseconds () - start);
 			
 			/* At least one module has data */
 			data_flag = 1;
@@ -1856,7 +1991,7 @@ Pandora_Windows_Service::pandora_run (int forced_run) {
 				
 		// Send the XML
 		if (!server_addr.empty ()) {
-		  this->sendXml (this->modules);
+		  this->sendXml (this->modules, true);
 		}
 	}
 	
@@ -1883,6 +2018,9 @@ Pandora_Windows_Service::pandora_run (int forced_run) {
 		this->timestamp = this->run_time;
 	}
 
+	this->cycle_timing.add (Pandora_Timing::getMicroseconds () - cycle_start);
+	pandoraDebug ("Cycle finished in %lu ms", (unsigned long) (this->cycle_timing.getLast () / 1000));
+
 	return;
 }
 
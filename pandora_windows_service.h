@@ -22,15 +22,24 @@
 #define	__PANDORA_WINDOWS_SERVICE_H__
 
 #include <list>
+#include <map>
 #include <time.h>
 #include "windows_service.h"
 #include "pandora_agent_conf.h"
 #include "modules/pandora_module_list.h"
 #include "ssh/pandora_ssh_client.h"
+#include "misc/pandora_timing.h"
 
 #define FTP_DEFAULT_PORT 21
 #define SSH_DEFAULT_PORT 22
 
+/* Default packet size limit (xml_max_size), in kilobytes */
+#define DEFAULT_XML_MAX_SIZE 1024
+
+/* Minimum size of each element when a log module is split, used when
+   the packet header leaves no room for it */
+#define MIN_LOG_CHUNK_SIZE 4096
+
 using namespace std;
 using namespace Pandora_Modules;
 
@@ -42,6 +51,7 @@ namespace Pandora {
 	private:
 		Pandora_Agent_Conf  *conf;
 		Pandora_Module_List *modules;
+		map<string, Pandora_Module_List *> module_lists;
 		long                 execution_number;
 		string               agent_name;
 		time_t               timestamp;
@@ -50,9 +60,17 @@ namespace Pandora {
 		void                 *udp_server;
 		bool                 tentacle_proxy;
 		list<string> collection_disk;
+		Pandora_Timing::Histogram cycle_timing;
+		Pandora_Timing::Histogram transfer_timing;
+		unsigned long        packet_size;
 		
 		string        getXmlHeader    ();
+		string        getSelfMonitoringXml ();
+		void          loadModules     (string conf_file);
+		void          clearModules    ();
 		int           copyDataFile    (string filename);
+		int           sendPacket      (const string &data_xml, bool send,
+					       int xml_buffer, double min_free_bytes);
 		string        getCoordinatesFromGisExec (string gis_exec);
 		int           copyTentacleDataFile (string host,
 						     string filename,
@@ -107,6 +125,8 @@ namespace Pandora {
 		
 		void           start        ();
 		int            sendXml      (Pandora_Module_List *modules);
+		int            sendXml      (Pandora_Module_List *modules,
+					     bool self_monitoring);
         void           sendBufferedXml (string path);
 		Pandora_Agent_Conf *getConf ();
 		long           getInterval ();
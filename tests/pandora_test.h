@@ -0,0 +1,42 @@
+/* Minimal checks shared by the tests.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef	__PANDORA_TEST_H__
+#define	__PANDORA_TEST_H__
+
+#include <cstdio>
+
+static int test_checks = 0, test_failures = 0;
+
+/* Count a check, printing it if it fails */
+#define CHECK(condition) do { \
+		test_checks++; \
+		if (! (condition)) { \
+			fprintf (stderr, "%s:%d: check failed: %s\n", \
+				 __FILE__, __LINE__, #condition); \
+			test_failures++; \
+		} \
+	} while (0)
+
+/* Print the summary of a test and get its exit status */
+#define TEST_RESULT(name) \
+	(printf ("%s: %d checks, %d failed\n", name, test_checks, test_failures), \
+	 test_failures == 0 ? 0 : 1)
+
+#endif /* __PANDORA_TEST_H__ */
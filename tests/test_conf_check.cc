@@ -0,0 +1,139 @@
+/* Tests of the configuration checker.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "modules/pandora_conf_check.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace Pandora_Modules;
+
+/**
+ * Write a file for the test.
+ */
+static void
+writeFile (string path, string contents) {
+	ofstream file (path.c_str ());
+
+	file << contents;
+}
+
+static void
+testAgentConfiguration () {
+	Pandora_Conf_Check conf_check;
+	ostringstream      report;
+
+	/* The configuration shipped with the agent has no problems */
+	CHECK (conf_check.check ("../bin/pandora_agent.conf"));
+	conf_check.printReport (report);
+	CHECK (report.str ().find (" 0 rejected, 0 problems found") != string::npos);
+}
+
+static void
+testProblems () {
+	Pandora_Conf_Check conf_check;
+	ostringstream      report;
+	string             conf, include, snapshot, text;
+	char               dir[] = "/tmp/pandora_conf_checkXXXXXX";
+
+	CHECK (mkdtemp (dir) != NULL);
+	conf = string (dir) + "/pandora_agent.conf";
+	include = string (dir) + "/include.conf";
+	snapshot = string (dir) + "/snapshot.conf";
+
+	writeFile (include,
+		   "module_begin\n"
+		   "module_name Included\n"
+		   "module_exec echo 1\n"
+		   "module_interval 2\n"
+		   "module_end\n");
+
+	writeFile (conf,
+		   "include " + include + "\n"
+		   "module_begin\n"
+		   "module_name Good\n"
+		   "module_exec echo 1\n"
+		   "module_condition > 1 alert.sh\n"
+		   "module_condition > x\n"
+		   "module_intensive_condition =~ [a\n"
+		   "module_end\n"
+		   "module_begin\n"
+		   "module_name No kind\n"
+		   "module_end\n"
+		   "module_begin\n"
+		   "module_name Watchdog\n"
+		   "module_proc app.exe\n"
+		   "module_watchdog 1\n"
+		   "module_end\n"
+		   "module_begin\n"
+		   "module_name Bad type\n"
+		   "module_exec echo 1\n"
+		   "module_type generic_string\n"
+		   "module_bogus 1\n"
+		   "module_end\n"
+		   "module_begin\n"
+		   "module_name Memory\n"
+		   "module_freememory\n"
+		   "module_end\n"
+		   "module_plugin persistent.sh\n");
+
+	CHECK (! conf_check.check (conf));
+	conf_check.printReport (report);
+	text = report.str ();
+
+	CHECK (text.find (":2: Invalid condition: > x") != string::npos);
+	CHECK (text.find (":2: Invalid intensive condition: =~ [a") != string::npos);
+	CHECK (text.find (":9: Module definition rejected: No module kind") != string::npos);
+	CHECK (text.find (":12: Module definition rejected: Watchdog") != string::npos);
+	CHECK (text.find (":17: Unknown token: module_bogus 1") != string::npos);
+	CHECK (text.find (":17: Module definition rejected: Bad module type") != string::npos);
+	CHECK (text.find (include + ": 1 modules, 0 rejected") != string::npos);
+	CHECK (text.find (conf + ": 3 modules, 3 rejected") != string::npos);
+
+	/* Exec modules, their valid condition and the plugin; the included
+	   module runs every two intervals */
+	CHECK (text.find ("Spawned processes: 3.5") != string::npos);
+	CHECK (text.find ("WMI queries:       1.0") != string::npos);
+	CHECK (text.find ("4 modules, 3 rejected, 6 problems found") != string::npos);
+
+	/* The snapshot has the accepted definitions only */
+	CHECK (conf_check.writeSnapshot (snapshot));
+	ifstream file (snapshot.c_str ());
+	ostringstream contents;
+	contents << file.rdbuf ();
+	CHECK (contents.str ().find ("module_name Included") != string::npos);
+	CHECK (contents.str ().find ("module_name Memory") != string::npos);
+	CHECK (contents.str ().find ("module_name Watchdog") == string::npos);
+
+	unlink (conf.c_str ());
+	unlink (include.c_str ());
+	unlink (snapshot.c_str ());
+	rmdir (dir);
+}
+
+int
+main () {
+	testAgentConfiguration ();
+	testProblems ();
+
+	return TEST_RESULT ("test_conf_check");
+}
@@ -0,0 +1,219 @@
+/* Tests of the event log readers, with recorded records.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "modules/pandora_event_reader.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace Pandora_Modules;
+
+/* Record bigger than the initial batch buffer */
+#define BIG_RECORD 200000
+
+/**
+ * Replay reader that counts the reads of the source.
+ */
+class Counting_Reader : public Pandora_Event_Replay_Reader {
+public:
+	int reads;
+
+	Counting_Reader (string path) : Pandora_Event_Replay_Reader (path) {
+		this->reads = 0;
+	}
+protected:
+	int readRecords (unsigned long first, unsigned char *buffer, size_t size,
+			 size_t &read, size_t &needed) {
+		this->reads++;
+		return Pandora_Event_Replay_Reader::readRecords (first, buffer, size,
+								  read, needed);
+	}
+};
+
+/* Big records handed out */
+static int big_records = 0;
+
+/* Write a log with the records from first to last, one of them big */
+static void
+writeLog (const string &path, unsigned long first, unsigned long last,
+	  unsigned long big) {
+	FILE          *file;
+	unsigned long  number;
+	size_t         length;
+
+	file = fopen (path.c_str (), "wb");
+	for (number = first; number <= last; number++) {
+		length = (number == big) ? BIG_RECORD : 56 + (number % 7) * 4;
+		vector<unsigned char> record (length, 0xAB);
+
+		record[0] = length;
+		record[1] = length >> 8;
+		record[2] = length >> 16;
+		record[3] = length >> 24;
+		record[8] = number;
+		record[9] = number >> 8;
+		record[10] = number >> 16;
+		record[11] = number >> 24;
+		fwrite (&record[0], 1, length, file);
+	}
+	fclose (file);
+}
+
+/* Read every new record, checking they come in order and whole. Stores
+   the first and last numbers read, and returns how many there were. */
+static int
+readAll (Pandora_Event_Reader &reader, unsigned long &first, unsigned long &last) {
+	const unsigned char *record;
+	size_t               size;
+	unsigned long        number;
+	int                  count = 0;
+
+	first = 0;
+	last = 0;
+	while (reader.next (record, size)) {
+		number = record[8] | (record[9] << 8) | (record[10] << 16) |
+			 ((unsigned long) record[11] << 24);
+		if (count == 0) {
+			first = number;
+		} else {
+			CHECK (number == last + 1);
+		}
+		if (size == BIG_RECORD) {
+			big_records++;
+		} else {
+			CHECK (size == 56 + (number % 7) * 4);
+		}
+		CHECK (record[size - 1] == 0xAB);
+		last = number;
+		count++;
+	}
+
+	return count;
+}
+
+/* Forget the bookmarks read from the file, as a restart of the agent */
+static void
+restart (const string &dir) {
+	Pandora_Event_Reader::setBookmarkDir ("");
+	Pandora_Event_Reader::setBookmarkDir (dir);
+}
+
+int
+main () {
+	char          dir[] = "/tmp/pandora_event_readerXXXXXX";
+	string        path;
+	unsigned long first, last;
+
+	CHECK (mkdtemp (dir) != NULL);
+	path = string (dir) + "/log.bin";
+	Pandora_Event_Reader::setBookmarkDir (string (dir) + "/");
+
+	/* Existing records are skipped, or read, without a bookmark */
+	writeLog (path, 1, 5000, 3000);
+	{
+		Counting_Reader skip (path), all (path);
+
+		skip.setBookmarkKey ("Application skip");
+		CHECK (skip.open (true));
+		CHECK (readAll (skip, first, last) == 0);
+		CHECK (skip.getBookmark () == 5000);
+		skip.saveBookmark ();
+
+		/* In batches, growing the buffer for the big record */
+		all.setBookmarkKey ("Application all");
+		CHECK (all.open (false));
+		CHECK (readAll (all, first, last) == 5000);
+		CHECK (first == 1 && last == 5000);
+		CHECK (big_records == 1);
+		CHECK (all.reads > 2 && all.reads < 20);
+		all.saveBookmark ();
+	}
+
+	/* A new reader resumes after the saved bookmark */
+	writeLog (path, 1, 6000, 5000);
+	restart (string (dir) + "/");
+	{
+		Counting_Reader skip (path);
+
+		skip.setBookmarkKey ("Application skip");
+		CHECK (skip.open (true));
+		CHECK (readAll (skip, first, last) == 1000);
+		CHECK (first == 5001 && last == 6000);
+		CHECK (readAll (skip, first, last) == 0);
+		skip.saveBookmark ();
+
+		/* Records appended while closed */
+		skip.close ();
+		writeLog (path, 1, 6100, 0);
+		CHECK (skip.open (true));
+		CHECK (readAll (skip, first, last) == 100);
+		CHECK (first == 6001 && last == 6100);
+		skip.saveBookmark ();
+	}
+
+	/* Overwritten past the bookmark: read from the oldest record */
+	writeLog (path, 7000, 7010, 0);
+	restart (string (dir) + "/");
+	{
+		Counting_Reader all (path);
+
+		all.setBookmarkKey ("Application all");
+		CHECK (all.open (true));
+		CHECK (readAll (all, first, last) == 11);
+		CHECK (first == 7000 && last == 7010);
+		all.saveBookmark ();
+	}
+
+	/* Cleared, numbering again from 1 */
+	writeLog (path, 1, 3, 0);
+	restart (string (dir) + "/");
+	{
+		Counting_Reader all (path), skip (path);
+
+		all.setBookmarkKey ("Application all");
+		CHECK (all.open (true));
+		CHECK (readAll (all, first, last) == 3);
+		CHECK (first == 1 && last == 3);
+		all.saveBookmark ();
+
+		skip.setBookmarkKey ("Application skip");
+		CHECK (skip.open (true));
+		CHECK (readAll (skip, first, last) == 3);
+		skip.saveBookmark ();
+	}
+
+	/* The bookmarks were saved for the next start */
+	restart (string (dir) + "/");
+	{
+		Counting_Reader all (path);
+
+		all.setBookmarkKey ("Application all");
+		CHECK (all.open (false));
+		CHECK (all.getBookmark () == 3);
+		CHECK (readAll (all, first, last) == 0);
+	}
+
+	unlink (path.c_str ());
+	unlink ((string (dir) + "/logevent_bookmarks.dat").c_str ());
+	rmdir (dir);
+
+	return TEST_RESULT ("test_event_reader");
+}
@@ -0,0 +1,200 @@
+/* Tests of the exec worker protocol with /bin/sh.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "misc/pandora_exec_worker.h"
+#include "misc/pandora_timing.h"
+
+#include <fstream>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace Pandora;
+
+/**
+ * Run a command in the worker, getting its whole output.
+ */
+static int
+execute (Pandora_Exec_Worker *worker, string command, int timeout,
+	 string &output, int &status) {
+	Pandora_Output_Buffer buffer;
+	int                   result;
+
+	result = worker->execute (command, timeout, buffer, status);
+	output = buffer.getData ();
+	return result;
+}
+
+static void
+testOutput (Pandora_Exec_Worker *worker) {
+	char   path[] = "/tmp/pandora_exec_workerXXXXXX";
+	string output;
+	int    status, fd;
+
+	CHECK (execute (worker, "echo hello; echo world >&2", 5000, output, status) == WORKER_OK);
+	CHECK (output == "hello\nworld\n");
+	CHECK (status == 0);
+
+	/* The exit status is read from the marker line */
+	CHECK (execute (worker, "sh -c 'exit 7'", 5000, output, status) == WORKER_OK);
+	CHECK (output == "" && status == 7);
+
+	/* Markers of other commands are output like anything else */
+	CHECK (execute (worker, "echo __pandora_worker_1_1__ 5", 5000, output, status) == WORKER_OK);
+	CHECK (output == "__pandora_worker_1_1__ 5\n" && status == 0);
+
+	/* Commands do not read the following requests */
+	CHECK (execute (worker, "cat", 5000, output, status) == WORKER_OK);
+	CHECK (output == "" && status == 0);
+	CHECK (execute (worker, "cat | wc -c | tr -d ' '", 5000, output, status) == WORKER_OK);
+	CHECK (output == "0\n" && status == 0);
+	CHECK (execute (worker, "cat && cat", 5000, output, status) == WORKER_OK);
+	CHECK (output == "" && status == 0);
+
+	/* Redirects of the command are kept */
+	fd = mkstemp (path);
+	CHECK (fd >= 0);
+	CHECK (write (fd, "b\na\n", 4) == 4);
+	close (fd);
+	CHECK (execute (worker, "sort < " + string (path), 5000, output, status) == WORKER_OK);
+	CHECK (output == "a\nb\n" && status == 0);
+	CHECK (execute (worker, "sort < " + string (path) + " | head -n 1", 5000, output, status) == WORKER_OK);
+	CHECK (output == "a\n" && status == 0);
+	unlink (path);
+
+	/* The status is that of each command, not of the previous one */
+	CHECK (execute (worker, "grep -q no_such_line /dev/null", 5000, output, status) == WORKER_OK);
+	CHECK (status == 1);
+	CHECK (execute (worker, "echo 5", 5000, output, status) == WORKER_OK);
+	CHECK (output == "5\n" && status == 0);
+
+	/* A trailing comment does not hide the end of the request */
+	CHECK (execute (worker, "echo 6 # comment", 5000, output, status) == WORKER_OK);
+	CHECK (output == "6\n" && status == 0);
+
+	/* A request is a single line */
+	CHECK (execute (worker, "echo a\necho b", 5000, output, status) == WORKER_ERROR);
+
+	/* The shell keeps its state between commands */
+	CHECK (execute (worker, "WORKER_TEST=kept", 5000, output, status) == WORKER_OK);
+	CHECK (execute (worker, "echo $WORKER_TEST", 5000, output, status) == WORKER_OK);
+	CHECK (output == "kept\n");
+}
+
+static void
+testLimits (Pandora_Exec_Worker *worker) {
+	Pandora_Output_Buffer output;
+	int                   status;
+
+	/* The reply is read to the marker, keeping only the limits */
+	output.setLimits (1000, 0, false);
+	CHECK (worker->execute ("awk 'BEGIN { for (i = 0; i < 500000; i++) print \"0123456789\" }'", 10000, output, status) == WORKER_OK);
+	CHECK (output.getData ().size () == 1000);
+	CHECK (output.getData ().compare (0, 11, "0123456789\n") == 0);
+	CHECK (output.isTruncated ());
+	CHECK (status == 0);
+
+	output.setLimits (0, 2, true);
+	CHECK (worker->execute ("echo 1; echo 2; echo 3; printf 4", 5000, output, status) == WORKER_OK);
+	CHECK (output.getData () == "3\n4");
+	CHECK (output.isTruncated ());
+
+	/* A marker split across reads is still found */
+	output.setLimits (0, 0, false);
+	CHECK (worker->execute ("printf '%4090s' ''", 5000, output, status) == WORKER_OK);
+	CHECK (output.getData () == string (4090, ' '));
+	CHECK (! output.isTruncated ());
+}
+
+static void
+testTimeout (Pandora_Exec_Worker *worker) {
+	unsigned long long start;
+	unsigned long      restarts;
+	string             output;
+	int                status;
+
+	restarts = worker->getRestarts ();
+	start = Pandora_Timing::getMicroseconds ();
+	CHECK (execute (worker, "sleep 10", 300, output, status) == WORKER_TIMEOUT);
+	CHECK (Pandora_Timing::getMicroseconds () - start < 3000000);
+	CHECK (worker->getRestarts () == restarts + 1);
+
+	/* A new shell runs the next command, without the old state */
+	CHECK (execute (worker, "echo x$WORKER_TEST", 5000, output, status) == WORKER_OK);
+	CHECK (output == "x\n" && status == 0);
+}
+
+static void
+testShellExit (Pandora_Exec_Worker *worker) {
+	char          path[] = "/tmp/pandora_exec_workerXXXXXX";
+	unsigned long restarts;
+	string        output, line;
+	int           status, fd, lines = 0;
+
+	fd = mkstemp (path);
+	CHECK (fd >= 0);
+	close (fd);
+
+	/* The command made the shell exit: it is reported as failed and
+	   it is not run again */
+	restarts = worker->getRestarts ();
+	CHECK (execute (worker, "echo run >> " + string (path) + "; exit 3", 5000, output, status) == WORKER_FAILED);
+	CHECK (status != 0);
+	CHECK (worker->getRestarts () == restarts + 1);
+
+	ifstream file (path);
+	while (getline (file, line)) {
+		lines++;
+	}
+	CHECK (lines == 1);
+	unlink (path);
+
+	CHECK (execute (worker, "echo again", 5000, output, status) == WORKER_OK);
+	CHECK (output == "again\n" && status == 0);
+}
+
+static void
+testSettings (Pandora_Exec_Worker *worker) {
+	string environment ("WORKER_VALUE=set\0PATH=/bin:/usr/bin\0", 35);
+	string output;
+	int    status;
+
+	worker->setWorkingDir ("/");
+	worker->setEnvironment (environment);
+	CHECK (execute (worker, "pwd; echo $WORKER_VALUE", 5000, output, status) == WORKER_OK);
+	CHECK (output == "/\nset\n");
+
+	/* Disabling the worker stops the shell */
+	worker->setEnabled (false);
+	CHECK (! worker->isEnabled ());
+}
+
+int
+main () {
+	Pandora_Exec_Worker *worker = Pandora_Exec_Worker::getInstance ();
+
+	worker->setEnabled (true);
+	testOutput (worker);
+	testLimits (worker);
+	testTimeout (worker);
+	testShellExit (worker);
+	testSettings (worker);
+
+	return TEST_RESULT ("test_exec_worker");
+}
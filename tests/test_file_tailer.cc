@@ -0,0 +1,286 @@
+/* Tests of the file tailer of the regexp modules.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "modules/pandora_file_tailer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Pandora_Modules;
+
+/**
+ * Subscriber that keeps the lines it gets.
+ */
+class Collector : public Pandora_Tailer_Subscriber {
+private:
+	string pattern;
+public:
+	vector<string> lines;
+
+	Collector (string pattern) {
+		this->pattern = pattern;
+	}
+
+	string getPattern () const {
+		return this->pattern;
+	}
+
+	void processMatch (const string &line) {
+		this->lines.push_back (line);
+	}
+
+	/* Get the lines, one per line, and forget them */
+	string take () {
+		string result;
+		size_t i;
+
+		for (i = 0; i < this->lines.size (); i++) {
+			result += this->lines[i] + "\n";
+		}
+		this->lines.clear ();
+		return result;
+	}
+};
+
+static void
+writeFile (const string &path, const char *text, const char *mode) {
+	FILE *file;
+
+	file = fopen (path.c_str (), mode);
+	CHECK (file != NULL);
+	if (file != NULL) {
+		fputs (text, file);
+		fclose (file);
+	}
+}
+
+/* Count the open file descriptors of the process */
+static int
+countOpenFiles () {
+	DIR           *dir;
+	struct dirent *entry;
+	int            count = 0;
+
+	dir = opendir ("/proc/self/fd");
+	if (dir == NULL) {
+		return -1;
+	}
+	while ((entry = readdir (dir)) != NULL) {
+		if (entry->d_name[0] != '.') {
+			count++;
+		}
+	}
+	closedir (dir);
+	return count;
+}
+
+/* Forget the checkpoints read from the file, as a restart of the agent */
+static void
+restart (const string &dir) {
+	Pandora_File_Tailer::setCheckpointDir ("");
+	Pandora_File_Tailer::setCheckpointDir (dir);
+}
+
+static void
+testSingle (const string &dir) {
+	Pandora_File_Tailer *tailer, *other;
+	Collector            a ("^a"), b ("b"), resumed ("^a");
+	string               path = dir + "app.log";
+
+	writeFile (path, "a old\n", "wb");
+
+	/* Without a checkpoint the file is read from its end. Modules on
+	   the same file share the tailer. */
+	tailer = Pandora_File_Tailer::subscribe (path, false, &a);
+	other = Pandora_File_Tailer::subscribe (path, false, &b);
+	CHECK (tailer == other);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "" && b.take () == "");
+
+	writeFile (path, "a1\nb1\nab\n", "ab");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a1\nab\n");
+	CHECK (b.take () == "b1\nab\n");
+
+	/* A partial last line waits until it is complete */
+	writeFile (path, "a2 part", "ab");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "");
+	writeFile (path, "ial\r\n\n", "ab");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a2 partial\n");
+
+	/* Rotated by renaming: the old file is read to the end, its last
+	   line included, and then the new one from the start */
+	writeFile (path, "a3 before\n", "ab");
+	CHECK (rename (path.c_str (), (path + ".1").c_str ()) == 0);
+	writeFile (path + ".1", "a3 after\na3 last", "ab");
+	writeFile (path, "a4 new\n", "wb");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a3 before\na3 after\na3 last\na4 new\n");
+	unlink ((path + ".1").c_str ());
+
+	/* Truncated: read from the start */
+	writeFile (path, "a5\n", "wb");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a5\n");
+
+	writeFile (path, "a6\n", "ab");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a6\n");
+	b.take ();
+
+	/* Unsubscribed, the lines written meanwhile are read on the
+	   next start from the checkpoint */
+	other->unsubscribe (&b);
+	tailer->unsubscribe (&a);
+	writeFile (path, "a7 while stopped\n", "ab");
+	restart (dir);
+
+	tailer = Pandora_File_Tailer::subscribe (path, false, &resumed);
+	CHECK (tailer->poll ());
+	CHECK (resumed.take () == "a7 while stopped\n");
+	tailer->unsubscribe (&resumed);
+
+	/* module_noseekeof: the whole file on every poll, apart */
+	tailer = Pandora_File_Tailer::subscribe (path, true, &a);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a5\na6\na7 while stopped\n");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a5\na6\na7 while stopped\n");
+	tailer->unsubscribe (&a);
+
+	unlink (path.c_str ());
+}
+
+static void
+testMultiple (const string &dir) {
+	Pandora_File_Tailer *tailer;
+	Collector            a ("^a");
+	string               logs = dir + "logs/", lines;
+	char                 name[64];
+	int                  open_files, i;
+
+	CHECK (mkdir (logs.c_str (), 0700) == 0);
+	writeFile (logs + "app1.log", "a1 old\n", "wb");
+	writeFile (logs + "other.txt", "a other\n", "wb");
+
+	CHECK (Pandora_File_Tailer::isMultiple (logs + "app*.log"));
+	CHECK (Pandora_File_Tailer::isMultiple (logs));
+	CHECK (! Pandora_File_Tailer::isMultiple (logs + "app1.log"));
+
+	/* Checkpoints of their own, the files of testSingle () are gone
+	   and their inodes may be reused */
+	Pandora_File_Tailer::setCheckpointDir (logs);
+
+	/* Listed every second, with up to 2 files open */
+	open_files = countOpenFiles ();
+	tailer = Pandora_File_Tailer::subscribe (logs + "app*.log", false, &a);
+	tailer->setListing (1, 2);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "");
+
+	/* Only the listed files are read */
+	writeFile (logs + "app1.log", "a1 new\n", "ab");
+	writeFile (logs + "other.txt", "a other new\n", "ab");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a1 new\n");
+
+	/* A file created after the first listing is read from the start */
+	writeFile (logs + "app2.log", "a2 first\n", "wb");
+	sleep (1);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a2 first\n");
+
+	/* A renamed file keeps its offset */
+	CHECK (rename ((logs + "app1.log").c_str (), (logs + "app1-old.log").c_str ()) == 0);
+	writeFile (logs + "app1-old.log", "a1 renamed\n", "ab");
+	sleep (1);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a1 renamed\n");
+
+	/* A file gone from the listing is read to the end and dropped */
+	writeFile (logs + "app2.log", "a2 last", "ab");
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "");
+	unlink ((logs + "app2.log").c_str ());
+	sleep (1);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a2 last\n");
+
+	/* More files than module_regexp_max_files: the idle ones are
+	   closed, and read again when the listing shows they grew */
+	for (i = 3; i <= 6; i++) {
+		sprintf (name, "app%d.log", i);
+		writeFile (logs + name, "a new\n", "wb");
+	}
+	sleep (1);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a new\na new\na new\na new\n");
+	CHECK (countOpenFiles () - open_files <= 2);
+
+	for (i = 3; i <= 6; i++) {
+		sprintf (name, "app%d.log", i);
+		writeFile (logs + name, "a more\n", "ab");
+	}
+	writeFile (logs + "app1-old.log", "a more\n", "ab");
+	sleep (1);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "a more\na more\na more\na more\na more\n");
+	CHECK (countOpenFiles () - open_files <= 2);
+
+	/* Nothing is read twice */
+	sleep (1);
+	CHECK (tailer->poll ());
+	CHECK (a.take () == "");
+
+	tailer->unsubscribe (&a);
+	CHECK (countOpenFiles () == open_files);
+
+	unlink ((logs + "app1-old.log").c_str ());
+	unlink ((logs + "other.txt").c_str ());
+	unlink ((logs + "regexp_checkpoints.dat").c_str ());
+	for (i = 3; i <= 6; i++) {
+		sprintf (name, "app%d.log", i);
+		unlink ((logs + name).c_str ());
+	}
+	rmdir (logs.c_str ());
+}
+
+int
+main () {
+	char   dir[] = "/tmp/pandora_file_tailerXXXXXX";
+	string path;
+
+	CHECK (mkdtemp (dir) != NULL);
+	path = string (dir) + "/";
+	Pandora_File_Tailer::setCheckpointDir (path);
+
+	testSingle (path);
+	testMultiple (path);
+
+	unlink ((path + "regexp_checkpoints.dat").c_str ());
+	rmdir (dir);
+
+	return TEST_RESULT ("test_file_tailer");
+}
@@ -0,0 +1,182 @@
+/* Tests of the literal filter against regexec ().
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "modules/pandora_literal_filter.h"
+#include "boost/regex.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Pandora_Modules;
+
+/* Patterns, with the literal expected from them */
+static const struct {
+	const char *pattern;
+	bool        extended;
+	const char *literal;
+} patterns[] = {
+	{ "ERROR", true, "ERROR" },
+	{ "[[:digit:]]ERROR", true, "ERROR" },
+	{ "[[:digit:]]]ERROR", true, "]ERROR" },
+	{ "[[:alpha:][:digit:]]+ failed", true, " failed" },
+	{ "[]a]x", true, "x" },
+	{ "[^]a]xyz", true, "xyz" },
+	{ "[[.-.]a]bc", true, "bc" },
+	{ "[[=e=]]rror", true, "rror" },
+	{ "[[:digit:]]ERROR", false, "ERROR" },
+	{ "\\<ERROR\\>", true, "ERROR" },
+	{ "\\<ERROR\\>", false, "ERROR" },
+	{ "disk\\.full", true, "disk.full" },
+	{ "colou?r", true, "colo" },
+	{ "colou\\?r", false, "colo" },
+	{ "ab+c", true, "ab" },
+	{ "warn|error", true, "" },
+	{ "warn\\|error", false, "" },
+	{ "(warn|error): disk", true, ": disk" },
+	{ "\\(a\\)bc*", false, "b" },
+	{ "x{2,3}yz", true, "yz" },
+	{ "x\\{2,3\\}yz", false, "yz" },
+	{ "a.b", true, "a" },
+	{ "^start", true, "start" },
+	{ "end$", true, "end" },
+	{ "\\w+ing", true, "ing" },
+	{ "(?i)error", false, "(?i)error" },
+};
+
+/* Texts checked against every pattern */
+static const char *texts[] = {
+	"", "ERROR", "5ERROR", "x5ERROR", "5]ERROR", "]ERROR", "ab1 failed",
+	"]x", "ax", "bxyz", "-bc", "abc", "erroror", "rror", "an ERROR here",
+	"ERRORS", "disk.full", "diskXfull", "color", "colour", "colouur", "abbbc",
+	"warn", "error", "warn: disk", "error: disk", "abc", "ac", "b", "xxyz",
+	"xxxyz", "yz", "a-b", "start of line", "the end", "testing", "ERROR\n",
+};
+
+/* Pieces of the random patterns */
+static const char *pieces[] = {
+	"a", "b", "E", "1", "-", "]", ".", "*", "+", "?", "^", "$", "|", "(", ")",
+	"[ab]", "[^a]", "[]a]", "[^]b]", "[[:digit:]]", "[[:alpha:]b]", "[[.-.]]",
+	"[[=a=]]", "[a-c]", "{1,2}", "{0}", "\\.", "\\<", "\\>", "\\(", "\\)",
+	"\\|", "\\{1\\}", "\\?", "\\+", "\\1", "\\w", "[",
+};
+
+/* Bytes of the random texts */
+static const char alphabet[] = "abE1-].x ";
+
+/**
+ * Check that every text matched by a pattern passes its filter.
+ *
+ * @return False if the pattern does not compile.
+ */
+static bool
+checkPattern (const string &pattern, bool extended, const vector<string> &samples) {
+	regex_t                regexp;
+	size_t                 i;
+	bool                   passed = true;
+
+	if (regcomp (&regexp, pattern.c_str (), extended ? REG_EXTENDED : 0) != 0) {
+		return false;
+	}
+
+	Pandora_Literal_Filter filter (pattern, extended);
+	for (i = 0; i < samples.size (); i++) {
+		if (regexec (&regexp, samples[i].c_str (), 0, NULL, 0) == 0 &&
+		    ! filter.mayMatch (samples[i].data (), samples[i].size ())) {
+			fprintf (stderr, "%s pattern \"%s\" (literal \"%s\") matches \"%s\"\n",
+				 extended ? "Extended" : "Basic", pattern.c_str (),
+				 filter.getLiteral ().c_str (), samples[i].c_str ());
+			passed = false;
+		}
+	}
+	CHECK (passed);
+
+	regfree (&regexp);
+	return true;
+}
+
+static void
+testCorpus () {
+	vector<string> samples (texts, texts + sizeof (texts) / sizeof (texts[0]));
+	size_t         i;
+
+	for (i = 0; i < sizeof (patterns) / sizeof (patterns[0]); i++) {
+		Pandora_Literal_Filter filter (patterns[i].pattern, patterns[i].extended);
+
+		if (filter.getLiteral () != patterns[i].literal) {
+			fprintf (stderr, "Pattern \"%s\": literal \"%s\", expected \"%s\"\n",
+				 patterns[i].pattern, filter.getLiteral ().c_str (),
+				 patterns[i].literal);
+		}
+		CHECK (filter.getLiteral () == patterns[i].literal);
+		CHECK (checkPattern (patterns[i].pattern, patterns[i].extended, samples));
+	}
+}
+
+static void
+testRandom () {
+	vector<string> samples;
+	string         pattern, text;
+	size_t         num_pieces = sizeof (pieces) / sizeof (pieces[0]);
+	int            i, j, length, compiled = 0;
+
+	srand (42);
+	for (i = 0; i < 300; i++) {
+		text.erase ();
+		length = rand () % 8;
+		for (j = 0; j < length; j++) {
+			text += alphabet[rand () % (sizeof (alphabet) - 1)];
+		}
+		samples.push_back (text);
+	}
+
+	for (i = 0; i < 4000; i++) {
+		pattern.erase ();
+		length = 1 + rand () % 5;
+		for (j = 0; j < length; j++) {
+			pattern += pieces[rand () % num_pieces];
+		}
+		if (checkPattern (pattern, (i % 2) == 0, samples)) {
+			compiled++;
+		}
+	}
+
+	/* Most of them are valid */
+	CHECK (compiled > 1000);
+}
+
+static void
+testMayMatch () {
+	Pandora_Literal_Filter filter ("[[:digit:]]ERROR", true);
+
+	CHECK (filter.mayMatch ("5ERROR", 6));
+	CHECK (filter.mayMatch ("x ERROR y", 9));
+	CHECK (! filter.mayMatch ("5ERRO", 5));
+	CHECK (! filter.mayMatch ("error", 5));
+}
+
+int
+main () {
+	testCorpus ();
+	testRandom ();
+	testMayMatch ();
+
+	return TEST_RESULT ("test_literal_filter");
+}
@@ -0,0 +1,192 @@
+/* Tests of the splitting of log modules in XML elements.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "misc/pandora_log_xml.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define DATA_BEGIN "\t<data>"
+#define DATA_END   "</data></log_module>"
+
+/* Parse a run of CDATA sections, as an XML parser would, and undo the
+   doubling of the %. Returns false if there is anything else. */
+static bool
+parseCdata (const string &xml, string &text) {
+	size_t pos, end, i;
+	string raw;
+
+	pos = 0;
+	while (pos < xml.size ()) {
+		if (xml.compare (pos, 9, "<![CDATA[") != 0) {
+			return false;
+		}
+		end = xml.find ("]]>", pos + 9);
+		if (end == string::npos) {
+			return false;
+		}
+		raw.append (xml, pos + 9, end - pos - 9);
+		pos = end + 3;
+	}
+
+	text.clear ();
+	for (i = 0; i < raw.size (); i++) {
+		if (raw[i] == '%') {
+			if (i + 1 >= raw.size () || raw[i + 1] != '%') {
+				return false;
+			}
+			i++;
+		}
+		text += raw[i];
+	}
+	return true;
+}
+
+/* Split the data and check the elements: their size, that they are
+   well formed and that they give back the data and source */
+static void
+checkSplit (const string &source, const string &dropped, const string &data,
+	    size_t max_size, list<string> &chunks) {
+	list<string>::iterator iter;
+	string                 joined, head, text;
+	size_t                 begin, end;
+	bool                   ok;
+
+	chunks.clear ();
+	Pandora_Log_Xml::split (source, dropped, data, max_size, chunks);
+	CHECK (! chunks.empty ());
+
+	for (iter = chunks.begin (); iter != chunks.end (); iter++) {
+		if (max_size > 0) {
+			CHECK (iter->size () <= max_size);
+		}
+		CHECK (iter->compare (0, 22, "<log_module>\n\t<source>") == 0);
+
+		/* The source */
+		end = iter->find ("</source>\n");
+		CHECK (end != string::npos);
+		ok = parseCdata (iter->substr (22, end - 22), text);
+		CHECK (ok && text == source);
+
+		/* Dropped data only in the first element */
+		head = (iter == chunks.begin ()) ? dropped : "";
+		CHECK (iter->compare (end + 10, head.size (), head) == 0);
+
+		/* The data */
+		begin = end + 10 + head.size ();
+		CHECK (iter->compare (begin, strlen (DATA_BEGIN), DATA_BEGIN) == 0);
+		begin += strlen (DATA_BEGIN);
+		end = iter->size () - strlen (DATA_END);
+		CHECK (iter->compare (end, string::npos, DATA_END) == 0);
+		ok = parseCdata (iter->substr (begin, end - begin), text);
+		CHECK (ok);
+		joined += text;
+	}
+
+	CHECK (joined == data);
+}
+
+/* Check that no element splits a UTF-8 character */
+static bool
+cutsCharacter (const list<string> &chunks) {
+	list<string>::const_iterator iter;
+	size_t                       pos;
+
+	for (iter = chunks.begin (); iter != chunks.end (); iter++) {
+		pos = iter->find ("\t<data><![CDATA[") + 16;
+		if (((unsigned char) (*iter)[pos] & 0xC0) == 0x80) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int
+main () {
+	list<string> chunks;
+	list<string>::iterator iter;
+	string       data, dropped;
+	int          i, j;
+
+	/* Escaping */
+	CHECK (Pandora_Log_Xml::escapeCdata ("a%b") == "a%%b");
+	CHECK (Pandora_Log_Xml::escapeCdata ("a]]>b") == "a]]]]><![CDATA[>b");
+	CHECK (Pandora_Log_Xml::escapeCdata ("]]]>]]>") == "]]]]]><![CDATA[>]]]]><![CDATA[>");
+
+	/* No limit, or no data: a single element */
+	checkSplit ("log", "", "line 1\nline 2\n", 0, chunks);
+	CHECK (chunks.size () == 1);
+	checkSplit ("log", "", "", 1000, chunks);
+	CHECK (chunks.size () == 1);
+
+	/* Lines that fit are not cut, and the tags count in the size */
+	for (i = 0; i < 100; i++) {
+		data += "line number " + string (1, 'a' + i % 26) + " of the log\n";
+	}
+	checkSplit ("log", "", data, 1000, chunks);
+	CHECK (chunks.size () > 2);
+	for (iter = chunks.begin (); iter != chunks.end (); iter++) {
+		CHECK (iter->find ("\n]]></data>") != string::npos);
+	}
+
+	/* The dropped data and the source count too */
+	dropped = "\t<dropped_lines><![CDATA[5]]></dropped_lines>\n"
+		  "\t<dropped_bytes><![CDATA[500]]></dropped_bytes>\n";
+	checkSplit ("a]]>source%", dropped, data, 1000, chunks);
+
+	/* Everything escaped grows the data */
+	data.clear ();
+	for (i = 0; i < 100; i++) {
+		data += "100% done ]]> ]]]>%%\n";
+	}
+	checkSplit ("log", "", data, 700, chunks);
+
+	/* A long line is cut between characters */
+	data.clear ();
+	for (i = 0; i < 1000; i++) {
+		data += "\xc3\xa9\xe2\x82\xac";
+	}
+	for (i = 700; i < 720; i++) {
+		checkSplit ("log", "", data, i, chunks);
+		CHECK (! cutsCharacter (chunks));
+	}
+
+	/* Random data */
+	srand (42);
+	for (i = 0; i < 200; i++) {
+		data.clear ();
+		for (j = rand () % 3000; j > 0; j--) {
+			static const char alphabet[] = "ab%]>\n\xc3\xa9";
+
+			data += alphabet[rand () % (sizeof (alphabet) - 1)];
+		}
+		checkSplit ("log", (i % 2) ? dropped : "", data, 800 + rand () % 1000, chunks);
+	}
+
+	/* Tags bigger than the size: LOG_XML_MIN_DATA of data anyway */
+	data = string (2000, 'x');
+	checkSplit ("log", "", data, 0, chunks);
+	chunks.clear ();
+	Pandora_Log_Xml::split ("log", "", data, 10, chunks);
+	CHECK (chunks.size () == 4);
+
+	return TEST_RESULT ("test_log_xml");
+}
@@ -0,0 +1,160 @@
+/* Tests of the module definition parser.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "modules/pandora_module_definition.h"
+
+using namespace Pandora_Modules;
+
+static void
+testTokens () {
+	list<string> errors;
+	string       definition;
+
+	definition  = "module_begin\n";
+	definition += "  module_name  Disk  \r\n";
+	definition += "module_name Other\n";
+	definition += "# module_exec commented\n";
+	definition += "\n";
+	definition += "module_exec df -k\n";
+	definition += "module_condition > 10 alert.sh\n";
+	definition += "module_condition < 2 other.sh\n";
+	definition += "module_unknown 1\n";
+	definition += "module_end\n";
+
+	Pandora_Module_Definition parsed (definition, &errors);
+
+	/* The first value of a token is kept */
+	CHECK (parsed.getValue (TOKEN_NAME) == " Disk");
+	CHECK (parsed.getValue (TOKEN_EXEC) == "df -k");
+	CHECK (parsed.getValue (TOKEN_TYPE) == "");
+
+	/* Every condition is kept, in order */
+	CHECK (parsed.getValues (TOKEN_CONDITION).size () == 2);
+	CHECK (parsed.getValues (TOKEN_CONDITION).front () == "> 10 alert.sh");
+	CHECK (parsed.getValues (TOKEN_CONDITION).back () == "< 2 other.sh");
+	CHECK (parsed.getValues (TOKEN_PRECONDITION).empty ());
+
+	CHECK (errors.size () == 1);
+	CHECK (! errors.empty () && errors.front () == "Unknown token: module_unknown 1");
+	CHECK (parsed.getKind () == MODULE_EXEC);
+}
+
+static void
+testPrefixTokens () {
+	list<string> errors;
+
+	/* Empty values are not missing values */
+	Pandora_Module_Definition memory ("module_freememory\nmodule_async\n", &errors);
+	CHECK (errors.empty ());
+	CHECK (memory.getKind () == MODULE_FREEMEMORY);
+	CHECK (memory.getValue (TOKEN_ASYNC) == " ");
+
+	Pandora_Module_Definition percent ("module_freepercentmemory\n", &errors);
+	CHECK (percent.getKind () == MODULE_FREEMEMORY_PERCENT);
+
+	Pandora_Module_Definition snmp ("module_snmpget\nmodule_snmp_version 2c\n", &errors);
+	CHECK (snmp.getKind () == MODULE_SNMPGET);
+	CHECK (snmp.getValue (TOKEN_SNMPVERSION) == "2c");
+	CHECK (errors.empty ());
+}
+
+static void
+testMacros () {
+	list<string> errors;
+	string       definition;
+
+	definition  = "module_macro_disk_ C:\n";
+	definition += "module_name Free _disk_\n";
+	definition += "module_freedisk _disk_\n";
+	definition += "module_condition < 10 cleanup.bat _disk_\n";
+
+	Pandora_Module_Definition parsed (definition, &errors);
+
+	CHECK (errors.empty ());
+	CHECK (parsed.getValue (TOKEN_NAME) == "Free C:");
+	CHECK (parsed.getValue (TOKEN_FREEDISK) == "C:");
+	CHECK (parsed.getValues (TOKEN_CONDITION).front () == "< 10 cleanup.bat C:");
+	CHECK (parsed.getValues (TOKEN_MACRO).front () == "_disk_ C:");
+}
+
+static void
+testKind () {
+	list<string> errors;
+
+	/* Same precedence as the module factory */
+	Pandora_Module_Definition exec ("module_plugin p.sh\nmodule_exec e.sh\n", &errors);
+	CHECK (exec.getKind () == MODULE_EXEC);
+
+	Pandora_Module_Definition plugin ("module_plugin p.sh\n", &errors);
+	CHECK (plugin.getKind () == MODULE_PLUGIN);
+
+	Pandora_Module_Definition none ("module_name Nothing\n", &errors);
+	CHECK (none.getKind () == MODULE_0);
+}
+
+static void
+testValues () {
+	list<string> errors;
+
+	Pandora_Module_Definition parsed ("module_persistent yes\nmodule_watchdog 0\n", &errors);
+	CHECK (parsed.isEnabled (TOKEN_PERSISTENT));
+	CHECK (! parsed.isEnabled (TOKEN_WATCHDOG));
+	CHECK (! parsed.isEnabled (TOKEN_ASYNC));
+
+	CHECK (Pandora_Module_Definition::parseType ("") == TYPE_GENERIC_DATA);
+	CHECK (Pandora_Module_Definition::parseType ("generic_data_string") == TYPE_GENERIC_DATA_STRING);
+	CHECK (Pandora_Module_Definition::parseType ("log") == TYPE_LOG);
+	CHECK (Pandora_Module_Definition::parseType ("generic_string") == TYPE_0);
+}
+
+static void
+testConditions () {
+	Condition cond;
+
+	CHECK (Pandora_Module_Definition::parseCondition ("> 10.5 alert.sh now", false, &cond));
+	CHECK (cond.operation == ">" && cond.value_1 == 10.5 && cond.command == "alert.sh now");
+
+	CHECK (Pandora_Module_Definition::parseCondition ("=~ ^err.* alert.sh", false, &cond));
+	CHECK (cond.operation == "=~" && cond.string_value == "^err.*" && cond.command == "alert.sh");
+
+	CHECK (Pandora_Module_Definition::parseCondition ("(1 , 5) alert.sh", false, &cond));
+	CHECK (cond.operation == "()" && cond.value_1 == 1 && cond.value_2 == 5);
+	CHECK (cond.string_value == "");
+
+	/* Conditions need a command, intensive conditions do not */
+	CHECK (! Pandora_Module_Definition::parseCondition ("> 10", false, &cond));
+	CHECK (Pandora_Module_Definition::parseCondition ("> 10", true, &cond));
+	CHECK (cond.command == "");
+	CHECK (Pandora_Module_Definition::parseCondition ("=~ ^err", true, &cond));
+	CHECK (Pandora_Module_Definition::parseCondition ("(1 , 5)", true, &cond));
+	CHECK (! Pandora_Module_Definition::parseCondition ("anything", true, &cond));
+}
+
+int
+main () {
+	testTokens ();
+	testPrefixTokens ();
+	testMacros ();
+	testKind ();
+	testValues ();
+	testConditions ();
+
+	return TEST_RESULT ("test_module_definition");
+}
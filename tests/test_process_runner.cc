@@ -0,0 +1,195 @@
+/* Tests of the process runner on POSIX systems.
+
+   Copyright (C) 2014 Artica ST.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include "pandora_test.h"
+#include "misc/pandora_process_runner.h"
+#include "misc/pandora_timing.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cerrno>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+
+using namespace Pandora;
+
+/**
+ * Check whether a process is gone (or a zombie waiting to be reaped).
+ */
+static bool
+isDead (pid_t pid) {
+	ostringstream path;
+	string        stat;
+
+	if (kill (pid, 0) != 0 && errno == ESRCH) {
+		return true;
+	}
+
+	path << "/proc/" << pid << "/stat";
+	ifstream file (path.str ().c_str ());
+	getline (file, stat);
+	return stat.find (") Z") != string::npos;
+}
+
+static void
+testExitCode () {
+	Pandora_Process_Runner ok ("echo out; echo err >&2");
+	Pandora_Process_Runner failed ("echo partial; exit 5");
+
+	CHECK (ok.run () == RUNNER_OK);
+	CHECK (ok.getOutput () == "out\nerr\n");
+	CHECK (ok.getExitCode () == 0);
+	CHECK (! ok.isTruncated ());
+
+	/* A nonzero exit is not an error of the runner */
+	CHECK (failed.run () == RUNNER_OK);
+	CHECK (failed.getOutput () == "partial\n");
+	CHECK (failed.getExitCode () == 5);
+}
+
+static void
+testTimeout () {
+	char               path[] = "/tmp/pandora_process_runnerXXXXXX";
+	unsigned long long start;
+	pid_t              child = 0;
+	int                fd;
+
+	fd = mkstemp (path);
+	CHECK (fd >= 0);
+	close (fd);
+
+	/* The command and the child it started are killed */
+	Pandora_Process_Runner runner ("sleep 30 & echo $! > " + string (path) + "; echo started; sleep 30");
+	runner.setTimeout (300);
+	start = Pandora_Timing::getMicroseconds ();
+	CHECK (runner.run () == RUNNER_TIMEOUT);
+	CHECK (Pandora_Timing::getMicroseconds () - start < 3000000);
+	CHECK (runner.getExitCode () == 128 + SIGKILL);
+	CHECK (runner.getOutput () == "started\n");
+
+	ifstream file (path);
+	file >> child;
+	CHECK (child > 0);
+	if (child > 0) {
+		poll (NULL, 0, 100);
+		CHECK (isDead (child));
+	}
+	unlink (path);
+
+	/* A child that keeps the output open does not delay the result */
+	Pandora_Process_Runner background ("sleep 3 & echo done");
+	background.setTimeout (10000);
+	start = Pandora_Timing::getMicroseconds ();
+	CHECK (background.run () == RUNNER_OK);
+	CHECK (Pandora_Timing::getMicroseconds () - start < 1000000);
+	CHECK (background.getOutput () == "done\n");
+}
+
+static void
+testLimits () {
+	Pandora_Process_Runner bytes ("yes 0123456789 | head -c 1000000");
+	Pandora_Process_Runner lines ("i=1; while [ $i -le 100 ]; do echo $i; i=$((i+1)); done");
+	Pandora_Process_Runner last ("i=1; while [ $i -le 100 ]; do echo $i; i=$((i+1)); done");
+
+	/* The rest of the output is read and discarded, the process is
+	   not blocked on a full pipe */
+	bytes.setMaxOutput (1000);
+	bytes.setTimeout (10000);
+	CHECK (bytes.run () == RUNNER_OK);
+	CHECK (bytes.getOutput ().size () <= 1000);
+	CHECK (bytes.getOutput ().compare (0, 15, "0123456789\n0123") == 0);
+	CHECK (bytes.isTruncated ());
+	CHECK (bytes.getExitCode () == 0);
+
+	lines.setMaxLines (3);
+	CHECK (lines.run () == RUNNER_OK);
+	CHECK (lines.getOutput () == "1\n2\n3\n");
+	CHECK (lines.isTruncated ());
+
+	last.setMaxLines (3);
+	last.setKeepLast (true);
+	CHECK (last.run () == RUNNER_OK);
+	CHECK (last.getOutput () == "98\n99\n100\n");
+	CHECK (last.isTruncated ());
+}
+
+static void
+testSettings () {
+	string environment ("RUNNER_VALUE=set\0PATH=/bin:/usr/bin\0", 35);
+	Pandora_Process_Runner runner ("pwd; echo $RUNNER_VALUE");
+
+	runner.setWorkingDir ("/");
+	runner.setEnvironment (environment);
+	CHECK (runner.run () == RUNNER_OK);
+	CHECK (runner.getOutput () == "/\nset\n");
+}
+
+static void *
+runSleep (void *) {
+	Pandora_Process_Runner runner ("sleep 0.3");
+
+	runner.run ();
+	return NULL;
+}
+
+/**
+ * Time to run some sleeps at the same time, in milliseconds.
+ */
+static unsigned long long
+timeSleeps (int count) {
+	vector<pthread_t>  threads (count);
+	unsigned long long start;
+	int                i;
+
+	start = Pandora_Timing::getMicroseconds ();
+	for (i = 0; i < count; i++) {
+		pthread_create (&threads[i], NULL, runSleep, NULL);
+	}
+	for (i = 0; i < count; i++) {
+		pthread_join (threads[i], NULL);
+	}
+
+	return (Pandora_Timing::getMicroseconds () - start) / 1000;
+}
+
+static void
+testSlots () {
+	/* One slot: the processes run one after another */
+	Pandora_Process_Runner::setMaxProcesses (1);
+	CHECK (timeSleeps (3) >= 900);
+
+	/* No limit: they run at the same time */
+	Pandora_Process_Runner::setMaxProcesses (0);
+	CHECK (timeSleeps (3) < 800);
+}
+
+int
+main () {
+	testExitCode ();
+	testTimeout ();
+	testLimits ();
+	testSettings ();
+	testSlots ();
+
+	return TEST_RESULT ("test_process_runner");
+}